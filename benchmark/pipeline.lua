@@ -0,0 +1,19 @@
+-- wrk script sending the requests of each connection pipelined, depth
+-- requests per write (default 16).
+--
+-- usage: wrk -t 10 -c 400 -d 15 -s pipeline.lua http://127.0.0.1:80/hello.html -- 16
+
+local depth = 16
+
+init = function(args)
+   depth = tonumber(args[1]) or depth
+   local r = {}
+   for i = 1, depth do
+      r[i] = wrk.format(nil, wrk.path)
+   end
+   req = table.concat(r)
+end
+
+request = function()
+   return req
+end
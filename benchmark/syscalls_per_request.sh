@@ -0,0 +1,51 @@
+#!/bin/bash
+#
+# Runs wrk against a running zproxy process and reports the number of system
+# calls executed by zproxy per request served. Run it once per EventEngine
+# (epoll / io_uring) to compare both engines.
+#
+# usage: ./syscalls_per_request.sh -p <zproxy pid> [-u url] [-d duration]
+#                                  [-c connections] [-t threads]
+#
+# Requires wrk (https://github.com/wg/wrk) and perf with tracepoint support.
+
+url="http://127.0.0.1:80/hello.html"
+duration=15
+connections=400
+threads=10
+pid=""
+
+while getopts p:u:d:c:t: opts; do
+    case ${opts} in
+        p) pid=${OPTARG} ;;
+        u) url=${OPTARG} ;;
+        d) duration=${OPTARG} ;;
+        c) connections=${OPTARG} ;;
+        t) threads=${OPTARG} ;;
+        *) echo "Unknown argument ${opts}"; exit 1 ;;
+    esac
+done
+
+if [ -z "$pid" ]; then
+    echo "zproxy pid is required (-p)"
+    exit 1
+fi
+
+perf_out=$(mktemp)
+perf stat -e raw_syscalls:sys_enter -p "$pid" -x, -o "$perf_out" &
+perf_pid=$!
+sleep 1
+
+wrk_out=$(wrk -d "$duration" -t "$threads" -c "$connections" "$url")
+kill -INT $perf_pid
+wait $perf_pid 2>/dev/null
+
+requests=$(echo "$wrk_out" | grep "requests in" | awk '{print $1}')
+syscalls=$(grep raw_syscalls "$perf_out" | cut -d, -f1)
+rm -f "$perf_out"
+
+echo "$wrk_out"
+echo ""
+echo "Requests:          $requests"
+echo "System calls:      $syscalls"
+echo "Syscalls/request:  $(echo "scale=2; $syscalls / $requests" | bc)"
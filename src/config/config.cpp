@@ -32,7 +32,9 @@
 #include <syslog.h>
 #undef NULL
 #undef SYSLOG_NAMES
+#include "../connection/connection_pool.h"
 #include "../debug/logger.h"
+#include "../event/dns_resolver.h"
 #include "../util/network.h"
 #include "config.h"
 #include "regex_manager.h"
@@ -87,6 +89,12 @@ void Config::parse_file() {
       daemonize = atoi(lin + matches[1].rm_so);
     } else if (!regexec(&regex_set::Threads, lin, 4, matches, 0)) {
       numthreads = atoi(lin + matches[1].rm_so);
+    } else if (!regexec(&regex_set::EventEngine, lin, 4, matches, 0)) {
+      event_engine = lin[matches[1].rm_so] == 'i' ? 1 : 0;
+    } else if (!regexec(&regex_set::AcceptBudget, lin, 4, matches, 0)) {
+      accept_budget = atoi(lin + matches[1].rm_so);
+    } else if (!regexec(&regex_set::WorkerAffinity, lin, 4, matches, 0)) {
+      worker_affinity = std::string(lin + matches[1].rm_so, static_cast<size_t>(matches[1].rm_eo - matches[1].rm_so));
     } else if (!regexec(&regex_set::ThreadModel, lin, 4, matches,
                         0)) {  // ignore
       // threadpool = ((lin[matches[1].rm_so] | 0x20) == 'p'); /* 'pool' */ //
@@ -134,6 +142,9 @@ void Config::parse_file() {
       if (!ctrl_name.empty()) conf_err("Control multiply defined - aborted");
       lin[matches[1].rm_eo] = '\0';
       ctrl_name = std::string(lin + matches[1].rm_so, static_cast<size_t>(matches[1].rm_eo - matches[1].rm_so));
+    } else if (!regexec(&regex_set::HandoverSocket, lin, 4, matches, 0)) {
+      lin[matches[1].rm_eo] = '\0';
+      handover_name = std::string(lin + matches[1].rm_so, static_cast<size_t>(matches[1].rm_eo - matches[1].rm_so));
     } else if (!regexec(&regex_set::ControlIP, lin, 4, matches, 0)) {
       lin[matches[1].rm_eo] = '\0';
       ctrl_ip = std::string(lin + matches[1].rm_so, static_cast<size_t>(matches[1].rm_eo - matches[1].rm_so));
@@ -242,6 +253,9 @@ bool Config::init(const global::StartOptions &start_options) {
 
   DHCustom_params = nullptr;
   numthreads = 0;
+  event_engine = 0;
+  accept_budget = ACCEPT_BUDGET;
+  worker_affinity = "none";
   alive_to = 30;
   daemonize = 1;
   grace = 30;
@@ -381,6 +395,7 @@ std::shared_ptr<ListenerConfig> Config::parse_HTTP() {
       if (regcomp(&m->pat, lin + matches[1].rm_so,
                   REG_ICASE | REG_NEWLINE | REG_EXTENDED))
         conf_err("HeadRemove bad pattern - aborted");
+      res->head_remove.add(lin + matches[1].rm_so, &m->pat);
     } else if (!regexec(&regex_set::AddHeader, lin, 4, matches, 0)) {
       lin[matches[1].rm_eo] = '\0';
       if (res->add_head.empty()) {
@@ -412,6 +427,7 @@ std::shared_ptr<ListenerConfig> Config::parse_HTTP() {
       if (regcomp(&m->pat, lin + matches[1].rm_so,
                   REG_ICASE | REG_NEWLINE | REG_EXTENDED))
         conf_err("RemoveResponseHead bad pattern - aborted");
+      res->response_head_remove.add(lin + matches[1].rm_so, &m->pat);
     } else if (!regexec(&regex_set::AddResponseHeader, lin, 4, matches, 0)) {
       if (res->response_add_head.empty()) {
         res->response_add_head = std::string(
@@ -425,6 +441,14 @@ std::shared_ptr<ListenerConfig> Config::parse_HTTP() {
       }
     } else if (!regexec(&regex_set::RewriteDestination, lin, 4, matches, 0)) {
       res->rewr_dest = atoi(lin + matches[1].rm_so);
+    } else if (!regexec(&regex_set::SteerAccept, lin, 4, matches, 0)) {
+      res->steer_accept = atoi(lin + matches[1].rm_so);
+    } else if (!regexec(&regex_set::TCPFastOpen, lin, 4, matches, 0)) {
+      res->tcp_fast_open = atoi(lin + matches[1].rm_so);
+    } else if (!regexec(&regex_set::ZeroCopy, lin, 4, matches, 0)) {
+      res->zero_copy = atoi(lin + matches[1].rm_so);
+    } else if (!regexec(&regex_set::ZeroCopySend, lin, 4, matches, 0)) {
+      res->zero_copy_send = atoi(lin + matches[1].rm_so);
     } else if (!regexec(&regex_set::RewriteHost, lin, 4, matches, 0)) {
       res->rewr_host = atoi(lin + matches[1].rm_so);
     } else if (!regexec(&regex_set::LogLevel, lin, 4, matches, 0)) {
@@ -664,6 +688,7 @@ std::shared_ptr<ListenerConfig> Config::parse_HTTPS() {
       if (regcomp(&m->pat, lin + matches[1].rm_so,
                   REG_ICASE | REG_NEWLINE | REG_EXTENDED))
         conf_err("HeadRemove bad pattern - aborted");
+      res->head_remove.add(lin + matches[1].rm_so, &m->pat);
     } else if (!regexec(&regex_set::ForwardSNI, lin, 4, matches, 0)) {
       res->ssl_forward_sni_server_name = std::atoi(lin + matches[1].rm_so) == 1;
     } else if (!regexec(&regex_set::RewriteLocation, lin, 4, matches, 0)) {
@@ -686,6 +711,7 @@ std::shared_ptr<ListenerConfig> Config::parse_HTTPS() {
       if (regcomp(&m->pat, lin + matches[1].rm_so,
                   REG_ICASE | REG_NEWLINE | REG_EXTENDED))
         conf_err("RemoveResponseHead bad pattern - aborted");
+      res->response_head_remove.add(lin + matches[1].rm_so, &m->pat);
     } else if (!regexec(&regex_set::AddResponseHeader, lin, 4, matches, 0)) {
       lin[matches[1].rm_eo] = '\0';
       if (res->response_add_head.empty()) {
@@ -700,6 +726,12 @@ std::shared_ptr<ListenerConfig> Config::parse_HTTPS() {
       }
     } else if (!regexec(&regex_set::RewriteDestination, lin, 4, matches, 0)) {
       res->rewr_dest = atoi(lin + matches[1].rm_so);
+    } else if (!regexec(&regex_set::SteerAccept, lin, 4, matches, 0)) {
+      res->steer_accept = atoi(lin + matches[1].rm_so);
+    } else if (!regexec(&regex_set::TCPFastOpen, lin, 4, matches, 0)) {
+      res->tcp_fast_open = atoi(lin + matches[1].rm_so);
+    } else if (!regexec(&regex_set::ZeroCopy, lin, 4, matches, 0)) {
+      res->zero_copy = atoi(lin + matches[1].rm_so);
     } else if (!regexec(&regex_set::RewriteHost, lin, 4, matches, 0)) {
       res->rewr_host = atoi(lin + matches[1].rm_so);
     } else if (!regexec(&regex_set::LogLevel, lin, 4, matches, 0)) {
@@ -813,6 +845,16 @@ std::shared_ptr<ListenerConfig> Config::parse_HTTPS() {
         ssl_op_disable |= SSL_OP_CIPHER_SERVER_PREFERENCE;
         ssl_op_enable &= ~SSL_OP_CIPHER_SERVER_PREFERENCE;
       }
+    } else if (!regexec(&regex_set::KernelTLS, lin, 4, matches, 0)) {
+#ifdef SSL_OP_ENABLE_KTLS
+      if (std::atoi(lin + matches[1].rm_so)) {
+        ssl_op_enable |= SSL_OP_ENABLE_KTLS;
+        ssl_op_disable &= ~SSL_OP_ENABLE_KTLS;
+      } else {
+        ssl_op_disable |= SSL_OP_ENABLE_KTLS;
+        ssl_op_enable &= ~SSL_OP_ENABLE_KTLS;
+      }
+#endif
     } else if (!regexec(&regex_set::Ciphers, lin, 4, matches, 0)) {
       has_other = 1;
       if (res->ctx == nullptr)
@@ -1424,8 +1466,11 @@ std::shared_ptr<BackendConfig> Config::parseBackend(const char *svc_name,
   res->next = nullptr;
   res->ctx = nullptr;
   res->nf_mark = 0;
+  res->pool_max_idle = CONNECTION_POOL_MAX_IDLE;
+  res->pool_idle_timeout = CONNECTION_POOL_IDLE_TIMEOUT;
+  res->pool_min_idle = CONNECTION_POOL_MIN_IDLE;
   has_addr = has_port = 0;
-  addrinfo addr{};
+  sockaddr_storage addr{};
   addrinfo ha_addr{};
   pthread_mutex_init(&res->mut, nullptr);
   while (conf_fgets(lin, MAXBUF)) {
@@ -1434,11 +1479,11 @@ std::shared_ptr<BackendConfig> Config::parseBackend(const char *svc_name,
     if (!regexec(&regex_set::Address, lin, 4, matches, 0)) {
       lin[matches[1].rm_eo] = '\0';
 
-      if (Network::getHost(lin + matches[1].rm_so, &addr, PF_UNSPEC)) {
-        /* if we can't resolve it assume this is a UNIX domain socket */
-        if ((strlen(lin + matches[1].rm_so) + 1) > UNIX_PATH_MAX)
-          conf_err("UNIX path name too long");
-      }
+      /* host names are resolved asynchronously, only paths are checked */
+      if (lin[matches[1].rm_so] == '/' &&
+          (strlen(lin + matches[1].rm_so) + 1) > UNIX_PATH_MAX)
+        conf_err("UNIX path name too long");
+      events::DnsResolver::parseAddress(lin + matches[1].rm_so, addr);
       res->address = lin + matches[1].rm_so;
       has_addr = 1;
     } else if (!regexec(&regex_set::Port, lin, 4, matches, 0)) {
@@ -1472,6 +1517,22 @@ std::shared_ptr<BackendConfig> Config::parseBackend(const char *svc_name,
       res->nf_mark = std::atoi(lin + matches[1].rm_so);
     } else if (!regexec(&regex_set::ConnTO, lin, 4, matches, 0)) {
       res->conn_to = std::atoi(lin + matches[1].rm_so);
+    } else if (!regexec(&regex_set::PoolMaxIdle, lin, 4, matches, 0)) {
+      if (is_emergency)
+        conf_err("PoolMaxIdle is not supported for Emergency back-ends");
+      res->pool_max_idle = std::atoi(lin + matches[1].rm_so);
+    } else if (!regexec(&regex_set::PoolMinIdle, lin, 4, matches, 0)) {
+      if (is_emergency)
+        conf_err("PoolMinIdle is not supported for Emergency back-ends");
+      res->pool_min_idle = std::atoi(lin + matches[1].rm_so);
+    } else if (!regexec(&regex_set::PoolIdleTimeout, lin, 4, matches, 0)) {
+      if (is_emergency)
+        conf_err("PoolIdleTimeout is not supported for Emergency back-ends");
+      res->pool_idle_timeout = std::atoi(lin + matches[1].rm_so);
+    } else if (!regexec(&regex_set::TCPFastOpen, lin, 4, matches, 0)) {
+      res->tcp_fast_open = std::atoi(lin + matches[1].rm_so);
+      if (res->tcp_fast_open > 1)
+        conf_err("BackEnd TCPFastOpen must be 0 or 1 - aborted");
     } else if (!regexec(&regex_set::HAport, lin, 4, matches, 0)) {
       if (is_emergency)
         conf_err("HAport is not supported for Emergency back-ends");
@@ -1565,6 +1626,15 @@ std::shared_ptr<BackendConfig> Config::parseBackend(const char *svc_name,
 #ifdef SSL_OP_NO_TLSv1_3
       else if (strcasecmp(lin + matches[1].rm_so, "TLSv1_3") == 0)
         SSL_CTX_set_options(res->ctx.get(), SSL_OP_NO_TLSv1_3);
+#endif
+    } else if (!regexec(&regex_set::KernelTLS, lin, 4, matches, 0)) {
+      if (res->ctx == nullptr)
+        conf_err("BackEnd KernelTLS can only be used after HTTPS - aborted");
+#ifdef SSL_OP_ENABLE_KTLS
+      if (std::atoi(lin + matches[1].rm_so))
+        SSL_CTX_set_options(res->ctx.get(), SSL_OP_ENABLE_KTLS);
+      else
+        SSL_CTX_clear_options(res->ctx.get(), SSL_OP_ENABLE_KTLS);
 #endif
 #ifndef OPENSSL_NO_ECDH
     } else if (!regexec(&regex_set::ECDHCurve, lin, 4, matches, 0)) {
@@ -1594,35 +1664,36 @@ std::shared_ptr<BackendConfig> Config::parseBackend(const char *svc_name,
       res->disabled = std::atoi(lin + matches[1].rm_so);
     } else if (!regexec(&regex_set::End, lin, 4, matches, 0)) {
       if (!has_addr) conf_err("BackEnd missing Address - aborted");
-      if ((addr.ai_family == AF_INET || addr.ai_family == AF_INET6) &&
-          !has_port)
+      if (res->address[0] != '/' && !has_port)
         conf_err("BackEnd missing Port - aborted");
+      /* the warmed connections are kept in the pool */
+      if (res->pool_max_idle < res->pool_min_idle)
+        res->pool_max_idle = res->pool_min_idle;
       if (res->bekey.empty()) {
-        if (addr.ai_family == AF_INET)
+        if (addr.ss_family == AF_INET)
           snprintf(
               lin, MAXBUF - 1, "4-%08x-%x",
-              htonl((reinterpret_cast<sockaddr_in *>(addr.ai_addr))
-                        ->sin_addr.s_addr),
-              htons((reinterpret_cast<sockaddr_in *>(addr.ai_addr))->sin_port));
-        else if (addr.ai_family == AF_INET6) {
+              htonl((reinterpret_cast<sockaddr_in *>(&addr))->sin_addr.s_addr),
+              htons((reinterpret_cast<sockaddr_in *>(&addr))->sin_port));
+        else if (addr.ss_family == AF_INET6) {
           cp = reinterpret_cast<char *>(
-              &((reinterpret_cast<sockaddr_in6 *>(addr.ai_addr))->sin6_addr));
+              &((reinterpret_cast<sockaddr_in6 *>(&addr))->sin6_addr));
           snprintf(
               lin, MAXBUF - 1,
               "6-%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%"
               "02x%02x-%x",
               cp[0], cp[1], cp[2], cp[3], cp[4], cp[5], cp[6], cp[7], cp[8],
               cp[9], cp[10], cp[11], cp[12], cp[13], cp[14], cp[15],
-              htons(
-                  (reinterpret_cast<sockaddr_in6 *>(addr.ai_addr))->sin6_port));
-        } else
+              htons((reinterpret_cast<sockaddr_in6 *>(&addr))->sin6_port));
+        } else if (res->address[0] != '/')
+          /* the addresses of a host name may change, the key may not */
+          snprintf(lin, MAXBUF - 1, "n-%s", res->address.data());
+        else
           conf_err("cannot autogenerate backendkey, please specify one");
         res->bekey = std::string(lin);
       }
-      std::free(addr.ai_addr);
       return res;
     } else {
-      std::free(addr.ai_addr);
       conf_err("unknown directive");
     }
   }
@@ -1876,6 +1947,9 @@ void Config::include_dir(const char *conf_path) {
 void Config::setAsCurrent() {
   if (found_parse_error) return;
   global::run_options::getCurrent().num_threads = numthreads;
+  global::run_options::getCurrent().event_engine = event_engine;
+  global::run_options::getCurrent().accept_budget = accept_budget;
+  global::run_options::getCurrent().worker_affinity = worker_affinity;
   global::run_options::getCurrent().log_level = log_level;
   global::run_options::getCurrent().log_facility = log_facility;
   global::run_options::getCurrent().user = user;
@@ -1886,6 +1960,7 @@ void Config::setAsCurrent() {
   global::run_options::getCurrent().ctrl_user = ctrl_user;
   global::run_options::getCurrent().ctrl_group = ctrl_group;
   global::run_options::getCurrent().ctrl_mode = ctrl_mode;
+  global::run_options::getCurrent().handover_name = handover_name;
   global::run_options::getCurrent().daemonize = daemonize;
   global::run_options::getCurrent().backend_resurrect_timeout = alive_to;
   global::run_options::getCurrent().grace_time = grace;
@@ -1907,6 +1982,9 @@ bool Config::init(const std::string &file_name) {
 
   DHCustom_params = nullptr;
   numthreads = 0;
+  event_engine = 0;
+  accept_budget = ACCEPT_BUDGET;
+  worker_affinity = "none";
   alive_to = 30;
   daemonize = 1;
   grace = 30;
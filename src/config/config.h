@@ -109,12 +109,16 @@ class Config : public Counter<Config> {
       ctrl_ip,        /* control socket ip */
       ctrl_user,      /* control socket username */
       ctrl_group,     /* control socket group name */
+      handover_name,  /* listener handover socket name */
       engine_id,      /* openssl engine id*/
+      worker_affinity, /* none, physical or the list of worker cpus */
       conf_file_name; /* Configuration file path name*/
 
   long ctrl_mode; /* octal mode of the control socket */
 
   int numthreads,                     /* number of worker threads */
+      event_engine,                   /* 0 epoll, 1 io_uring */
+      accept_budget,                  /* connections accepted per loop */
       anonymise,                      /* anonymise client address */
       alive_to,                       /* check interval for resurrection */
       daemonize,                      /* run as daemon */
@@ -26,6 +26,7 @@
 #include <sys/socket.h>
 #include <memory>
 #include <string>
+#include "../http/header_matcher.h"
 #include "../stats/counter.h"
 
 #if WAF_ENABLED
@@ -94,6 +95,10 @@ class BackendConfig : Counter<BackendConfig> {
   std::shared_ptr<BackendConfig> next = nullptr;
   int key_id;
   int nf_mark;
+  int pool_max_idle;     /* idle keep-alive connections kept per worker */
+  int pool_idle_timeout; /* seconds an idle connection is kept */
+  int pool_min_idle;     /* connections each worker keeps established */
+  int tcp_fast_open{0};  /* send the first request bytes in the SYN */
   ~BackendConfig() {}
 };
 
@@ -189,10 +194,16 @@ struct ListenerConfig : Counter<ListenerConfig> {
   long max_req;          /* max. request size */
   MATCHER *head_off{nullptr};          /* headers to remove */
   MATCHER *response_head_off{nullptr}; /* headers to remove  from response */
+  http::HeaderMatcher head_remove;          /* head_off patterns */
+  http::HeaderMatcher response_head_remove; /* response_head_off patterns */
   std::string ssl_config_file;         /* OpenSSL config file path */
   int rewr_loc{0};                     /* rewrite location response */
   int rewr_dest{0};                    /* rewrite destination header */
   int rewr_host{0};                    /* rewrite host header */
+  int steer_accept{0};                 /* accept in the worker of the RX cpu */
+  int tcp_fast_open{0};                /* TFO pending queue length, 0 off */
+  int zero_copy{0};                    /* splice() plain bodies */
+  int zero_copy_send{0};               /* MSG_ZEROCOPY threshold, 0 off */
   std::string ssl_config_section;      /* OpenSSL config section */
   int disabled{0};                        /* true if the listener is disabled */
   int log_level;                       /* log level for this listener */
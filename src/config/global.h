@@ -27,11 +27,26 @@
 #include "../version.h"
 #include "ssl_helper.h"
 
+/** Connections a worker accepts in each loop iteration, shared round robin
+ * among its ready listeners. */
+#ifndef ACCEPT_BUDGET
+#define ACCEPT_BUDGET 64
+#endif
+
+/** Milliseconds a worker stops accepting after running out of file
+ * descriptors. */
+#ifndef ACCEPT_BACKOFF
+#define ACCEPT_BACKOFF 100
+#endif
+
 namespace global {
 struct run_options {
   explicit run_options(bool write_to_current = false);
   static run_options &getCurrent();
   int num_threads{0};           /*number of StreamManagers to use (workers)*/
+  int event_engine{0};          /*events::EVENT_ENGINE used by the workers*/
+  std::string worker_affinity{"none"}; /*cpus the workers are pinned to*/
+  int accept_budget{ACCEPT_BUDGET}; /*connections accepted per loop*/
   int log_level{5};             /*default log leves*/
   int log_facility{LOG_DAEMON}; /*syslog log facility to use*/
   std::string user;             /* user to run as */
@@ -42,6 +57,7 @@ struct run_options {
   std::string ctrl_user;        /* API control socket username */
   std::string ctrl_group;       /* API control socket group name */
   long ctrl_mode{-1};           /* octal mode of the control socket */
+  std::string handover_name;    /* listener handover unix socket name */
   bool daemonize{true};         /* run as daemon */
   int backend_resurrect_timeout{10}; /* time in seconds for backend resurrection check */
   // TODO::To implement
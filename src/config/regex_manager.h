@@ -47,6 +47,9 @@ static const Regex Name("^[ \t]*Name[ \t]+(.+)[ \t]*$");
 static const Regex RootJail("^[ \t]*RootJail[ \t]+\"(.+)\"[ \t]*$");
 static const Regex Daemon("^[ \t]*Daemon[ \t]+([01])[ \t]*$");
 static const Regex Threads("^[ \t]*Threads[ \t]+([1-9][0-9]*)[ \t]*$");
+static const Regex EventEngine("^[ \t]*EventEngine[ \t]+(epoll|io_uring)[ \t]*$");
+static const Regex AcceptBudget("^[ \t]*AcceptBudget[ \t]+([1-9][0-9]*)[ \t]*$");
+static const Regex WorkerAffinity("^[ \t]*WorkerAffinity[ \t]+(none|physical|[0-9][0-9,-]*)[ \t]*$");
 static const Regex ThreadModel("^[ \t]*ThreadModel[ \t]+(pool|dynamic)[ \t]*$");
 static const Regex LogFacility("^[ \t]*LogFacility[ \t]+([a-z0-9-]+)[ \t]*$");
 static const Regex LogLevel("^[ \t]*LogLevel[ \t]+([0-9])[ \t]*$");
@@ -54,6 +57,7 @@ static const Regex Grace("^[ \t]*Grace[ \t]+([0-9]+)[ \t]*$");
 static const Regex Alive("^[ \t]*Alive[ \t]+([1-9][0-9]*)[ \t]*$");
 static const Regex SSLEngine("^[ \t]*SSLEngine[ \t]+\"(.+)\"[ \t]*$");
 static const Regex Control("^[ \t]*Control[ \t]+\"(.+)\"[ \t]*$");
+static const Regex HandoverSocket("^[ \t]*HandoverSocket[ \t]+\"(.+)\"[ \t]*$");
 static const Regex ControlIP("^[ \t]*ControlIP[ \t]+([^ \t]+)[ \t]*$");
 static const Regex ControlPort("^[ \t]*ControlPort[ \t]+([1-9][0-9]*)[ \t]*$");
 static const Regex ControlUser("^[ \t]*ControlUser[ \t]+\"(.+)\"[ \t]*$");
@@ -144,6 +148,11 @@ static const Regex CacheDiskPath("^[ \t]*CacheDiskPath[ \t]+\"([a-zA-Z\\/\\._]*)
 #ifndef OPENSSL_NO_ECDH
 static const Regex ECDHCurve("^[ \t]*ECDHCurve[ \t]+\"(.+)\"[ \t]*$");
 #endif
+static const Regex SteerAccept("^[ \t]*SteerAccept[ \t]+([01])[ \t]*$");
+static const Regex TCPFastOpen("^[ \t]*TCPFastOpen[ \t]+([0-9]+)[ \t]*$");
+static const Regex ZeroCopy("^[ \t]*ZeroCopy[ \t]+([01])[ \t]*$");
+static const Regex ZeroCopySend("^[ \t]*ZeroCopySend[ \t]+([0-9]+)[ \t]*$");
+static const Regex KernelTLS("^[ \t]*KernelTLS[ \t]+([01])[ \t]*$");
 static const Regex ForwardSNI("^[ \t]*ForwardSNI[ \t]+([01])[ \t]*$");
 static const Regex HEADER("^([a-z0-9!#$%&'*+.^_`|~-]+):[ \t]*(.*)[ \t]*$");
 static const Regex CONN_UPGRD("(^|[ \t,])upgrade([ \t,]|$)");
@@ -152,6 +161,9 @@ static const Regex RESP_SKIP("^HTTP/1.1 100.*$");
 static const Regex RESP_IGN("^HTTP/1.[01] (10[1-9]|1[1-9][0-9]|204|30[456]).*$");
 static const Regex LOCATION("(http|https)://([^/]+)(.*)");
 static const Regex AUTHORIZATION("Authorization:[ \t]*Basic[ \t]*\"?([^ \t]*)\"?[ \t]*");
+static const Regex PoolMaxIdle("^[ \t]*PoolMaxIdle[ \t]+([0-9]+)[ \t]*$");
+static const Regex PoolMinIdle("^[ \t]*PoolMinIdle[ \t]+([0-9]+)[ \t]*$");
+static const Regex PoolIdleTimeout("^[ \t]*PoolIdleTimeout[ \t]+([1-9][0-9]*)[ \t]*$");
 static const Regex NfMark("^[ \t]*NfMark[ \t]+([1-9][0-9]*)[ \t]*$");
 #if WAF_ENABLED
 static const Regex WafRules("^[ \t]*WafRules[ \t]+\"(.+)\"[ \t]*$");
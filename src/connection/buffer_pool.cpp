@@ -0,0 +1,123 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "buffer_pool.h"
+#include <unistd.h>
+#include "segment_buffer.h"
+
+static thread_local BufferPool *local_pool{nullptr};
+
+BufferPool::~BufferPool() {
+  for (auto &list : free_list)
+    for (auto buffer : list) delete[] buffer;
+  /* the worker is gone, nothing will reuse the pages of these sockets */
+  for (auto &socket : lingering) {
+    socket.sender->discard();
+    ::close(socket.fd);
+  }
+}
+
+size_t BufferPool::getClass(size_t size) {
+  for (size_t i = 0; i < CLASS_COUNT - 1; i++)
+    if (size <= CLASS_SIZES[i]) return i;
+  return CLASS_COUNT - 1;
+}
+
+char *BufferPool::acquire(size_t size, size_t &capacity) {
+  reapLingering();
+  auto class_index = getClass(size);
+  auto &list = free_list[class_index];
+  auto &class_stats = stats[class_index];
+  capacity = CLASS_SIZES[class_index];
+  class_stats.in_use.fetch_add(1, std::memory_order_relaxed);
+  if (list.empty()) {
+    class_stats.misses.fetch_add(1, std::memory_order_relaxed);
+    return new char[capacity];
+  }
+  auto buffer = list.back();
+  list.pop_back();
+  class_stats.hits.fetch_add(1, std::memory_order_relaxed);
+  class_stats.cached.fetch_sub(1, std::memory_order_relaxed);
+  return buffer;
+}
+
+void BufferPool::release(char *buffer, size_t capacity) {
+  auto class_index = getClass(capacity);
+  auto &list = free_list[class_index];
+  auto &class_stats = stats[class_index];
+  class_stats.in_use.fetch_sub(1, std::memory_order_relaxed);
+  if ((list.size() + 1) * capacity > BUFFER_POOL_MAX_CACHED) {
+    delete[] buffer;
+    return;
+  }
+  list.push_back(buffer);
+  class_stats.cached.fetch_add(1, std::memory_order_relaxed);
+}
+
+void BufferPool::defer(char *, size_t capacity) {
+  auto &class_stats = stats[getClass(capacity)];
+  class_stats.in_use.fetch_sub(1, std::memory_order_relaxed);
+  class_stats.deferred.fetch_add(1, std::memory_order_relaxed);
+}
+
+void BufferPool::reclaim(char *buffer, size_t capacity) {
+  auto &class_stats = stats[getClass(capacity)];
+  class_stats.deferred.fetch_sub(1, std::memory_order_relaxed);
+  /* release() accounts it as a buffer in use */
+  class_stats.in_use.fetch_add(1, std::memory_order_relaxed);
+  release(buffer, capacity);
+}
+
+void BufferPool::linger(int fd, std::unique_ptr<ZeroCopySender> sender) {
+  if (lingering.empty())
+    next_linger_check = std::chrono::steady_clock::now() +
+                        std::chrono::milliseconds(BUFFER_POOL_LINGER_INTERVAL);
+  lingering.push_back({fd, std::move(sender)});
+}
+
+void BufferPool::reapLingering() {
+  if (lingering.empty()) return;
+  auto now = std::chrono::steady_clock::now();
+  if (now < next_linger_check) return;
+  next_linger_check =
+      now + std::chrono::milliseconds(BUFFER_POOL_LINGER_INTERVAL);
+  for (size_t i = 0; i < lingering.size();) {
+    auto &socket = lingering[i];
+    socket.sender->readCompletions(socket.fd);
+    if (socket.sender->hasPending()) {
+      i++;
+      continue;
+    }
+    ::close(socket.fd);
+    if (i + 1 < lingering.size()) socket = std::move(lingering.back());
+    lingering.pop_back();
+  }
+}
+
+BufferPool &BufferPool::local() {
+  if (local_pool == nullptr) {
+    static thread_local BufferPool thread_pool;
+    local_pool = &thread_pool;
+  }
+  return *local_pool;
+}
+
+void BufferPool::setLocal(BufferPool *pool) { local_pool = pool; }
@@ -0,0 +1,153 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#ifndef MAX_DATA_SIZE
+#define MAX_DATA_SIZE 65000
+#endif
+#ifndef BUFFER_POOL_SMALL_SIZE
+#define BUFFER_POOL_SMALL_SIZE 16384
+#endif
+/** Bytes of free buffers each size class keeps cached for reuse. */
+#ifndef BUFFER_POOL_MAX_CACHED
+#define BUFFER_POOL_MAX_CACHED (16 * 1024 * 1024)
+#endif
+/** Milliseconds between two checks of the sockets closed with sends
+ * pending. */
+#ifndef BUFFER_POOL_LINGER_INTERVAL
+#define BUFFER_POOL_LINGER_INTERVAL 100
+#endif
+
+class ZeroCopySender;
+
+/**
+ * @class BufferPool buffer_pool.h "src/connection/buffer_pool.h"
+ * @brief Size classed pool of the Connection data buffers.
+ *
+ * Connections attach a buffer when they have data to read and return it once
+ * it is empty and the stream is idle, so idle keep-alive connections do not
+ * hold any buffer memory. Each StreamManager owns a pool that is only used
+ * from its worker thread, the threads without one use a thread local pool.
+ */
+class BufferPool {
+ public:
+  /** Buffer sizes, from the smallest to the largest one. */
+  static constexpr size_t CLASS_SIZES[] = {BUFFER_POOL_SMALL_SIZE,
+                                           MAX_DATA_SIZE};
+  static constexpr size_t CLASS_COUNT =
+      sizeof(CLASS_SIZES) / sizeof(CLASS_SIZES[0]);
+
+  struct Stats {
+    /** Buffers served from the cache. */
+    std::atomic<uint64_t> hits{0};
+    /** Buffers allocated because the cache was empty. */
+    std::atomic<uint64_t> misses{0};
+    /** Buffers attached to connections. */
+    std::atomic<int64_t> in_use{0};
+    /** Free buffers cached. */
+    std::atomic<int64_t> cached{0};
+    /** Buffers the kernel may still read, after defer(). */
+    std::atomic<int64_t> deferred{0};
+  };
+
+ private:
+  struct Lingering {
+    int fd;
+    std::unique_ptr<ZeroCopySender> sender;
+  };
+  std::vector<char *> free_list[CLASS_COUNT];
+  /** Sockets closed by their connection while they had sends pending. */
+  std::vector<Lingering> lingering;
+  std::chrono::steady_clock::time_point next_linger_check;
+  Stats stats[CLASS_COUNT];
+
+  static size_t getClass(size_t size);
+
+ public:
+  BufferPool() = default;
+  ~BufferPool();
+  BufferPool(const BufferPool &) = delete;
+  BufferPool &operator=(const BufferPool &) = delete;
+
+  /**
+   * @brief Gets a buffer of the smallest size class that fits @p size.
+   * @param size is the minimum size needed, capped to the largest class.
+   * @param capacity is set to the size of the buffer returned.
+   * @return the buffer.
+   */
+  char *acquire(size_t size, size_t &capacity);
+
+  /**
+   * @brief Returns a buffer got from acquire().
+   * @param buffer to return.
+   * @param capacity of the buffer.
+   */
+  void release(char *buffer, size_t capacity);
+
+  /**
+   * @brief Accounts as deferred a buffer that the kernel may still read, as
+   * the pages sent with MSG_ZEROCOPY by a closed socket. It is not reused
+   * until it is returned with reclaim().
+   * @param buffer deferred.
+   * @param capacity of the buffer.
+   */
+  void defer(char *buffer, size_t capacity);
+
+  /** @brief Returns a buffer deferred with defer(). */
+  void reclaim(char *buffer, size_t capacity);
+
+  /**
+   * @brief Takes the socket @p fd, closed by its connection while the kernel
+   * still owns the pages of some MSG_ZEROCOPY sends of @p sender.
+   *
+   * The socket is kept open, so the completions can still be read from its
+   * error queue, and it is checked by reapLingering(). Once all its sends
+   * have completed it is closed and the buffers are reused.
+   */
+  void linger(int fd, std::unique_ptr<ZeroCopySender> sender);
+
+  /**
+   * @brief Closes the lingering sockets whose sends have completed, at most
+   * once every BUFFER_POOL_LINGER_INTERVAL. It is called by the worker loop
+   * and while buffers are acquired.
+   */
+  void reapLingering();
+
+  /** @return the number of sockets waiting for their sends to complete. */
+  size_t lingeringCount() const { return lingering.size(); }
+
+  /** @return the statistics of the size class @p class_index. */
+  const Stats &getStats(size_t class_index) const { return stats[class_index]; }
+
+  /** @return the pool of the calling thread. */
+  static BufferPool &local();
+
+  /** @brief Sets @p pool as the pool of the calling thread. */
+  static void setLocal(BufferPool *pool);
+};
@@ -22,4 +22,8 @@
 #include "../stats/counter.h"
 #include "connection.h"
 
-class ClientConnection : public Connection, public Counter<ClientConnection> {};
+class ClientConnection : public Connection, public Counter<ClientConnection> {
+ public:
+  /* requests fit in the small size class, the buffer grows for longer headers */
+  ClientConnection() { buffer_size_hint = BUFFER_POOL_SMALL_SIZE; }
+};
@@ -46,11 +46,12 @@ IO::IO_RESULT Connection::read() {
   ssize_t count;
   IO::IO_RESULT result = IO::IO_RESULT::ERROR;
   //  PRINT_BUFFER_SIZE
-  if ((MAX_DATA_SIZE - (buffer_size + buffer_offset)) == 0)
+  acquireBuffer();
+  if ((buffer_capacity - (buffer_size + buffer_offset)) == 0)
     return IO::IO_RESULT::FULL_BUFFER;
   while (!done) {
     count = ::recv(fd_, (buffer + buffer_offset + buffer_size),
-                   (MAX_DATA_SIZE - buffer_size - buffer_offset), MSG_NOSIGNAL);
+                   (buffer_capacity - buffer_size - buffer_offset), MSG_NOSIGNAL);
     if (count < 0) {
       if (errno != EAGAIN && errno != EWOULDBLOCK) {
         std::string error = "read() failed  ";
@@ -69,7 +70,7 @@ IO::IO_RESULT Connection::read() {
       // PRINT_BUFFER_SIZE
       buffer_size += static_cast<size_t>(count);
       // PRINT_BUFFER_SIZE
-      if ((MAX_DATA_SIZE - (buffer_size + buffer_offset)) == 0) {
+      if ((buffer_capacity - (buffer_size + buffer_offset)) == 0) {
         //        PRINT_BUFFER_SIZE
         //        Logger::LogInfo("Buffer maximum size reached !!", LOG_DEBUG);
         return IO::IO_RESULT::FULL_BUFFER;
@@ -82,6 +83,30 @@ IO::IO_RESULT Connection::read() {
   return result;
 }
 
+void Connection::acquireBuffer() {
+  if (buffer != nullptr) return;
+  buffer = BufferPool::local().acquire(buffer_size_hint, buffer_capacity);
+}
+
+void Connection::releaseBuffer() {
+  if (buffer == nullptr || buffer_size > 0) return;
+  BufferPool::local().release(buffer, buffer_capacity);
+  buffer = nullptr;
+  buffer_capacity = 0;
+  buffer_offset = 0;
+}
+
+bool Connection::growBuffer() {
+  size_t new_capacity = 0;
+  if (buffer == nullptr || buffer_capacity >= MAX_DATA_SIZE) return false;
+  auto new_buffer = BufferPool::local().acquire(buffer_capacity + 1, new_capacity);
+  std::memcpy(new_buffer, buffer, buffer_offset + buffer_size);
+  BufferPool::local().release(buffer, buffer_capacity);
+  buffer = new_buffer;
+  buffer_capacity = new_capacity;
+  return true;
+}
+
 std::string Connection::getPeerAddress() {
   if (this->fd_ > 0 && address_str.empty()) {
 	char addr[150];
@@ -116,10 +141,26 @@ int Connection::getLocalPort() {
 void Connection::reset() {
   this->disableEvents();
   freeSsl();
+  /* the kernel can still read the segments of the sends not completed, the
+   * socket is closed once they are */
+  if (fd_ > 0 && zerocopy.hasPending()) {
+    segment_buffer.clear(&zerocopy);
+    zerocopy.close(fd_);
+    fd_ = -1;
+  }
+  zerocopy.clear();
   if (fd_ > 0) this->closeConnection();
   fd_ = -1;
+  corked = false;
+  fast_open = false;
   buffer_size = 0;
   buffer_offset = 0;
+  releaseBuffer();
+  segment_buffer.clear();
+#if ENABLE_ZERO_COPY
+  /* data left in the pipe belongs to the previous connection */
+  splice_pipe.close();
+#endif
   if (address != nullptr) {
     if (address->ai_addr != nullptr) delete address->ai_addr;
   }
@@ -132,6 +173,8 @@ void Connection::reset() {
 
 void Connection::freeSsl() {
   this->ssl_connected = false;
+  ktls_send = false;
+  ktls_recv = false;
   handshake_retries = 0;
   if (ssl != nullptr) {
     SSL_set_shutdown(ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
@@ -158,108 +201,94 @@ void Connection::freeSsl() {
 
 #if ENABLE_ZERO_COPY
 #if !FAKE_ZERO_COPY
-IO::IO_RESULT Connection::zeroRead() {
-  IO::IO_RESULT result = IO::IO_RESULT::ZERO_DATA;
+IO::IO_RESULT Connection::zeroRead(size_t max_bytes) {
+  if (!splice_pipe.open()) return IO::IO_RESULT::ERROR;
+  size_t count = 0;
   for (;;) {
-    if (splice_pipe.bytes >= BUFSZ) {
-      result = IO::IO_RESULT::FULL_BUFFER;
-      break;
-    }
-    auto n = splice(fd_, nullptr, splice_pipe.pipe[1], nullptr, BUFSZ,
-                    SPLICE_F_NONBLOCK | SPLICE_F_MOVE);
-    if (n > 0) splice_pipe.bytes += n;
-    if (n == 0) break;
-    if (n < 0) {
-      if (errno == EAGAIN || errno == EWOULDBLOCK) {
-        result = IO::IO_RESULT::DONE_TRY_AGAIN;
-        break;
-      }
-      result = IO::IO_RESULT::ERROR;
-      break;
+    auto len = std::min(splice_pipe.size - splice_pipe.bytes, max_bytes - count);
+    if (len == 0) return IO::IO_RESULT::FULL_BUFFER;
+    auto n = ::splice(fd_, nullptr, splice_pipe.pipe[1], nullptr, len,
+                      SPLICE_F_NONBLOCK | SPLICE_F_MOVE);
+    if (n > 0) {
+      splice_pipe.bytes += static_cast<size_t>(n);
+      count += static_cast<size_t>(n);
+    } else if (n == 0) {
+      //  The  remote has closed the connection, wait for EPOLLRDHUP
+      if (count > 0) return IO::IO_RESULT::SUCCESS;
+      if (splice_pipe.bytes == 0) splice_pipe.close();
+      return IO::IO_RESULT::FD_CLOSED;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      if (count > 0) return IO::IO_RESULT::SUCCESS;
+      /* nothing to splice, do not hold an empty pipe */
+      if (splice_pipe.bytes == 0) splice_pipe.close();
+      return IO::IO_RESULT::DONE_TRY_AGAIN;
+    } else {
+      std::string error = "splice() failed  ";
+      error += std::strerror(errno);
+      Logger::LogInfo(error, LOG_NOTICE);
+      return IO::IO_RESULT::ERROR;
     }
   }
-  Logger::logmsg(LOG_REMOVE, "ZERO READ write %d  buffer %d", splice_pipe.bytes,
-                buffer_size);
-  return result;
 }
 
-IO::IO_RESULT Connection::zeroWrite(int dst_fd,
-                                    http_parser::HttpData &http_data) {
-  //  Logger::LogInfo("ZERO_BUFFER::SIZE = " + std::to_string(splice_pipe.bytes),
-  //  LOG_DEBUG);
-
-  Logger::logmsg(LOG_REMOVE, "ZERO WRITE write %d  left %d  buffer %d",
-                splice_pipe.bytes, http_data.message_bytes_left, buffer_size);
+IO::IO_RESULT Connection::zeroWrite(int dst_fd, size_t &sent) {
+  sent = 0;
   while (splice_pipe.bytes > 0) {
-    int bytes = splice_pipe.bytes;
-    if (bytes > BUFSZ) bytes = BUFSZ;
-    auto n = ::splice(splice_pipe.pipe[0], nullptr, dst_fd, nullptr, bytes,
-                      SPLICE_F_NONBLOCK | SPLICE_F_MOVE);
-    //    Logger::LogInfo("ZERO_BUFFER::SIZE = " +
-    //    std::to_string(splice_pipe.bytes), LOG_DEBUG);
-    if (n == 0) break;
+    auto n = ::splice(splice_pipe.pipe[0], nullptr, dst_fd, nullptr,
+                      splice_pipe.bytes, SPLICE_F_NONBLOCK | SPLICE_F_MOVE);
     if (n < 0) {
       if (errno == EAGAIN || errno == EWOULDBLOCK)
         return IO::IO_RESULT::DONE_TRY_AGAIN;
+      std::string error = "splice() failed  ";
+      error += std::strerror(errno);
+      Logger::LogInfo(error, LOG_NOTICE);
       return IO::IO_RESULT::ERROR;
     }
-    splice_pipe.bytes -= n;
-    http_data.message_bytes_left -= n;
+    if (n == 0) break;
+    splice_pipe.bytes -= static_cast<size_t>(n);
+    sent += static_cast<size_t>(n);
   }
-  /* bytes > 0, add dst to epoll set */
-  /* else remove if it was added */
+  /* the pipe is leased again on the next zeroRead() */
+  if (splice_pipe.bytes == 0) splice_pipe.close();
   return IO::IO_RESULT::SUCCESS;
 }
 
 #else
-IO::IO_RESULT Connection::zeroRead() {
-  IO::IO_RESULT result = IO::IO_RESULT::ZERO_DATA;
-  //  Logger::logmsg(LOG_REMOVE, "ZERO READ IN %d  buffer %d", splice_pipe.bytes,
-  //  buffer_size);
+IO::IO_RESULT Connection::zeroRead(size_t max_bytes) {
+  size_t count = 0;
   for (;;) {
-    if (splice_pipe.bytes >= BUFSZ) {
-      result = IO::IO_RESULT::FULL_BUFFER;
-      break;
-    }
-    auto n =
-        ::read(fd_, buffer_aux + splice_pipe.bytes, BUFSZ - splice_pipe.bytes);
-    if (n > 0) splice_pipe.bytes += n;
-    if (n == 0) break;
-    if (n < 0) {
-      if (errno == EAGAIN || errno == EWOULDBLOCK) {
-        result = IO::IO_RESULT::DONE_TRY_AGAIN;
-        break;
-      }
-      result = IO::IO_RESULT::ERROR;
-      break;
+    auto len = std::min(BUFSZ - splice_pipe.bytes, max_bytes - count);
+    if (len == 0) return IO::IO_RESULT::FULL_BUFFER;
+    auto n = ::read(fd_, buffer_aux + splice_pipe.bytes, len);
+    if (n > 0) {
+      splice_pipe.bytes += static_cast<size_t>(n);
+      count += static_cast<size_t>(n);
+    } else if (n == 0) {
+      return count > 0 ? IO::IO_RESULT::SUCCESS : IO::IO_RESULT::FD_CLOSED;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return count > 0 ? IO::IO_RESULT::SUCCESS
+                       : IO::IO_RESULT::DONE_TRY_AGAIN;
+    } else {
+      return IO::IO_RESULT::ERROR;
     }
   }
-  //  Logger::logmsg(LOG_REMOVE, "ZERO READ OUT %d  buffer %d",
-  //  splice_pipe.bytes, buffer_size);
-  return result;
 }
 
-IO::IO_RESULT Connection::zeroWrite(int dst_fd,
-                                    http_parser::HttpData &http_data) {
-  //  Logger::logmsg(LOG_REMOVE, "ZERO WRITE write %d  left %d  buffer %d",
-  //  splice_pipe.bytes, http_data.message_bytes_left, buffer_size);
-  int sent = 0;
+IO::IO_RESULT Connection::zeroWrite(int dst_fd, size_t &sent) {
+  sent = 0;
   while (splice_pipe.bytes > 0) {
-    int bytes = splice_pipe.bytes;
-    if (bytes > BUFSZ) bytes = BUFSZ;
-    auto n = ::write(dst_fd, buffer_aux + sent, bytes - sent);
-    if (n == 0) break;
+    auto n = ::write(dst_fd, buffer_aux + sent, splice_pipe.bytes);
     if (n < 0) {
-      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        std::memmove(buffer_aux, buffer_aux + sent, splice_pipe.bytes);
         return IO::IO_RESULT::DONE_TRY_AGAIN;
+      }
       return IO::IO_RESULT::ERROR;
     }
-    splice_pipe.bytes -= n;
-    http_data.message_bytes_left -= n;
-    sent += n;
+    if (n == 0) break;
+    splice_pipe.bytes -= static_cast<size_t>(n);
+    sent += static_cast<size_t>(n);
   }
-  /* bytes > 0, add dst to epoll set */
-  /* else remove if it was added */
   return IO::IO_RESULT::SUCCESS;
 }
 #endif
@@ -316,7 +345,7 @@ IO::IO_RESULT Connection::writeTo(int target_fd,
   //                IO::getResultString(result).data());
   if (result != IO::IO_RESULT::SUCCESS) return result;
 
-  buffer_size = 0;  // buffer_offset;
+  consumeMessage(http_data);
   http_data.message_length = 0;
   http_data.setHeaderSent(true);
 #if PRINT_DEBUG_FLOW_BUFFERS
@@ -434,12 +463,40 @@ IO::IO_RESULT Connection::write(const char *data, size_t size, size_t &sent) {
   return result;
 }
 
+void Connection::setCork(bool enable) {
+  if (corked == enable || fd_ < 0) return;
+  /* unix domain backends do not support it, they are left as they are */
+  if (Network::setTcpCorkOption(fd_, enable)) corked = enable;
+}
+
 void Connection::closeConnection() {
   if (fd_ > 0) {
     ::close(fd_);
   }
 }
-IO::IO_OP Connection::doConnect(addrinfo &address_, int timeout, bool async) {
+
+void Connection::consumeMessage(const http_parser::HttpData &http_data) {
+  size_t used = buffer_size;
+  if (http_data.message >= buffer && http_data.message <= buffer + buffer_size)
+    used = static_cast<size_t>(http_data.message - buffer) +
+           http_data.message_length;
+  if (used < buffer_size) {
+    std::memmove(buffer, buffer + used, buffer_size - used);
+    buffer_size -= used;
+  } else {
+    buffer_size = 0;
+  }
+}
+
+int Connection::detachSocket() {
+  this->disableEvents();
+  int fd = fd_;
+  fd_ = -1;
+  reset();
+  return fd;
+}
+IO::IO_OP Connection::doConnect(addrinfo &address_, int timeout, bool async,
+                                bool fast_open_) {
   int result = -1;
   if ((fd_ = socket(address_.ai_family, SOCK_STREAM, 0)) < 0) {
     Logger::logmsg(LOG_WARNING, "socket() failed ");
@@ -456,7 +513,11 @@ IO::IO_OP Connection::doConnect(addrinfo &address_, int timeout, bool async) {
     timeout_.tv_usec = 0;
     setsockopt(fd_, SOL_SOCKET, SO_SNDTIMEO, &timeout_, sizeof(timeout_));
   }
-  if ((result = ::connect(fd_, address_.ai_addr, sizeof(address_))) < 0) {
+  fast_open = fast_open_ && async && Network::setTcpFastOpenConnectOption(fd_);
+  if ((result = ::connect(fd_, address_.ai_addr, address_.ai_addrlen)) < 0) {
+    /* with fast open, EINPROGRESS means there is no cookie for the backend
+     * yet and this SYN asks for one */
+    fast_open = false;
     if (errno == EINPROGRESS && async) {
       return IO::IO_OP::OP_IN_PROGRESS;
     } else {
@@ -468,6 +529,8 @@ IO::IO_OP Connection::doConnect(addrinfo &address_, int timeout, bool async) {
       return IO::IO_OP::OP_ERROR;
     }
   }
+  /* nothing has been sent yet, it goes on with the first write */
+  if (fast_open) return IO::IO_OP::OP_IN_PROGRESS;
   // Create stream object if connected
   return result != -1 ? IO::IO_OP::OP_SUCCESS : IO::IO_OP::OP_ERROR;
 }
@@ -509,32 +572,19 @@ bool Connection::isConnected() {
 }
 
 int Connection::doAccept(int listener_fd) {
-  int new_fd = -1;
-  sockaddr_in peer_address{};
-  socklen_t peer_addr_length = sizeof(peer_address);
-
-  if ((new_fd = accept4(listener_fd, (sockaddr *)&peer_address, &peer_addr_length,
-                        SOCK_NONBLOCK | SOCK_CLOEXEC)) < 0) {
+  /* the socket options are inherited from the listener, see listen() */
+  int new_fd = accept4(listener_fd, nullptr, nullptr,
+                       SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (new_fd < 0) {
     if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
       return 0;  // We have processed all incoming connections.
     }
-    Logger::logmsg(LOG_NOTICE, "accept() failed  %s", std::strerror(errno));
-    // break;
+    int error = errno;
+    Logger::logmsg(LOG_NOTICE, "accept() failed  %s", std::strerror(error));
+    errno = error;  // the caller tells transient errors apart
     return -1;
   }
-
-  if (peer_address.sin_family == AF_INET ||
-      peer_address.sin_family == AF_INET6 ||
-      peer_address.sin_family == AF_UNIX) {
-    Network::setTcpNoDelayOption(new_fd);
-    Network::setSoKeepAliveOption(new_fd);
-    Network::setSoLingerOption(new_fd, true);
-    return new_fd;
-  } else {
-    ::close(new_fd);
-    Logger::logmsg(LOG_WARNING, "HTTP connection prematurely closed by peer");
-  }
-  return -1;
+  return new_fd;
 }
 bool Connection::listen(const std::string &address_str_, int port_) {
   this->address = Network::getAddress(address_str_, port_).release();
@@ -557,7 +607,10 @@ int Connection::listen(const addrinfo &address_) {
       continue;
     }
 
-    Network::setSoLingerOption(listen_fd);
+    /* the accepted connections inherit them */
+    Network::setTcpNoDelayOption(listen_fd);
+    Network::setSoKeepAliveOption(listen_fd);
+    Network::setSoLingerOption(listen_fd, true);
     Network::setSoReuseAddrOption(listen_fd);
     Network::setTcpDeferAcceptOption(listen_fd);
     Network::setTcpReusePortOption(listen_fd);
@@ -26,6 +26,9 @@
 #include "../http/http_request.h"
 #include "../ssl/ssl_common.h"
 #include "../util/utils.h"
+#include "buffer_pool.h"
+#include "pipe_pool.h"
+#include "segment_buffer.h"
 #include <atomic>
 #include <fcntl.h>
 #include <netdb.h>
@@ -42,18 +45,26 @@
 
 #define BUFSZ MAX_DATA_SIZE
 
+/** Pipe used to splice the body data between two sockets, leased from the
+ * worker PipePool while the body is spliced. */
 struct SplicePipe {
-  int pipe[2];
-  int bytes{0};
-  SplicePipe() {
-    if (pipe2(pipe, O_NONBLOCK) < 0) {
-      perror("pipe");
-    }
+  int pipe[2]{-1, -1};
+  /** Capacity of the leased pipe. */
+  size_t size{0};
+  /** Bytes spliced into the pipe and not written yet. */
+  size_t bytes{0};
+  /** @brief Leases a pipe if there is none leased yet. */
+  bool open() {
+    return pipe[0] >= 0 || PipePool::local().acquire(pipe, size);
   }
-  ~SplicePipe() {
-    close(pipe[0]);
-    close(pipe[1]);
+  /** @brief Returns the pipe to the pool, discarding the data it holds. */
+  void close() {
+    if (pipe[0] < 0) return;
+    PipePool::local().release(pipe, size, bytes == 0);
+    size = 0;
+    bytes = 0;
   }
+  ~SplicePipe() { close(); }
 };
 
 #endif
@@ -78,9 +89,52 @@ class Connection : public Descriptor {
   addrinfo *address;
 
   // StringBuffer string_buffer;
-  char buffer[MAX_DATA_SIZE];
+  /** Data buffer, attached from the worker BufferPool while in use. */
+  char *buffer{nullptr};
+  size_t buffer_capacity{0};
   size_t buffer_size{0};
   size_t buffer_offset{0};  // TODO::REMOVE
+  /** Buffer size requested to the pool when a buffer is attached. */
+  size_t buffer_size_hint{MAX_DATA_SIZE};
+  /** @brief Attaches a buffer from the pool if there is none. */
+  void acquireBuffer();
+  /** @brief Returns the buffer to the pool if it has no pending data. */
+  void releaseBuffer();
+  /**
+   * @brief Moves the buffer content to a buffer of the next size class.
+   * @return @c false if the buffer is already of the largest size class.
+   */
+  bool growBuffer();
+  /**
+   * @brief Drops the data of @p http_data from the buffer once it has been
+   * sent. The data read after it, the next pipelined messages, is moved to the
+   * start of the buffer.
+   */
+  void consumeMessage(const http_parser::HttpData &http_data);
+  /** Message body data forwarded through a chain of pooled segments. */
+  SegmentBuffer segment_buffer;
+  /** MSG_ZEROCOPY state of the sends to this connection socket. */
+  ZeroCopySender zerocopy;
+  /** The socket holds the partial segments until it is uncorked. */
+  bool corked{false};
+  /**
+   * @brief Sets or clears TCP_CORK on the socket, so the headers of a message
+   * leave in the same segment as the first body data instead of on their own.
+   *
+   * The kernel sends the held data after 200ms even if it is not uncorked.
+   * It is a no-op if the socket is already in the requested state.
+   */
+  void setCork(bool enable);
+  /** The SYN waits for the first write to carry its data, TCP Fast Open. */
+  bool fast_open{false};
+  /** @return the bytes pending in the buffer and in the segment chain. */
+  inline size_t getBufferedSize() const {
+#if ENABLE_ZERO_COPY
+    return buffer_size + segment_buffer.size() + splice_pipe.bytes;
+#else
+    return buffer_size + segment_buffer.size();
+#endif
+  }
   std::string getPeerAddress();
   std::string getLocalAddress();
   int getPeerPort();
@@ -88,8 +142,20 @@ class Connection : public Descriptor {
   void reset();
   void freeSsl();
 #if ENABLE_ZERO_COPY
-  IO::IO_RESULT zeroRead();
-  IO::IO_RESULT zeroWrite(int dst_fd, http_parser::HttpData &http_data);
+  /**
+   * @brief Splices data from the socket into the splice pipe, leasing a pipe
+   * from the worker PipePool if needed.
+   * @param max_bytes is the maximum number of bytes to read.
+   * @return FULL_BUFFER if the pipe is full or @p max_bytes have been read,
+   * the same results as read() otherwise.
+   */
+  IO::IO_RESULT zeroRead(size_t max_bytes = SIZE_MAX);
+  /**
+   * @brief Splices the splice pipe data to @p dst_fd, the pipe is returned
+   * to the pool once it is drained.
+   * @param sent is set to the number of bytes written.
+   */
+  IO::IO_RESULT zeroWrite(int dst_fd, size_t &sent);
 #endif
   static IO::IO_RESULT writeIOvec(int target_fd, iovec *iov, size_t iovec_size,
 								  size_t &iovec_written, size_t &nwritten);
@@ -101,6 +167,12 @@ class Connection : public Descriptor {
   IO::IO_RESULT read();
 
   void closeConnection();
+  /**
+   * @brief Gives up the socket without closing it and resets the rest of the
+   * connection state.
+   * @return the socket file descriptor.
+   */
+  int detachSocket();
   Connection();
   virtual ~Connection();
 
@@ -109,7 +181,13 @@ class Connection : public Descriptor {
   bool listen(const std::string &af_unix_name);
 
   static int doAccept(int listener_fd);
-  IO::IO_OP doConnect(addrinfo &address, int timeout, bool async = true);
+  /**
+   * @brief Connects to @p address.
+   * @param fast_open sends the first bytes written in the SYN, TCP Fast Open.
+   * The connect is reported in progress until that write.
+   */
+  IO::IO_OP doConnect(addrinfo &address, int timeout, bool async = true,
+                      bool fast_open = false);
   IO::IO_OP doConnect(const std::string &af_unix_socket_path, int timeout);
   bool isConnected();
   // SSL stuff
@@ -125,4 +203,9 @@ class Connection : public Descriptor {
   BIO *ssl_bio{nullptr};
   const char *server_name{nullptr};
   std::atomic<bool> ssl_connected;
+  /** The kernel encrypts the sends (kTLS), plain writes can be used. */
+  bool ktls_send{false};
+  /** The kernel decrypts the records received (kTLS), plain reads can be
+   * used. */
+  bool ktls_recv{false};
 };
@@ -0,0 +1,146 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "connection_pool.h"
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <iterator>
+#include "connection.h"
+
+ConnectionPool::~ConnectionPool() {
+  for (auto &idle_list : idle_set)
+    for (auto &idle_connection : idle_list.second) close(idle_connection);
+}
+
+void ConnectionPool::close(IdleConnection &idle_connection) {
+  if (idle_connection.ssl != nullptr) {
+    SSL_set_shutdown(idle_connection.ssl,
+                     SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+    SSL_free(idle_connection.ssl);
+#if USE_SSL_BIO_BUFFER
+    if (idle_connection.sbio != nullptr) BIO_vfree(idle_connection.sbio);
+    if (idle_connection.io != nullptr) BIO_free(idle_connection.io);
+    if (idle_connection.ssl_bio != nullptr) BIO_free(idle_connection.ssl_bio);
+#endif
+  }
+  ::close(idle_connection.fd);
+  stats.idle.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool ConnectionPool::acquire(const std::string &key, Connection &connection) {
+  auto it = idle_set.find(key);
+  if (it != idle_set.end()) {
+    auto now = std::chrono::steady_clock::now();
+    auto &idle_list = it->second;
+    while (!idle_list.empty()) {
+      auto idle_connection = idle_list.back();
+      idle_list.pop_back();
+      if (idle_connection.expiration <= now) {
+        stats.expired.fetch_add(1, std::memory_order_relaxed);
+        close(idle_connection);
+        continue;
+      }
+      /* an idle keep-alive socket has nothing to read, a read of 0 bytes
+       * means the backend has closed it */
+      char data;
+      if (::recv(idle_connection.fd, &data, 1, MSG_PEEK | MSG_DONTWAIT) >= 0 ||
+          (errno != EAGAIN && errno != EWOULDBLOCK)) {
+        stats.closed.fetch_add(1, std::memory_order_relaxed);
+        close(idle_connection);
+        continue;
+      }
+      connection.setFileDescriptor(idle_connection.fd);
+      connection.ssl = idle_connection.ssl;
+      connection.sbio = idle_connection.sbio;
+      connection.io = idle_connection.io;
+      connection.ssl_bio = idle_connection.ssl_bio;
+      connection.ssl_conn_status = idle_connection.ssl_conn_status;
+      connection.ssl_connected = idle_connection.ssl != nullptr;
+      connection.ktls_send = idle_connection.ktls_send;
+      connection.ktls_recv = idle_connection.ktls_recv;
+      stats.hits.fetch_add(1, std::memory_order_relaxed);
+      stats.idle.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  stats.misses.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+bool ConnectionPool::release(const std::string &key, Connection &connection,
+                             size_t max_idle, int timeout) {
+  IdleConnection idle_connection{
+      -1,
+      connection.ssl,
+      connection.sbio,
+      connection.io,
+      connection.ssl_bio,
+      connection.ssl_conn_status,
+      connection.ktls_send,
+      connection.ktls_recv,
+      std::chrono::steady_clock::now() + std::chrono::seconds(timeout)};
+  connection.ssl = nullptr;
+  connection.sbio = nullptr;
+  connection.io = nullptr;
+  connection.ssl_bio = nullptr;
+  idle_connection.fd = connection.detachSocket();
+  stats.idle.fetch_add(1, std::memory_order_relaxed);
+  auto &idle_list = idle_set[key];
+  if (idle_list.size() >= max_idle) {
+    stats.discarded.fetch_add(1, std::memory_order_relaxed);
+    close(idle_connection);
+    return false;
+  }
+  idle_list.push_back(idle_connection);
+  stats.released.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool ConnectionPool::warm(const std::string &key, Connection &connection,
+                          size_t max_idle, int timeout) {
+  if (!release(key, connection, max_idle, timeout)) return false;
+  stats.warmed.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void ConnectionPool::expire() {
+  auto now = std::chrono::steady_clock::now();
+  if (now - last_expire < std::chrono::seconds(1)) return;
+  last_expire = now;
+  for (auto it = idle_set.begin(); it != idle_set.end();) {
+    auto &idle_list = it->second;
+    /* the oldest connections are at the front */
+    size_t expired = 0;
+    while (expired < idle_list.size() &&
+           idle_list[expired].expiration <= now) {
+      stats.expired.fetch_add(1, std::memory_order_relaxed);
+      close(idle_list[expired++]);
+    }
+    idle_list.erase(idle_list.begin(), idle_list.begin() + expired);
+    it = idle_list.empty() ? idle_set.erase(it) : std::next(it);
+  }
+}
+
+size_t ConnectionPool::size(const std::string &key) const {
+  auto it = idle_set.find(key);
+  return it != idle_set.end() ? it->second.size() : 0;
+}
@@ -0,0 +1,155 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <openssl/ssl.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../ssl/ssl_common.h"
+
+class Connection;
+
+/** Idle connections each backend keeps by default, 0 disables the pool. */
+#ifndef CONNECTION_POOL_MAX_IDLE
+#define CONNECTION_POOL_MAX_IDLE 0
+#endif
+/** Connections each backend keeps established in advance by default. */
+#ifndef CONNECTION_POOL_MIN_IDLE
+#define CONNECTION_POOL_MIN_IDLE 0
+#endif
+/** Seconds an idle connection is kept by default, it should be shorter than
+ * the keep-alive timeout of the backends. */
+#ifndef CONNECTION_POOL_IDLE_TIMEOUT
+#define CONNECTION_POOL_IDLE_TIMEOUT 4
+#endif
+
+/**
+ * @class ConnectionPool connection_pool.h "src/connection/connection_pool.h"
+ * @brief Pool of the idle keep-alive connections to the backends.
+ *
+ * A stream returns its backend connection once the response has been
+ * forwarded and the next stream sending a request to the same backend takes
+ * it instead of connecting, so the backends see fewer connects, TLS
+ * handshakes and TIME_WAIT sockets. Connections are kept by key, which
+ * identifies the backend address and the TLS setup, and reused last in,
+ * first out. Each StreamManager owns a pool that is only used from its
+ * worker thread.
+ */
+class ConnectionPool {
+ public:
+  struct Stats {
+    /** Connections taken from the pool. */
+    std::atomic<uint64_t> hits{0};
+    /** Checkouts with no idle connection to reuse. */
+    std::atomic<uint64_t> misses{0};
+    /** Connections returned to the pool. */
+    std::atomic<uint64_t> released{0};
+    /** Idle connections closed by the idle timeout. */
+    std::atomic<uint64_t> expired{0};
+    /** Idle connections found closed or with unexpected data on checkout. */
+    std::atomic<uint64_t> closed{0};
+    /** Connections closed on release because the pool was full. */
+    std::atomic<uint64_t> discarded{0};
+    /** Connections established in advance and added to the pool. */
+    std::atomic<uint64_t> warmed{0};
+    /** Idle connections in the pool. */
+    std::atomic<int64_t> idle{0};
+  };
+
+ private:
+  struct IdleConnection {
+    int fd;
+    SSL *ssl;
+    BIO *sbio;
+    BIO *io;
+    BIO *ssl_bio;
+    ssl::SSL_STATUS ssl_conn_status;
+    bool ktls_send;
+    bool ktls_recv;
+    std::chrono::steady_clock::time_point expiration;
+  };
+  std::unordered_map<std::string, std::vector<IdleConnection>> idle_set;
+  std::chrono::steady_clock::time_point last_expire;
+  Stats stats;
+
+  void close(IdleConnection &idle_connection);
+
+ public:
+  ConnectionPool() = default;
+  ~ConnectionPool();
+  ConnectionPool(const ConnectionPool &) = delete;
+  ConnectionPool &operator=(const ConnectionPool &) = delete;
+
+  /**
+   * @brief Sets up @p connection with an idle connection of @p key.
+   *
+   * The idle connections closed by the peer or that got unexpected data are
+   * closed and skipped.
+   *
+   * @param key identifies the backend.
+   * @param connection is the connection to set up, it must have no socket.
+   * @return @c true if an idle connection was reused, @c false if a new one
+   * has to be connected.
+   */
+  bool acquire(const std::string &key, Connection &connection);
+
+  /**
+   * @brief Moves the socket and the TLS session of @p connection to the pool.
+   *
+   * @p connection is reset, its socket must have been removed from the event
+   * manager. The socket is closed if the pool of @p key already holds
+   * @p max_idle connections.
+   *
+   * @param key identifies the backend.
+   * @param connection is the idle connection to return.
+   * @param max_idle is the maximum number of idle connections of @p key.
+   * @param timeout is the number of seconds the connection is kept.
+   * @return @c true if the connection was kept, @c false if it was closed.
+   */
+  bool release(const std::string &key, Connection &connection,
+               size_t max_idle, int timeout);
+
+  /**
+   * @brief Adds @p connection, established in advance to keep the idle
+   * connections of @p key over its minimum, to the pool as release() does.
+   * It is counted as released too.
+   * @return @c true if the connection was kept, @c false if it was closed.
+   */
+  bool warm(const std::string &key, Connection &connection, size_t max_idle,
+            int timeout);
+
+  /**
+   * @brief Closes the idle connections whose timeout has expired, it runs at
+   * most once per second.
+   */
+  void expire();
+
+  /** @return the number of idle connections of @p key. */
+  size_t size(const std::string &key) const;
+
+  /** @return the pool statistics. */
+  const Stats &getStats() const { return stats; }
+};
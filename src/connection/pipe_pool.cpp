@@ -0,0 +1,86 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "pipe_pool.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include "../debug/logger.h"
+
+static thread_local PipePool *local_pool{nullptr};
+
+PipePool::~PipePool() {
+  for (auto &pipe : free_list) {
+    ::close(pipe.fds[0]);
+    ::close(pipe.fds[1]);
+  }
+}
+
+bool PipePool::acquire(int fds[2], size_t &size) {
+  if (!free_list.empty()) {
+    auto &pipe = free_list.back();
+    fds[0] = pipe.fds[0];
+    fds[1] = pipe.fds[1];
+    size = pipe.size;
+    free_list.pop_back();
+    stats.hits.fetch_add(1, std::memory_order_relaxed);
+    stats.cached.fetch_sub(1, std::memory_order_relaxed);
+    stats.in_use.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0) {
+    Logger::logmsg(LOG_ERR, "pipe2() failed: %s", std::strerror(errno));
+    fds[0] = fds[1] = -1;
+    return false;
+  }
+  /* the pipe keeps its default size if the limit does not allow it */
+  int pipe_size = ::fcntl(fds[1], F_SETPIPE_SZ, PIPE_POOL_PIPE_SIZE);
+  if (pipe_size < 0) pipe_size = ::fcntl(fds[1], F_GETPIPE_SZ);
+  size = pipe_size > 0 ? static_cast<size_t>(pipe_size) : 0;
+  stats.pipe_size.store(static_cast<int64_t>(size), std::memory_order_relaxed);
+  stats.misses.fetch_add(1, std::memory_order_relaxed);
+  stats.in_use.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void PipePool::release(int fds[2], size_t size, bool drained) {
+  stats.in_use.fetch_sub(1, std::memory_order_relaxed);
+  if (drained && free_list.size() < PIPE_POOL_MAX_CACHED) {
+    free_list.push_back({{fds[0], fds[1]}, size});
+    stats.cached.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    if (!drained) stats.discarded.fetch_add(1, std::memory_order_relaxed);
+    ::close(fds[0]);
+    ::close(fds[1]);
+  }
+  fds[0] = fds[1] = -1;
+}
+
+PipePool &PipePool::local() {
+  if (local_pool == nullptr) {
+    static thread_local PipePool thread_pool;
+    local_pool = &thread_pool;
+  }
+  return *local_pool;
+}
+
+void PipePool::setLocal(PipePool *pool) { local_pool = pool; }
@@ -0,0 +1,102 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** Capacity requested for the pipes with F_SETPIPE_SZ. */
+#ifndef PIPE_POOL_PIPE_SIZE
+#define PIPE_POOL_PIPE_SIZE (256 * 1024)
+#endif
+/** Free pipes each pool keeps open for reuse. */
+#ifndef PIPE_POOL_MAX_CACHED
+#define PIPE_POOL_MAX_CACHED 64
+#endif
+
+/**
+ * @class PipePool pipe_pool.h "src/connection/pipe_pool.h"
+ * @brief Pool of the pipes used to splice body data between two sockets.
+ *
+ * A connection leases a pipe while it splices a body and returns it once the
+ * pipe is drained, so idle connections do not hold any pipe and a new stream
+ * costs no pipe2(2) call. Each StreamManager owns a pool that is only used
+ * from its worker thread, the threads without one use a thread local pool.
+ */
+class PipePool {
+ public:
+  struct Stats {
+    /** Pipes served from the cache. */
+    std::atomic<uint64_t> hits{0};
+    /** Pipes created because the cache was empty. */
+    std::atomic<uint64_t> misses{0};
+    /** Pipes closed on release because they still held data. */
+    std::atomic<uint64_t> discarded{0};
+    /** Pipes leased to connections. */
+    std::atomic<int64_t> in_use{0};
+    /** Free pipes cached. */
+    std::atomic<int64_t> cached{0};
+    /** Capacity of the last pipe created, 0 if none. */
+    std::atomic<int64_t> pipe_size{0};
+  };
+
+ private:
+  struct Pipe {
+    int fds[2];
+    size_t size;
+  };
+  std::vector<Pipe> free_list;
+  Stats stats;
+
+ public:
+  PipePool() = default;
+  ~PipePool();
+  PipePool(const PipePool &) = delete;
+  PipePool &operator=(const PipePool &) = delete;
+
+  /**
+   * @brief Leases a non blocking pipe.
+   * @param fds is set to the read and write ends of the pipe.
+   * @param size is set to the capacity of the pipe.
+   * @return @c true on success, @c false if a new pipe could not be created.
+   */
+  bool acquire(int fds[2], size_t &size);
+
+  /**
+   * @brief Returns a pipe got from acquire().
+   * @param fds are the pipe ends, they are set to -1.
+   * @param size is the capacity of the pipe.
+   * @param drained tells if the pipe is empty, pipes with data are closed.
+   */
+  void release(int fds[2], size_t size, bool drained);
+
+  /** @return the pool statistics. */
+  const Stats &getStats() const { return stats; }
+
+  /** @return the pool of the calling thread. */
+  static PipePool &local();
+
+  /** @brief Sets @p pool as the pool of the calling thread. */
+  static void setLocal(PipePool *pool);
+};
@@ -0,0 +1,309 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "segment_buffer.h"
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include "../debug/logger.h"
+#include "../util/network.h"
+
+ZeroCopySender::ZeroCopySender(ZeroCopySender &&other) noexcept
+    : pending(std::move(other.pending)),
+      early_completions(std::move(other.early_completions)),
+      next_id(other.next_id),
+      completed_id(other.completed_id),
+      state(other.state),
+      closed(other.closed),
+      threshold(other.threshold),
+      sends(other.sends),
+      copied(other.copied) {
+  other.pending.clear();
+  other.early_completions.clear();
+  other.next_id = other.completed_id = 0;
+  other.state = 0;
+  other.closed = false;
+}
+
+bool ZeroCopySender::enable(int fd) {
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+  if (state == 0) state = Network::setSoZeroCopy(fd) ? 1 : -1;
+  return state > 0;
+#else
+  return false;
+#endif
+}
+
+void ZeroCopySender::retire(char *data, size_t capacity, uint32_t id) {
+  pending.push_back({data, capacity, id});
+}
+
+void ZeroCopySender::complete(uint32_t first, uint32_t last) {
+  if (first != completed_id) {
+    /* the kernel may report a range before the previous ones */
+    early_completions.emplace_back(first, last);
+    return;
+  }
+  completed_id = last + 1;
+  for (auto it = early_completions.begin(); it != early_completions.end();) {
+    if (it->first == completed_id) {
+      completed_id = it->second + 1;
+      early_completions.erase(it);
+      it = early_completions.begin();
+    } else {
+      it++;
+    }
+  }
+  while (!pending.empty() && isCompleted(pending.front().id)) {
+    if (closed)
+      BufferPool::local().reclaim(pending.front().data,
+                                  pending.front().capacity);
+    else
+      BufferPool::local().release(pending.front().data,
+                                  pending.front().capacity);
+    pending.pop_front();
+  }
+}
+
+bool ZeroCopySender::readCompletions(int fd) {
+  bool read_any = false;
+#ifdef SO_EE_ORIGIN_ZEROCOPY
+  char control[128];
+  for (;;) {
+    msghdr msg{};
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (::recvmsg(fd, &msg, MSG_ERRQUEUE) < 0) break;
+    for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) &&
+          !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+        continue;
+      auto error = reinterpret_cast<sock_extended_err *>(CMSG_DATA(cmsg));
+      if (error->ee_errno != 0 || error->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+        continue;
+      /* the range [ee_info, ee_data] of sends has completed */
+      if ((error->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0)
+        copied += error->ee_data - error->ee_info + 1;
+      complete(error->ee_info, error->ee_data);
+      read_any = true;
+    }
+  }
+#endif
+  return read_any;
+}
+
+void ZeroCopySender::close(int fd) {
+  if (hasPending()) readCompletions(fd);
+  if (!hasPending()) {
+    clear();
+    ::close(fd);
+    return;
+  }
+  /* the peer still gets all the data and the FIN, the socket stays open for
+   * the error queue only */
+  ::shutdown(fd, SHUT_RDWR);
+  for (auto &segment : pending)
+    BufferPool::local().defer(segment.data, segment.capacity);
+  closed = true;
+  BufferPool::local().linger(fd,
+                             std::make_unique<ZeroCopySender>(std::move(*this)));
+}
+
+void ZeroCopySender::clear() {
+  if (!closed)
+    for (auto &segment : pending)
+      BufferPool::local().defer(segment.data, segment.capacity);
+  pending.clear();
+  early_completions.clear();
+  next_id = completed_id = 0;
+  state = 0;
+  closed = false;
+}
+
+void ZeroCopySender::discard() {
+  for (auto &segment : pending) delete[] segment.data;
+  pending.clear();
+}
+
+void SegmentBuffer::release(Segment &segment, ZeroCopySender *zerocopy) {
+  if (!segment.zerocopy || (zerocopy != nullptr &&
+                            zerocopy->isCompleted(segment.zerocopy_id)))
+    BufferPool::local().release(segment.data, segment.capacity);
+  else if (zerocopy != nullptr)
+    zerocopy->retire(segment.data, segment.capacity, segment.zerocopy_id);
+  else
+    BufferPool::local().defer(segment.data, segment.capacity);
+}
+
+void SegmentBuffer::releaseEmptyTail() {
+  while (!segments.empty() && segments.back().end == 0) {
+    BufferPool::local().release(segments.back().data,
+                                segments.back().capacity);
+    segments.pop_back();
+  }
+}
+
+IO::IO_RESULT SegmentBuffer::readFrom(int fd, size_t max_bytes) {
+  iovec iov[SEGMENT_BUFFER_MAX_SEGMENTS];
+  size_t iov_size = 0;
+  size_t space = 0;
+  size_t first = segments.size();
+  if (!segments.empty() && segments.back().end < segments.back().capacity) {
+    first--;
+  }
+  for (auto i = first; space < max_bytes && i < SEGMENT_BUFFER_MAX_SEGMENTS;
+       i++) {
+    if (i == segments.size()) {
+      Segment segment;
+      segment.data = BufferPool::local().acquire(MAX_DATA_SIZE, segment.capacity);
+      segments.push_back(segment);
+    }
+    auto &segment = segments[i];
+    auto len = std::min(segment.capacity - segment.end, max_bytes - space);
+    iov[iov_size++] = {segment.data + segment.end, len};
+    space += len;
+  }
+  if (space == 0) return IO::IO_RESULT::FULL_BUFFER;
+
+  auto count = ::readv(fd, iov, static_cast<int>(iov_size));
+  if (count < 0) {
+    releaseEmptyTail();
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return IO::IO_RESULT::DONE_TRY_AGAIN;
+    std::string error = "readv() failed  ";
+    error += std::strerror(errno);
+    Logger::LogInfo(error, LOG_NOTICE);
+    return IO::IO_RESULT::ERROR;
+  }
+  if (count == 0) {
+    releaseEmptyTail();
+    return IO::IO_RESULT::FD_CLOSED;
+  }
+  auto left = static_cast<size_t>(count);
+  data_size += left;
+  for (auto i = first; left > 0; i++) {
+    auto len = std::min(left, iov[i - first].iov_len);
+    segments[i].end += len;
+    left -= len;
+  }
+  releaseEmptyTail();
+  return static_cast<size_t>(count) == space ? IO::IO_RESULT::FULL_BUFFER
+                                             : IO::IO_RESULT::SUCCESS;
+}
+
+IO::IO_RESULT SegmentBuffer::writeTo(int fd, size_t &sent,
+                                     ZeroCopySender *zerocopy) {
+  iovec iov[SEGMENT_BUFFER_MAX_SEGMENTS];
+  sent = 0;
+  while (data_size > 0) {
+    auto iov_size = getIovec(iov, SEGMENT_BUFFER_MAX_SEGMENTS);
+    ssize_t count = -1;
+    bool zerocopy_send = zerocopy != nullptr && zerocopy->threshold > 0 &&
+                         data_size >= zerocopy->threshold &&
+                         zerocopy->enable(fd);
+#ifdef MSG_ZEROCOPY
+    if (zerocopy_send) {
+      msghdr msg{};
+      msg.msg_iov = iov;
+      msg.msg_iovlen = iov_size;
+      count = ::sendmsg(fd, &msg, MSG_ZEROCOPY | MSG_NOSIGNAL);
+      /* no memory left for the notifications, copy this write */
+      if (count < 0 && errno == ENOBUFS) zerocopy_send = false;
+    }
+#endif
+    if (!zerocopy_send)
+      count = ::writev(fd, iov, static_cast<int>(iov_size));
+    if (count < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return IO::IO_RESULT::DONE_TRY_AGAIN;
+      std::string error = "writev() failed  ";
+      error += std::strerror(errno);
+      Logger::LogInfo(error, LOG_NOTICE);
+      return IO::IO_RESULT::ERROR;
+    }
+    if (zerocopy_send) {
+      /* the segments written are kept until this send completes */
+      auto id = zerocopy->onSend();
+      auto left = static_cast<size_t>(count);
+      for (auto it = segments.begin(); it != segments.end() && left > 0; it++) {
+        if (it->end == it->begin) continue;
+        it->zerocopy = true;
+        it->zerocopy_id = id;
+        left -= std::min(left, it->end - it->begin);
+      }
+    }
+    consume(static_cast<size_t>(count), zerocopy);
+    sent += static_cast<size_t>(count);
+  }
+  return IO::IO_RESULT::SUCCESS;
+}
+
+void SegmentBuffer::append(const char *data, size_t size) {
+  while (size > 0) {
+    if (segments.empty() || segments.back().end == segments.back().capacity) {
+      Segment segment;
+      segment.data = BufferPool::local().acquire(MAX_DATA_SIZE, segment.capacity);
+      segments.push_back(segment);
+    }
+    auto &segment = segments.back();
+    auto len = std::min(size, segment.capacity - segment.end);
+    std::memcpy(segment.data + segment.end, data, len);
+    segment.end += len;
+    data_size += len;
+    data += len;
+    size -= len;
+  }
+}
+
+size_t SegmentBuffer::getIovec(iovec *iov, size_t iov_size) const {
+  size_t count = 0;
+  for (auto it = segments.begin(); it != segments.end() && count < iov_size;
+       it++) {
+    if (it->end == it->begin) continue;
+    iov[count++] = {it->data + it->begin, it->end - it->begin};
+  }
+  return count;
+}
+
+void SegmentBuffer::consume(size_t bytes, ZeroCopySender *zerocopy) {
+  bytes = std::min(bytes, data_size);
+  data_size -= bytes;
+  while (!segments.empty()) {
+    auto &segment = segments.front();
+    auto len = std::min(bytes, segment.end - segment.begin);
+    segment.begin += len;
+    bytes -= len;
+    if (segment.begin < segment.end) break;
+    release(segment, zerocopy);
+    segments.pop_front();
+  }
+}
+
+void SegmentBuffer::clear(ZeroCopySender *zerocopy) {
+  for (auto &segment : segments) release(segment, zerocopy);
+  segments.clear();
+  data_size = 0;
+}
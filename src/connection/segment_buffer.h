@@ -0,0 +1,221 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <sys/uio.h>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+#include "../util/utils.h"
+#include "buffer_pool.h"
+
+/** Segments a SegmentBuffer can hold, it limits the data read by each readv. */
+#ifndef SEGMENT_BUFFER_MAX_SEGMENTS
+#define SEGMENT_BUFFER_MAX_SEGMENTS 4
+#endif
+
+/**
+ * @class ZeroCopySender segment_buffer.h "src/connection/segment_buffer.h"
+ * @brief MSG_ZEROCOPY state of a socket.
+ *
+ * The kernel reads the pages of a MSG_ZEROCOPY send after sendmsg(2) has
+ * returned, so the segments written this way are kept here until the
+ * completion of their send is read from the socket error queue. Sends are
+ * numbered in the same order as the kernel does, starting at 0.
+ */
+class ZeroCopySender {
+  struct Pending {
+    char *data;
+    size_t capacity;
+    uint32_t id;
+  };
+  /** Segments already written, waiting for their completion. */
+  std::deque<Pending> pending;
+  /** Completion ranges received before the previous ones. */
+  std::vector<std::pair<uint32_t, uint32_t>> early_completions;
+  /** Number of the next send. */
+  uint32_t next_id{0};
+  /** All the sends before this one have completed. */
+  uint32_t completed_id{0};
+  /** 1 if SO_ZEROCOPY is enabled, -1 if it is not supported. */
+  int state{0};
+  /** The socket has been closed, its segments are deferred in the pool. */
+  bool closed{false};
+
+  void complete(uint32_t first, uint32_t last);
+
+ public:
+  /** Minimum bytes of a write to send it with MSG_ZEROCOPY, 0 disables it. */
+  size_t threshold{0};
+  /** Sends done with MSG_ZEROCOPY. */
+  uint64_t sends{0};
+  /** Sends the kernel completed by copying the data. */
+  uint64_t copied{0};
+
+  ZeroCopySender() = default;
+  ~ZeroCopySender() { clear(); }
+  ZeroCopySender(const ZeroCopySender &) = delete;
+  ZeroCopySender &operator=(const ZeroCopySender &) = delete;
+  /** Takes the sends of @p other, which is left as a new sender. */
+  ZeroCopySender(ZeroCopySender &&other) noexcept;
+
+  /**
+   * @brief Enables SO_ZEROCOPY on @p fd the first time it is called.
+   * @return @c true if MSG_ZEROCOPY can be used on @p fd.
+   */
+  bool enable(int fd);
+
+  /** @return the number given to the next send and counts it. */
+  uint32_t onSend() {
+    sends++;
+    return next_id++;
+  }
+
+  /** @return @c true if the send @p id has completed. */
+  bool isCompleted(uint32_t id) const {
+    return static_cast<int32_t>(id - completed_id) < 0;
+  }
+
+  /** @return @c true if there are sends waiting for their completion. */
+  bool hasPending() const { return next_id != completed_id; }
+
+  /**
+   * @brief Keeps a segment written by the send @p id until it completes.
+   * @param data is the segment buffer.
+   * @param capacity is the segment buffer size.
+   * @param id is the last send that included data of the segment.
+   */
+  void retire(char *data, size_t capacity, uint32_t id);
+
+  /**
+   * @brief Reads the completions queued in the error queue of @p fd and
+   * returns the segments of the completed sends to the pool.
+   * @return @c true if any completion has been read.
+   */
+  bool readCompletions(int fd);
+
+  /**
+   * @brief Closes the socket @p fd of the sends.
+   *
+   * The kernel can retransmit the pages of a send until the peer acknowledges
+   * them, after the close too. If some sends are still pending the socket is
+   * shut down instead and handed over, with them, to the BufferPool of the
+   * thread, which closes it and reuses the segments once they complete.
+   */
+  void close(int fd);
+
+  /**
+   * @brief Resets the state. The segments still pending, if any, are given up
+   * to the kernel and never reused, it must only happen if their socket was
+   * closed without close().
+   */
+  void clear();
+
+  /** @brief Frees the segments still pending, only when their pool is
+   * destroyed. */
+  void discard();
+};
+
+/**
+ * @class SegmentBuffer segment_buffer.h "src/connection/segment_buffer.h"
+ * @brief Chain of pooled buffer segments used to forward message bodies.
+ *
+ * Data is read with a single readv(2) into the free space of the chain and
+ * written with writev(2), so a body larger than one buffer does not need one
+ * event round trip per buffer and bytes are never moved inside the buffers.
+ * Segments are taken from the BufferPool of the calling thread and returned
+ * as soon as they have been written.
+ */
+class SegmentBuffer {
+  struct Segment {
+    char *data{nullptr};
+    size_t capacity{0};
+    /** Offset of the first byte not written yet. */
+    size_t begin{0};
+    /** Offset of the first free byte. */
+    size_t end{0};
+    /** Last MSG_ZEROCOPY send that included data of the segment. */
+    uint32_t zerocopy_id{0};
+    bool zerocopy{false};
+  };
+  std::deque<Segment> segments;
+  size_t data_size{0};
+
+  void releaseEmptyTail();
+  void release(Segment &segment, ZeroCopySender *zerocopy);
+
+ public:
+  SegmentBuffer() = default;
+  ~SegmentBuffer() { clear(); }
+  SegmentBuffer(const SegmentBuffer &) = delete;
+  SegmentBuffer &operator=(const SegmentBuffer &) = delete;
+
+  /** @return the bytes queued in the chain. */
+  size_t size() const { return data_size; }
+  bool empty() const { return data_size == 0; }
+  /** @return the number of segments attached. */
+  size_t segmentCount() const { return segments.size(); }
+
+  /**
+   * @brief Reads from @p fd into the free space of the chain.
+   * @param fd is the socket to read from.
+   * @param max_bytes is the maximum number of bytes to read.
+   * @return FULL_BUFFER if all the space offered has been filled or there is
+   * no space left, the same results as Connection::read() otherwise.
+   */
+  IO::IO_RESULT readFrom(int fd, size_t max_bytes);
+
+  /**
+   * @brief Writes the queued data to @p fd until it is empty or would block.
+   * @param fd is the socket to write to.
+   * @param sent is set to the number of bytes written.
+   * @param zerocopy is the MSG_ZEROCOPY state of @p fd, writes of at least
+   * its threshold are sent with MSG_ZEROCOPY.
+   * @return SUCCESS if the chain has been emptied, DONE_TRY_AGAIN if the
+   * socket would block or ERROR.
+   */
+  IO::IO_RESULT writeTo(int fd, size_t &sent,
+                        ZeroCopySender *zerocopy = nullptr);
+
+  /** @brief Copies @p size bytes at the end of the chain. */
+  void append(const char *data, size_t size);
+
+  /**
+   * @brief Fills @p iov with the queued data, one entry per segment.
+   * @return the number of entries used.
+   */
+  size_t getIovec(iovec *iov, size_t iov_size) const;
+
+  /**
+   * @brief Discards the first @p bytes queued.
+   * @param zerocopy keeps the emptied segments sent with MSG_ZEROCOPY.
+   */
+  void consume(size_t bytes, ZeroCopySender *zerocopy = nullptr);
+
+  /**
+   * @brief Discards all the data and returns the segments to the pool.
+   * @param zerocopy keeps the segments sent with MSG_ZEROCOPY that have not
+   * completed yet.
+   */
+  void clear(ZeroCopySender *zerocopy = nullptr);
+};
@@ -216,7 +216,14 @@ std::string ctl::ControlManager::handleCommand(HttpRequest &request) {
   std::string str;
   bool multiple = false;
   for (auto it = result.begin(); it < result.end(); it++) {
-    auto res_string = it->get();
+    std::string res_string;
+    try {
+      res_string = it->get();
+    } catch (const std::future_error &e) {
+      // the observer stopped before running the task
+      Logger::logmsg(LOG_WARNING, "Control task not completed: %s", e.what());
+      continue;
+    }
     if (res_string.empty()) continue;
     str += res_string;
     if (it + 1 < result.end()) {
@@ -34,14 +34,16 @@
 namespace ctl {
 using namespace events;
 using namespace json;
-class ControlManager : public EpollManager, public CtlNotify<CtlTask, std::string> {
+class ControlManager : public EpollManager<ControlManager>,
+                       public CtlNotify<CtlTask, std::string> {
   static std::shared_ptr<ControlManager> instance;
   std::thread control_thread;
   Connection control_listener;
   std::atomic<bool> is_running;
   CTL_INTERFACE_MODE ctl_listener_mode;
   std::string control_path_name;
-  void HandleEvent(int fd, EVENT_TYPE event_type, EVENT_GROUP event_group) override;
+  friend class EpollManager<ControlManager>;
+  void HandleEvent(int fd, EVENT_TYPE event_type, EVENT_GROUP event_group);
   void doWork();
 
  public:
@@ -20,7 +20,9 @@
  */
 #pragma once
 
+#include <functional>
 #include <future>
+#include <memory>
 #include <vector>
 
 template <typename T, typename IResponse>
@@ -35,6 +37,17 @@ class CtlObserver {
   virtual ~CtlObserver() = default;
   virtual IResponse handleTask(T &arg) = 0;
   static IResponse handle(T arg, CtlObserver<T, IResponse> &obj) { return obj.handleTask(arg); }
+  /**
+   * @brief Queues a task to be run by the observer own thread.
+   *
+   * Observers running an event loop override it to deliver the tasks through
+   * their events::Mailbox. The default one queues nothing.
+   *
+   * @return @c true if the task was queued, @c false if the observer has no
+   * thread to run it or does not take more tasks: the task has not been run
+   * and the caller must run it itself.
+   */
+  virtual bool postTask(std::function<void()>) { return false; }
   virtual bool isHandler(T &arg) = 0;
   bool operator==(const CtlObserver& rhs) {
     return this->__id__ == rhs.__id__;
@@ -78,8 +91,14 @@ class CtlNotify {
         continue;
       }
       if ((*it)->isHandler(arg)) {
-        result_future.push_back(std::async(lazy_eval ? std::launch::deferred : std::launch::async, (*it)->handle,
-                                           arg, std::ref(*(*it))));
+        if (lazy_eval) {
+          result_future.push_back(std::async(std::launch::deferred, (*it)->handle, arg, std::ref(*(*it))));
+        } else {
+          auto task = std::make_shared<std::packaged_task<IResponse()>>(
+              std::bind((*it)->handle, arg, std::ref(*(*it))));
+          result_future.push_back(task->get_future());
+          if (!(*it)->postTask([task] { (*task)(); })) (*task)();
+        }
       }
       it++;
     }
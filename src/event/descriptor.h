@@ -26,7 +26,7 @@
 #include <atomic>
 namespace events {
 class Descriptor {
-  events::EpollManager *event_manager_{nullptr};
+  events::EventManager *event_manager_{nullptr};
   std::atomic<events::EVENT_TYPE> current_event{events::EVENT_TYPE::NONE};
   std::atomic<events::EVENT_GROUP> event_group_{events::EVENT_GROUP::NONE};
   bool cancelled{false};
@@ -40,7 +40,7 @@ class Descriptor {
     if (event_manager_ != nullptr && fd_ > 0) event_manager_->deleteFd(fd_);
   }
 
-  inline void setEventManager(events::EpollManager &event_manager) { event_manager_ = &event_manager; }
+  inline void setEventManager(events::EventManager &event_manager) { event_manager_ = &event_manager; }
   inline bool isCancelled() const { return cancelled; }
   inline bool disableEvents() {
     current_event = events::EVENT_TYPE::NONE;
@@ -49,7 +49,7 @@ class Descriptor {
     return false;
   }
 
-  inline bool enableEvents(events::EpollManager *epoll_manager, events::EVENT_TYPE event_type,
+  inline bool enableEvents(events::EventManager *epoll_manager, events::EVENT_TYPE event_type,
                            events::EVENT_GROUP event_group) {
     if (epoll_manager != nullptr && fd_ > 0) {
       cancelled = false;
@@ -105,6 +105,8 @@ class Descriptor {
 
   inline int getFileDescriptor() const { return fd_; }
 
+  inline events::EVENT_TYPE getCurrentEvent() const { return current_event; }
+
   inline void setFileDescriptor(int fd) {
     if (fd < 0) {
       Logger::LogInfo("File descriptor not valid", LOG_REMOVE);
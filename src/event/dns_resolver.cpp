@@ -0,0 +1,653 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "dns_resolver.h"
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include "../debug/logger.h"
+
+namespace events {
+
+static const uint16_t DNS_PORT = 53;
+static const size_t DNS_HEADER_SIZE = 12;
+/* answers of plain DNS over UDP are up to 512 bytes, more is allowed */
+static const size_t DNS_MAX_MESSAGE = 1500;
+
+static std::string toLower(std::string name) {
+  std::transform(name.begin(), name.end(), name.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  if (!name.empty() && name.back() == '.') name.pop_back();
+  return name;
+}
+
+static uint16_t readU16(const uint8_t *data) {
+  return static_cast<uint16_t>((data[0] << 8) | data[1]);
+}
+
+static uint32_t readU32(const uint8_t *data) {
+  return (static_cast<uint32_t>(readU16(data)) << 16) | readU16(data + 2);
+}
+
+/* Skips the possibly compressed name at @p pos, @return false if it is not
+ * valid. */
+static bool skipName(const uint8_t *data, size_t size, size_t &pos) {
+  while (pos < size) {
+    uint8_t len = data[pos];
+    if (len == 0) {
+      pos++;
+      return true;
+    }
+    if ((len & 0xc0) == 0xc0) {
+      pos += 2;
+      return pos <= size;
+    }
+    if ((len & 0xc0) != 0) return false;
+    pos += 1 + len;
+  }
+  return false;
+}
+
+static socklen_t addressLength(const sockaddr_storage &address) {
+  return address.ss_family == AF_INET6 ? sizeof(sockaddr_in6)
+                                       : sizeof(sockaddr_in);
+}
+
+/* Adds the @p addresses of the family of each query to its list. */
+static void splitFamilies(const std::vector<sockaddr_storage> &addresses,
+                          std::vector<sockaddr_storage> &ipv4,
+                          std::vector<sockaddr_storage> &ipv6) {
+  for (auto &address : addresses) {
+    if (address.ss_family == AF_INET)
+      ipv4.push_back(address);
+    else if (address.ss_family == AF_INET6)
+      ipv6.push_back(address);
+  }
+}
+
+DnsResolver::Lookup::~Lookup() {
+  if (fd >= 0) ::close(fd);
+}
+
+DnsResolver::DnsResolver() {
+  std::random_device seed;
+  generator.seed(seed());
+}
+
+DnsResolver::~DnsResolver() { closeAll(); }
+
+bool DnsResolver::parseAddress(const std::string &address,
+                               sockaddr_storage &result) {
+  std::memset(&result, 0, sizeof(result));
+  auto &in4 = reinterpret_cast<sockaddr_in &>(result);
+  auto &in6 = reinterpret_cast<sockaddr_in6 &>(result);
+  if (::inet_pton(AF_INET, address.data(), &in4.sin_addr) == 1) {
+    in4.sin_family = AF_INET;
+    return true;
+  }
+  if (::inet_pton(AF_INET6, address.data(), &in6.sin6_addr) == 1) {
+    in6.sin6_family = AF_INET6;
+    return true;
+  }
+  return false;
+}
+
+void DnsResolver::closeAll() {
+  for (auto &[name, entry] : entries) {
+    for (auto &pending : entry.queries) closeSocket(pending.fd);
+    /* a running lookup closes its eventfd when it ends */
+    if (entry.lookup != nullptr) removeSocket(entry.lookup->fd);
+  }
+  entries.clear();
+  sockets.clear();
+  if (fd_ >= 0) ::close(fd_);
+  fd_ = -1;
+}
+
+bool DnsResolver::open() {
+  closeAll();
+  if (nameservers.empty()) return false;
+  /* the query sockets are watched by an epoll descriptor of the resolver, it
+   * is the one registered in the loop */
+  fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+  if (fd_ < 0) {
+    Logger::logmsg(LOG_ERR, "DNS resolver epoll_create1() failed: %s",
+                   std::strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+static std::vector<sockaddr_storage> withPort(
+    const std::vector<sockaddr_storage> &servers) {
+  std::vector<sockaddr_storage> result;
+  for (auto nameserver : servers) {
+    auto &port = nameserver.ss_family == AF_INET6
+                     ? reinterpret_cast<sockaddr_in6 &>(nameserver).sin6_port
+                     : reinterpret_cast<sockaddr_in &>(nameserver).sin_port;
+    if (port == 0) port = htons(DNS_PORT);
+    result.push_back(nameserver);
+  }
+  return result;
+}
+
+bool DnsResolver::init(const std::vector<sockaddr_storage> &nameservers_,
+                       const std::vector<std::string> &search_, int ndots_) {
+  resolv_conf_path.clear();
+  hosts_path.clear();
+  nsswitch_path.clear();
+  hosts.clear();
+  nameservers = withPort(nameservers_);
+  search.clear();
+  for (auto &domain : search_) search.push_back(toLower(domain));
+  ndots = ndots_;
+  use_files = use_dns = true;
+  use_lookup = false;
+  return open();
+}
+
+bool DnsResolver::init(const std::string &resolv_conf,
+                       const std::string &hosts_file,
+                       const std::string &nsswitch_conf) {
+  resolv_conf_path = resolv_conf;
+  hosts_path = hosts_file;
+  nsswitch_path = nsswitch_conf;
+  files_stamp.clear();
+  loadFiles();
+  return open();
+}
+
+bool DnsResolver::loadFiles() {
+  std::string stamp;
+  for (auto path : {&resolv_conf_path, &hosts_path, &nsswitch_path}) {
+    struct stat info {};
+    if (path->empty() || ::stat(path->data(), &info) != 0) {
+      stamp += "-;";
+      continue;
+    }
+    stamp += std::to_string(info.st_ino) + ' ' + std::to_string(info.st_size) +
+             ' ' + std::to_string(info.st_mtim.tv_sec) + '.' +
+             std::to_string(info.st_mtim.tv_nsec) + ';';
+  }
+  if (resolv_conf_path.empty() || stamp == files_stamp) return false;
+  files_stamp = stamp;
+
+  std::vector<sockaddr_storage> servers;
+  search.clear();
+  ndots = 1;
+  bool has_search = false;
+  std::ifstream resolv(resolv_conf_path);
+  std::string line;
+  while (std::getline(resolv, line)) {
+    std::istringstream tokens(line.substr(0, line.find_first_of("#;")));
+    std::string key, value;
+    if (!(tokens >> key)) continue;
+    if (key == "nameserver") {
+      sockaddr_storage address{};
+      if (tokens >> value &&
+          parseAddress(value.substr(0, value.find('%')), address))
+        servers.push_back(address);
+    } else if (key == "search" || key == "domain") {
+      /* the last one is used */
+      has_search = true;
+      search.clear();
+      while (tokens >> value) {
+        auto domain = toLower(value);
+        if (!domain.empty()) search.push_back(domain);
+      }
+    } else if (key == "options") {
+      while (tokens >> value)
+        if (value.compare(0, 6, "ndots:") == 0)
+          ndots = std::min(15, std::max(0, std::atoi(value.data() + 6)));
+    }
+  }
+  /* as the libc resolver, use the local one if there is none and the domain
+   * of the host name if there is no search list */
+  if (servers.empty()) {
+    sockaddr_storage address{};
+    parseAddress("127.0.0.1", address);
+    servers.push_back(address);
+  }
+  char host_name[256]{};
+  if (!has_search && ::gethostname(host_name, sizeof(host_name) - 1) == 0) {
+    auto dot = std::strchr(host_name, '.');
+    if (dot != nullptr && dot[1] != '\0') search.push_back(toLower(dot + 1));
+  }
+  nameservers = withPort(servers);
+
+  hosts.clear();
+  std::ifstream hosts_stream(hosts_path);
+  while (std::getline(hosts_stream, line)) {
+    std::istringstream tokens(line.substr(0, line.find('#')));
+    std::string value;
+    sockaddr_storage address{};
+    if (!(tokens >> value) || !parseAddress(value, address)) continue;
+    while (tokens >> value) hosts[toLower(value)].push_back(address);
+  }
+
+  use_files = use_dns = true;
+  use_lookup = false;
+  std::ifstream nsswitch(nsswitch_path);
+  while (std::getline(nsswitch, line)) {
+    std::istringstream tokens(line.substr(0, line.find('#')));
+    std::string value;
+    if (!(tokens >> value) || value != "hosts:") continue;
+    use_files = use_dns = false;
+    bool action = false;
+    while (tokens >> value) {
+      /* skip the [STATUS=ACTION] items */
+      if (value.front() == '[') action = true;
+      if (action) {
+        action = value.back() != ']';
+        continue;
+      }
+      if (value == "files")
+        use_files = true;
+      else if (value == "dns")
+        use_dns = true;
+      else
+        use_lookup = true;
+    }
+  }
+  return true;
+}
+
+bool DnsResolver::addSocket(int fd, const std::string &name) {
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.fd = fd;
+  if (::epoll_ctl(fd_, EPOLL_CTL_ADD, fd, &event) < 0) return false;
+  sockets[fd] = name;
+  return true;
+}
+
+void DnsResolver::removeSocket(int fd) {
+  if (fd < 0) return;
+  ::epoll_ctl(fd_, EPOLL_CTL_DEL, fd, nullptr);
+  sockets.erase(fd);
+}
+
+void DnsResolver::closeSocket(int &fd) {
+  if (fd < 0) return;
+  removeSocket(fd);
+  ::close(fd);
+  fd = -1;
+}
+
+std::vector<std::string> DnsResolver::searchNames(
+    const std::string &name) const {
+  if (!name.empty() && name.back() == '.')
+    return {name.substr(0, name.size() - 1)};
+  auto dots = std::count(name.begin(), name.end(), '.');
+  std::vector<std::string> names;
+  if (dots >= ndots) names.push_back(name);
+  for (auto &domain : search) names.push_back(name + '.' + domain);
+  if (dots < ndots) names.push_back(name);
+  return names;
+}
+
+size_t DnsResolver::buildQuery(const std::string &name, uint16_t id,
+                               DNS_TYPE type, uint8_t *out, size_t size) {
+  /* header, name, type and class */
+  if (name.empty() || name.size() > 253 ||
+      size < DNS_HEADER_SIZE + name.size() + 2 + 4)
+    return 0;
+  std::memset(out, 0, DNS_HEADER_SIZE);
+  out[0] = static_cast<uint8_t>(id >> 8);
+  out[1] = static_cast<uint8_t>(id);
+  /* recursion desired */
+  out[2] = 0x01;
+  /* one question */
+  out[5] = 1;
+  size_t pos = DNS_HEADER_SIZE;
+  size_t start = 0;
+  while (start < name.size()) {
+    auto end = name.find('.', start);
+    if (end == std::string::npos) end = name.size();
+    auto len = end - start;
+    if (len == 0 || len > 63) return 0;
+    out[pos++] = static_cast<uint8_t>(len);
+    std::memcpy(out + pos, name.data() + start, len);
+    pos += len;
+    start = end + 1;
+  }
+  out[pos++] = 0;
+  out[pos++] = 0;
+  out[pos++] = static_cast<uint8_t>(type);
+  out[pos++] = 0;
+  /* class IN */
+  out[pos++] = 1;
+  return pos;
+}
+
+bool DnsResolver::parseAnswer(const uint8_t *data, size_t size, uint16_t &id,
+                              std::vector<sockaddr_storage> &addresses,
+                              uint32_t &ttl) {
+  if (size < DNS_HEADER_SIZE) return false;
+  id = readU16(data);
+  uint16_t flags = readU16(data + 2);
+  /* it must be a response, a name error is an answer with no records */
+  if ((flags & 0x8000) == 0) return false;
+  auto rcode = flags & 0x000f;
+  if (rcode != 0 && rcode != 3) return false;
+  auto questions = readU16(data + 4);
+  auto answers = readU16(data + 6);
+  size_t pos = DNS_HEADER_SIZE;
+  for (int i = 0; i < questions; i++) {
+    if (!skipName(data, size, pos)) return false;
+    pos += 4;
+  }
+  ttl = DNS_RESOLVER_MAX_TTL;
+  for (int i = 0; i < answers; i++) {
+    if (!skipName(data, size, pos) || pos + 10 > size) return false;
+    auto type = readU16(data + pos);
+    auto record_class = readU16(data + pos + 2);
+    auto record_ttl = readU32(data + pos + 4);
+    auto length = readU16(data + pos + 8);
+    pos += 10;
+    if (pos + length > size) return false;
+    if (record_class == 1 && (type == A || type == AAAA || type == CNAME))
+      ttl = std::min(ttl, record_ttl);
+    sockaddr_storage address{};
+    if (record_class == 1 && type == A && length == 4) {
+      auto &in4 = reinterpret_cast<sockaddr_in &>(address);
+      in4.sin_family = AF_INET;
+      std::memcpy(&in4.sin_addr, data + pos, 4);
+      addresses.push_back(address);
+    } else if (record_class == 1 && type == AAAA && length == 16) {
+      auto &in6 = reinterpret_cast<sockaddr_in6 &>(address);
+      in6.sin6_family = AF_INET6;
+      std::memcpy(&in6.sin6_addr, data + pos, 16);
+      addresses.push_back(address);
+    }
+    pos += length;
+  }
+  return true;
+}
+
+void DnsResolver::resolve(const std::string &name, Entry &entry,
+                          time_point now) {
+  auto host_it = use_files ? hosts.find(toLower(name)) : hosts.end();
+  if (host_it != hosts.end()) {
+    splitFamilies(host_it->second, entry.queries[0].addresses,
+                  entry.queries[1].addresses);
+    entry.ttl = DNS_RESOLVER_HOSTS_TTL;
+    finish(name, entry, now);
+    return;
+  }
+  if (!use_dns) {
+    fail(name, entry, now);
+    return;
+  }
+  entry.candidates = searchNames(name);
+  entry.candidate = 0;
+  entry.attempts = 0;
+  send(name, entry);
+}
+
+void DnsResolver::send(const std::string &name, Entry &entry) {
+  uint8_t query[DNS_MAX_MESSAGE];
+  auto &nameserver = nameservers[nameserver_index % nameservers.size()];
+  auto &query_name = entry.candidates[entry.candidate];
+  for (int i = 0; i < 2; i++) {
+    auto &pending = entry.queries[i];
+    if (pending.done) continue;
+    /* the answers to the previous attempt are not expected anymore, a new
+     * connected socket gets a new random source port from the kernel */
+    closeSocket(pending.fd);
+    pending.id = static_cast<uint16_t>(generator());
+    pending.fd = ::socket(nameserver.ss_family,
+                          SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    auto len = buildQuery(query_name, pending.id, i == 0 ? A : AAAA, query,
+                          sizeof(query));
+    if (len == 0 || pending.fd < 0 ||
+        ::connect(pending.fd, reinterpret_cast<const sockaddr *>(&nameserver),
+                  addressLength(nameserver)) < 0 ||
+        !addSocket(pending.fd, name) ||
+        ::send(pending.fd, query, len, MSG_NOSIGNAL) < 0)
+      Logger::logmsg(LOG_DEBUG, "DNS query for %s not sent: %s",
+                     query_name.data(),
+                     len == 0 ? "invalid name" : std::strerror(errno));
+  }
+  entry.in_flight = true;
+  entry.attempts++;
+  entry.deadline = std::chrono::steady_clock::now() +
+                   std::chrono::milliseconds(DNS_RESOLVER_TIMEOUT);
+}
+
+void DnsResolver::readAnswer(const std::string &name, Entry &entry,
+                             Query &pending) {
+  uint8_t answer[DNS_MAX_MESSAGE];
+  ssize_t len;
+  /* the socket is connected, only the nameserver queried can answer */
+  while ((len = ::recv(pending.fd, answer, sizeof(answer), 0)) >= 0) {
+    uint16_t id;
+    uint32_t ttl;
+    std::vector<sockaddr_storage> addresses;
+    if (!parseAnswer(answer, static_cast<size_t>(len), id, addresses, ttl) ||
+        id != pending.id)
+      continue;
+    bool ipv4 = &pending == &entry.queries[0];
+    /* ignore the records of the other family sent by a confused server */
+    std::vector<sockaddr_storage> other;
+    if (ipv4)
+      splitFamilies(addresses, pending.addresses, other);
+    else
+      splitFamilies(addresses, other, pending.addresses);
+    closeSocket(pending.fd);
+    pending.id = 0;
+    pending.done = true;
+    if (!pending.addresses.empty() &&
+        (ipv4 || entry.queries[0].addresses.empty()))
+      entry.ttl = ttl;
+    break;
+  }
+  if (!entry.queries[0].done || !entry.queries[1].done) return;
+  auto now = std::chrono::steady_clock::now();
+  if (!entry.queries[0].addresses.empty() ||
+      !entry.queries[1].addresses.empty()) {
+    finish(name, entry, now);
+  } else if (entry.candidate + 1 < entry.candidates.size()) {
+    /* the name does not exist, try the next one of the search list */
+    entry.candidate++;
+    entry.attempts = 0;
+    for (auto &query : entry.queries) query.done = false;
+    send(name, entry);
+  } else {
+    fail(name, entry, now);
+  }
+}
+
+void DnsResolver::fail(const std::string &name, Entry &entry,
+                       time_point now) {
+  if (use_lookup && entry.lookup == nullptr)
+    lookUp(name, entry, now);
+  else
+    finish(name, entry, now);
+}
+
+void DnsResolver::lookUp(const std::string &name, Entry &entry,
+                         time_point now) {
+  for (auto &pending : entry.queries) {
+    closeSocket(pending.fd);
+    pending.id = 0;
+  }
+  entry.in_flight = false;
+  auto lookup = std::make_shared<Lookup>();
+  lookup->fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (lookup->fd < 0 || !addSocket(lookup->fd, name)) {
+    finish(name, entry, now);
+    return;
+  }
+  entry.lookup = lookup;
+  entry.deadline = now + std::chrono::seconds(DNS_RESOLVER_RETRY);
+  /* getaddrinfo() blocks, the thread keeps the lookup until it ends */
+  std::thread([lookup, name] {
+    addrinfo hints{};
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *result = nullptr;
+    if (::getaddrinfo(name.data(), nullptr, &hints, &result) == 0) {
+      for (auto info = result; info != nullptr; info = info->ai_next) {
+        sockaddr_storage address{};
+        std::memcpy(&address, info->ai_addr,
+                    std::min<size_t>(info->ai_addrlen, sizeof(address)));
+        if (address.ss_family == AF_INET6)
+          reinterpret_cast<sockaddr_in6 &>(address).sin6_port = 0;
+        else
+          reinterpret_cast<sockaddr_in &>(address).sin_port = 0;
+        lookup->addresses.push_back(address);
+      }
+      ::freeaddrinfo(result);
+    }
+    lookup->done.store(true, std::memory_order_release);
+    ::eventfd_write(lookup->fd, 1);
+  }).detach();
+}
+
+void DnsResolver::finish(const std::string &name, Entry &entry,
+                         time_point now) {
+  for (auto &pending : entry.queries) {
+    closeSocket(pending.fd);
+    pending.id = 0;
+  }
+  if (entry.lookup != nullptr) {
+    removeSocket(entry.lookup->fd);
+    entry.lookup.reset();
+  }
+  entry.in_flight = false;
+  entry.attempts = 0;
+  /* the connections are balanced between the addresses of one family, the
+   * IPv4 ones if there are any */
+  auto &addresses = !entry.queries[0].addresses.empty()
+                        ? entry.queries[0].addresses
+                        : entry.queries[1].addresses;
+  bool failed = addresses.empty();
+  if (failed) {
+    Logger::logmsg(LOG_WARNING, "Cannot resolve back-end host %s",
+                   name.data());
+    entry.deadline = now + std::chrono::seconds(DNS_RESOLVER_RETRY);
+  } else {
+    entry.addresses = addresses;
+    entry.ttl = std::max<uint32_t>(DNS_RESOLVER_MIN_TTL, entry.ttl);
+    entry.deadline = now + std::chrono::seconds(entry.ttl);
+  }
+  for (auto &pending : entry.queries) {
+    pending.done = false;
+    pending.addresses.clear();
+  }
+  /* an empty set tells the failure, the previous addresses are kept */
+  if (callback != nullptr &&
+      !callback(name, failed ? std::vector<sockaddr_storage>()
+                             : entry.addresses))
+    entries.erase(name);
+}
+
+void DnsResolver::watch(const std::string &host) {
+  sockaddr_storage address{};
+  if (parseAddress(host, address)) {
+    if (callback != nullptr) callback(host, {address});
+    return;
+  }
+  auto it = entries.find(host);
+  if (it != entries.end()) {
+    if (!it->second.addresses.empty() && callback != nullptr)
+      callback(host, it->second.addresses);
+    return;
+  }
+  if (fd_ < 0) return;
+  resolve(host, entries[host], std::chrono::steady_clock::now());
+}
+
+void DnsResolver::onReadEvent() {
+  epoll_event events[64];
+  int ready;
+  do {
+    ready = ::epoll_wait(fd_, events, 64, 0);
+    for (int i = 0; i < ready; i++) {
+      auto socket_it = sockets.find(events[i].data.fd);
+      if (socket_it == sockets.end()) continue;
+      auto name = socket_it->second;
+      auto it = entries.find(name);
+      if (it == entries.end()) continue;
+      auto &entry = it->second;
+      if (entry.lookup != nullptr && entry.lookup->fd == events[i].data.fd) {
+        if (!entry.lookup->done.load(std::memory_order_acquire)) continue;
+        splitFamilies(entry.lookup->addresses, entry.queries[0].addresses,
+                      entry.queries[1].addresses);
+        entry.ttl = DNS_RESOLVER_LOOKUP_TTL;
+        finish(name, entry, std::chrono::steady_clock::now());
+        continue;
+      }
+      for (auto &pending : entry.queries) {
+        if (pending.fd != events[i].data.fd) continue;
+        readAnswer(name, entry, pending);
+        break;
+      }
+    }
+  } while (ready == 64);
+}
+
+int DnsResolver::doWork() {
+  auto now = std::chrono::steady_clock::now();
+  /* the names are looked up again with the new files */
+  if (loadFiles())
+    for (auto &[name, entry] : entries)
+      if (!entry.in_flight && entry.lookup == nullptr) entry.deadline = now;
+  std::vector<std::string> due;
+  for (auto &[name, entry] : entries)
+    if (entry.deadline <= now) due.push_back(name);
+  for (auto &name : due) {
+    auto it = entries.find(name);
+    if (it == entries.end()) continue;
+    auto &entry = it->second;
+    if (entry.lookup != nullptr) {
+      /* getaddrinfo() has its own timeouts */
+      entry.deadline = now + std::chrono::seconds(DNS_RESOLVER_RETRY);
+    } else if (!entry.in_flight) {
+      resolve(name, entry, now);
+    } else if (entry.attempts < DNS_RESOLVER_ATTEMPTS) {
+      /* no answer, ask the next nameserver */
+      nameserver_index++;
+      send(name, entry);
+    } else {
+      fail(name, entry, now);
+    }
+  }
+  if (entries.empty()) return -1;
+  auto next = std::min_element(entries.begin(), entries.end(),
+                               [](auto &a, auto &b) {
+                                 return a.second.deadline < b.second.deadline;
+                               })
+                  ->second.deadline;
+  auto ms =
+      std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count();
+  return ms > 0 ? static_cast<int>(ms) : 0;
+}
+}  // namespace events
@@ -0,0 +1,238 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <sys/socket.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "descriptor.h"
+
+/** Milliseconds to wait for the answer of a query before sending it again. */
+#ifndef DNS_RESOLVER_TIMEOUT
+#define DNS_RESOLVER_TIMEOUT 2000
+#endif
+/** Times a query is sent before the resolution fails. */
+#ifndef DNS_RESOLVER_ATTEMPTS
+#define DNS_RESOLVER_ATTEMPTS 3
+#endif
+/** Seconds before a name that could not be resolved is tried again. */
+#ifndef DNS_RESOLVER_RETRY
+#define DNS_RESOLVER_RETRY 5
+#endif
+/** Bounds of the TTL used to refresh a name, in seconds. */
+#ifndef DNS_RESOLVER_MIN_TTL
+#define DNS_RESOLVER_MIN_TTL 1
+#endif
+#ifndef DNS_RESOLVER_MAX_TTL
+#define DNS_RESOLVER_MAX_TTL 3600
+#endif
+/** Seconds before a name of the hosts file is looked up again. */
+#ifndef DNS_RESOLVER_HOSTS_TTL
+#define DNS_RESOLVER_HOSTS_TTL 5
+#endif
+/** Seconds before a name resolved by getaddrinfo() is looked up again. */
+#ifndef DNS_RESOLVER_LOOKUP_TTL
+#define DNS_RESOLVER_LOOKUP_TTL 30
+#endif
+
+namespace events {
+
+/**
+ * @class DnsResolver dns_resolver.h "src/event/dns_resolver.h"
+ * @brief Non blocking DNS stub resolver for the back-end host names.
+ *
+ * The A and AAAA queries of the watched names are sent over UDP to the
+ * nameservers of /etc/resolv.conf, with its search list and ndots option, and
+ * the answers are read from the loop that owns the resolver, which registers
+ * its descriptor and calls onReadEvent() and doWork(). Each query uses its own
+ * connected socket, so it has a random source port and only the nameserver
+ * can answer it. Each name is resolved again when the TTL of its records
+ * expires, if it fails the previous addresses are kept.
+ *
+ * The names of /etc/hosts are answered from there, the file is read again
+ * when it changes. If /etc/nsswitch.conf has other sources than "files" and
+ * "dns" for the hosts, the names the nameservers cannot resolve are looked up
+ * with getaddrinfo() in a thread of their own.
+ */
+class DnsResolver : public Descriptor {
+ public:
+  /**
+   * Called with the addresses @p name resolves to, their port is not set. It
+   * returns @c false if the name is no longer used, then it is not refreshed.
+   */
+  using Callback = std::function<bool(
+      const std::string &name, const std::vector<sockaddr_storage> &addresses)>;
+
+  enum DNS_TYPE : uint16_t { A = 1, CNAME = 5, AAAA = 28 };
+
+ private:
+  using time_point = std::chrono::steady_clock::time_point;
+  struct Query {
+    uint16_t id{0};
+    int fd{-1};
+    bool done{false};
+    std::vector<sockaddr_storage> addresses;
+  };
+  /* getaddrinfo() result, the thread signals it on the eventfd */
+  struct Lookup {
+    int fd{-1};
+    std::atomic<bool> done{false};
+    std::vector<sockaddr_storage> addresses;
+    ~Lookup();
+  };
+  struct Entry {
+    /* A and AAAA queries */
+    Query queries[2];
+    /* names to query, from the search list, and the one being queried */
+    std::vector<std::string> candidates;
+    size_t candidate{0};
+    std::shared_ptr<Lookup> lookup;
+    bool in_flight{false};
+    int attempts{0};
+    uint32_t ttl{0};
+    /* next refresh or, while the queries are in flight, their timeout */
+    time_point deadline;
+    std::vector<sockaddr_storage> addresses;
+  };
+  std::map<std::string, Entry> entries;
+  /* watched name of each query socket and lookup eventfd */
+  std::unordered_map<int, std::string> sockets;
+  std::unordered_map<std::string, std::vector<sockaddr_storage>> hosts;
+  std::vector<sockaddr_storage> nameservers;
+  std::vector<std::string> search;
+  int ndots{1};
+  /* sources of the hosts in nsswitch.conf */
+  bool use_files{true};
+  bool use_dns{true};
+  bool use_lookup{false};
+  std::string resolv_conf_path;
+  std::string hosts_path;
+  std::string nsswitch_path;
+  /* inode, size and mtime of the files read */
+  std::string files_stamp;
+  size_t nameserver_index{0};
+  std::mt19937 generator;
+  Callback callback;
+
+  bool open();
+  void closeAll();
+  bool loadFiles();
+  bool addSocket(int fd, const std::string &name);
+  void removeSocket(int fd);
+  void closeSocket(int &fd);
+  void resolve(const std::string &name, Entry &entry, time_point now);
+  void send(const std::string &name, Entry &entry);
+  void readAnswer(const std::string &name, Entry &entry, Query &pending);
+  void fail(const std::string &name, Entry &entry, time_point now);
+  void lookUp(const std::string &name, Entry &entry, time_point now);
+  void finish(const std::string &name, Entry &entry, time_point now);
+
+ public:
+  DnsResolver();
+  ~DnsResolver() override;
+  DnsResolver(const DnsResolver &) = delete;
+  DnsResolver &operator=(const DnsResolver &) = delete;
+
+  /**
+   * @brief Opens the resolver for the @p nameservers_ given, port 53 is used
+   * if they have none. The names with less than @p ndots_ dots are tried
+   * first with the @p search_ domains appended.
+   * @return @c false if there is no usable nameserver.
+   */
+  bool init(const std::vector<sockaddr_storage> &nameservers_,
+            const std::vector<std::string> &search_ = {}, int ndots_ = 1);
+
+  /**
+   * @brief Loads the nameservers and the search list of @p resolv_conf, the
+   * names of @p hosts_file and the hosts sources of @p nsswitch_conf, and
+   * opens the resolver. The files are read again when they change.
+   * @return @c false if there is no usable nameserver.
+   */
+  bool init(const std::string &resolv_conf = "/etc/resolv.conf",
+            const std::string &hosts_file = "/etc/hosts",
+            const std::string &nsswitch_conf = "/etc/nsswitch.conf");
+
+  /** @brief Sets the function receiving the resolved addresses. */
+  void setCallback(Callback callback_) { callback = std::move(callback_); }
+
+  /**
+   * @brief Resolves @p name now and each time its TTL expires. The callback is
+   * called in place if it is a numeric address, a name of the hosts file or
+   * a name already resolved.
+   */
+  void watch(const std::string &name);
+
+  /**
+   * @brief Reads the answers received, call it on the read events of the
+   * resolver descriptor.
+   */
+  void onReadEvent();
+
+  /**
+   * @brief Sends the refresh queries due and the ones not answered in time.
+   * @return milliseconds until it has to be called again, -1 if never.
+   */
+  int doWork();
+
+  /** @return @c true if @p name is being resolved or refreshed. */
+  bool isWatched(const std::string &name) const {
+    return entries.count(name) > 0;
+  }
+
+  /**
+   * @return the names to query for @p name, in order: a name ending with a
+   * dot is only tried as is, one with @c ndots dots or more is tried as is
+   * before the search list, other names after it.
+   */
+  std::vector<std::string> searchNames(const std::string &name) const;
+
+  /** @brief Parses the numeric IPv4 or IPv6 @p address. */
+  static bool parseAddress(const std::string &address,
+                           sockaddr_storage &result);
+
+  /**
+   * @brief Writes the query of @p type for @p name in @p out.
+   * @return the query length, 0 if it does not fit or the name is not valid.
+   */
+  static size_t buildQuery(const std::string &name, uint16_t id,
+                           DNS_TYPE type, uint8_t *out, size_t size);
+
+  /**
+   * @brief Reads the addresses of the answer in @p data.
+   * @param id is set with the query id.
+   * @param addresses gets the A and AAAA records, CNAME records are skipped.
+   * @param ttl is set with the lowest TTL of the records.
+   * @return @c false if the message is not a valid answer. A name that does
+   * not exist is a valid answer with no records.
+   */
+  static bool parseAnswer(const uint8_t *data, size_t size, uint16_t &id,
+                          std::vector<sockaddr_storage> &addresses,
+                          uint32_t &ttl);
+};
+}  // namespace events
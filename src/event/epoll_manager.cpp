@@ -20,12 +20,23 @@
  */
 
 #include "epoll_manager.h"
+#include "../config/global.h"
 #include "../debug/logger.h"
 #include "../util/network.h"
 #include <climits>
 namespace events {
 
-EpollManager::EpollManager() : accept_fd_set() {
+EventManager::EventManager() : accept_fd_set() {
+  if (static_cast<EVENT_ENGINE>(global::run_options::getCurrent().event_engine) ==
+      EVENT_ENGINE::IO_URING) {
+    if (IoUringEngine::isSupported()) {
+      uring_engine = std::make_unique<IoUringEngine>();
+      if (!uring_engine->isReady()) uring_engine.reset();
+    }
+    if (uring_engine != nullptr) return;
+    Logger::logmsg(LOG_WARNING,
+                   "io_uring event engine not available, using epoll");
+  }
   if ((epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
     std::string error = "epoll_create(2) failed: ";
     error += std::strerror(errno);
@@ -34,38 +45,8 @@ EpollManager::EpollManager() : accept_fd_set() {
   }
 }
 
-/** Handles the connect events. */
-void EpollManager::onConnectEvent(epoll_event &event) {
-#if DEBUG_EVENT_MANAGER
-  Logger::logmsg(LOG_DEBUG, "~~ONConnectEvent fd: %d",
-                static_cast<int>(event.data.u64 >> CHAR_BIT));
-#endif
-  HandleEvent(static_cast<int>(event.data.u64 >> CHAR_BIT), EVENT_TYPE::CONNECT,
-              static_cast<EVENT_GROUP>(event.data.u64 & 0xff));
-}
-
-/** Handles the write events. */
-void EpollManager::onWriteEvent(epoll_event &event) {
-#if DEBUG_EVENT_MANAGER
-  Logger::logmsg(LOG_DEBUG, "~~ONWriteEvent fd: %d",
-                static_cast<int>(event.data.u64 >> CHAR_BIT));
-#endif
-  HandleEvent(static_cast<int>(event.data.u64 >> CHAR_BIT), EVENT_TYPE::WRITE,
-              static_cast<EVENT_GROUP>(event.data.u64 & 0xff));
-}
-
-/** Handles the read events. */
-void EpollManager::onReadEvent(epoll_event &event) {
-#if DEBUG_EVENT_MANAGER
-  Logger::logmsg(LOG_DEBUG, "~~ONReadEvent fd: %d",
-                static_cast<int>(event.data.u64 >> CHAR_BIT));
-#endif
-  HandleEvent(static_cast<int>(event.data.u64 >> CHAR_BIT), EVENT_TYPE::READ,
-              static_cast<EVENT_GROUP>(event.data.u64 & 0xff));
-}
-
-bool EpollManager::deleteFd(int fd) {
-  if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL) < 0) {
+bool EventManager::deleteFd(int fd) {
+  if (eventCtl(EPOLL_CTL_DEL, fd, nullptr) < 0) {
     if (errno == ENOENT || errno == EBADF || errno == EPERM) {
       //      std::string error = "epoll_ctl(delete) unnecessary. ";
       //      error += std::strerror(errno);
@@ -80,59 +61,24 @@ bool EpollManager::deleteFd(int fd) {
   return true;
 }
 
-int EpollManager::loopOnce(int time_out) {
-  int fd, i, ev_count = 0;
-  ev_count = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENT, time_out);
-  if (ev_count <= 0) return ev_count;
-  for (i = 0; i < ev_count; ++i) {
-    fd = static_cast<int>(events[i].data.u64 >> CHAR_BIT);
-    auto event_group = static_cast<EVENT_GROUP>(events[i].data.u32 & 0xff);
-    if ((events[i].events & EPOLLERR) != 0u) {
-      HandleEvent(fd, EVENT_TYPE::DISCONNECT, event_group);
-      continue;
-    } else {
-      if ((events[i].events & EPOLLIN) != 0u) {
-        if (event_group == EVENT_GROUP::ACCEPTOR) {
-          for (auto accept_fd : accept_fd_set) {
-            if (fd == accept_fd) {
-              onConnectEvent(events[i]);
-            }
-          }
-        } else {
-          onReadEvent(events[i]);
-        }
-      }
-      if ((events[i].events & (EPOLLRDHUP | EPOLLHUP)) != 0u) {
-        HandleEvent(fd, EVENT_TYPE::DISCONNECT, event_group);
-        continue;
-      }
-      if ((events[i].events & EPOLLOUT) != 0u) {
-        onWriteEvent(events[i]);
-      }
-    }
-  }
-
-  return ev_count;
+EventManager::~EventManager() {
+  if (epoll_fd >= 0) ::close(epoll_fd);
 }
 
-EpollManager::~EpollManager() { ::close(epoll_fd); }
-
-bool EpollManager::handleAccept(int listener_fd) {
+bool EventManager::handleAccept(int listener_fd) {
   Logger::logmsg(LOG_DEBUG, "Adding listener fd: %d", listener_fd);
   accept_fd_set.emplace_back(listener_fd);
   Network::setSocketNonBlocking(listener_fd);
   return addFd(listener_fd, EVENT_TYPE::ACCEPT, EVENT_GROUP::ACCEPTOR);
 }
 
-bool EpollManager::addFd(int fd, EVENT_TYPE event_type,
+bool EventManager::addFd(int fd, EVENT_TYPE event_type,
                          EVENT_GROUP event_group) {
   //  std::lock_guard<std::mutex> loc(epoll_mutex);
   struct epoll_event epevent = {};
   epevent.events = static_cast<uint32_t>(event_type);
-  epevent.data.u64 = static_cast<uint64_t>(fd);
-  epevent.data.u64 <<= CHAR_BIT;
-  epevent.data.u64 |= static_cast<char>(event_group) & 0xff;
-  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &epevent) < 0) {
+  epevent.data.u64 = eventData(fd, event_group);
+  if (eventCtl(EPOLL_CTL_ADD, fd, &epevent) < 0) {
     if (errno == EEXIST) {
       return updateFd(fd, event_type, event_group);
     } else {
@@ -150,7 +96,7 @@ bool EpollManager::addFd(int fd, EVENT_TYPE event_type,
   return true;
 }
 
-bool EpollManager::updateFd(int fd, EVENT_TYPE event_type,
+bool EventManager::updateFd(int fd, EVENT_TYPE event_type,
                             EVENT_GROUP event_group) {
   //  std::lock_guard<std::mutex> loc(epoll_mutex);
 #if DEBUG_EVENT_MANAGER
@@ -158,10 +104,8 @@ bool EpollManager::updateFd(int fd, EVENT_TYPE event_type,
 #endif
   struct epoll_event epevent = {};
   epevent.events = static_cast<uint32_t>(event_type);
-  epevent.data.u64 = static_cast<uint64_t>(fd);
-  epevent.data.u64 <<= CHAR_BIT;
-  epevent.data.u64 |= static_cast<char>(event_group) & 0xff;
-  if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &epevent) < 0) {
+  epevent.data.u64 = eventData(fd, event_group);
+  if (eventCtl(EPOLL_CTL_MOD, fd, &epevent) < 0) {
     if (errno == ENOENT) {
       std::string error = "epoll_ctl(update) failed, fd reopened, adding .. ";
       error += std::strerror(errno);
@@ -177,7 +121,7 @@ bool EpollManager::updateFd(int fd, EVENT_TYPE event_type,
 
   return true;
 }
-bool EpollManager::stopAccept(int listener_fd) {
+bool EventManager::stopAccept(int listener_fd) {
   this->deleteFd(listener_fd);
   for (auto it = accept_fd_set.begin(); it != accept_fd_set.end(); ) {
     if ((*it) == listener_fd) {
@@ -22,14 +22,33 @@
 #pragma once
 
 #include <sys/epoll.h>
+#include <climits>
 #include <unistd.h>
+#include <memory>
 #include <mutex>
 #include <vector>
+#include "io_uring_engine.h"
+#if DEBUG_EVENT_MANAGER
+#include "../debug/logger.h"
+#endif
 
 namespace events {
 
 #define MAX_EPOLL_EVENT 100000
 #define EPOLL_WAIT_TIMEOUT 500
+/** epoll_event data layout: generation(24) | fd(32) | group(8). */
+#define EPOLL_DATA_FD(data) (static_cast<int>(((data) >> CHAR_BIT) & 0xffffffff))
+#define EPOLL_DATA_GROUP(data) (static_cast<EVENT_GROUP>((data) & 0xff))
+#define EPOLL_DATA_GENERATION(data) (static_cast<uint32_t>((data) >> 40))
+#define EPOLL_GENERATION_MASK 0xffffff
+/** The enum EVENT_ENGINE defines the kernel notification engines. */
+enum class EVENT_ENGINE : uint8_t {
+  /** epoll(7), always available and used as fallback. */
+  EPOLL,
+  /** io_uring(7) poll requests, needs a kernel >= 5.13. */
+  IO_URING,
+};
+
 /** The enum EVENT_GROUP defines the different group types. */
 enum class EVENT_GROUP : char {
   /** This group accept connections. */
@@ -50,6 +69,10 @@ enum class EVENT_GROUP : char {
   MAINTENANCE,
   /** This groups handles the CTL events. */
   CTL_INTERFACE,
+  /** This group handles the tasks posted to the events::Mailbox. */
+  MAILBOX,
+  /** This group handles the backend connections warmed up for the pool. */
+  POOL,
   NONE,
 };
 
@@ -84,42 +107,77 @@ enum class EVENT_TYPE : uint32_t {
   NONE
 };
 
-// TODO:: Make it static polimorphosm, template<typename Handler>
 /**
- * @class EpollManager epoll_manager.h "src/event/epoll_manager.h"
- * @brief The EpollManager is a wrapper class over the EPOLL system. It handles
- * all
- * the operations needed.
+ * @class EventManager epoll_manager.h "src/event/epoll_manager.h"
+ * @brief Handler independent part of the EpollManager. It owns the kernel
+ * notification engine and the operations to register the file descriptors,
+ * so the Descriptor objects can refer to any EpollManager through it.
  */
-class EpollManager {
+class EventManager {
   //  std::mutex epoll_mutex;
-  /** Epoll file descriptor. */
-  int epoll_fd;
+  /** Epoll file descriptor, -1 if the io_uring engine is used. */
+  int epoll_fd{-1};
+  /** io_uring engine, if set it replaces the epoll system calls. */
+  std::unique_ptr<IoUringEngine> uring_engine{nullptr};
+
+protected:
   // TODO: Documentar abdess
   std::vector<int> accept_fd_set;
   /** Array of epoll_event. This array contains all the events. */
   epoll_event events[MAX_EPOLL_EVENT];
+  /** fd and events being dispatched by loopOnce(), -1 between events. */
+  int dispatched_fd{-1};
+  uint32_t dispatched_events{0};
 
-protected:
-  virtual void HandleEvent(int fd, EVENT_TYPE event_type,
-						   EVENT_GROUP event_group) = 0;
-  inline void onReadEvent(epoll_event &event);
-  inline void onWriteEvent(epoll_event &event);
-  inline void onConnectEvent(epoll_event &event);
-
-public:
-  EpollManager();
+  inline int eventCtl(int op, int fd, epoll_event *event) {
+    return uring_engine != nullptr ? uring_engine->ctl(op, fd, event)
+                                   : ::epoll_ctl(epoll_fd, op, fd, event);
+  }
+  inline int waitEvents(int time_out) {
+    return uring_engine != nullptr
+               ? uring_engine->wait(events, MAX_EPOLL_EVENT, time_out)
+               : ::epoll_wait(epoll_fd, events, MAX_EPOLL_EVENT, time_out);
+  }
+  /**
+   * @brief Gets the generation of the @p fd, stored in the events registered
+   * and checked before dispatching them. Handlers that reuse their fds in the
+   * same loop return a value that changes every time the fd is reassigned, so
+   * the pending events of the previous owner are discarded.
+   * @param fd is the file descriptor.
+   * @return the generation, only its lower 24 bits are used.
+   */
+  virtual uint32_t getFdGeneration([[maybe_unused]] int fd) const { return 0; }
+  inline uint64_t eventData(int fd, EVENT_GROUP event_group) const {
+    return (static_cast<uint64_t>(getFdGeneration(fd) & EPOLL_GENERATION_MASK)
+            << 40) |
+           (static_cast<uint64_t>(static_cast<uint32_t>(fd)) << CHAR_BIT) |
+           (static_cast<uint64_t>(event_group) & 0xff);
+  }
 
-  virtual ~EpollManager();
+  /**
+   * @return @c true if the event being dispatched for @p fd tells the peer
+   * has closed or hung up, the disconnection is dispatched once the current
+   * handler returns.
+   */
+  inline bool isHangingUp(int fd) const {
+    return fd == dispatched_fd &&
+           (dispatched_events & (EPOLLRDHUP | EPOLLHUP)) != 0u;
+  }
 
+public:
   /**
-   * @brief This function is the core function of the system. It waits for new
-   * events
-   * and handles them.
-   * @param time_out used to wait for events.
-   * @return the current number of events.
+   * @brief Creates the event manager using the engine set in the global run
+   * options. If the io_uring engine is not supported it falls back to epoll.
    */
-  int loopOnce(int time_out = -1);
+  EventManager();
+
+  /** @return the notification engine in use. */
+  EVENT_ENGINE getEngine() const {
+    return uring_engine != nullptr ? EVENT_ENGINE::IO_URING
+                                   : EVENT_ENGINE::EPOLL;
+  }
+
+  virtual ~EventManager();
 
   /**
    * @brief Sets the Listener as a non blocking socket and starts to accept
@@ -166,4 +224,119 @@ public:
    */
   bool updateFd(int fd, EVENT_TYPE event_type, EVENT_GROUP event_group);
 };
+
+/**
+ * @class EpollManager epoll_manager.h "src/event/epoll_manager.h"
+ * @brief The EpollManager is a wrapper class over the EPOLL system. It handles
+ * all
+ * the operations needed.
+ *
+ * The events are dispatched to @p Handler::HandleEvent(fd, event_type,
+ * event_group) resolved at compile time, so the handler can be inlined in the
+ * loop. @p Handler must derive from EpollManager<Handler>.
+ */
+template <typename Handler>
+class EpollManager : public EventManager {
+  inline Handler &handler() { return *static_cast<Handler *>(this); }
+
+  /** Handles the connect events. */
+  inline void onConnectEvent(epoll_event &event) {
+#if DEBUG_EVENT_MANAGER
+    Logger::logmsg(LOG_DEBUG, "~~ONConnectEvent fd: %d",
+                   EPOLL_DATA_FD(event.data.u64));
+#endif
+    handler().HandleEvent(EPOLL_DATA_FD(event.data.u64), EVENT_TYPE::CONNECT,
+                          EPOLL_DATA_GROUP(event.data.u64));
+  }
+
+  /** Handles the write events. */
+  inline void onWriteEvent(epoll_event &event) {
+#if DEBUG_EVENT_MANAGER
+    Logger::logmsg(LOG_DEBUG, "~~ONWriteEvent fd: %d",
+                   EPOLL_DATA_FD(event.data.u64));
+#endif
+    handler().HandleEvent(EPOLL_DATA_FD(event.data.u64), EVENT_TYPE::WRITE,
+                          EPOLL_DATA_GROUP(event.data.u64));
+  }
+
+  /** Handles the read events. */
+  inline void onReadEvent(epoll_event &event) {
+#if DEBUG_EVENT_MANAGER
+    Logger::logmsg(LOG_DEBUG, "~~ONReadEvent fd: %d",
+                   EPOLL_DATA_FD(event.data.u64));
+#endif
+    handler().HandleEvent(EPOLL_DATA_FD(event.data.u64), EVENT_TYPE::READ,
+                          EPOLL_DATA_GROUP(event.data.u64));
+  }
+
+protected:
+  /**
+   * @brief Called on EPOLLERR, before handling it as a disconnection. A
+   * Handler hides it to consume the errors that do not break the connection,
+   * as the MSG_ZEROCOPY completions queued in the socket error queue.
+   * @return @c true if the other events of the event mask have to be handled
+   * as usual.
+   */
+  inline bool onErrorEvent(int, EVENT_GROUP, uint32_t) {
+    return false;
+  }
+
+public:
+  /**
+   * @brief This function is the core function of the system. It waits for new
+   * events
+   * and handles them.
+   * @param time_out used to wait for events.
+   * @return the current number of events.
+   */
+  int loopOnce(int time_out = -1) {
+    int fd, i, ev_count = 0;
+    ev_count = waitEvents(time_out);
+    if (ev_count <= 0) return ev_count;
+    for (i = 0; i < ev_count; ++i) {
+      fd = EPOLL_DATA_FD(events[i].data.u64);
+      auto event_group = EPOLL_DATA_GROUP(events[i].data.u64);
+      /* the fd may be closed and reused while handling this batch, or handed
+       * off by one of the handlers of this event, as a backend connection
+       * returned to the pool; the qualified call avoids the virtual dispatch */
+      auto stale = [&] {
+        return EPOLL_DATA_GENERATION(events[i].data.u64) !=
+               (handler().Handler::getFdGeneration(fd) &
+                EPOLL_GENERATION_MASK);
+      };
+      if (stale()) continue;
+      dispatched_fd = fd;
+      dispatched_events = events[i].events;
+      if ((events[i].events & EPOLLERR) != 0u &&
+          !handler().onErrorEvent(fd, event_group, events[i].events)) {
+        if (!stale())
+          handler().HandleEvent(fd, EVENT_TYPE::DISCONNECT, event_group);
+        continue;
+      }
+      if ((events[i].events & EPOLLIN) != 0u) {
+        if (stale()) continue;
+        if (event_group == EVENT_GROUP::ACCEPTOR) {
+          for (auto accept_fd : accept_fd_set) {
+            if (fd == accept_fd) {
+              onConnectEvent(events[i]);
+            }
+          }
+        } else {
+          onReadEvent(events[i]);
+        }
+      }
+      if ((events[i].events & (EPOLLRDHUP | EPOLLHUP)) != 0u) {
+        if (!stale())
+          handler().HandleEvent(fd, EVENT_TYPE::DISCONNECT, event_group);
+        continue;
+      }
+      if ((events[i].events & EPOLLOUT) != 0u && !stale()) {
+        onWriteEvent(events[i]);
+      }
+    }
+    dispatched_fd = -1;
+
+    return ev_count;
+  }
+};
 } // namespace events
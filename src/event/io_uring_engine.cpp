@@ -0,0 +1,280 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "io_uring_engine.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include "../debug/logger.h"
+
+namespace events {
+
+/** user_data layout: generation(32) | fd(32). */
+#define URING_FD_MASK 0xffffffffULL
+/** user_data of the poll remove requests, its completions are discarded. */
+#define URING_CANCEL_DATA (~0ULL)
+/** EPOLLEXCLUSIVE is kept, the poll waits in the exclusive queue of the
+ * listeners as with epoll, the kernels without support ignore it. */
+#define URING_POLL_MASK (~(EPOLLET | EPOLLONESHOT))
+
+static inline int io_uring_setup(unsigned entries, io_uring_params *params) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+static inline int io_uring_enter(int fd, unsigned to_submit,
+                                 unsigned min_complete, unsigned flags,
+                                 void *arg, size_t arg_size) {
+  return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit,
+                                    min_complete, flags, arg, arg_size));
+}
+
+bool IoUringEngine::isSupported() {
+#if defined(IORING_FEAT_EXT_ARG) && defined(IORING_FEAT_RSRC_TAGS) && \
+    defined(IORING_POLL_ADD_MULTI)
+  static int supported = -1;
+  if (supported < 0) {
+    io_uring_params params{};
+    int fd = io_uring_setup(2, &params);
+    /* multishot poll landed in the same release as the resource tags */
+    supported = fd >= 0 && (params.features & IORING_FEAT_EXT_ARG) != 0 &&
+                (params.features & IORING_FEAT_RSRC_TAGS) != 0;
+    if (fd >= 0) ::close(fd);
+  }
+  return supported == 1;
+#else
+  return false;
+#endif
+}
+
+IoUringEngine::IoUringEngine() {
+  io_uring_params params{};
+  params.flags = IORING_SETUP_CQSIZE;
+  params.cq_entries = IO_URING_CQ_ENTRIES;
+  if ((ring_fd = io_uring_setup(IO_URING_SQ_ENTRIES, &params)) < 0) {
+    std::string error = "io_uring_setup(2) failed: ";
+    error += std::strerror(errno);
+    Logger::LogInfo(error, LOG_ERR);
+    return;
+  }
+  sq_entries = params.sq_entries;
+  cq_entries = params.cq_entries;
+  sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+
+  sq_ring = ::mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+  cq_ring = single_mmap ? sq_ring
+                        : ::mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE, ring_fd,
+                                 IORING_OFF_CQ_RING);
+  auto sqes_ptr = ::mmap(nullptr, sq_entries * sizeof(io_uring_sqe),
+                         PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ring_fd, IORING_OFF_SQES);
+  if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes_ptr == MAP_FAILED) {
+    std::string error = "io_uring mmap(2) failed: ";
+    error += std::strerror(errno);
+    Logger::LogInfo(error, LOG_ERR);
+    if (sqes_ptr != MAP_FAILED) ::munmap(sqes_ptr, sq_entries * sizeof(io_uring_sqe));
+    if (cq_ring != MAP_FAILED && cq_ring != sq_ring) ::munmap(cq_ring, cq_ring_size);
+    if (sq_ring != MAP_FAILED) ::munmap(sq_ring, sq_ring_size);
+    sq_ring = cq_ring = nullptr;
+    ::close(ring_fd);
+    ring_fd = -1;
+    return;
+  }
+  sqes = static_cast<io_uring_sqe *>(sqes_ptr);
+  auto sq_base = static_cast<char *>(sq_ring);
+  sq_head = reinterpret_cast<unsigned *>(sq_base + params.sq_off.head);
+  sq_tail = reinterpret_cast<unsigned *>(sq_base + params.sq_off.tail);
+  sq_mask = reinterpret_cast<unsigned *>(sq_base + params.sq_off.ring_mask);
+  sq_array = reinterpret_cast<unsigned *>(sq_base + params.sq_off.array);
+  auto cq_base = static_cast<char *>(cq_ring);
+  cq_head = reinterpret_cast<unsigned *>(cq_base + params.cq_off.head);
+  cq_tail = reinterpret_cast<unsigned *>(cq_base + params.cq_off.tail);
+  cq_mask = reinterpret_cast<unsigned *>(cq_base + params.cq_off.ring_mask);
+  cqes = reinterpret_cast<io_uring_cqe *>(cq_base + params.cq_off.cqes);
+  /* sqes are always consumed in order, use an identity index array */
+  for (unsigned i = 0; i < sq_entries; i++) sq_array[i] = i;
+  sqe_tail = *sq_tail;
+}
+
+IoUringEngine::~IoUringEngine() {
+  if (ring_fd < 0) return;
+  ::munmap(sqes, sq_entries * sizeof(io_uring_sqe));
+  if (cq_ring != sq_ring) ::munmap(cq_ring, cq_ring_size);
+  ::munmap(sq_ring, sq_ring_size);
+  ::close(ring_fd);
+}
+
+IoUringEngine::PollEntry &IoUringEngine::getEntry(int fd) {
+  if (static_cast<size_t>(fd) >= poll_set.size())
+    poll_set.resize(std::max(static_cast<size_t>(fd) + 1, poll_set.size() * 2));
+  return poll_set[fd];
+}
+
+io_uring_sqe *IoUringEngine::getSqe() {
+  if (sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries) {
+    /* submission queue full, flush it without waiting */
+    submit(0, 0);
+  }
+  auto sqe = &sqes[sqe_tail & *sq_mask];
+  std::memset(sqe, 0, sizeof(io_uring_sqe));
+  sqe_tail++;
+  to_submit++;
+  return sqe;
+}
+
+void IoUringEngine::armPoll(int fd, PollEntry &entry) {
+  entry.generation++;
+  entry.user_data = (static_cast<uint64_t>(entry.generation) << 32) |
+                    static_cast<uint32_t>(fd);
+  auto sqe = getSqe();
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = entry.events & URING_POLL_MASK;
+  /* level triggered interests are re-armed once dispatched */
+  if ((entry.events & EPOLLET) != 0u && (entry.events & EPOLLONESHOT) == 0u)
+    sqe->len = IORING_POLL_ADD_MULTI;
+  sqe->user_data = entry.user_data;
+  entry.armed = true;
+}
+
+void IoUringEngine::cancelPoll(PollEntry &entry) {
+  if (!entry.armed) return;
+  auto sqe = getSqe();
+  sqe->opcode = IORING_OP_POLL_REMOVE;
+  sqe->fd = -1;
+  sqe->addr = entry.user_data;
+  sqe->user_data = URING_CANCEL_DATA;
+  entry.armed = false;
+}
+
+int IoUringEngine::submit(unsigned min_complete, int time_out) {
+  __kernel_timespec ts{};
+  io_uring_getevents_arg arg{};
+  unsigned flags = 0;
+  if (min_complete > 0) {
+    flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+    if (time_out >= 0) {
+      ts.tv_sec = time_out / 1000;
+      ts.tv_nsec = (time_out % 1000) * 1000000L;
+      arg.ts = reinterpret_cast<uint64_t>(&ts);
+    }
+  }
+  __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+  int ret = io_uring_enter(ring_fd, to_submit, min_complete, flags,
+                           flags != 0 ? &arg : nullptr,
+                           flags != 0 ? sizeof(arg) : 0);
+  if (ret >= 0) to_submit -= std::min(to_submit, static_cast<unsigned>(ret));
+  return ret;
+}
+
+int IoUringEngine::ctl(int op, int fd, epoll_event *event) {
+  if (fd < 0 || ring_fd < 0) {
+    errno = EBADF;
+    return -1;
+  }
+  auto &entry = getEntry(fd);
+  switch (op) {
+    case EPOLL_CTL_ADD:
+      if (entry.registered) {
+        errno = EEXIST;
+        return -1;
+      }
+      entry.registered = true;
+      entry.events = event->events;
+      entry.data = event->data.u64;
+      armPoll(fd, entry);
+      return 0;
+    case EPOLL_CTL_MOD:
+      if (!entry.registered) {
+        errno = ENOENT;
+        return -1;
+      }
+      cancelPoll(entry);
+      entry.events = event->events;
+      entry.data = event->data.u64;
+      armPoll(fd, entry);
+      return 0;
+    case EPOLL_CTL_DEL:
+      if (!entry.registered) {
+        errno = ENOENT;
+        return -1;
+      }
+      cancelPoll(entry);
+      entry.registered = false;
+      return 0;
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+}
+
+int IoUringEngine::wait(epoll_event *events, int max_events, int time_out) {
+  for (auto fd : rearm_set) {
+    auto &entry = poll_set[fd];
+    if (entry.registered && !entry.armed && (entry.events & EPOLLONESHOT) == 0u)
+      armPoll(fd, entry);
+  }
+  rearm_set.clear();
+
+  unsigned head = *cq_head;
+  if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+    if (submit(time_out == 0 ? 0 : 1, time_out) < 0 && errno != ETIME &&
+        errno != EBUSY) {
+      return -1;
+    }
+  } else if (to_submit > 0) {
+    submit(0, 0);
+  }
+
+  int count = 0;
+  unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+  while (head != tail && count < max_events) {
+    auto cqe = &cqes[head & *cq_mask];
+    head++;
+    if (cqe->user_data == URING_CANCEL_DATA) continue;
+    auto fd = static_cast<size_t>(cqe->user_data & URING_FD_MASK);
+    if (fd >= poll_set.size()) continue;
+    auto &entry = poll_set[fd];
+    /* discard completions of polls already cancelled or replaced */
+    if (!entry.registered || !entry.armed || entry.user_data != cqe->user_data)
+      continue;
+    if ((cqe->flags & IORING_CQE_F_MORE) == 0u) {
+      entry.armed = false;
+      if (cqe->res >= 0 || cqe->res == -ECANCELED)
+        rearm_set.push_back(static_cast<int>(fd));
+    }
+    if (cqe->res == -ECANCELED) continue;
+    events[count].events =
+        cqe->res < 0 ? EPOLLERR : static_cast<uint32_t>(cqe->res);
+    events[count].data.u64 = entry.data;
+    count++;
+  }
+  __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+  return count;
+}
+}  // namespace events
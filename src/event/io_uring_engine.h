@@ -0,0 +1,133 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <linux/io_uring.h>
+#include <sys/epoll.h>
+#include <cstdint>
+#include <vector>
+
+namespace events {
+
+#define IO_URING_SQ_ENTRIES 4096
+#define IO_URING_CQ_ENTRIES 65536
+
+/**
+ * @class IoUringEngine io_uring_engine.h "src/event/io_uring_engine.h"
+ * @brief Readiness notification engine built on io_uring poll requests.
+ *
+ * It exposes the same contract as epoll_ctl/epoll_wait so the EpollManager can
+ * switch engines without changing the handlers. Interest changes are queued as
+ * submission entries and flushed by the same io_uring_enter call that waits
+ * for completions, so an updateFd costs no syscall of its own. Edge triggered
+ * interests use multishot polls; level triggered ones are re-armed after they
+ * have been dispatched. EPOLLEXCLUSIVE is passed to the kernel, so only one
+ * worker is woken for each connection of a shared listener.
+ *
+ * Only readiness is taken from the ring: the handlers still accept, read and
+ * write with their own system calls, there is no multishot accept, provided
+ * buffer recv or linked send.
+ */
+class IoUringEngine {
+  struct PollEntry {
+    /** epoll_event data of the registered interest. */
+    uint64_t data{0};
+    /** user_data of the poll request currently armed. */
+    uint64_t user_data{0};
+    uint32_t events{0};
+    uint32_t generation{0};
+    bool registered{false};
+    bool armed{false};
+  };
+
+  int ring_fd{-1};
+  unsigned sq_entries{0};
+  unsigned cq_entries{0};
+  unsigned to_submit{0};
+  /** Local submission tail, published to the kernel on submit. */
+  unsigned sqe_tail{0};
+  void *sq_ring{nullptr};
+  void *cq_ring{nullptr};
+  size_t sq_ring_size{0};
+  size_t cq_ring_size{0};
+  io_uring_sqe *sqes{nullptr};
+  unsigned *sq_head{nullptr};
+  unsigned *sq_tail{nullptr};
+  unsigned *sq_mask{nullptr};
+  unsigned *sq_array{nullptr};
+  unsigned *cq_head{nullptr};
+  unsigned *cq_tail{nullptr};
+  unsigned *cq_mask{nullptr};
+  io_uring_cqe *cqes{nullptr};
+  /** Per fd interest table, indexed by file descriptor. */
+  std::vector<PollEntry> poll_set;
+  /** Fds dispatched in the last wait, pending of re-arm. */
+  std::vector<int> rearm_set;
+
+  PollEntry &getEntry(int fd);
+  io_uring_sqe *getSqe();
+  void armPoll(int fd, PollEntry &entry);
+  void cancelPoll(PollEntry &entry);
+  int submit(unsigned min_complete, int time_out);
+
+ public:
+  IoUringEngine();
+  ~IoUringEngine();
+  IoUringEngine(const IoUringEngine &) = delete;
+  IoUringEngine &operator=(const IoUringEngine &) = delete;
+
+  /**
+   * @brief Checks if the running kernel supports the io_uring features used by
+   * the engine (multishot poll and extended wait arguments).
+   * @return @c true if the engine can be used, @c false if not.
+   */
+  static bool isSupported();
+
+  /** @return @c true if the ring has been setup successfully. */
+  bool isReady() const { return ring_fd >= 0; }
+
+  /**
+   * @brief Registers, modifies or removes the interest on @p fd.
+   *
+   * Follows the epoll_ctl(2) semantics and errno values, the request is queued
+   * and submitted on the next wait().
+   *
+   * @param op is EPOLL_CTL_ADD, EPOLL_CTL_MOD or EPOLL_CTL_DEL.
+   * @param fd is the file descriptor.
+   * @param event is the interest and data to report.
+   * @return 0 on success, -1 on error with errno set.
+   */
+  int ctl(int op, int fd, epoll_event *event);
+
+  /**
+   * @brief Submits the queued requests and waits for readiness events.
+   *
+   * Follows the epoll_wait(2) semantics.
+   *
+   * @param events is the output array.
+   * @param max_events is the size of @p events.
+   * @param time_out in milliseconds, -1 waits forever.
+   * @return the number of events ready, 0 on timeout or -1 on error.
+   */
+  int wait(epoll_event *events, int max_events, int time_out);
+};
+}  // namespace events
@@ -0,0 +1,84 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "mailbox.h"
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <system_error>
+#include <thread>
+#include "../debug/logger.h"
+
+namespace events {
+
+Mailbox::Mailbox() {
+  fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (fd_ < 0) {
+    std::string error = "eventfd() failed: ";
+    error += std::strerror(errno);
+    Logger::LogInfo(error, LOG_ERR);
+    throw std::system_error(errno, std::system_category());
+  }
+}
+
+Mailbox::~Mailbox() {
+  if (fd_ > 0) ::close(fd_);
+}
+
+bool Mailbox::post(std::function<void()> task) {
+  /* close() sets closed before waiting for posting to drop to zero, so a task
+   * pushed here is always seen by its drain() */
+  posting++;
+  if (closed) {
+    posting--;
+    return false;
+  }
+  tasks.push(std::move(task));
+  uint64_t one = 1;
+  /* a failure means the counter is already set, the owner will wake up */
+  if (::write(fd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+    Logger::logmsg(LOG_ERR, "Mailbox eventfd write failed: %s",
+                   std::strerror(errno));
+  }
+  posting--;
+  return true;
+}
+
+int Mailbox::drain() {
+  uint64_t count;
+  if (::read(fd_, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+    Logger::logmsg(LOG_ERR, "Mailbox eventfd read failed: %s",
+                   std::strerror(errno));
+  }
+  int executed = 0;
+  std::function<void()> task;
+  while (tasks.pop(task)) {
+    task();
+    executed++;
+  }
+  return executed;
+}
+
+int Mailbox::close() {
+  closed = true;
+  while (posting > 0) std::this_thread::yield();
+  return drain();
+}
+}  // namespace events
@@ -0,0 +1,78 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include "../util/mpsc_queue.h"
+#include "descriptor.h"
+
+namespace events {
+
+/**
+ * @class Mailbox mailbox.h "src/event/mailbox.h"
+ * @brief Delivers tasks from any thread to the thread running an
+ * EpollManager loop.
+ *
+ * The tasks are queued in a lock-free MpscQueue and an eventfd registered in
+ * the loop with the EVENT_GROUP::MAILBOX group wakes the owner, which runs
+ * them calling drain(). The tasks run in the owner thread, so they can modify
+ * its state without locks.
+ *
+ * The owner closes the mailbox when its loop exits, the tasks posted after
+ * that are refused so their callers never wait for a thread that is gone.
+ */
+class Mailbox : public Descriptor {
+  MpscQueue<std::function<void()>> tasks;
+  std::atomic<bool> closed{false};
+  /** Producers between the closed check and the push. */
+  std::atomic<int> posting{0};
+
+ public:
+  Mailbox();
+  ~Mailbox() override;
+  Mailbox(const Mailbox &) = delete;
+  Mailbox &operator=(const Mailbox &) = delete;
+
+  /**
+   * @brief Queues the @p task and wakes the owner loop. Can be called from any
+   * thread.
+   * @param task to run in the owner thread.
+   * @return @c false if the mailbox is closed, the task is not queued.
+   */
+  bool post(std::function<void()> task);
+
+  /**
+   * @brief Runs all the queued tasks. Must be called from the owner thread
+   * when the eventfd is readable.
+   * @return the number of tasks executed.
+   */
+  int drain();
+
+  /**
+   * @brief Refuses the new tasks and runs the ones already queued. Must be
+   * called from the owner thread once its loop has exited, or by the thread
+   * stopping it if the loop never ran.
+   * @return the number of tasks executed.
+   */
+  int close();
+};
+}  // namespace events
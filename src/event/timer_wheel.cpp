@@ -0,0 +1,154 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "timer_wheel.h"
+#include <ctime>
+
+namespace events {
+
+TimerWheel::TimerWheel(uint64_t now_ms)
+    : current_tick(now_ms / TIMER_WHEEL_TICK_MS) {
+  for (auto &level : slots)
+    for (auto &slot : level) slot.prev = slot.next = &slot;
+  expired.prev = expired.next = &expired;
+}
+
+uint64_t TimerWheel::now() {
+  timespec ts{};
+  ::clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000 +
+         static_cast<uint64_t>(ts.tv_nsec) / 1000000;
+}
+
+void TimerWheel::link(Timer &head, Timer &timer) {
+  timer.prev = head.prev;
+  timer.next = &head;
+  head.prev->next = &timer;
+  head.prev = &timer;
+}
+
+void TimerWheel::unlink(Timer &timer) {
+  timer.prev->next = timer.next;
+  timer.next->prev = timer.prev;
+  timer.prev = timer.next = nullptr;
+}
+
+void TimerWheel::place(Timer &timer) {
+  uint64_t delta = timer.expires - current_tick;
+  int level = 0;
+  while (level < TIMER_WHEEL_LEVELS - 1 &&
+         delta >= (1ULL << ((level + 1) * TIMER_WHEEL_BITS)))
+    level++;
+  uint64_t slot_tick = timer.expires;
+  if (delta >= (1ULL << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS))) {
+    /* out of range, it goes to the last slot of the wheel span keeping its
+     * expiration, and it is placed again each time that slot cascades until
+     * the remaining time is in range */
+    slot_tick =
+        current_tick + (1ULL << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS)) - 1;
+  }
+  auto index = (slot_tick >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK;
+  link(slots[level][index], timer);
+}
+
+void TimerWheel::cascade(int level) {
+  auto &head =
+      slots[level][(current_tick >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK];
+  while (head.next != &head) {
+    auto timer = head.next;
+    unlink(*timer);
+    place(*timer);
+  }
+}
+
+void TimerWheel::arm(Timer &timer, EVENT_GROUP group, int timeout_ms,
+                     uint64_t now_ms) {
+  cancel(timer);
+  if (timeout_ms <= 0) return;
+  timer.group = group;
+  /* one extra tick so the timer never expires before timeout_ms */
+  timer.expires = now_ms / TIMER_WHEEL_TICK_MS +
+                  (timeout_ms + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS +
+                  1;
+  if (timer.expires <= current_tick) timer.expires = current_tick + 1;
+  place(timer);
+  count++;
+}
+
+void TimerWheel::cancel(Timer &timer) {
+  if (!timer.isSet()) return;
+  /* the timers in the wheel always expire after the current tick */
+  if (timer.expires > current_tick) count--;
+  unlink(timer);
+}
+
+void TimerWheel::advance(uint64_t now_ms) {
+  uint64_t target_tick = now_ms / TIMER_WHEEL_TICK_MS;
+  if (count == 0) {
+    if (target_tick > current_tick) current_tick = target_tick;
+    return;
+  }
+  while (current_tick < target_tick) {
+    current_tick++;
+    if ((current_tick & TIMER_WHEEL_MASK) == 0) {
+      int level = 1;
+      while (level < TIMER_WHEEL_LEVELS - 1 &&
+             ((current_tick >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK) == 0)
+        level++;
+      /* upper levels first, so their timers can go down to the lower ones */
+      for (; level > 0; level--) cascade(level);
+    }
+    auto &head = slots[0][current_tick & TIMER_WHEEL_MASK];
+    while (head.next != &head) {
+      auto timer = head.next;
+      unlink(*timer);
+      link(expired, *timer);
+      count--;
+    }
+    if (count == 0) current_tick = target_tick;
+  }
+}
+
+TimerWheel::Timer *TimerWheel::popExpired() {
+  if (expired.next == &expired) return nullptr;
+  auto timer = expired.next;
+  unlink(*timer);
+  return timer;
+}
+
+int TimerWheel::nextTimeout(int max_ms, uint64_t now_ms) const {
+  if (expired.next != &expired) return 0;
+  if (count == 0) return max_ms;
+  uint64_t tick = current_tick + 1;
+  /* stop at the next wrap of the first level, the upper ones cascade there */
+  while ((tick & TIMER_WHEEL_MASK) != 0) {
+    auto &head = slots[0][tick & TIMER_WHEEL_MASK];
+    if (head.next != &head) break;
+    tick++;
+  }
+  uint64_t expire_ms = tick * TIMER_WHEEL_TICK_MS;
+  if (expire_ms <= now_ms) return 0;
+  return expire_ms - now_ms < static_cast<uint64_t>(max_ms)
+             ? static_cast<int>(expire_ms - now_ms)
+             : max_ms;
+}
+}  // namespace events
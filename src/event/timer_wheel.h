@@ -0,0 +1,138 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include "epoll_manager.h"
+
+namespace events {
+
+/** Resolution of the timer wheel in milliseconds. */
+#define TIMER_WHEEL_TICK_MS 10
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SIZE (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SIZE - 1)
+#define TIMER_WHEEL_LEVELS 4
+
+/**
+ * @class TimerWheel timer_wheel.h "src/event/timer_wheel.h"
+ * @brief Hierarchical timing wheel used to handle the stream timeouts.
+ *
+ * Each level has TIMER_WHEEL_SIZE slots, a slot of the level @c n covers
+ * TIMER_WHEEL_SIZE^n ticks. Timers are kept in intrusive lists so arming and
+ * cancelling are O(1) and do not need any file descriptor or syscall. The
+ * owner drives the wheel calling advance() after every epoll wait, using
+ * nextTimeout() as the wait timeout, and then pops the expired timers.
+ */
+class TimerWheel {
+ public:
+  /** Timer node, embedded in the object that owns the timeout. */
+  struct Timer {
+    Timer *prev{nullptr};
+    Timer *next{nullptr};
+    /** Tick when the timer expires. */
+    uint64_t expires{0};
+    /** Owner of the timer, returned back when the timer expires. */
+    void *data{nullptr};
+    /** Timeout type, one of the *_TIMEOUT groups. */
+    EVENT_GROUP group{EVENT_GROUP::NONE};
+    /** @return @c true if the timer is armed or expired but not popped. */
+    bool isSet() const { return next != nullptr; }
+  };
+
+ private:
+  /** Circular lists, each slot is the sentinel node of its list. */
+  std::array<std::array<Timer, TIMER_WHEEL_SIZE>, TIMER_WHEEL_LEVELS> slots;
+  /** Timers already expired, pending of being popped. */
+  Timer expired;
+  uint64_t current_tick{0};
+  size_t count{0};
+
+  static void link(Timer &head, Timer &timer);
+  static void unlink(Timer &timer);
+  void place(Timer &timer);
+  void cascade(int level);
+
+ public:
+  /**
+   * @brief Creates the wheel.
+   * @param now_ms is the current time in milliseconds, see now().
+   */
+  explicit TimerWheel(uint64_t now_ms = now());
+  TimerWheel(const TimerWheel &) = delete;
+  TimerWheel &operator=(const TimerWheel &) = delete;
+
+  /** @return the monotonic clock time in milliseconds. */
+  static uint64_t now();
+
+  /**
+   * @brief Arms the @p timer, if it was already armed it is rescheduled.
+   *
+   * The timer never expires before @p timeout_ms, it may expire up to a tick
+   * later. A @p timeout_ms of 0 or lower just cancels the timer.
+   *
+   * @param timer to arm.
+   * @param group is the timeout type stored in the timer.
+   * @param timeout_ms is the time in milliseconds until the timer expiration.
+   * @param now_ms is the current time in milliseconds.
+   */
+  void arm(Timer &timer, EVENT_GROUP group, int timeout_ms,
+           uint64_t now_ms = now());
+
+  /**
+   * @brief Disarms the @p timer, it does nothing if it is not set.
+   * @param timer to disarm.
+   */
+  void cancel(Timer &timer);
+
+  /**
+   * @brief Moves the wheel up to @p now_ms. The timers expired are kept in an
+   * internal list until they are popped with popExpired().
+   * @param now_ms is the current time in milliseconds.
+   */
+  void advance(uint64_t now_ms = now());
+
+  /**
+   * @brief Pops the next expired timer.
+   *
+   * Timers can be armed or cancelled while the expired ones are being
+   * processed, a cancelled timer is not returned.
+   *
+   * @return the expired timer or nullptr if there is none.
+   */
+  Timer *popExpired();
+
+  /**
+   * @brief Gets the time until the next slot with timers, to be used as the
+   * epoll wait timeout.
+   * @param max_ms is the maximum value returned.
+   * @param now_ms is the current time in milliseconds.
+   * @return the time in milliseconds, between 0 and @p max_ms.
+   */
+  int nextTimeout(int max_ms, uint64_t now_ms = now()) const;
+
+  /** @return the number of timers armed. */
+  size_t size() const { return count; }
+};
+}  // namespace events
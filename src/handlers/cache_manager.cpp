@@ -101,9 +101,8 @@ void CacheManager::validateCacheResponse(HttpResponse &response) {
 
     auto header = std::string_view(response.headers[i].name, response.headers[i].name_len);
     auto header_value = std::string_view(response.headers[i].value, response.headers[i].value_len);
-    auto it = http::http_info::headers_names.find(header);
-    if (it != http::http_info::headers_names.end()) {
-      const auto header_name = it->second;
+    auto header_name = http::http_info::getHeaderName(header);
+    if (header_name != http::HTTP_HEADER_NAME::NONE) {
       switch (header_name) {
         case http::HTTP_HEADER_NAME::CONTENT_LENGTH: {
           response.content_length = static_cast<size_t>(std::atoi(response.headers[i].value));
@@ -208,9 +207,8 @@ void CacheManager::validateCacheRequest(HttpRequest &request) {
     auto header = std::string_view(request.headers[i].name, request.headers[i].name_len);
     auto header_value = std::string_view(request.headers[i].value, request.headers[i].value_len);
 
-    auto it = http::http_info::headers_names.find(header);
-    if (it != http::http_info::headers_names.end()) {
-      auto header_name = it->second;
+    auto header_name = http::http_info::getHeaderName(header);
+    if (header_name != http::HTTP_HEADER_NAME::NONE) {
       switch (header_name) {
         case http::HTTP_HEADER_NAME::TRANSFER_ENCODING:
           // TODO
@@ -26,100 +26,81 @@
 //#define PRINT_DEBUG_CHUNKED 1
 
 ssize_t http_manager::handleChunkedData(Connection &connection, http_parser::HttpData & http_data) {
-  auto last_chunk_size = http_data.chunk_size_left;
-  if (last_chunk_size >= connection.buffer_size) {
-    http_data.chunk_size_left -= connection.buffer_size;
-  } else {
-    size_t data_offset = last_chunk_size;
-    size_t new_chunk_left = 0;
-    auto chunk_size = http_manager::getLastChunkSize(
-        connection.buffer + last_chunk_size,
-        connection.buffer_size - http_data.chunk_size_left,
-        data_offset, new_chunk_left, http_data.content_length);
-    //#if PRINT_DEBUG_CHUNKED
-    const char *status = chunk_size < 0 ? "*" : chunk_size == 0 ? "/" : "";
-    Logger::logmsg(LOG_REMOVE,
-                   "[%s] buffer size: %6lu chunk left: %8d => Chunk size: %8d "
-                   "Data offset: %6lu Content_length: %8d  next chunk left %8d",
-                   status, connection.buffer_size,
-                   last_chunk_size, chunk_size, data_offset,
-                   http_data.content_length, new_chunk_left);
-    //#endif
-    if (chunk_size < 0) {
-      //	  const char *new_chunk_buff = connection.buffer
-      //+ http_data.chunk_size_left - 5;
-      /* here we have a tricky situation, we have received the last pendind part
-       * of last chunk, bute not enough data to process next chunk size */
-      //	  http_data.chunk_buffer_size_offset =
-      // connection.buffer_size -
-      // http_data.chunk_size_left;
-      return -1;
-    } else if (chunk_size == 0) {
-      http_data.chunk_size_left = 0;
-      http_data.chunked_status = CHUNKED_STATUS::CHUNKED_LAST_CHUNK;
-#if PRINT_DEBUG_CHUNKED
-      Logger::logmsg(LOG_REMOVE, "LAST CHUNK");
-#endif
-      return 0;
-    } else {
-      http_data.chunk_size_left = new_chunk_left;
-    }
-    return static_cast<ssize_t>(new_chunk_left);
-  }
-  return static_cast<ssize_t>(http_data.chunk_size_left);
+  return parseChunks(connection.buffer + connection.buffer_offset,
+                     connection.buffer_size, http_data);
 }
 
-ssize_t http_manager::getChunkSize(const std::string &data, size_t data_size,
-                                   int &chunk_size_line_len) {
-  auto pos = data.find(http::CRLF);
-  if (pos != std::string::npos && pos < data_size) {
-    chunk_size_line_len = static_cast<int>(pos) + http::CRLF_LEN;
-    auto hex = data.substr(0, pos);
-    char *error;
-    auto chunk_length = ::strtol(hex.data(), &error, 16);
-    if (*error != 0) {
-      Logger::logmsg(LOG_NOTICE, "strtol() failed: Data size: %d  Buffer: %.*s",
-                     data_size, 10, data.data());
-      return -1;
-    } else {
-#if PRINT_DEBUG_CHUNKED
-      Logger::logmsg(LOG_DEBUG, "CHUNK found size %s => %d ", hex.data(),
-                     chunk_length);
-#endif
-      return static_cast<ssize_t>(chunk_length);
-    }
-  }
-  //  Logger::logmsg(LOG_NOTICE, "Chunk not found, need more data: Buff size: %d
-  //  Buff %.*s ",data_size, 5, data.data());
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  c |= 0x20;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
   return -1;
 }
 
-ssize_t http_manager::getLastChunkSize(const char *data, size_t data_size,
-                                       size_t &data_offset,
-                                       size_t &chunk_size_bytes_left,
-                                       size_t &content_length) {
-  int chunk_size_len = 0;
-  auto chunk_size = getChunkSize(data, data_size, chunk_size_len);
-  if (chunk_size > 0) {
-    content_length += static_cast<size_t>(chunk_size);
-    auto offset = chunk_size + chunk_size_len + http::CRLF_LEN;
-    if (data_size > (static_cast<size_t>(offset) + http::CRLF_LEN)) {
-      data_offset += static_cast<size_t>(offset);
-      auto data_ptr = data + offset;
-      return getLastChunkSize(data_ptr, data_size - static_cast<size_t>(offset),
-                              data_offset, chunk_size_bytes_left,
-                              content_length);
-    } else {
-      data_offset += data_size;
-      chunk_size_bytes_left = static_cast<size_t>(offset) - data_size;
-      return chunk_size;
+ssize_t http_manager::parseChunks(const char *data, size_t data_size,
+                                  http_parser::HttpData &http_data) {
+  size_t i = 0;
+  while (i < data_size &&
+         http_data.chunked_status != CHUNKED_STATUS::CHUNKED_LAST_CHUNK) {
+    char c = data[i];
+    switch (http_data.chunk_state) {
+      case CHUNK_STATE::DATA: {
+        auto len = std::min(http_data.chunk_size_left, data_size - i);
+        http_data.chunk_size_left -= len;
+        i += len;
+        if (http_data.chunk_size_left == 0)
+          http_data.chunk_state = CHUNK_STATE::DATA_END;
+        continue;
+      }
+      case CHUNK_STATE::SIZE:
+        if (hexValue(c) < 0) return -1;
+        http_data.chunk_size_left = static_cast<size_t>(hexValue(c));
+        http_data.chunk_state = CHUNK_STATE::SIZE_DIGITS;
+        break;
+      case CHUNK_STATE::SIZE_DIGITS:
+        if (hexValue(c) >= 0) {
+          if (http_data.chunk_size_left > (SIZE_MAX >> 4)) return -1;
+          http_data.chunk_size_left = (http_data.chunk_size_left << 4) |
+                                      static_cast<size_t>(hexValue(c));
+          break;
+        }
+        if (c != ';' && c != ' ' && c != '\t' && c != '\r' && c != '\n')
+          return -1;
+        http_data.chunk_state = CHUNK_STATE::EXTENSION;
+        [[fallthrough]];
+      case CHUNK_STATE::EXTENSION:
+        if (c != '\n') break;
+        http_data.content_length += http_data.chunk_size_left;
+        http_data.chunk_state = http_data.chunk_size_left > 0
+                                    ? CHUNK_STATE::DATA
+                                    : CHUNK_STATE::TRAILER;
+        break;
+      case CHUNK_STATE::DATA_END:
+        if (c == '\n')
+          http_data.chunk_state = CHUNK_STATE::SIZE;
+        else if (c != '\r')
+          return -1;
+        break;
+      case CHUNK_STATE::TRAILER:
+        /* an empty line ends the trailer section and the body */
+        if (c == '\n')
+          http_data.chunked_status = CHUNKED_STATUS::CHUNKED_LAST_CHUNK;
+        else if (c != '\r')
+          http_data.chunk_state = CHUNK_STATE::TRAILER_LINE;
+        break;
+      case CHUNK_STATE::TRAILER_LINE:
+        if (c == '\n') http_data.chunk_state = CHUNK_STATE::TRAILER;
+        break;
     }
-  } else if (chunk_size == 0) {
-    return 0;
-  } else {
-    // an error has ocurred;
-    return chunk_size;
+    i++;
   }
+#if PRINT_DEBUG_CHUNKED
+  Logger::logmsg(LOG_REMOVE, "chunk left: %lu %s", http_data.chunk_size_left,
+                 http_data.chunked_status == CHUNKED_STATUS::CHUNKED_LAST_CHUNK
+                     ? "LAST CHUNK"
+                     : "");
+#endif
+  return static_cast<ssize_t>(http_data.chunk_size_left);
 }
 
 void http_manager::setBackendCookie(Service *service, HttpStream *stream) {
@@ -173,8 +154,8 @@ validation::REQUEST_RESULT http_manager::validateRequest(HttpStream &stream) {
   } else {
     request.setRequestMethod();
   }
-  const auto request_url = std::string(request.path, request.path_length);
-  if (request_url.find("%00") != std::string::npos) {
+  const auto request_url = std::string_view(request.path, request.path_length);
+  if (request_url.find("%00") != std::string_view::npos) {
     return validation::REQUEST_RESULT::URL_CONTAIN_NULL;
   }
 
@@ -201,13 +182,9 @@ validation::REQUEST_RESULT http_manager::validateRequest(HttpStream &stream) {
         request.headers[i].name);
 #endif
     /* maybe header to be removed */
-    MATCHER *m;
-    for (m = listener_config_.head_off; m; m = m->next) {
-      if (::regexec(&m->pat, request.headers[i].name, 0, nullptr, 0) == 0) {
-        request.headers[i].header_off = true;
-        break;
-      }
-    }
+    if (!listener_config_.head_remove.empty() &&
+        listener_config_.head_remove.matches(request.headers[i]))
+      request.headers[i].header_off = true;
     if (request.headers[i].header_off) continue;
 
     //      Logger::logmsg(LOG_REMOVE, "\t%.*s",request.headers[i].name_len +
@@ -222,9 +199,8 @@ validation::REQUEST_RESULT http_manager::validateRequest(HttpStream &stream) {
     auto header_value = std::string_view(request.headers[i].value,
                                          request.headers[i].value_len);
 
-    auto it = http::http_info::headers_names.find(header);
-    if (it != http::http_info::headers_names.end()) {
-      auto header_name = it->second;
+    auto header_name = http::http_info::getHeaderName(header);
+    if (header_name != http::HTTP_HEADER_NAME::NONE) {
       switch (header_name) {
         case http::HTTP_HEADER_NAME::DESTINATION:
           if (listener_config_.rewr_dest != 0) {
@@ -236,13 +212,13 @@ validation::REQUEST_RESULT http_manager::validateRequest(HttpStream &stream) {
           request.upgrade_header = true;
 
           break;
-        case http::HTTP_HEADER_NAME::CONNECTION:
-          if (http_info::connection_values.count(std::string(header_value)) >
-                  0 &&
-              http_info::connection_values.at(std::string(header_value)) ==
-                  CONNECTION_VALUES::UPGRADE)
+        case http::HTTP_HEADER_NAME::CONNECTION: {
+          auto value = http_info::connection_values.find(header_value);
+          if (value != http_info::connection_values.end() &&
+              value->second == CONNECTION_VALUES::UPGRADE)
             request.connection_header_upgrade = true;
           break;
+        }
         case http::HTTP_HEADER_NAME::ACCEPT_ENCODING:
           request.accept_encoding_header = true;
           //          request.headers[i].header_off = true;
@@ -257,29 +233,11 @@ validation::REQUEST_RESULT http_manager::validateRequest(HttpStream &stream) {
                     TRANSFER_ENCODING_TYPE::CHUNKED;
                 request.chunked_status = http::CHUNKED_STATUS::CHUNKED_ENABLED;
 #ifdef CACHE_ENABLED
-                if (request.message_length > 0) {
-                  size_t data_offset = 0;
-                  size_t new_chunk_left = 0;
-                  auto chunk_size = http_manager::getLastChunkSize(
-                      request.message, request.message_length,
-                      data_offset, new_chunk_left, request.content_length);
-#if PRINT_DEBUG_CHUNKED
-                  Logger::logmsg(LOG_REMOVE, ">>>> Chunk size %d left %d ",
-                                 chunk_size, new_chunk_left);
-#endif
-                  request.content_length +=
-                      static_cast<size_t>(chunk_size);
-                  if (chunk_size == 0) {
-#if PRINT_DEBUG_CHUNKED
-                    Logger::logmsg(LOG_REMOVE, "Set LAST CHUNK");
-#endif
-                    request.chunk_size_left = 0;
-                    request.chunked_status =
-                        CHUNKED_STATUS::CHUNKED_LAST_CHUNK;
-                  } else {
-                    request.chunk_size_left = new_chunk_left;
-                  }
-                }
+                if (request.message_length > 0 &&
+                    http_manager::parseChunks(request.message,
+                                              request.message_length,
+                                              request) < 0)
+                  return validation::REQUEST_RESULT::BAD_REQUEST;
 #endif
               } else if (header_value[2] == 'o') {
                 request.transfer_encoding_type =
@@ -302,7 +260,7 @@ validation::REQUEST_RESULT http_manager::validateRequest(HttpStream &stream) {
         case http::HTTP_HEADER_NAME::CONTENT_LENGTH: {
           request.content_length =
               static_cast<size_t>(std::atoi(request.headers[i].value));
-          if ((request.content_length - request.message_length) > 0)
+          if (request.content_length > request.message_length)
             request.message_bytes_left =
                 request.content_length - request.message_length;
           continue;
@@ -329,6 +287,10 @@ validation::REQUEST_RESULT http_manager::validateRequest(HttpStream &stream) {
       }
     }
   }
+  /* the data after the body belongs to the next pipelined requests */
+  if (request.chunked_status == CHUNKED_STATUS::CHUNKED_DISABLED &&
+      request.message_length > request.content_length)
+    request.message_length = request.content_length;
   // waf
 
   return validation::REQUEST_RESULT::OK;
@@ -337,6 +299,7 @@ validation::REQUEST_RESULT http_manager::validateRequest(HttpStream &stream) {
 validation::REQUEST_RESULT http_manager::validateResponse(HttpStream &stream) {
   auto &listener_config_ = *stream.service_manager->listener_config_;
   HttpResponse &response = stream.response;
+  response.reusable = false;
   /* If the response is 100 continue we need to enable chunked transfer. */
   if (response.http_status_code < 200) {
     //    stream.response.chunked_status =
@@ -348,6 +311,12 @@ validation::REQUEST_RESULT http_manager::validateResponse(HttpStream &stream) {
   stream.request.c_opt.no_store ? response.c_opt.cacheable = false
                                 : response.c_opt.cacheable = true;
 #endif
+  /* a Content-Length in these responses describes the body not sent */
+  bool no_body = response.http_status_code == 204 ||
+                 response.http_status_code == 304 ||
+                 stream.request.request_method == http::REQUEST_METHOD::HEAD;
+  bool delimited = no_body;
+  bool connection_close = false;
   for (size_t i = 0; i != response.num_headers; i++) {
     // check header values length
 
@@ -361,19 +330,26 @@ validation::REQUEST_RESULT http_manager::validateResponse(HttpStream &stream) {
         response.headers[i].name_len + response.headers[i].value_len + 2,
         response.headers[i].name);
 #endif
-    auto it = http::http_info::headers_names.find(header);
-    if (it != http::http_info::headers_names.end()) {
-      const auto header_name = it->second;
+    auto header_name = http::http_info::getHeaderName(header);
+    if (header_name != http::HTTP_HEADER_NAME::NONE) {
       switch (header_name) {
         case http::HTTP_HEADER_NAME::CONTENT_LENGTH: {
           stream.response.content_length =
               static_cast<size_t>(std::atoi(header_value.data()));
-          if ((stream.response.content_length -
-               stream.response.message_length) > 0)
+          if (!no_body && stream.response.content_length >
+                              stream.response.message_length)
             stream.response.message_bytes_left =
                 stream.response.content_length - stream.response.message_length;
+          delimited = true;
           continue;
         }
+        case http::HTTP_HEADER_NAME::CONNECTION: {
+          auto value = http_info::connection_values.find(header_value);
+          if (value != http_info::connection_values.end() &&
+              value->second == CONNECTION_VALUES::CLOSE)
+            connection_close = true;
+          break;
+        }
         case http::HTTP_HEADER_NAME::CONTENT_LOCATION: {
           if (listener_config_.rewr_loc == 0) continue;
           // Rewrite location
@@ -497,31 +473,13 @@ validation::REQUEST_RESULT http_manager::validateResponse(HttpStream &stream) {
                 response.transfer_encoding_type =
                     TRANSFER_ENCODING_TYPE::CHUNKED;
                 response.chunked_status = http::CHUNKED_STATUS::CHUNKED_ENABLED;
-#ifdef CACHE_ENABLED
-                if (stream.response.message_length > 0) {
-                  size_t data_offset = 0;
-                  size_t new_chunk_left = 0;
-                  auto chunk_size = http_manager::getLastChunkSize(
-                      stream.response.message, stream.response.message_length,
-                      data_offset, new_chunk_left, response.content_length);
-#if PRINT_DEBUG_CHUNKED
-                  Logger::logmsg(LOG_REMOVE, ">>>> Chunk size %d left %d ",
-                                 chunk_size, new_chunk_left);
-#endif
-                  stream.response.content_length +=
-                      static_cast<size_t>(chunk_size);
-                  if (chunk_size == 0) {
-#if PRINT_DEBUG_CHUNKED
-                    Logger::logmsg(LOG_REMOVE, "Set LAST CHUNK");
-#endif
-                    stream.response.chunk_size_left = 0;
-                    stream.response.chunked_status =
-                        CHUNKED_STATUS::CHUNKED_LAST_CHUNK;
-                  } else {
-                    stream.response.chunk_size_left = new_chunk_left;
-                  }
-                }
-#endif
+                delimited = true;
+                /* the end of the body is found parsing its chunks */
+                if (response.message_length > 0 &&
+                    http_manager::parseChunks(response.message,
+                                              response.message_length,
+                                              response) < 0)
+                  return validation::REQUEST_RESULT::BAD_REQUEST;
               } else if (header_value[2] == 'o') {
                 response.transfer_encoding_type =
                     TRANSFER_ENCODING_TYPE::COMPRESS;
@@ -554,14 +512,12 @@ validation::REQUEST_RESULT http_manager::validateResponse(HttpStream &stream) {
       }
     }
     /* maybe header to be removed from response */
-    MATCHER *m;
-    for (m = listener_config_.response_head_off; m; m = m->next) {
-      if (::regexec(&m->pat, response.headers[i].name, 0, nullptr, 0) == 0) {
-        response.headers[i].header_off = true;
-        break;
-      }
-    }
+    if (!listener_config_.response_head_remove.empty() &&
+        listener_config_.response_head_remove.matches(response.headers[i]))
+      response.headers[i].header_off = true;
   }
+  response.reusable =
+      response.minor_version == 1 && delimited && !connection_close;
   return validation::REQUEST_RESULT::OK;
 }
 
@@ -573,10 +529,14 @@ void http_manager::replyError(http::Code code, const std::string &code_string,
                                        200) == nullptr)) {
     Logger::LogInfo("Error getting peer address", LOG_DEBUG);
   } else {
-    auto request_data_len = std::string_view(target.buffer).find('\r');
+    std::string_view request_data;
+    if (target.buffer != nullptr)
+      request_data = std::string_view(target.buffer, target.buffer_size);
+    request_data = request_data.substr(0, request_data.find('\r'));
     Logger::logmsg(LOG_WARNING, "(%lx) e%d %s %.*s from %s",
                    std::this_thread::get_id(), static_cast<int>(code),
-                   code_string.data(), request_data_len, target.buffer, caddr);
+                   code_string.data(), static_cast<int>(request_data.size()),
+                   request_data.data(), caddr);
   }
   auto response_ = http::getHttpResponse(code, code_string, str);
   size_t written = 0;
@@ -683,6 +643,7 @@ bool http_manager::replyRedirect(int code, const std::string &url,
   }
 
   if (result == IO::IO_RESULT::DONE_TRY_AGAIN && sent < response_.length()) {
+    stream.backend_connection.acquireBuffer();
     std::strncpy(stream.backend_connection.buffer, response_.data() + sent,
                  response_.size() - sent);
     stream.backend_connection.buffer_size = response_.size() - sent;
@@ -70,48 +70,27 @@ class http_manager {
   static void setBackendCookie(Service *service, HttpStream *stream);
 
   /**
-   * @brief Check if last chunk found in stream response and set stream chunk
-   * status
+   * @brief Parses the chunked body data read in the @p connection buffer.
    *
-   * @param stream is the HttpStream to get the response to take the chunked
-   * data.
-   * @return current chunk pending bytes or -1 if need more data to get chunk
-   * size.
+   * @param connection holding the body data not parsed yet.
+   * @param http_data is the message the body belongs to.
+   * @return current chunk pending bytes or -1 if the body is not valid.
    */
-
-  /**/
   static ssize_t handleChunkedData(Connection &connection, http_parser::HttpData & http_data);
   /**
-   * @brief Get chunk size from buffer
-   * if
-   * @param data buffer to search chunks
-   * @param data_size buffer size
-   * @param chunk_size_len bytes of data consumed in search
-   * @param chunk_size_line_len store chunk size line length
-   * @return Chunk size or -1 en case of error.
-   */
-
-  /**/
-  static ssize_t getChunkSize(const std::string &data, size_t data_size,
-                              int &chunk_size_line_len);
-  /**
-   * @brief Search for last chunk size in buffer data
+   * @brief Parses the next @p data_size bytes of a chunked body.
    *
+   * The parser state is kept in @p http_data, so the body can be split at any
+   * byte. The chunked status is set to CHUNKED_LAST_CHUNK once the last chunk
+   * and the trailer section have been parsed.
    *
-   * @param data buffer to search chunks
-   * @param data_size buffer size
-   * @param data_offset bytes of data consumed in search
-   * @param chunk_size_bytes_left reference to variable to store bytes left to
-   * read for last chunk found
-   * @param total_chunks_size reference to variable to add chunks size found
-   * @return last chunk size found.
+   * @param data is the chunked body data.
+   * @param data_size is the size of @p data.
+   * @param http_data is the message the body belongs to.
+   * @return current chunk pending bytes or -1 if the body is not valid.
    */
-
-  /**/
-  static ssize_t getLastChunkSize(const char *data, size_t data_size,
-                                  size_t &data_offset,
-                                  size_t &chunk_size_bytes_left,
-                                  size_t &total_chunks_size);
+  static ssize_t parseChunks(const char *data, size_t data_size,
+                             http_parser::HttpData &http_data);
   /**
    * @brief Replies an specified error to the client.
    *
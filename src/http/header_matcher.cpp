@@ -0,0 +1,119 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "header_matcher.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+char toLower(char c) {
+  return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+/* the text is in lower case */
+bool startsWithIgnoreCase(std::string_view line, std::string_view text) {
+  if (line.size() < text.size()) return false;
+  for (size_t i = 0; i < text.size(); i++)
+    if (toLower(line[i]) != text[i]) return false;
+  return true;
+}
+}  // namespace
+
+bool http::HeaderMatcher::isLiteral(std::string_view pattern,
+                                    std::string &text, bool &prefix) {
+  prefix = !pattern.empty() && pattern.front() == '^';
+  if (prefix) pattern.remove_prefix(1);
+  if (pattern.size() >= 2 && pattern.substr(pattern.size() - 2) == ".*")
+    pattern.remove_suffix(2);
+  if (pattern.empty() ||
+      pattern.find_first_of("\\^$.|?*+()[]{}") != std::string_view::npos)
+    return false;
+  text.resize(pattern.size());
+  std::transform(pattern.begin(), pattern.end(), text.begin(), toLower);
+  return true;
+}
+
+std::string http::HeaderMatcher::anchoredPrefix(std::string_view pattern) {
+  if (pattern.empty() || pattern.front() != '^') return {};
+  pattern.remove_prefix(1);
+  /* the alternatives out of a group are not anchored */
+  if (pattern.find('|') != std::string_view::npos) {
+    if (pattern.find_first_of("\\[") != std::string_view::npos) return {};
+    int depth = 0;
+    for (auto c : pattern) {
+      depth += c == '(' ? 1 : c == ')' ? -1 : 0;
+      if (c == '|' && depth <= 0) return {};
+    }
+  }
+  auto end =
+      std::min(pattern.find_first_of("\\^$.|?*+()[]{}"), pattern.size());
+  /* a quantifier may leave out the character before it */
+  if (end > 0 && end < pattern.size() &&
+      std::strchr("?*{", pattern[end]) != nullptr)
+    end--;
+  std::string prefix(end, '\0');
+  std::transform(pattern.begin(), pattern.begin() + end, prefix.begin(),
+                 toLower);
+  return prefix;
+}
+
+void http::HeaderMatcher::add(std::string_view pattern,
+                              const regex_t *compiled) {
+  Literal literal;
+  if (isLiteral(pattern, literal.text, literal.prefix)) {
+    has_substrings |= !literal.prefix;
+    literals.push_back(std::move(literal));
+  } else {
+    expressions.push_back({compiled, anchoredPrefix(pattern)});
+  }
+}
+
+bool http::HeaderMatcher::matches(std::string_view line) const {
+  for (auto &literal : literals)
+    if (literal.prefix && startsWithIgnoreCase(line, literal.text)) return true;
+  if (has_substrings) {
+    static thread_local std::string lower;
+    lower.resize(line.size());
+    std::transform(line.begin(), line.end(), lower.begin(), toLower);
+    for (auto &literal : literals)
+      if (!literal.prefix &&
+          ::memmem(lower.data(), lower.size(), literal.text.data(),
+                   literal.text.size()) != nullptr)
+        return true;
+  }
+  if (!expressions.empty()) {
+    /* regexec() needs the line terminated */
+    static thread_local std::string copy;
+    copy.assign(line);
+    for (auto &expression : expressions)
+      if (startsWithIgnoreCase(line, expression.prefix) &&
+          ::regexec(expression.compiled, copy.c_str(), 0, nullptr, 0) == 0)
+        return true;
+  }
+  return false;
+}
+
+bool http::HeaderMatcher::matches(const phr_header &header) const {
+  /* the continuation lines of a folded header have no name */
+  if (header.name == nullptr) return false;
+  return matches(std::string_view(
+      header.name,
+      static_cast<size_t>(header.value + header.value_len - header.name)));
+}
@@ -0,0 +1,81 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <pcreposix.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "pico_http_parser.h"
+
+namespace http {
+
+/**
+ * @class HeaderMatcher header_matcher.h "src/http/header_matcher.h"
+ * @brief Matches the header lines against the HeadRemove and
+ * RemoveResponseHeader patterns.
+ *
+ * The patterns are matched ignoring case against the whole line,
+ * "Name: value". Most of them are plain header names, so the patterns with no
+ * special characters, optionally anchored with '^' and ending with ".*", are
+ * compared as text. The rest go through regexec(), only for the lines
+ * starting with the text their anchor is followed by, if any.
+ */
+class HeaderMatcher {
+  struct Literal {
+    std::string text; /* lower case */
+    bool prefix;      /* anchored to the start of the line */
+  };
+  struct Expression {
+    const regex_t *compiled;
+    std::string prefix; /* lower case text the line has to start with */
+  };
+  std::vector<Literal> literals;
+  std::vector<Expression> expressions;
+  bool has_substrings{false};
+
+ public:
+  /**
+   * @brief Adds @p pattern, @p compiled is used if it is not a literal and
+   * has to outlive the matcher.
+   */
+  void add(std::string_view pattern, const regex_t *compiled);
+
+  /** @return @c true if there are no patterns. */
+  bool empty() const { return literals.empty() && expressions.empty(); }
+
+  /** @return @c true if the header @p line matches any of the patterns. */
+  bool matches(std::string_view line) const;
+
+  /** @return @c true if the line of the parsed @p header matches. */
+  bool matches(const phr_header &header) const;
+
+  /**
+   * @brief Gets the text of @p pattern if it can be compared as a literal.
+   * @param prefix is set if the text has to be at the start of the line.
+   */
+  static bool isLiteral(std::string_view pattern, std::string &text,
+                        bool &prefix);
+
+  /** @return the lower case text an anchored @p pattern starts with. */
+  static std::string anchoredPrefix(std::string_view pattern);
+};
+}  // namespace http
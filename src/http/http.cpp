@@ -20,17 +20,17 @@
  */
 
 #include "http.h"
+#include <cstring>
 
 using namespace http;
 
-const std::map<std::string, HTTP_HEADER_NAME,
-#if ENABLE_CI_HEADERS
-               helper::ci_less>
-#else
-               std::less<>>
-#endif
-    http_info::headers_names = {
-    {"", HTTP_HEADER_NAME::NONE},
+namespace {
+struct HeaderNameEntry {
+  std::string_view name;
+  HTTP_HEADER_NAME value;
+};
+
+constexpr HeaderNameEntry header_name_entries[] = {
     {"Accept", HTTP_HEADER_NAME::ACCEPT},
     {"Accept-Charset", HTTP_HEADER_NAME::ACCEPT_CHARSET},
     {"Accept-Encoding", HTTP_HEADER_NAME::ACCEPT_ENCODING},
@@ -113,6 +113,144 @@ const std::map<std::string, HTTP_HEADER_NAME,
     {"X-Forwarded-Proto", HTTP_HEADER_NAME::X_FORWARDED_PROTO},
     {"X-Frame-Options", HTTP_HEADER_NAME::X_FRAME_OPTIONS},
     {"X-XSS-Protection", HTTP_HEADER_NAME::X_XSS_PROTECTION}};
+
+constexpr size_t HEADER_NAME_COUNT =
+    sizeof(header_name_entries) / sizeof(header_name_entries[0]);
+constexpr int HEADER_NAME_BUCKET_BITS = 5;
+constexpr int HEADER_NAME_SLOT_BITS = 7;
+constexpr size_t HEADER_NAME_BUCKETS = size_t{1} << HEADER_NAME_BUCKET_BITS;
+constexpr size_t HEADER_NAME_SLOTS = size_t{1} << HEADER_NAME_SLOT_BITS;
+
+/* The length and the first and two last chars folded to lower case, they
+ * tell the known names apart. @p name has two chars at least. */
+constexpr uint32_t headerNameKey(const char *name, size_t len) {
+  return static_cast<uint32_t>(len) << 24 |
+         static_cast<uint32_t>(static_cast<unsigned char>(name[len - 2]) | 0x20)
+             << 16 |
+         static_cast<uint32_t>(static_cast<unsigned char>(name[len - 1]) | 0x20)
+             << 8 |
+         static_cast<uint32_t>(static_cast<unsigned char>(name[0]) | 0x20);
+}
+
+/* The top bits of the result are the bucket or the slot. */
+constexpr uint32_t headerNameHash(uint32_t key, uint32_t seed) {
+  return (key ^ seed * 0x9e3779b9u) * 0x85ebca6bu;
+}
+
+constexpr uint32_t headerNameBucket(uint32_t key) {
+  return headerNameHash(key, 0) >> (32 - HEADER_NAME_BUCKET_BITS);
+}
+
+constexpr uint32_t headerNameSlot(uint32_t key, uint32_t seed) {
+  return headerNameHash(key, seed) >> (32 - HEADER_NAME_SLOT_BITS);
+}
+
+struct HeaderNameTable {
+  /* hash seed of the names of each bucket */
+  uint8_t displacement[HEADER_NAME_BUCKETS]{};
+  /* header_name_entries index + 1 of each slot, 0 if it is empty */
+  uint8_t slot[HEADER_NAME_SLOTS]{};
+};
+
+/* Hash and displace: the names are split in buckets and the buckets, the
+ * largest first, take the first seed that puts all their names in free
+ * slots. */
+constexpr HeaderNameTable buildHeaderNameTable() {
+  HeaderNameTable table{};
+  size_t bucket[HEADER_NAME_COUNT]{};
+  size_t bucket_size[HEADER_NAME_BUCKETS]{};
+  for (size_t i = 0; i < HEADER_NAME_COUNT; i++) {
+    auto &name = header_name_entries[i].name;
+    bucket[i] = headerNameBucket(headerNameKey(name.data(), name.size()));
+    bucket_size[bucket[i]]++;
+  }
+  for (size_t size = HEADER_NAME_COUNT; size > 0; size--) {
+    for (size_t b = 0; b < HEADER_NAME_BUCKETS; b++) {
+      if (bucket_size[b] != size) continue;
+      for (uint32_t seed = 1; seed < 256; seed++) {
+        auto next = table;
+        bool placed = true;
+        for (size_t i = 0; i < HEADER_NAME_COUNT && placed; i++) {
+          if (bucket[i] != b) continue;
+          auto &name = header_name_entries[i].name;
+          auto &slot = next.slot[headerNameSlot(
+              headerNameKey(name.data(), name.size()), seed)];
+          placed = slot == 0;
+          slot = static_cast<uint8_t>(i + 1);
+        }
+        if (placed) {
+          table = next;
+          table.displacement[b] = static_cast<uint8_t>(seed);
+          break;
+        }
+      }
+    }
+  }
+  return table;
+}
+
+constexpr HeaderNameTable header_name_table = buildHeaderNameTable();
+
+constexpr bool isPerfect(const HeaderNameTable &table) {
+  size_t used = 0;
+  for (auto slot : table.slot) used += slot != 0;
+  return used == HEADER_NAME_COUNT;
+}
+static_assert(isPerfect(header_name_table),
+              "header names without a slot, grow HEADER_NAME_SLOT_BITS");
+
+#if ENABLE_CI_HEADERS
+inline uint64_t load8(const char *data) {
+  uint64_t chunk;
+  std::memcpy(&chunk, data, sizeof(chunk));
+  return chunk;
+}
+
+/* ASCII lower case of the 8 chars of @p chunk, the bytes over 0x7f are kept */
+inline uint64_t toLower8(uint64_t chunk) {
+  constexpr uint64_t ones = 0x0101010101010101ull;
+  uint64_t ascii = chunk & (0x7f * ones);
+  uint64_t upper = (ascii + (0x80 - 'A') * ones) & ~(ascii + (0x80 - 'Z' - 1) * ones) &
+                   ~chunk & (0x80 * ones);
+  return chunk | upper >> 2;
+}
+
+inline char toLower(char c) {
+  return static_cast<char>(c + ((static_cast<unsigned char>(c - 'A') < 26) << 5));
+}
+
+/* Case insensitive comparison 8 chars at a time, the last chunk overlaps the
+ * previous one. */
+inline bool equalsIgnoreCase(const char *a, const char *b, size_t len) {
+  if (len < 8) {
+    for (size_t i = 0; i < len; i++)
+      if (toLower(a[i]) != toLower(b[i])) return false;
+    return true;
+  }
+  for (size_t i = 0; i + 8 < len; i += 8)
+    if (toLower8(load8(a + i)) != toLower8(load8(b + i))) return false;
+  return toLower8(load8(a + len - 8)) == toLower8(load8(b + len - 8));
+}
+#endif
+}  // namespace
+
+HTTP_HEADER_NAME http_info::getHeaderName(std::string_view name) {
+  if (name.size() < 2) return HTTP_HEADER_NAME::NONE;
+  auto key = headerNameKey(name.data(), name.size());
+  auto index = header_name_table.slot[headerNameSlot(
+      key, header_name_table.displacement[headerNameBucket(key)])];
+  if (index == 0) return HTTP_HEADER_NAME::NONE;
+  auto &entry = header_name_entries[index - 1];
+  if (entry.name.size() != name.size()) return HTTP_HEADER_NAME::NONE;
+#if ENABLE_CI_HEADERS
+  if (!equalsIgnoreCase(name.data(), entry.name.data(), name.size()))
+    return HTTP_HEADER_NAME::NONE;
+#else
+  if (name != entry.name) return HTTP_HEADER_NAME::NONE;
+#endif
+  return entry.value;
+}
+
 const std::unordered_map<HTTP_HEADER_NAME, const std::string> http_info::headers_names_strings = {
     {HTTP_HEADER_NAME::NONE, ""},
     {HTTP_HEADER_NAME::ACCEPT, "Accept"},
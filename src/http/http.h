@@ -23,6 +23,7 @@
 
 #include <map>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include "../version.h"
 #include <memory>
@@ -32,6 +33,10 @@
 #define MAX_HEADER_LEN 4096
 #define MAX_HEADERS_SIZE 50
 #endif
+/** Longest request or response head, first line and headers, in bytes. */
+#ifndef MAX_HEADERS_LENGTH
+#define MAX_HEADERS_LENGTH 32768
+#endif
 
 namespace http {
 constexpr const char *CRLF = "\r\n";
@@ -45,6 +50,17 @@ enum class CHUNKED_STATUS : uint8_t {
   CHUNKED_LAST_CHUNK,
 };
 
+/** Part of a chunked body the chunk parser is in. */
+enum class CHUNK_STATE : uint8_t {
+  SIZE,         /* first digit of the chunk size */
+  SIZE_DIGITS,  /* rest of the chunk size */
+  EXTENSION,    /* chunk extensions up to the end of the size line */
+  DATA,         /* chunk data */
+  DATA_END,     /* CRLF after the chunk data */
+  TRAILER,      /* start of a trailer line or of the final CRLF */
+  TRAILER_LINE, /* rest of a trailer line */
+};
+
 enum class CONNECTION_VALUES : uint8_t {
   CLOSE,
   UPGRADE,
@@ -342,13 +358,12 @@ enum class Code {
   // 512-599	Unassigned
 };
 struct http_info {
-  static const std::map<std::string, HTTP_HEADER_NAME,
-#if ENABLE_CI_HEADERS
-                        helper::ci_less>
-#else
-                        std::less<>>
-#endif
-headers_names;
+  /**
+   * @brief Classifies the header @p name through a perfect hash of the known
+   * names built at compile time. It is case insensitive if ENABLE_CI_HEADERS.
+   * @return the header name or HTTP_HEADER_NAME::NONE if it is not known.
+   */
+  static HTTP_HEADER_NAME getHeaderName(std::string_view name);
   static const std::unordered_map<HTTP_HEADER_NAME, const std::string> headers_names_strings;
   static const std::map<std::string, REQUEST_METHOD, std::less<>> http_verbs;
   static const std::unordered_map<REQUEST_METHOD, const std::string> http_verb_strings;
@@ -57,6 +57,7 @@ void http_parser::HttpData::reset_parser() {
   content_length = 0;
   setHeaderSent(false);
   chunked_status = CHUNKED_STATUS::CHUNKED_DISABLED;
+  chunk_state = CHUNK_STATE::SIZE;
   extra_headers.clear();
   iov_size = 0;
   chunk_size_left = 0;
@@ -69,6 +70,21 @@ void http_parser::HttpData::setBuffer(char *ext_buffer,
   buffer_size = ext_buffer_size;
 }
 
+void http_parser::HttpData::detachBuffer() {
+  buffer = nullptr;
+  buffer_size = 0;
+  http_message = nullptr;
+  http_message_length = 0;
+  method = nullptr;
+  method_len = 0;
+  path = nullptr;
+  path_length = 0;
+  status_message = nullptr;
+  message = nullptr;
+  message_length = 0;
+  num_headers = 0;
+}
+
 void http_parser::HttpData::prepareToSend() {
   iov_size = 0;
   iov[iov_size++] = {http_message, http_message_length + CRLF_LEN};
@@ -161,15 +177,11 @@ void http_parser::HttpData::setHeaderSent(bool value) { headers_sent = value; }
 bool http_parser::HttpData::getHeaderValue(http::HTTP_HEADER_NAME header_name,
                                            std::string &out_key) {
   for (size_t i = 0; i != num_headers; ++i) {
-    std::string header(headers[i].name, headers[i].name_len);
-    std::string header_value(headers[i].value, headers[i].value_len);
-    if (http_info::headers_names.find(header) !=
-        http_info::headers_names.end()) {
-      auto header_name_ = http_info::headers_names.at(header);
-      if (header_name_ == header_name) {
-        out_key = header_value;
-        return true;
-      }
+    auto name = http_info::getHeaderName(
+        std::string_view(headers[i].name, headers[i].name_len));
+    if (name != HTTP_HEADER_NAME::NONE && name == header_name) {
+      out_key = std::string(headers[i].value, headers[i].value_len);
+      return true;
     }
   }
   return false;
@@ -189,6 +201,19 @@ bool http_parser::HttpData::getHeaderValue(const std::string &header_name,
   return false;
 }
 
+size_t http_parser::HttpData::resumeLength(size_t scanned,
+                                           size_t data_size) {
+  /* the data is not the one scanned before if it got shorter */
+  return scanned <= data_size ? scanned : 0;
+}
+
+http_parser::PARSE_RESULT http_parser::HttpData::incomplete(size_t data_size) {
+  if (data_size > MAX_HEADERS_LENGTH) return PARSE_RESULT::TOOLONG;
+  /* the next call only looks for the end of the head in the new bytes */
+  last_length = data_size;
+  return PARSE_RESULT::INCOMPLETE;
+}
+
 http_parser::PARSE_RESULT http_parser::HttpData::parseRequest(
     const std::string &data, size_t *used_bytes, bool reset) {
   return parseRequest(data.c_str(), data.length(), used_bytes, reset);
@@ -198,6 +223,7 @@ http_parser::PARSE_RESULT http_parser::HttpData::parseRequest(
     const char *data, const size_t data_size, size_t *used_bytes,
     [[maybe_unused]] bool reset) {
   //  if (LIKELY(reset))
+  auto scanned = last_length;
   reset_parser();
   buffer = const_cast<char *>(data);
   buffer_size = data_size;
@@ -206,9 +232,9 @@ http_parser::PARSE_RESULT http_parser::HttpData::parseRequest(
   const char **path_ = const_cast<const char **>(&path);
   auto pret = phr_parse_request(data, data_size, method_, &method_len, path_,
                                 &path_length, &minor_version, headers,
-                                &num_headers, last_length);
-  last_length = data_size;
+                                &num_headers, resumeLength(scanned, data_size));
   //  Logger::logmsg(LOG_DEBUG, "request is %d bytes long\n", pret);
+  if (pret > MAX_HEADERS_LENGTH) return PARSE_RESULT::TOOLONG;
   if (pret > 0) {
     *used_bytes = static_cast<size_t>(pret);
     headers_length = pret;
@@ -233,7 +259,7 @@ http_parser::PARSE_RESULT http_parser::HttpData::parseRequest(
     //    }
     return PARSE_RESULT::SUCCESS; /* successfully parsed the request */
   } else if (pret == -2) {        /* request is incomplete, continue the loop */
-    return PARSE_RESULT::INCOMPLETE;
+    return incomplete(data_size);
   }
   return PARSE_RESULT::FAILED;
 }
@@ -245,6 +271,7 @@ http_parser::PARSE_RESULT http_parser::HttpData::parseResponse(
     const char *data, const size_t data_size, size_t *used_bytes,
     [[maybe_unused]] bool reset) {
   //  if (LIKELY(reset))
+  auto scanned = last_length;
   reset_parser();
   buffer = const_cast<char *>(data);
   buffer_size = data_size;
@@ -252,9 +279,10 @@ http_parser::PARSE_RESULT http_parser::HttpData::parseResponse(
   const char **status_message_ = const_cast<const char **>(&status_message);
   auto pret = phr_parse_response(
       data, data_size, &minor_version, &http_status_code, status_message_,
-      &message_length, headers, &num_headers, last_length);
-  last_length = data_size;
+      &message_length, headers, &num_headers,
+      resumeLength(scanned, data_size));
   //  Logger::logmsg(LOG_DEBUG, "request is %d bytes long\n", pret);
+  if (pret > MAX_HEADERS_LENGTH) return PARSE_RESULT::TOOLONG;
   if (pret > 0) {
     *used_bytes = static_cast<size_t>(pret);
     headers_length = pret;
@@ -271,7 +299,7 @@ http_parser::PARSE_RESULT http_parser::HttpData::parseResponse(
 #endif
     return PARSE_RESULT::SUCCESS; /* successfully parsed the request */
   } else if (pret == -2) { /* response is incomplete, continue the loop */
-    return PARSE_RESULT::INCOMPLETE;
+    return incomplete(data_size);
   }
   return PARSE_RESULT::FAILED;
 }
@@ -64,6 +64,8 @@ public:
   bool getHeaderValue(http::HTTP_HEADER_NAME header_name, std::string &out_key);
   bool getHeaderValue(const std::string &, std::string &out_key);
   void setBuffer(char *ext_buffer, size_t ext_buffer_size);
+  /** @brief Drops the references into a buffer that is going to be released. */
+  void detachBuffer();
 
 public:
   std::vector< std::string> extra_headers;
@@ -83,7 +85,7 @@ public:
   phr_header headers[MAX_HEADERS_SIZE];
   char *buffer;
   size_t buffer_size;
-  size_t last_length;
+  size_t last_length; // head bytes scanned by the last incomplete parse
   size_t num_headers;
   char *http_message; // indicate firl line in a http request / response
   size_t http_message_length;
@@ -106,6 +108,8 @@ public:
   size_t chunk_size_left;
   /** This enumerate indicates the chunked mechanism status. */
   http::CHUNKED_STATUS chunked_status{CHUNKED_STATUS::CHUNKED_DISABLED};
+  /** Position of the chunk parser in the chunked body. */
+  http::CHUNK_STATE chunk_state{CHUNK_STATE::SIZE};
   http::HTTP_VERSION http_version;
   http::REQUEST_METHOD request_method;
   http::TRANSFER_ENCODING_TYPE transfer_encoding_type;
@@ -116,6 +120,10 @@ public:
   void setHeaderSent(bool value);
 private:
   bool headers_sent{false};
+  /** @return the length already scanned to resume the parsing from. */
+  static size_t resumeLength(size_t scanned, size_t data_size);
+  /** @brief Keeps the scanned length for the next parse of the message. */
+  PARSE_RESULT incomplete(size_t data_size);
 };
 } // namespace http_parser
 
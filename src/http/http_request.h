@@ -74,6 +74,9 @@ class HttpRequest : public http_parser::HttpData {
 
 class HttpResponse : public http_parser::HttpData {
  public:
+  /** The backend connection can be reused once this response is forwarded,
+   * it is HTTP/1.1 with a delimited body and no Connection: close. */
+  bool reusable{false};
 #ifdef CACHE_ENABLED
   bool transfer_encoding_header;
   bool cached = false;
@@ -27,9 +27,10 @@
 HttpStream::HttpStream()
     : client_connection(),
       backend_connection(),
-      timer_fd(),
+      timer(),
       request(),
       response() {
+  timer.data = this;
 #ifdef CACHE_ENABLED
     this->current_time = time_helper::gmtTimeNow();
     this->prev_time = std::chrono::steady_clock::now();
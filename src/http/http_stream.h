@@ -24,7 +24,7 @@
 #include "../connection/backend_connection.h"
 #include "../connection/client_connection.h"
 #include "../event/epoll_manager.h"
-#include "../event/timer_fd.h"
+#include "../event/timer_wheel.h"
 #include "../service/backend.h"
 #include "../service/service_manager.h"
 #include "../ssl/ssl_connection_manager.h"
@@ -68,14 +68,19 @@ class HttpStream : public Counter<HttpStream> {
   ClientConnection client_connection;
   /** Connection between zproxy and the backend. */
   BackendConnection backend_connection;
-  /** Timer descriptor used for the stream timeouts. */
-  TimerFd timer_fd;
+  /** Timer used for the stream timeouts, armed in the worker TimerWheel. */
+  events::TimerWheel::Timer timer;
   /** HttpRequest containing the request sent by the client. */
   HttpRequest request;
   /** HttpResponse containing the response sent by the backend. */
   HttpResponse response;
   /** This struct indicates the upgrade mechanism status. */
   UpgradeStatus upgrade;
+  /** The request headers have been forwarded to the backend and the response
+   * has not been forwarded completely yet. The requests pipelined after it are
+   * queued in the client buffer until then, so the responses are sent in the
+   * request order. */
+  bool awaiting_response{false};
 
   std::shared_ptr<ServiceManager> service_manager;
 };
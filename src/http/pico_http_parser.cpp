@@ -27,14 +27,13 @@
 #include <assert.h>
 #include <stddef.h>
 #include <string.h>
-#ifdef __SSE4_2__
-#ifdef _MSC_VER
-#include <nmmintrin.h>
-#else
+#include "pico_http_parser.h"
+/* the vector scanning functions are built for their own target and the one
+ * the CPU supports is picked at run time, see phr_simd_level() */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define PHR_SIMD_DISPATCH 1
 #include <x86intrin.h>
 #endif
-#endif
-#include "pico_http_parser.h"
 
 #if __GNUC__ >= 3
 #define likely(x) __builtin_expect(!!(x), 1)
@@ -73,7 +72,7 @@
         const char *tok_start = buf;                                                                                               \
         static const char ALIGNED(16) ranges2[16] = "\000\040\177\177";                                                            \
         int found2;                                                                                                                \
-        buf = findchar_fast(buf, buf_end, ranges2, 4, &found2);                                                                    \
+        buf = findchar_fast(buf, buf_end, ranges2, 4, CHARSET_TOKEN, &found2);                                                     \
         if (!found2) {                                                                                                             \
             CHECK_EOF();                                                                                                           \
         }                                                                                                                          \
@@ -102,34 +101,168 @@ static const char *token_char_map = "\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\
                                     "\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0"
                                     "\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0";
 
-static const char *findchar_fast(const char *buf,
+/* bytes the scanning stops at: SP, CTLs and DEL after a token; anything but
+ * a token char after a header name; CTLs except HT and DEL in a line */
+enum { CHARSET_TOKEN, CHARSET_NAME, CHARSET_EOL };
+
+#ifdef PHR_SIMD_DISPATCH
+static int detect_simd_level() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512bw")) return PHR_SIMD_AVX512;
+  if (__builtin_cpu_supports("avx2")) return PHR_SIMD_AVX2;
+  if (__builtin_cpu_supports("sse4.2")) return PHR_SIMD_SSE42;
+  return PHR_SIMD_NONE;
+}
+
+static const int simd_supported = detect_simd_level();
+static int simd_level = simd_supported;
+
+/* token_char_map as nibble tables, a byte is a token char if the entry of
+ * its low nibble has the bit of its high nibble */
+static const char ALIGNED(16) token_lo_nibble[16] = {'\xe8', '\xfc', '\xf8', '\xfc', '\xfc', '\xfc', '\xfc', '\xfc',
+                                                     '\xf8', '\xf8', '\xf4', '\x54', '\xd0', '\x54', '\xf4', '\x70'};
+static const char ALIGNED(16) token_hi_nibble[16] = {'\x01', '\x02', '\x04', '\x08', '\x10', '\x20', '\x40', '\x80',
+                                                     0,       0,       0,       0,       0,       0,       0,       0};
+
+/* The vector functions only scan whole vectors, the rest is left to the
+ * narrower ones and to the byte loops of the callers. */
+__attribute__((target("sse4.2"))) static const char *findchar_sse42(const char *buf,
+                                                                   const char *buf_end,
+                                                                   const char *ranges,
+                                                                   size_t ranges_size,
+                                                                   int *found) {
+  __m128i ranges16 = _mm_loadu_si128((const __m128i *) ranges);
+  while (likely(buf_end - buf >= 16)) {
+    __m128i b16 = _mm_loadu_si128((const __m128i *) buf);
+    int r = _mm_cmpestri(ranges16, ranges_size, b16, 16, _SIDD_LEAST_SIGNIFICANT | _SIDD_CMP_RANGES | _SIDD_UBYTE_OPS);
+    if (unlikely(r != 16)) {
+      *found = 1;
+      return buf + r;
+    }
+    buf += 16;
+  }
+  return buf;
+}
+
+__attribute__((target("avx2"))) static inline unsigned match_avx2(__m256i b32, int charset) {
+  __m256i match;
+  switch (charset) {
+  case CHARSET_TOKEN:
+    /* b <= SP as unsigned bytes, or DEL */
+    match = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(b32, _mm256_set1_epi8('\040')), b32),
+                            _mm256_cmpeq_epi8(b32, _mm256_set1_epi8('\177')));
+    break;
+  case CHARSET_NAME: {
+    __m256i lo = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) token_lo_nibble)),
+                                     _mm256_and_si256(b32, _mm256_set1_epi8(0x0f)));
+    __m256i hi = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) token_hi_nibble)),
+                                     _mm256_and_si256(_mm256_srli_epi16(b32, 4), _mm256_set1_epi8(0x0f)));
+    match = _mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), _mm256_setzero_si256());
+    break;
+  }
+  default:
+    /* b < SP but HT, or DEL */
+    match = _mm256_or_si256(_mm256_andnot_si256(_mm256_cmpeq_epi8(b32, _mm256_set1_epi8('\011')),
+                                                _mm256_cmpeq_epi8(_mm256_min_epu8(b32, _mm256_set1_epi8('\037')), b32)),
+                            _mm256_cmpeq_epi8(b32, _mm256_set1_epi8('\177')));
+    break;
+  }
+  return (unsigned) _mm256_movemask_epi8(match);
+}
+
+__attribute__((target("avx2"))) static const char *findchar_avx2(const char *buf, const char *buf_end, int charset, int *found) {
+  while (likely(buf_end - buf >= 32)) {
+    unsigned mask = match_avx2(_mm256_loadu_si256((const __m256i *) buf), charset);
+    if (unlikely(mask != 0)) {
+      *found = 1;
+      return buf + __builtin_ctz(mask);
+    }
+    buf += 32;
+  }
+  return buf;
+}
+
+__attribute__((target("avx512f,avx512bw"))) static inline __mmask64 match_avx512(__m512i b64, int charset) {
+  switch (charset) {
+  case CHARSET_TOKEN:
+    return _mm512_cmple_epu8_mask(b64, _mm512_set1_epi8('\040')) | _mm512_cmpeq_epi8_mask(b64, _mm512_set1_epi8('\177'));
+  case CHARSET_NAME: {
+    __m512i lo = _mm512_shuffle_epi8(_mm512_broadcast_i32x4(_mm_load_si128((const __m128i *) token_lo_nibble)),
+                                     _mm512_and_si512(b64, _mm512_set1_epi8(0x0f)));
+    __m512i hi = _mm512_shuffle_epi8(_mm512_broadcast_i32x4(_mm_load_si128((const __m128i *) token_hi_nibble)),
+                                     _mm512_and_si512(_mm512_srli_epi16(b64, 4), _mm512_set1_epi8(0x0f)));
+    return _mm512_testn_epi8_mask(lo, hi);
+  }
+  default:
+    return _mm512_mask_cmplt_epu8_mask(_mm512_cmpneq_epi8_mask(b64, _mm512_set1_epi8('\011')), b64,
+                                       _mm512_set1_epi8('\040')) |
+           _mm512_cmpeq_epi8_mask(b64, _mm512_set1_epi8('\177'));
+  }
+}
+
+__attribute__((target("avx512f,avx512bw"))) static const char *findchar_avx512(const char *buf, const char *buf_end, int charset,
+                                                                               int *found) {
+  while (likely(buf_end - buf >= 64)) {
+    __mmask64 mask = match_avx512(_mm512_loadu_si512((const void *) buf), charset);
+    if (unlikely(mask != 0)) {
+      *found = 1;
+      return buf + __builtin_ctzll(mask);
+    }
+    buf += 64;
+  }
+  return buf;
+}
+#endif
+
+int phr_simd_level(void) {
+#ifdef PHR_SIMD_DISPATCH
+  return simd_level;
+#else
+  return PHR_SIMD_NONE;
+#endif
+}
+
+int phr_set_simd_level(int level) {
+#ifdef PHR_SIMD_DISPATCH
+  simd_level = level < simd_supported ? level : simd_supported;
+#else
+  (void) level;
+#endif
+  return phr_simd_level();
+}
+
+/* @ranges are pairs of inclusive bounds of the @charset bytes for
+ * _mm_cmpestri, they may stop the scanning earlier than the charset */
+static inline const char *findchar_fast(const char *buf,
                                  const char *buf_end,
                                  const char *ranges,
                                  size_t ranges_size,
+                                 int charset,
                                  int *found) {
   *found = 0;
-#if __SSE4_2__
-  if (likely(buf_end - buf >= 16)) {
-        __m128i ranges16 = _mm_loadu_si128((const __m128i *)ranges);
-
-        size_t left = (buf_end - buf) & ~15;
-        do {
-            __m128i b16 = _mm_loadu_si128((const __m128i *)buf);
-            int r = _mm_cmpestri(ranges16, ranges_size, b16, 16, _SIDD_LEAST_SIGNIFICANT | _SIDD_CMP_RANGES | _SIDD_UBYTE_OPS);
-            if (unlikely(r != 16)) {
-                buf += r;
-                *found = 1;
-                break;
-            }
-            buf += 16;
-            left -= 16;
-        } while (likely(left != 0));
-    }
+#ifdef PHR_SIMD_DISPATCH
+  if (simd_level >= PHR_SIMD_AVX512 && buf_end - buf >= 96) {
+    /* most tokens end in the first 32 bytes */
+    buf = findchar_avx2(buf, buf + 32, charset, found);
+    if (*found)
+      return buf;
+    buf = findchar_avx512(buf, buf_end, charset, found);
+    if (*found)
+      return buf;
+  }
+  if (simd_level >= PHR_SIMD_AVX2 && buf_end - buf >= 32) {
+    buf = findchar_avx2(buf, buf_end, charset, found);
+    if (*found)
+      return buf;
+  }
+  if (simd_level >= PHR_SIMD_SSE42 && buf_end - buf >= 16)
+    buf = findchar_sse42(buf, buf_end, ranges, ranges_size, found);
 #else
   /* suppress unused parameter warning */
   (void) buf_end;
   (void) ranges;
   (void) ranges_size;
+  (void) charset;
 #endif
   return buf;
 }
@@ -141,15 +274,15 @@ static const char *get_token_to_eol(const char *buf,
                                     int *ret) {
   const char *token_start = buf;
 
-#ifdef __SSE4_2__
+#ifdef PHR_SIMD_DISPATCH
   static const char ALIGNED(16) ranges1[16] = "\0\010"    /* allow HT */
                                                 "\012\037"  /* allow SP and up to but not including DEL */
                                                 "\177\177"; /* allow chars w. MSB set */
     int found;
-    buf = findchar_fast(buf, buf_end, ranges1, 6, &found);
+    buf = findchar_fast(buf, buf_end, ranges1, 6, CHARSET_EOL, &found);
     if (found)
         goto FOUND_CTL;
-#else
+#endif
   /* find non-printable char within the next 8 bytes, this is the hottest code; manually inlined */
   while (likely(buf_end - buf >= 8)) {
 #define DOIT()                                                                                                                     \
@@ -174,7 +307,6 @@ static const char *get_token_to_eol(const char *buf,
     }
     ++buf;
   }
-#endif
   for (;; ++buf) {
     CHECK_EOF();
     if (unlikely(!IS_PRINTABLE_ASCII(*buf))) {
@@ -294,7 +426,7 @@ static const char *parse_headers(const char *buf, const char *buf_end, struct ph
                                                 "[]"     /* 0x5b-0x5d */
                                                 "{\377"; /* 0x7b-0xff */
       int found;
-      buf = findchar_fast(buf, buf_end, ranges1, sizeof(ranges1) - 1, &found);
+      buf = findchar_fast(buf, buf_end, ranges1, sizeof(ranges1) - 1, CHARSET_NAME, &found);
       if (!found) {
         CHECK_EOF();
       }
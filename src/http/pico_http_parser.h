@@ -84,6 +84,17 @@ int phr_parse_response(const char *_buf, size_t len, int *minor_version, int *st
 /* ditto */
 int phr_parse_headers(const char *buf, size_t len, struct phr_header *headers, size_t *num_headers, size_t last_len);
 
+/* vector instructions used to scan the messages */
+enum { PHR_SIMD_NONE, PHR_SIMD_SSE42, PHR_SIMD_AVX2, PHR_SIMD_AVX512 };
+
+/* returns the widest instructions the CPU supports unless limited with
+ * phr_set_simd_level() */
+int phr_simd_level(void);
+
+/* limits the scanning to the instructions of @level and below, returns the
+ * level used, which is lower if the CPU does not support it */
+int phr_set_simd_level(int level);
+
 /* should be zero-filled before start */
 struct phr_chunked_decoder {
     size_t bytes_left_in_chunk; /* number of bytes left in current chunk */
@@ -60,6 +60,8 @@ const std::string JSON_KEYS::CONNECTIONS = "connections";
 const std::string JSON_KEYS::PENDING_CONNS = "pending-connections";
 const std::string JSON_KEYS::RESPONSE_TIME = "response-time";
 const std::string JSON_KEYS::CONNECT_TIME = "connect-time";
+const std::string JSON_KEYS::FAST_OPEN_HITS = "tfo-hits";
+const std::string JSON_KEYS::FAST_OPEN_MISSES = "tfo-misses";
 const std::string JSON_KEYS::WEIGHT = "weight";
 const std::string JSON_KEYS::PRIORITY = "priority";
 const std::string JSON_KEYS::CONFIG = "config";
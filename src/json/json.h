@@ -63,6 +63,8 @@ struct JSON_KEYS {
   static const std::string PENDING_CONNS;
   static const std::string RESPONSE_TIME;
   static const std::string CONNECT_TIME;
+  static const std::string FAST_OPEN_HITS;
+  static const std::string FAST_OPEN_MISSES;
   static const std::string WEIGHT;
   static const std::string PRIORITY;
   static const std::string CONFIG;
@@ -22,12 +22,49 @@
 
 Backend::Backend() : status(BACKEND_STATUS::NO_BACKEND) {}
 
-Backend::~Backend() {
-  if (address_info != nullptr) {
-    ::freeaddrinfo(address_info);
+Backend::~Backend() {}
+
+void Backend::setAddresses(const std::vector<sockaddr_storage> &addresses_) {
+  auto new_addresses =
+      std::make_shared<std::vector<sockaddr_storage>>(addresses_);
+  for (auto &new_address : *new_addresses) {
+    if (new_address.ss_family == AF_INET6)
+      reinterpret_cast<sockaddr_in6 &>(new_address).sin6_port = htons(port);
+    else
+      reinterpret_cast<sockaddr_in &>(new_address).sin_port = htons(port);
+  }
+  auto old_addresses = std::atomic_exchange(
+      &addresses, std::shared_ptr<const std::vector<sockaddr_storage>>(
+                      std::move(new_addresses)));
+  if ((old_addresses == nullptr || old_addresses->empty()) &&
+      !addresses_.empty() && status == BACKEND_STATUS::BACKEND_DOWN) {
+    Logger::logmsg(LOG_NOTICE, "BackEnd %s:%d resolved, farm: '%s', service: '%s'",
+                   address.data(), port, backend_config->f_name.data(),
+                   backend_config->srv_name.data());
+    status = BACKEND_STATUS::BACKEND_UP;
   }
 }
 
+IO::IO_OP Backend::connect(Connection &connection, int timeout, bool async,
+                           bool fast_open) {
+  auto current = getAddresses();
+  if (current == nullptr || current->empty()) return IO::IO_OP::OP_ERROR;
+  auto &peer =
+      (*current)[next_address.fetch_add(1, std::memory_order_relaxed) %
+                 current->size()];
+  addrinfo address_info{};
+  address_info.ai_family = peer.ss_family;
+  address_info.ai_socktype = SOCK_STREAM;
+  address_info.ai_addr =
+      reinterpret_cast<sockaddr *>(const_cast<sockaddr_storage *>(&peer));
+  address_info.ai_addrlen = peer.ss_family == AF_INET6 ? sizeof(sockaddr_in6)
+                                                       : sizeof(sockaddr_in);
+  return connection.doConnect(
+      address_info, timeout, async,
+      fast_open && backend_config != nullptr &&
+          backend_config->tcp_fast_open > 0);
+}
+
 std::string Backend::handleTask(ctl::CtlTask& task) {
   if (!isHandler(task) || this->backend_type != BACKEND_TYPE::REMOTE) return "";
   //  Logger::logmsg(LOG_REMOVE, "Backend %d handling task", backend_id);
@@ -58,7 +95,7 @@ std::string Backend::handleTask(ctl::CtlTask& task) {
       case ctl::CTL_SUBJECT::WEIGHT: {
         JsonObject weight_;
         weight_.emplace(JSON_KEYS::WEIGHT,
-                        std::make_unique<JsonDataValue>(this->weight));
+                        std::make_unique<JsonDataValue>(this->weight.load()));
         return weight_.stringify();
       }
       default:
@@ -128,7 +165,7 @@ std::unique_ptr<JsonObject> Backend::getBackendJson() {
                   std::make_unique<JsonDataValue>(this->address));
     root->emplace(JSON_KEYS::PORT, std::make_unique<JsonDataValue>(this->port));
     root->emplace(JSON_KEYS::WEIGHT,
-                  std::make_unique<JsonDataValue>(this->weight));
+                  std::make_unique<JsonDataValue>(this->weight.load()));
     root->emplace(JSON_KEYS::PRIORITY,
                   std::make_unique<JsonDataValue>(this->priority));
     switch (this->status) {
@@ -157,6 +194,10 @@ std::unique_ptr<JsonObject> Backend::getBackendJson() {
                   std::make_unique<JsonDataValue>(this->avg_response_time));
     root->emplace(JSON_KEYS::CONNECT_TIME,
                   std::make_unique<JsonDataValue>(this->avg_conn_time));
+    root->emplace(JSON_KEYS::FAST_OPEN_HITS,
+                  std::make_unique<JsonDataValue>(this->fast_open_hits));
+    root->emplace(JSON_KEYS::FAST_OPEN_MISSES,
+                  std::make_unique<JsonDataValue>(this->fast_open_misses));
   }
   return root;
 }
@@ -165,7 +206,7 @@ void Backend::doMaintenance() {
   if (this->status != BACKEND_STATUS::BACKEND_DOWN) return;
 
   Connection checkOut;
-  auto res = checkOut.doConnect(*address_info, 5, false);
+  auto res = connect(checkOut, 5, false);
 
   switch (res) {
     case IO::IO_OP::OP_SUCCESS: {
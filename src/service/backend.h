@@ -32,7 +32,9 @@
 #include "../stats/backend_stats.h"
 #include "../util/utils.h"
 #include <atomic>
+#include <memory>
 #include <netdb.h>
+#include <vector>
 
 /** The enum Backend::BACKEND_STATUS defines the status of the Backend. */
 enum class BACKEND_STATUS {
@@ -77,14 +79,20 @@ class Backend : public CtlObserver<ctl::CtlTask, std::string>, public BackendInf
   BACKEND_TYPE backend_type;
   /** BackendConfig parameters from the backend section. */
   std::shared_ptr<BackendConfig> backend_config;
-  /** Backend Address as a addrinfo type. */
-  addrinfo *address_info{nullptr};
+  /**
+   * Addresses the Backend Address resolves to, with the port set. The set is
+   * replaced as a whole when the name is resolved again, use getAddresses()
+   * and setAddresses() to access it from any thread.
+   */
+  std::shared_ptr<const std::vector<sockaddr_storage>> addresses;
+  /** Next address to connect to, the connections are balanced between all. */
+  std::atomic<uint32_t> next_address{0};
   /** Backend id. */
   int backend_id;
   /** Backend name. */
   std::string name;
   /** Backend weight, used for the balancing algorithms. */
-  int weight;
+  std::atomic<int> weight;
   /** Backend priority, used for the balancing algorithms. */
   int priority{0};
   /** Backend Address as a std::string type. */
@@ -105,6 +113,26 @@ class Backend : public CtlObserver<ctl::CtlTask, std::string>, public BackendInf
    */
   void doMaintenance();
 
+  /** @return the current set of addresses of the Backend. */
+  std::shared_ptr<const std::vector<sockaddr_storage>> getAddresses() const {
+    return std::atomic_load(&addresses);
+  }
+
+  /**
+   * @brief Replaces the addresses of the Backend with the @p addresses_ its
+   * Address resolves to. A Backend down because it had no address is set up.
+   */
+  void setAddresses(const std::vector<sockaddr_storage> &addresses_);
+
+  /**
+   * @brief Connects @p connection to the next address of the Backend.
+   * @param fast_open allows TCP Fast Open if the Backend has it enabled, it
+   * delays the connect until the first write.
+   * @return IO::IO_OP::OP_ERROR if it fails or there is no address yet.
+   */
+  IO::IO_OP connect(Connection &connection, int timeout, bool async = true,
+                    bool fast_open = true);
+
   /**
    * @brief This function handles the @p tasks received with the API format.
    *
@@ -84,6 +84,7 @@ SessionInfo *HttpSessionManager::getSession(Connection &source,
                                             bool update_if_exist) {
   std::string session_key = getSessionKey(source, request);
   if (session_key.empty()) return nullptr;
+  std::lock_guard<std::recursive_mutex> locker(lock_mtx);
   auto session_it = sessions_set.find(session_key);
   if (session_it == sessions_set.end()) return nullptr;
   if (session_it->second != nullptr) {
@@ -100,6 +101,7 @@ SessionInfo *HttpSessionManager::getSession(Connection &source,
 
 std::unique_ptr<json::JsonArray> HttpSessionManager::getSessionsJson() {
   std::unique_ptr<json::JsonArray> data{new json::JsonArray()};
+  std::lock_guard<std::recursive_mutex> locker(lock_mtx);
   for (auto &session : sessions_set) {
     std::unique_ptr<JsonObject> json_data{new json::JsonObject()};
     json_data->emplace(JSON_KEYS::ID,
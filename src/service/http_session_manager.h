@@ -65,11 +65,12 @@ struct SessionInfo {
 };
 
 class HttpSessionManager {
-  // used
-  std::recursive_mutex lock_mtx;
   std::unordered_map<std::string, SessionInfo *>
       sessions_set;  // key can be anything, depending on the session type
  protected:
+  /* the workers and the control tasks access the sessions from their own
+   * threads, a SessionInfo returned must be used with it held */
+  std::recursive_mutex lock_mtx;
   HttpSessionType session_type;
   std::string sess_id;  /* id to construct the pattern */
   regex_t sess_start{}; /* pattern to identify the session data */
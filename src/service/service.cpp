@@ -21,12 +21,18 @@
 
 #include "service.h"
 #include <numeric>
+#include "../event/dns_resolver.h"
 #include "../util/network.h"
 
+/** Resolves the host names of the backends added through the control API. */
+static std::mutex host_watcher_mtx;
+static std::function<void(const std::string &)> host_watcher;
+
 Backend *Service::getBackend(Connection &source, HttpRequest &request) {
   if (backend_set.empty()) return getEmergencyBackend();
 
   if (session_type != sessions::SESS_NONE) {
+    std::lock_guard<std::recursive_mutex> locker(lock_mtx);
     auto session = getSession(source, request);
     if (session != nullptr) {
       if (session->assigned_backend->status != BACKEND_STATUS::BACKEND_UP) {
@@ -66,12 +72,16 @@ void Service::addBackend(std::shared_ptr<BackendConfig> backend_config,
   backend->status = backend_config->disabled ? BACKEND_STATUS::BACKEND_DISABLED
                                              : BACKEND_STATUS::BACKEND_UP;
   if (backend_config->be_type == 0) {
-    backend->address_info =
-        Network::getAddress(backend_config->address, backend_config->port)
-            .release();
-    if (backend->address_info != nullptr) {
-      backend->address = std::move(backend_config->address);
+    if (!backend_config->address.empty()) {
+      backend->address = backend_config->address;
       backend->port = backend_config->port;
+      /* host names are resolved by the listener loop, the backend is down
+       * until they are */
+      sockaddr_storage address{};
+      if (events::DnsResolver::parseAddress(backend->address, address))
+        backend->setAddresses({address});
+      else if (!backend_config->disabled)
+        backend->status = BACKEND_STATUS::BACKEND_DOWN;
       backend->backend_type = BACKEND_TYPE::REMOTE;
       backend->nf_mark = backend_config->nf_mark;
       backend->ctx = backend_config->ctx;
@@ -163,7 +173,17 @@ bool Service::addBackend(JsonObject *json_object) {
     }
     config->status = BACKEND_STATUS::BACKEND_DISABLED;
     config->backend_type = BACKEND_TYPE::REMOTE;
+    /* as the configured ones, host names are resolved by the listener loop */
+    sockaddr_storage address{};
+    bool is_literal =
+        events::DnsResolver::parseAddress(config->address, address);
+    if (is_literal) config->setAddresses({address});
+    auto host = config->address;
     backend_set.push_back(config.release());
+    if (!is_literal) {
+      std::lock_guard<std::mutex> lock(host_watcher_mtx);
+      if (host_watcher != nullptr) host_watcher(host);
+    }
   }
 
   return true;
@@ -509,6 +529,44 @@ void Service::doMaintenance() {
 #endif
 }
 
+std::vector<std::string> Service::getBackendHosts() {
+  std::vector<std::string> hosts;
+  for (auto set : {&backend_set, &emergency_backend_set})
+    for (Backend *bck : *set)
+      if (bck->backend_type == BACKEND_TYPE::REMOTE)
+        hosts.push_back(bck->address);
+  return hosts;
+}
+
+void Service::setHostWatcher(
+    std::function<void(const std::string &)> watcher) {
+  std::lock_guard<std::mutex> lock(host_watcher_mtx);
+  host_watcher = std::move(watcher);
+}
+
+std::vector<Backend *> Service::getWarmBackends() {
+  std::vector<Backend *> backends;
+  for (Backend *bck : backend_set)
+    if (bck->backend_type == BACKEND_TYPE::REMOTE &&
+        bck->backend_config != nullptr &&
+        bck->backend_config->pool_min_idle > 0)
+      backends.push_back(bck);
+  return backends;
+}
+
+bool Service::setBackendAddresses(
+    const std::string &host, const std::vector<sockaddr_storage> &addresses) {
+  bool used = false;
+  for (auto set : {&backend_set, &emergency_backend_set})
+    for (Backend *bck : *set) {
+      if (bck->backend_type != BACKEND_TYPE::REMOTE || bck->address != host)
+        continue;
+      used = true;
+      if (!addresses.empty()) bck->setAddresses(addresses);
+    }
+  return used;
+}
+
 /** There is not backend available, trying to pick an emergency backend. If
  * there is not an emergency backend available it returns nullptr. */
 Backend *Service::getEmergencyBackend() {
@@ -128,6 +128,29 @@ class Service : public sessions::HttpSessionManager,
    */
   void doMaintenance();
 
+  /** @return the Address of the remote backends, emergency ones included. */
+  std::vector<std::string> getBackendHosts();
+
+  /**
+   * @brief Sets the function called with the Address of the backends added
+   * through the control API, so their host names are resolved as the ones of
+   * the configuration file. It is called from the control thread.
+   * @param watcher to call, @c nullptr to stop calling it.
+   */
+  static void setHostWatcher(
+      std::function<void(const std::string &)> watcher);
+
+  /** @return the remote backends with idle connections kept established. */
+  std::vector<Backend *> getWarmBackends();
+
+  /**
+   * @brief Sets the @p addresses the @p host resolves to in the remote
+   * backends with that Address.
+   * @return @c false if no backend has that Address.
+   */
+  bool setBackendAddresses(const std::string &host,
+                           const std::vector<sockaddr_storage> &addresses);
+
   /**
    * @brief Check if the Service should handle the HttpRequest.
    *
@@ -129,6 +129,8 @@ std::string ServiceManager::handleTask(ctl::CtlTask &task) {
           auto count = this->disabled ? sm.use_count() : sm.use_count() - 1;
           root->emplace(JSON_KEYS::CONNECTIONS,
                         std::make_unique<JsonDataValue>(count));
+          root->emplace(JSON_KEYS::FAST_OPEN_HITS,
+                        std::make_unique<JsonDataValue>(fast_open_hits.load()));
 
           auto services_array = std::make_unique<JsonArray>();
           for (auto service : services)
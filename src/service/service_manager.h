@@ -53,6 +53,8 @@ class ServiceManager : public CtlObserver<ctl::CtlTask, std::string>,
   int id;
   std::string name;
   std::atomic<bool> disabled{false};
+  /** Connections accepted with data in their SYN, TCP Fast Open. */
+  std::atomic<int> fast_open_hits{0};
   /**
    * @brief Gets the Service that handles the HttpRequest.
    *
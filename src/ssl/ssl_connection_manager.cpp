@@ -83,7 +83,11 @@ IO::IO_RESULT SSLConnectionManager::handleDataRead(Connection &ssl_connection) {
   if (!ssl_connection.ssl_connected) {
     return IO::IO_RESULT::SSL_NEED_HANDSHAKE;
   }
-  if ((MAX_DATA_SIZE -
+  /* with kTLS receive the kernel decrypts the records, but a plain recv()
+   * fails with EIO on the control ones (session tickets, key updates, alerts),
+   * OpenSSL reads them with their record type and handles them */
+  ssl_connection.acquireBuffer();
+  if ((ssl_connection.buffer_capacity -
        (ssl_connection.buffer_size + ssl_connection.buffer_offset)) == 0)
     return IO::IO_RESULT::FULL_BUFFER;
   //  Logger::logmsg(LOG_DEBUG, "> handleRead");
@@ -95,7 +99,8 @@ IO::IO_RESULT SSLConnectionManager::handleDataRead(Connection &ssl_connection) {
     rc = BIO_read(ssl_connection.io,
                   ssl_connection.buffer + ssl_connection.buffer_offset +
                       ssl_connection.buffer_size,
-                  static_cast<int>(MAX_DATA_SIZE - ssl_connection.buffer_size -
+                  static_cast<int>(ssl_connection.buffer_capacity -
+                                   ssl_connection.buffer_size -
                                    ssl_connection.buffer_offset));
     //    Logger::logmsg(LOG_DEBUG, "BIO_read return code %d buffer size %d ERRNO %s", rc,
     //                  ssl_connection.buffer_size, std::strerror(errno));
@@ -127,6 +132,8 @@ IO::IO_RESULT SSLConnectionManager::handleWrite(Connection &ssl_connection, cons
     return IO::IO_RESULT::SSL_NEED_HANDSHAKE;
   }
   if (data_size == 0) return IO::IO_RESULT::SUCCESS;
+  if (ssl_connection.ktls_send)
+    return ssl_connection.write(data, data_size, written);
   IO::IO_RESULT result;
   int rc = -1;
   //  // FIXME: Buggy, used just for test
@@ -277,6 +284,15 @@ bool SSLConnectionManager::handleHandshake(SSL_CTX *ssl_ctx,
   } else if (r == 1) {
 #endif
   ssl_connection.ssl_connected = true;
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+  /* OpenSSL only pushes the keys to the kernel if the cipher and the kernel
+   * support it, if not the records keep going through the BIOs */
+  ssl_connection.ktls_send = BIO_get_ktls_send(SSL_get_wbio(ssl_connection.ssl)) != 0;
+  ssl_connection.ktls_recv = BIO_get_ktls_recv(SSL_get_rbio(ssl_connection.ssl)) != 0;
+  if ((SSL_get_options(ssl_connection.ssl) & SSL_OP_ENABLE_KTLS) != 0)
+    Logger::logmsg(LOG_DEBUG, "fd:%d kTLS send: %s recv: %s", ssl_connection.getFileDescriptor(),
+                   ssl_connection.ktls_send ? "on" : "off", ssl_connection.ktls_recv ? "on" : "off");
+#endif
   const SSL_CIPHER *cipher = SSL_get_current_cipher(ssl_connection.ssl);
   if (cipher) {
     auto buf = std::make_unique<char[]>(MAXBUF);
@@ -398,11 +414,15 @@ IO::IO_RESULT SSLConnectionManager::sslRead(Connection &ssl_connection) {
   }
   IO::IO_RESULT result = IO::IO_RESULT::ERROR;
   int rc = -1;
+  ssl_connection.acquireBuffer();
   do {
+    if (ssl_connection.buffer_capacity ==
+        ssl_connection.buffer_size + ssl_connection.buffer_offset)
+      return IO::IO_RESULT::FULL_BUFFER;
     ERR_clear_error();
     rc = SSL_read(ssl_connection.ssl,
                   ssl_connection.buffer + ssl_connection.buffer_offset + ssl_connection.buffer_size,
-                  static_cast<int>(MAX_DATA_SIZE - ssl_connection.buffer_size - ssl_connection.buffer_offset ));
+                  static_cast<int>(ssl_connection.buffer_capacity - ssl_connection.buffer_size - ssl_connection.buffer_offset ));
     auto ssle = SSL_get_error(ssl_connection.ssl, rc);
     switch (ssle) {
       case SSL_ERROR_NONE:
@@ -497,6 +517,9 @@ IO::IO_RESULT SSLConnectionManager::sslWriteIOvec(
 
 IO::IO_RESULT SSLConnectionManager::handleWriteIOvec(Connection &target_ssl_connection, iovec *iov, size_t &iovec_size,
                                                      size_t &iovec_written, size_t &nwritten) {
+  if (target_ssl_connection.ktls_send)
+    return Connection::writeIOvec(target_ssl_connection.getFileDescriptor(), iov, iovec_size, iovec_written,
+                                  nwritten);
   IO::IO_RESULT result = IO::IO_RESULT::ERROR;
   size_t count = 0;
   auto nvec = iovec_size;
@@ -556,7 +579,7 @@ IO::IO_RESULT SSLConnectionManager::handleDataWrite(Connection &target_ssl_conne
 
   if (result != IO::IO_RESULT::SUCCESS) return result;
 
-  ssl_connection.buffer_size = 0;  // buffer_offset;
+  ssl_connection.consumeMessage(http_data);
   http_data.message_length = 0;
   http_data.setHeaderSent(true);
   http_data.iov_size = 0;
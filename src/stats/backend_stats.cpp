@@ -53,6 +53,8 @@ Statistics::BackendInfo::BackendInfo() {
   established_conn = 0;
   total_connections = 0;
   pending_connections = 0;
+  fast_open_hits = 0;
+  fast_open_misses = 0;
   max_response_time = -1;
   avg_response_time = -1;
   min_response_time = -1;
@@ -84,6 +86,13 @@ void Statistics::BackendInfo::increaseConnTimeoutAlive() { pending_connections++
 
 void Statistics::BackendInfo::decreaseConnTimeoutAlive() { pending_connections--; }
 
+void Statistics::BackendInfo::increaseFastOpen(bool hit) {
+  if (hit)
+    fast_open_hits++;
+  else
+    fast_open_misses++;
+}
+
 int Statistics::BackendInfo::getPendingConn() { return pending_connections; }
 
 int Statistics::BackendInfo::getAssignedConn() { return total_connections; }
@@ -44,6 +44,9 @@ class BackendInfo {
   std::atomic<int> established_conn;
   std::atomic<int> total_connections;
   std::atomic<int> pending_connections;
+  /* TCP Fast Open connects whose SYN data was acknowledged or not */
+  std::atomic<int> fast_open_hits;
+  std::atomic<int> fast_open_misses;
   // TODO: TRANSFERENCIA BYTES/SEC (NO HACER)
   // TODO: WRITE/READ TIME (TIEMPO COMPLETO)
  public:
@@ -72,6 +75,8 @@ class BackendInfo {
 
   void decreaseConnTimeoutAlive();
 
+  void increaseFastOpen(bool hit);
+
   int getPendingConn();
 
   int getAssignedConn();
@@ -0,0 +1,190 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "listener_handover.h"
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include "../debug/logger.h"
+
+/* file descriptors sent in a single message */
+#define HANDOVER_MAX_FDS 64
+#define HANDOVER_MAX_KEY 512
+
+ListenerHandover::~ListenerHandover() { clear(); }
+
+std::string ListenerHandover::getKey(const std::string &address, int port) {
+  return address + ':' + std::to_string(port);
+}
+
+void ListenerHandover::add(const std::string &key, int fd) {
+  std::lock_guard<std::mutex> lock(mtx);
+  sockets[key].push_back(fd);
+}
+
+int ListenerHandover::take(const std::string &key) {
+  std::lock_guard<std::mutex> lock(mtx);
+  auto it = sockets.find(key);
+  if (it == sockets.end()) return -1;
+  int fd = it->second.front();
+  it->second.pop_front();
+  if (it->second.empty()) sockets.erase(it);
+  return fd;
+}
+
+size_t ListenerHandover::size() const {
+  std::lock_guard<std::mutex> lock(mtx);
+  size_t count = 0;
+  for (auto &entry : sockets) count += entry.second.size();
+  return count;
+}
+
+void ListenerHandover::clear() {
+  std::lock_guard<std::mutex> lock(mtx);
+  for (auto &entry : sockets)
+    for (int fd : entry.second) ::close(fd);
+  sockets.clear();
+}
+
+bool ListenerHandover::send(int peer_fd) const {
+  std::lock_guard<std::mutex> lock(mtx);
+  for (auto &entry : sockets) {
+    auto &key = entry.first;
+    std::vector<int> fds(entry.second.begin(), entry.second.end());
+    for (size_t sent = 0; sent < fds.size(); sent += HANDOVER_MAX_FDS) {
+      size_t count = std::min<size_t>(HANDOVER_MAX_FDS, fds.size() - sent);
+      iovec iov{const_cast<char *>(key.data()), key.size()};
+      alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * HANDOVER_MAX_FDS)];
+      msghdr message{};
+      message.msg_iov = &iov;
+      message.msg_iovlen = 1;
+      message.msg_control = control;
+      message.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+      auto header = CMSG_FIRSTHDR(&message);
+      header->cmsg_level = SOL_SOCKET;
+      header->cmsg_type = SCM_RIGHTS;
+      header->cmsg_len = CMSG_LEN(sizeof(int) * count);
+      std::memcpy(CMSG_DATA(header), fds.data() + sent, sizeof(int) * count);
+      if (::sendmsg(peer_fd, &message, MSG_NOSIGNAL) !=
+          static_cast<ssize_t>(key.size())) {
+        Logger::logmsg(LOG_ERR, "Listener handover send failed: %s",
+                       std::strerror(errno));
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool ListenerHandover::receive(int peer_fd) {
+  while (true) {
+    char key[HANDOVER_MAX_KEY];
+    iovec iov{key, sizeof(key)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * HANDOVER_MAX_FDS)];
+    msghdr message{};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    auto len = ::recvmsg(peer_fd, &message, MSG_CMSG_CLOEXEC);
+    /* the peer closes the socket once all the sockets have been sent */
+    if (len == 0) return true;
+    if (len < 0) {
+      Logger::logmsg(LOG_ERR, "Listener handover receive failed: %s",
+                     std::strerror(errno));
+      return false;
+    }
+    std::vector<int> fds;
+    for (auto header = CMSG_FIRSTHDR(&message); header != nullptr;
+         header = CMSG_NXTHDR(&message, header)) {
+      if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+        continue;
+      size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      fds.resize(count);
+      std::memcpy(fds.data(), CMSG_DATA(header), sizeof(int) * count);
+    }
+    if ((message.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) != 0 || fds.empty()) {
+      for (int fd : fds) ::close(fd);
+      Logger::logmsg(LOG_ERR, "Listener handover message not valid");
+      return false;
+    }
+    std::string name(key, static_cast<size_t>(len));
+    for (int fd : fds) add(name, fd);
+  }
+}
+
+bool ListenerHandover::receive(const std::string &path) {
+  sockaddr_un address{};
+  if (path.size() >= sizeof(address.sun_path)) return false;
+  address.sun_family = AF_UNIX;
+  std::memcpy(address.sun_path, path.data(), path.size());
+  int fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (fd < 0) return false;
+  timeval timeout{LISTENER_HANDOVER_TIMEOUT / 1000,
+                  (LISTENER_HANDOVER_TIMEOUT % 1000) * 1000};
+  ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  bool result =
+      ::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) ==
+          0 &&
+      isTrustedPeer(fd) && receive(fd);
+  ::close(fd);
+  return result;
+}
+
+int ListenerHandover::listen(const std::string &path) {
+  sockaddr_un address{};
+  if (path.size() >= sizeof(address.sun_path)) return -1;
+  address.sun_family = AF_UNIX;
+  std::memcpy(address.sun_path, path.data(), path.size());
+  int fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) return -1;
+  ::unlink(path.data());
+  /* the mode is set before listen(), nobody can connect while it is the
+   * default one */
+  if (::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) <
+          0 ||
+      ::chmod(path.data(), S_IRUSR | S_IWUSR) < 0 || ::listen(fd, 1) < 0) {
+    Logger::logmsg(LOG_ERR, "Listener handover socket %s failed: %s",
+                   path.data(), std::strerror(errno));
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool ListenerHandover::isTrustedPeer(int peer_fd) {
+  ucred credentials{};
+  socklen_t len = sizeof(credentials);
+  if (::getsockopt(peer_fd, SOL_SOCKET, SO_PEERCRED, &credentials, &len) < 0) {
+    Logger::logmsg(LOG_ERR, "Listener handover peer credentials failed: %s",
+                   std::strerror(errno));
+    return false;
+  }
+  if (credentials.uid == ::geteuid() || credentials.uid == 0) return true;
+  Logger::logmsg(LOG_WARNING,
+                 "Listener handover refused to pid %d of uid %u",
+                 credentials.pid, credentials.uid);
+  return false;
+}
@@ -0,0 +1,107 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/** Milliseconds a new process waits for the listening sockets. */
+#ifndef LISTENER_HANDOVER_TIMEOUT
+#define LISTENER_HANDOVER_TIMEOUT 5000
+#endif
+
+/**
+ * @class ListenerHandover listener_handover.h "src/stream/listener_handover.h"
+ * @brief Listening sockets passed from the old listeners to the new ones.
+ *
+ * The sockets are kept by the address and port they are bound to. On a
+ * reload the new listener bound to the same address takes the socket of the
+ * previous one instead of binding a new socket, so the connections queued in
+ * its backlog are not reset and there is no time with the port closed. The
+ * sockets can also be sent to a new zproxy process over a unix socket with
+ * SCM_RIGHTS, each message carrying a key and its sockets.
+ */
+class ListenerHandover {
+  mutable std::mutex mtx;
+  std::unordered_map<std::string, std::deque<int>> sockets;
+
+ public:
+  ListenerHandover() = default;
+  ~ListenerHandover();
+  ListenerHandover(const ListenerHandover &) = delete;
+  ListenerHandover &operator=(const ListenerHandover &) = delete;
+
+  /** @return the key of the sockets bound to @p address and @p port. */
+  static std::string getKey(const std::string &address, int port);
+
+  /** @brief Keeps the listening socket @p fd, it is owned by the handover. */
+  void add(const std::string &key, int fd);
+
+  /**
+   * @brief Takes a socket of @p key, in the order they were added.
+   * @return the socket, -1 if there is none left.
+   */
+  int take(const std::string &key);
+
+  /** @return the number of sockets kept. */
+  size_t size() const;
+
+  /** @brief Closes the sockets that no listener has taken. */
+  void clear();
+
+  /**
+   * @brief Sends a copy of the sockets kept through the unix socket
+   * @p peer_fd, they are still owned by the handover.
+   * @return @c false if any message could not be sent.
+   */
+  bool send(int peer_fd) const;
+
+  /**
+   * @brief Adds the sockets received through the unix socket @p peer_fd
+   * until the peer closes it.
+   * @return @c false if the messages were not valid or could not be read.
+   */
+  bool receive(int peer_fd);
+
+  /**
+   * @brief Receives the sockets of the process listening on the unix socket
+   * @p path, if it is a trusted peer.
+   * @return @c false if there is no process listening or it failed.
+   */
+  bool receive(const std::string &path);
+
+  /**
+   * @brief Creates the unix socket @p path the next process connects to for
+   * the sockets, a previous one is replaced. Only its owner can connect to
+   * it, its mode is 0600.
+   * @return the socket, -1 if it fails.
+   */
+  static int listen(const std::string &path);
+
+  /**
+   * @return @c true if the process at the other end of the unix socket
+   * @p peer_fd runs as the same user as this one or as root.
+   */
+  static bool isTrustedPeer(int peer_fd);
+};
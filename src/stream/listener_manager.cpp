@@ -24,6 +24,7 @@
 #include <memory>
 #include "../config/global.h"
 #include "../ssl/ssl_session.h"
+#include "../util/cpu_topology.h"
 #ifdef ENABLE_HEAP_PROFILE
 #include <gperftools/heap-profiler.h>
 #endif
@@ -60,6 +61,13 @@ void ListenerManager::HandleEvent(int fd, EVENT_TYPE event_type,
       updateFd(ssl_maintenance_timer.getFileDescriptor(),
                EVENT_TYPE::READ_ONESHOT, EVENT_GROUP::MAINTENANCE);
     }
+    if (fd == resolver.getFileDescriptor()) {
+      resolver.onReadEvent();
+      updateResolver();
+    }
+    if (fd == resolver_timer.getFileDescriptor()) updateResolver();
+    if (fd == handover_fd) handOverListeners();
+    if (fd == drain_timer.getFileDescriptor()) checkDrain();
 #if MALLOC_TRIM_TIMER
     if (fd == timer_internal_maintenance.getFileDescriptor()) {
       // release memory back to the system
@@ -70,6 +78,9 @@ void ListenerManager::HandleEvent(int fd, EVENT_TYPE event_type,
     }
 #endif
     return;
+  } else if (event_group == EVENT_GROUP::MAILBOX) {
+    mailbox.drain();
+    return;
   } else if (event_group == EVENT_GROUP::SIGNAL &&
              fd == signal_fd.getFileDescriptor()) {
     Logger::logmsg(LOG_DEBUG, "Received singal %x", signal_fd.getSignal());
@@ -129,6 +140,85 @@ std::string ListenerManager::handleTask(ctl::CtlTask &task) {
       root->emplace("backend_count",
                     std::make_unique<JsonDataValue>(backend_count));
 
+      auto workers = std::make_unique<JsonArray>();
+      for (auto &[sm_id, sm] : stream_manager_set) {
+        auto worker = std::make_unique<JsonObject>();
+        worker->emplace("id",
+                        std::make_unique<JsonDataValue>(sm->getWorkerId()));
+        worker->emplace("cpu",
+                        std::make_unique<JsonDataValue>(sm->getWorkerCpu()));
+        worker->emplace("numa_node",
+                        std::make_unique<JsonDataValue>(sm->getNumaNode()));
+        worker->emplace("accepted", std::make_unique<JsonDataValue>(static_cast<long>(
+                                        sm->getAcceptedConnections())));
+        worker->emplace("accept_failed", std::make_unique<JsonDataValue>(static_cast<long>(
+                                             sm->getAcceptFailures())));
+        auto buffer_pool = std::make_unique<JsonArray>();
+        auto &pool = sm->getBufferPool();
+        for (size_t i = 0; i < BufferPool::CLASS_COUNT; i++) {
+          auto &stats = pool.getStats(i);
+          auto size_class = std::make_unique<JsonObject>();
+          size_class->emplace("size", std::make_unique<JsonDataValue>(
+                                          static_cast<long>(BufferPool::CLASS_SIZES[i])));
+          size_class->emplace("hits", std::make_unique<JsonDataValue>(
+                                          static_cast<long>(stats.hits.load())));
+          size_class->emplace("misses", std::make_unique<JsonDataValue>(
+                                            static_cast<long>(stats.misses.load())));
+          size_class->emplace("in_use", std::make_unique<JsonDataValue>(
+                                            static_cast<long>(stats.in_use.load())));
+          size_class->emplace("cached", std::make_unique<JsonDataValue>(
+                                            static_cast<long>(stats.cached.load())));
+          size_class->emplace("deferred", std::make_unique<JsonDataValue>(
+                                              static_cast<long>(stats.deferred.load())));
+          buffer_pool->emplace_back(std::move(size_class));
+        }
+        worker->emplace("buffer_pool", std::move(buffer_pool));
+        auto &pipe_stats = sm->getPipePool().getStats();
+        auto pipe_pool = std::make_unique<JsonObject>();
+        pipe_pool->emplace("pipe_size", std::make_unique<JsonDataValue>(
+                                            static_cast<long>(pipe_stats.pipe_size.load())));
+        pipe_pool->emplace("hits", std::make_unique<JsonDataValue>(
+                                       static_cast<long>(pipe_stats.hits.load())));
+        pipe_pool->emplace("misses", std::make_unique<JsonDataValue>(
+                                         static_cast<long>(pipe_stats.misses.load())));
+        pipe_pool->emplace("discarded", std::make_unique<JsonDataValue>(
+                                            static_cast<long>(pipe_stats.discarded.load())));
+        pipe_pool->emplace("in_use", std::make_unique<JsonDataValue>(
+                                         static_cast<long>(pipe_stats.in_use.load())));
+        pipe_pool->emplace("cached", std::make_unique<JsonDataValue>(
+                                         static_cast<long>(pipe_stats.cached.load())));
+        worker->emplace("pipe_pool", std::move(pipe_pool));
+        auto &conn_stats = sm->getConnectionPool().getStats();
+        auto connection_pool = std::make_unique<JsonObject>();
+        auto checkouts = conn_stats.hits.load() + conn_stats.misses.load();
+        connection_pool->emplace("hits", std::make_unique<JsonDataValue>(
+                                             static_cast<long>(conn_stats.hits.load())));
+        connection_pool->emplace("misses", std::make_unique<JsonDataValue>(
+                                               static_cast<long>(conn_stats.misses.load())));
+        connection_pool->emplace(
+            "reuse_ratio",
+            std::make_unique<JsonDataValue>(
+                checkouts > 0 ? static_cast<double>(conn_stats.hits.load()) / checkouts : 0.0));
+        connection_pool->emplace("released", std::make_unique<JsonDataValue>(
+                                                 static_cast<long>(conn_stats.released.load())));
+        connection_pool->emplace("expired", std::make_unique<JsonDataValue>(
+                                                static_cast<long>(conn_stats.expired.load())));
+        connection_pool->emplace("closed", std::make_unique<JsonDataValue>(
+                                               static_cast<long>(conn_stats.closed.load())));
+        connection_pool->emplace("discarded", std::make_unique<JsonDataValue>(
+                                                  static_cast<long>(conn_stats.discarded.load())));
+        connection_pool->emplace("warmed", std::make_unique<JsonDataValue>(
+                                               static_cast<long>(conn_stats.warmed.load())));
+        connection_pool->emplace("idle", std::make_unique<JsonDataValue>(
+                                             static_cast<long>(conn_stats.idle.load())));
+        worker->emplace("connection_pool", std::move(connection_pool));
+        workers->emplace_back(std::move(worker));
+      }
+      root->emplace("worker_affinity",
+                    std::make_unique<JsonDataValue>(
+                        global::run_options::getCurrent().worker_affinity));
+      root->emplace("workers", std::move(workers));
+
 #if DEBUG_STREAM_EVENTS_COUNT
 
       clients_stats->emplace("on_client_connect",
@@ -299,9 +389,48 @@ bool ListenerManager::isHandler(ctl::CtlTask &task) {
           task.target == ctl::CTL_HANDLER_TYPE::ALL);
 }
 
+bool ListenerManager::postTask(std::function<void()> task) {
+  return mailbox.post(std::move(task));
+}
+
+void ListenerManager::runInWorkers(
+    const std::function<void(StreamManager *)> &task, bool in_order) {
+  std::vector<std::future<void>> pending;
+  for (auto &[sm_id, sm] : stream_manager_set) {
+    if (sm == nullptr) continue;
+    auto job = std::make_shared<std::packaged_task<void()>>(
+        [&task, sm = sm] { task(sm); });
+    pending.push_back(job->get_future());
+    if (!sm->postTask([job] { (*job)(); })) (*job)();
+    if (in_order) pending.back().wait();
+  }
+  for (auto &result : pending) result.wait();
+}
+
 ListenerManager::ListenerManager() : is_running(false), stream_manager_set() {}
 
+void ListenerManager::resolveBackends() {
+  for (auto &[sm_id, sm] : ServiceManager::getInstance()) {
+    if (sm == nullptr || sm->disabled) continue;
+    for (auto service : sm->getServices())
+      for (auto &host : service->getBackendHosts()) resolver.watch(host);
+  }
+  updateResolver();
+}
+
+void ListenerManager::updateResolver() {
+  if (resolver.getFileDescriptor() < 0) return;
+  auto timeout = resolver.doWork();
+  if (timeout < 0)
+    resolver_timer.unset();
+  else
+    resolver_timer.set(timeout > 0 ? timeout : 1);
+  updateFd(resolver_timer.getFileDescriptor(), EVENT_TYPE::READ_ONESHOT,
+           EVENT_GROUP::MAINTENANCE);
+}
+
 ListenerManager::~ListenerManager() {
+  Service::setHostWatcher(nullptr);
   ctl::ControlManager::getInstance()->deAttach(std::ref(*this));
   is_running = false;
   for (auto &sm : stream_manager_set) {
@@ -321,12 +450,15 @@ void ListenerManager::doWork() {
       //      Logger::LogInfo("No event received");
     }
   }
+  mailbox.close();
   Logger::logmsg(LOG_REMOVE, "Exiting loop");
 }
 
 void ListenerManager::stop() {
+  Service::setHostWatcher(nullptr);
   is_running = false;
   if (worker_thread.joinable()) worker_thread.join();
+  mailbox.close();
   ctl::ControlManager::getInstance()->deAttach(std::ref(*this));
 }
 
@@ -346,13 +478,31 @@ void ListenerManager::start() {
   HeapProfilerStart("/tmp/zproxy");
 #endif
   is_running = true;
+  auto affinity_cpus = helper::CpuTopology::getWorkerCpus(
+      global::run_options::getCurrent().worker_affinity);
+  if (affinity_cpus.empty() &&
+      global::run_options::getCurrent().worker_affinity != "none")
+    Logger::logmsg(LOG_WARNING, "WorkerAffinity %s has no usable cpu",
+                   global::run_options::getCurrent().worker_affinity.data());
+  std::vector<int> worker_cpus(stream_manager_set.size(), -1);
+  for (size_t i = 0; i < worker_cpus.size() && !affinity_cpus.empty(); i++)
+    worker_cpus[i] = affinity_cpus[i % affinity_cpus.size()];
+  auto &handover_name = global::run_options::getCurrent().handover_name;
+  if (!handover_name.empty() && handover.receive(handover_name))
+    Logger::logmsg(LOG_NOTICE, "Received %lu listening sockets from %s",
+                   handover.size(), handover_name.data());
   for (size_t i = 0; i < stream_manager_set.size(); i++) {
     auto sm = stream_manager_set[i];
     if (sm != nullptr) {
-      sm->start(i);
+      sm->start(i, worker_cpus[i], &handover);
     }
   }
+  adoptListeners();
+  if (!handover_name.empty() &&
+      (handover_fd = ListenerHandover::listen(handover_name)) > 0)
+    addFd(handover_fd, EVENT_TYPE::READ, EVENT_GROUP::MAINTENANCE);
   //  signal_fd.init();
+  mailbox.enableEvents(this, EVENT_TYPE::READ, EVENT_GROUP::MAILBOX);
   auto alive_to = global::run_options::getCurrent().backend_resurrect_timeout;
   timer_maintenance.set(
       (alive_to > 0 ? alive_to : DEFAULT_MAINTENANCE_INTERVAL) * 1000);
@@ -368,12 +518,106 @@ void ListenerManager::start() {
   addFd(timer_internal_maintenance.getFileDescriptor(),
         EVENT_TYPE::READ_ONESHOT, EVENT_GROUP::MAINTENANCE);
 #endif
+  if (resolver.init()) {
+    resolver.setCallback([](const std::string &host,
+                            const std::vector<sockaddr_storage> &addresses) {
+      bool used = false;
+      for (auto &[sm_id, sm] : ServiceManager::getInstance()) {
+        if (sm == nullptr || sm->disabled) continue;
+        for (auto service : sm->getServices())
+          used = service->setBackendAddresses(host, addresses) || used;
+      }
+      return used;
+    });
+    addFd(resolver.getFileDescriptor(), EVENT_TYPE::READ,
+          EVENT_GROUP::MAINTENANCE);
+    addFd(resolver_timer.getFileDescriptor(), EVENT_TYPE::READ_ONESHOT,
+          EVENT_GROUP::MAINTENANCE);
+    resolveBackends();
+    /* the backends added by the control thread */
+    Service::setHostWatcher([this](const std::string &host) {
+      postTask([this, host] {
+        resolver.watch(host);
+        updateResolver();
+      });
+    });
+  } else {
+    Logger::logmsg(LOG_ERR, "No nameserver available, back-end host names "
+                            "are not resolved");
+  }
   //  helper::ThreadHelper::setThreadAffinity(
   //      0, pthread_self());  // worker_thread.native_handle());
   helper::ThreadHelper::setThreadName("LISTENER", pthread_self());
   doWork();
 }
 
+void ListenerManager::adoptListeners() {
+  /* a previous process with more workers had more sockets in the
+   * SO_REUSEPORT group, the connections queued in them are accepted too */
+  size_t worker = 0;
+  for (auto &[svm_id, svm] : ServiceManager::getInstance()) {
+    if (svm == nullptr || svm->disabled) continue;
+    auto key = ListenerHandover::getKey(svm->listener_config_->address,
+                                        svm->listener_config_->port);
+    for (int fd; (fd = handover.take(key)) >= 0; worker++) {
+      auto sm = stream_manager_set[worker % stream_manager_set.size()];
+      std::weak_ptr<ServiceManager> listener = svm;
+      if (!sm->postTask([sm, listener, fd] {
+            if (!sm->registerListenerSocket(listener, fd)) ::close(fd);
+          }))
+        ::close(fd);
+    }
+  }
+  handover.clear();
+}
+
+void ListenerManager::handOverListeners() {
+  int peer_fd = ::accept4(handover_fd, nullptr, nullptr, SOCK_CLOEXEC);
+  if (peer_fd < 0) return;
+  if (!ListenerHandover::isTrustedPeer(peer_fd)) {
+    ::close(peer_fd);
+    return;
+  }
+  ListenerHandover copies;
+  runInWorkers([&copies](StreamManager *sm) { sm->copyListeners(copies); },
+               true);
+  bool sent = copies.send(peer_fd);
+  ::close(peer_fd);
+  if (!sent) return;
+  Logger::logmsg(LOG_NOTICE,
+                 "Listening sockets handed over, draining %d connections",
+                 Counter<HttpStream>::count.load());
+  deleteFd(handover_fd);
+  ::close(handover_fd);
+  handover_fd = -1;
+  for (auto &[svm_id, svm] : ServiceManager::getInstance()) {
+    if (svm == nullptr || svm->disabled) continue;
+    svm->disabled = true;
+    int listener_id = svm->id;
+    runInWorkers(
+        [listener_id](StreamManager *sm) { sm->stopListener(listener_id); });
+  }
+  drain_deadline = std::chrono::steady_clock::now() +
+                   std::chrono::seconds(
+                       global::run_options::getCurrent().grace_time);
+  drain_timer.set(1000);
+  addFd(drain_timer.getFileDescriptor(), EVENT_TYPE::READ_ONESHOT,
+        EVENT_GROUP::MAINTENANCE);
+}
+
+void ListenerManager::checkDrain() {
+  auto streams = Counter<HttpStream>::count.load();
+  if (streams > 0 && std::chrono::steady_clock::now() < drain_deadline) {
+    drain_timer.set(1000);
+    updateFd(drain_timer.getFileDescriptor(), EVENT_TYPE::READ_ONESHOT,
+             EVENT_GROUP::MAINTENANCE);
+    return;
+  }
+  Logger::logmsg(LOG_NOTICE, "Exiting after the handover, %d connections left",
+                 streams);
+  is_running = false;
+}
+
 StreamManager *ListenerManager::getManager(int fd) {
   static unsigned long c;
   ++c;
@@ -415,37 +659,39 @@ bool ListenerManager::reloadConfigFile() {
   for (auto it = sm_set.begin(); it != sm_set.end();) {
     // stop the listener in all stream workers
     it->second->disabled = true;
-    for (auto &[sm_id, sm] : stream_manager_set) {
-      sm->stopListener((it->second)->id);
-    }
+    int listener_id = it->second->id;
+    runInWorkers(
+        [this, listener_id](StreamManager *sm) {
+          sm->stopListener(listener_id, false, &handover);
+        },
+        true);
     // remove Listener from StreamManager set
     sm_set[(it->second)->id] = nullptr;
     it = sm_set.erase(it);
   }
-  // create new instances with new configuration, connections may be lost during
-  // this switch
+  // create new instances with new configuration, the listeners bound to the
+  // same address take the sockets of the old ones with their queued
+  // connections
   for (auto lc = config.listeners; lc != nullptr; lc = lc->next) {
     if (lc->disabled) continue;
     auto listener_config = std::shared_ptr<ListenerConfig>(lc);
     this->addListener(listener_config);
   }
 
-  for (size_t i = 0; i < stream_manager_set.size(); i++) {
-    auto sm = stream_manager_set[i];
-    if (sm != nullptr) {
-      for (auto &[svm_id, svm] : ServiceManager::getInstance()) {
-        if (svm->disabled) continue;
-        if (!sm->registerListener(svm)) {
-          Logger::logmsg(LOG_ERR,
-                         "Error initializing StreamManager for farm %s",
-                         svm->listener_config_->name.data());
-          return false;
-        }
+  std::atomic<bool> registered{true};
+  runInWorkers([this, &registered](StreamManager *sm) {
+    for (auto &[svm_id, svm] : ServiceManager::getInstance()) {
+      if (svm->disabled) continue;
+      if (!sm->registerListener(svm, &handover)) {
+        Logger::logmsg(LOG_ERR, "Error initializing StreamManager for farm %s",
+                       svm->listener_config_->name.data());
+        registered = false;
+        return;
       }
-    } else {
-      Logger::logmsg(LOG_ERR, "StreamManager id: %d doesn't exist  ", i);
     }
-  }
+  }, true);
+  adoptListeners();
+  if (!registered) return false;
   // update maintenance timeouts
   this->deleteFd(timer_maintenance.getFileDescriptor());
   global::run_options::getCurrent().backend_resurrect_timeout = config.alive_to;
@@ -454,5 +700,6 @@ bool ListenerManager::reloadConfigFile() {
       1000);
   addFd(timer_maintenance.getFileDescriptor(), EVENT_TYPE::READ_ONESHOT,
         EVENT_GROUP::MAINTENANCE);
+  resolveBackends();
   return true;
 }
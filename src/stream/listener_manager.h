@@ -23,8 +23,11 @@
 
 #include "../ctl/ctl.h"
 #include "../ctl/observer.h"
+#include "../event/dns_resolver.h"
 #include "../event/epoll_manager.h"
+#include "../event/mailbox.h"
 #include "../event/signal_fd.h"
+#include "../event/timer_fd.h"
 #include "stream_manager.h"
 #include <thread>
 #include <vector>
@@ -43,7 +46,8 @@
  * attached to it.
  *
  */
-class ListenerManager : public EpollManager, public CtlObserver<ctl::CtlTask, std::string> {
+class ListenerManager : public EpollManager<ListenerManager>,
+                        public CtlObserver<ctl::CtlTask, std::string> {
   std::thread worker_thread;
   std::atomic<bool> is_running;
   std::map<int, StreamManager *> stream_manager_set;
@@ -54,8 +58,46 @@ class ListenerManager : public EpollManager, public CtlObserver<ctl::CtlTask, st
   TimerFd timer_internal_maintenance;
 #endif
   SignalFd signal_fd;
+  /** Resolves the back-end host names, refreshed on the TTL of the records. */
+  events::DnsResolver resolver;
+  TimerFd resolver_timer;
+  /** Control tasks posted by other threads to run in the listener loop. */
+  events::Mailbox mailbox;
+  /** Listening sockets passed from the previous listeners or process. */
+  ListenerHandover handover;
+  /** HandoverSocket the next process gets the listening sockets from. */
+  int handover_fd{-1};
+  /** Checks the connections left once the listeners have been handed over. */
+  TimerFd drain_timer;
+  std::chrono::steady_clock::time_point drain_deadline;
   void doWork();
   StreamManager *getManager(int fd);
+  /** @brief Resolves the Address of all the backends. */
+  void resolveBackends();
+  /** @brief Runs the resolver pending work and sets its timer for the next. */
+  void updateResolver();
+  /**
+   * @brief Distributes among the workers the listening sockets handed over
+   * that no worker has taken and closes the ones of the listeners removed.
+   */
+  void adoptListeners();
+  /**
+   * @brief Sends the listening sockets to the process connected to the
+   * HandoverSocket, then stops accepting and drains the connections.
+   */
+  void handOverListeners();
+  /**
+   * @brief Stops the loop once the connections have been drained or the
+   * Grace time has expired.
+   */
+  void checkDrain();
+  /**
+   * @brief Runs @p task in every StreamManager worker thread and waits until
+   * all of them have finished it.
+   * @param in_order runs it in one worker after the other, by worker id.
+   */
+  void runInWorkers(const std::function<void(StreamManager *)> &task,
+                    bool in_order = false);
 
  public:
   ListenerManager();
@@ -93,7 +135,8 @@ class ListenerManager : public EpollManager, public CtlObserver<ctl::CtlTask, st
    * @param event_type is the type of the event.
    * @param event_group is the group of the event.
    */
-  void HandleEvent(int fd, EVENT_TYPE event_type, EVENT_GROUP event_group) override;
+  friend class EpollManager<ListenerManager>;
+  void HandleEvent(int fd, EVENT_TYPE event_type, EVENT_GROUP event_group);
 
   /**
    * @brief This function handles the tasks received with the API format.
@@ -113,6 +156,12 @@ class ListenerManager : public EpollManager, public CtlObserver<ctl::CtlTask, st
    * @return true if should handle the task, false if not.
    */
   bool isHandler(ctl::CtlTask &task) override;
+
+  /**
+   * @brief Queues @p task to be run by the listener loop.
+   * @return @c false if the loop is not running.
+   */
+  bool postTask(std::function<void()> task) override;
   /**
  * @brief Reload the listeners config from the current loaded configuration file.
  *
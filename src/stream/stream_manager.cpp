@@ -20,9 +20,12 @@
  */
 
 #include "stream_manager.h"
+#include <fcntl.h>
+#include <algorithm>
 #include <cstdio>
 #include <thread>
 #include "../handlers/https_manager.h"
+#include "../util/cpu_topology.h"
 #include "../util/network.h"
 #include "stream_data_logger.h"
 
@@ -35,11 +38,11 @@ void StreamManager::HandleEvent(int fd, EVENT_TYPE event_type,
                                 EVENT_GROUP event_group) {
   switch (event_type) {
     case READ_ONESHOT: {
-      HttpStream* stream = streams_set[fd];
+      HttpStream* stream = streams_set.get(fd);
       if (stream == nullptr) {
         stream = new HttpStream();
         stream->client_connection.setFileDescriptor(fd);
-        streams_set[fd] = stream;
+        streams_set.set(fd, stream);
       }
       auto connection = stream->getConnection(fd);
       connection->read();
@@ -51,11 +54,11 @@ void StreamManager::HandleEvent(int fd, EVENT_TYPE event_type,
     }
 
     case READ: {
-      HttpStream* stream = streams_set[fd];
+      HttpStream* stream = streams_set.get(fd);
       if (stream == nullptr) {
         stream = new HttpStream();
         stream->client_connection.setFileDescriptor(fd);
-        streams_set[fd] = stream;
+        streams_set.set(fd, stream);
       }
       auto connection = stream->getConnection(fd);
       connection->read();
@@ -64,7 +67,7 @@ void StreamManager::HandleEvent(int fd, EVENT_TYPE event_type,
     }
 
     case WRITE: {
-      auto stream = streams_set[fd];
+      auto stream = streams_set.get(fd);
       if (stream == nullptr) {
         Logger::LogInfo("Connection closed prematurely" + std::to_string(fd));
         return;
@@ -98,11 +101,10 @@ void StreamManager::HandleEvent(int fd, EVENT_TYPE event_type,
     case ACCEPT:
       break;
     case DISCONNECT: {
-      auto stream = streams_set[fd];
+      auto stream = streams_set.get(fd);
       if (stream == nullptr) {
         Logger::LogInfo("Stream doesn't exist for " + std::to_string(fd));
         deleteFd(fd);
-        ::close(fd);
         return;
       }
       /*      streams_set.erase(fd);
@@ -116,29 +118,27 @@ void StreamManager::HandleEvent(int fd, EVENT_TYPE event_type,
 #else
 void StreamManager::HandleEvent(int fd, EVENT_TYPE event_type,
                                 EVENT_GROUP event_group) {
+  if (event_group == EVENT_GROUP::POOL) {
+    onWarmUpEvent(fd, event_type);
+    return;
+  }
   switch (event_type) {
 #if SM_HANDLE_ACCEPT
     case EVENT_TYPE::CONNECT: {
       DEBUG_COUNTER_HIT(debug__::event_connect);
-      auto spt = service_manager_set[fd].lock();
-      if (!spt) {
+      /* the socket of a stopped listener may be owned by a new one */
+      auto listener = service_manager_set.find(fd);
+      if (listener == service_manager_set.end()) return;
+      if (listener->second.expired()) {
         deleteFd(fd);  // remove listener from epoll manager.
         ::close(fd);   // we close the listening socket
+        service_manager_set.erase(listener);
         return;
       }
-      int new_fd;
-#ifndef EPOLLEXCLUSIVE
-      do {
-#endif
-        new_fd = Connection::doAccept(fd);
-        if (new_fd > 0) {
-          addStream(new_fd, std::move(spt));
-        } else {
-          DEBUG_COUNTER_HIT(debug__::event_connect_fail);
-        }
-#ifndef EPOLLEXCLUSIVE
-      } while (new_fd > 0);
-#endif
+      /* accepted after the events, round robin with the other listeners */
+      if (std::find(ready_listeners.begin(), ready_listeners.end(), fd) ==
+          ready_listeners.end())
+        ready_listeners.push_back(fd);
       return;
     }
 #endif
@@ -157,20 +157,14 @@ void StreamManager::HandleEvent(int fd, EVENT_TYPE event_type,
           onRequestEvent(fd);
           break;
         }
-        case EVENT_GROUP::CONNECT_TIMEOUT:
-          onConnectTimeoutEvent(fd);
-          break;
-        case EVENT_GROUP::REQUEST_TIMEOUT:
-          onRequestTimeoutEvent(fd);
-          break;
-        case EVENT_GROUP::RESPONSE_TIMEOUT:
-          onResponseTimeoutEvent(fd);
-          break;
         case EVENT_GROUP::SIGNAL:
           onSignalEvent(fd);
           break;
         case EVENT_GROUP::MAINTENANCE:
           break;
+        case EVENT_GROUP::MAILBOX:
+          mailbox.drain();
+          break;
         default:
           deleteFd(fd);
           close(fd);
@@ -179,7 +173,7 @@ void StreamManager::HandleEvent(int fd, EVENT_TYPE event_type,
       return;
     }
     case EVENT_TYPE::WRITE: {
-      auto stream = streams_set[fd];
+      auto stream = streams_set.get(fd);
       if (stream == nullptr) {
         switch (event_group) {
           case EVENT_GROUP::ACCEPTOR:
@@ -195,8 +189,8 @@ void StreamManager::HandleEvent(int fd, EVENT_TYPE event_type,
           default:
             break;
         }
+        /* the fd is not ours anymore, it may already be reused */
         deleteFd(fd);
-        ::close(fd);
         return;
       }
 
@@ -222,14 +216,13 @@ void StreamManager::HandleEvent(int fd, EVENT_TYPE event_type,
       return;
     }
     case EVENT_TYPE::DISCONNECT: {
-      auto stream = streams_set[fd];
+      auto stream = streams_set.get(fd);
       if (stream == nullptr) {
         char addr[150];
         Network::getPeerAddress(fd, addr, 150);
         Logger::logmsg(LOG_DEBUG,
                        "Remote host %s closed connection prematurely ", addr);
         deleteFd(fd);
-        ::close(fd);
         return;
       }
       switch (event_group) {
@@ -256,33 +249,84 @@ void StreamManager::HandleEvent(int fd, EVENT_TYPE event_type,
 }
 #endif
 
+bool StreamManager::onErrorEvent(int fd, EVENT_GROUP event_group,
+                                 uint32_t event_mask) {
+  if (event_group != EVENT_GROUP::CLIENT) return false;
+  auto stream = streams_set.get(fd);
+  if (stream == nullptr) return false;
+  auto& connection = stream->client_connection;
+  if (!connection.zerocopy.hasPending() ||
+      !connection.zerocopy.readCompletions(fd) || !Network::isConnected(fd))
+    return false;
+  /* the error has consumed the one shot write interest */
+  if ((event_mask & EPOLLOUT) == 0u &&
+      connection.getCurrentEvent() == EVENT_TYPE::WRITE)
+    connection.enableWriteEvent();
+  return true;
+}
+
 void StreamManager::stop() {
   is_running = false;
   if (this->worker.joinable()) this->worker.join();
+  // a worker that never started leaves its tasks to the stopping thread
+  mailbox.close();
 }
 
-void StreamManager::start(int thread_id_) {
+void StreamManager::start(int thread_id_, int cpu,
+                          ListenerHandover* handover) {
   ctl::ControlManager::getInstance()->attach(std::ref(*this));
 
   is_running = true;
   worker_id = thread_id_;
+  accept_budget = global::run_options::getCurrent().accept_budget;
+  // the listeners registered below are steered to this cpu
+  if (cpu >= 0) {
+    worker_cpu = cpu;
+    numa_node = helper::CpuTopology::getNumaNode(cpu);
+  }
+  mailbox.enableEvents(this, EVENT_TYPE::READ, EVENT_GROUP::MAILBOX);
 
   for (auto& [sm_id, sm] : ServiceManager::getInstance()) {
     if (sm->disabled) continue;
-    if (!this->registerListener(sm)) {
+    if (!this->registerListener(sm, handover)) {
       Logger::logmsg(LOG_ERR, "Error initializing StreamManager for farm %s",
                      sm->listener_config_->name.data());
+      is_running = false;
+      mailbox.close();
       return;
     }
   }
 
   this->worker = std::thread([this] {
+    if (worker_cpu >= 0) {
+      // pin before allocating anything so the thread arena is node local
+      if (!helper::ThreadHelper::setThreadAffinity(worker_cpu,
+                                                   pthread_self())) {
+        Logger::logmsg(LOG_WARNING, "Worker %d can not be pinned to cpu %d",
+                       worker_id, worker_cpu.load());
+        worker_cpu = numa_node = -1;
+      } else if (!helper::CpuTopology::setPreferredNode(numa_node)) {
+        Logger::logmsg(LOG_DEBUG, "Worker %d NUMA policy not set: %s",
+                       worker_id, std::strerror(errno));
+      } else {
+        /* the manager, with its event array, and the slots of its stream
+         * table were allocated by the main thread. The streams and the pools
+         * allocate once the worker runs, so they already prefer the node;
+         * the io_uring rings, mapped by the kernel, are not moved */
+        size_t table_size;
+        void *table = streams_set.data(table_size);
+        if (!helper::CpuTopology::moveToNode(this, sizeof(*this), numa_node) ||
+            !helper::CpuTopology::moveToNode(table, table_size, numa_node))
+          Logger::logmsg(LOG_DEBUG, "Worker %d state not moved to node %d: %s",
+                         worker_id, numa_node.load(), std::strerror(errno));
+      }
+    }
+    BufferPool::setLocal(&buffer_pool);
+    PipePool::setLocal(&pipe_pool);
     StreamDataLogger::resetLogData();
     doWork();
   });
   if (worker_id >= 0) {
-    //    helper::ThreadHelper::setThreadAffinity(worker_id,
-    //    worker.native_handle());
     helper::ThreadHelper::setThreadName("WORKER_" + std::to_string(worker_id),
                                         worker.native_handle());
   }
@@ -296,26 +340,131 @@ StreamManager::~StreamManager() {
   ctl::ControlManager::getInstance()->deAttach(std::ref(*this));
   stop();
   if (worker.joinable()) worker.join();
-  for (auto& key_pair : streams_set) {
-    delete key_pair.second;
-  }
+  BufferPool::setLocal(&buffer_pool);
+  PipePool::setLocal(&pipe_pool);
+  streams_set.forEach([](int fd, HttpStream* stream) {
+    if (fd == stream->client_connection.getFileDescriptor()) delete stream;
+  });
+  BufferPool::setLocal(nullptr);
+  PipePool::setLocal(nullptr);
 }
 
 void StreamManager::doWork() {
   while (is_running) {
-    if (loopOnce(EPOLL_WAIT_TIMEOUT) <= 0) {
+    /* the listeners left with pending connections do not wait for events,
+     * the paused ones and the lingering sockets are checked again soon */
+    int max_wait = EPOLL_WAIT_TIMEOUT;
+    if (!paused_listeners.empty()) max_wait = ACCEPT_BACKOFF;
+    if (buffer_pool.lingeringCount() > 0)
+      max_wait = std::min(max_wait, BUFFER_POOL_LINGER_INTERVAL);
+    if (loopOnce(ready_listeners.empty() ? timer_wheel.nextTimeout(max_wait)
+                                         : 0) <= 0) {
       //       something bad happend
     }
+    acceptConnections();
+    onTimerWheelEvent();
+    connection_pool.expire();
+    buffer_pool.reapLingering();
+    warmUpPool();
     // if(needMainatance)
     //    doMaintenance();
   }
+  // run the tasks posted while exiting, their callers may be waiting, and
+  // refuse the later ones so they are run by their callers
+  mailbox.close();
+}
+
+void StreamManager::acceptConnections() {
+  resumeAccept();
+  int budget = accept_budget;
+  size_t next = 0;
+  while (budget > 0 && !ready_listeners.empty()) {
+    if (next >= ready_listeners.size()) next = 0;
+    int listen_fd = ready_listeners[next];
+    /* the listener may have been stopped by a control task meanwhile */
+    auto listener = service_manager_set.find(listen_fd);
+    auto spt = listener != service_manager_set.end() ? listener->second.lock()
+                                                      : nullptr;
+    if (spt == nullptr) {
+      ready_listeners.erase(ready_listeners.begin() + next);
+      continue;
+    }
+    int new_fd = Connection::doAccept(listen_fd);
+    if (new_fd > 0) {
+      accepted_connections.fetch_add(1, std::memory_order_relaxed);
+      addStream(new_fd, std::move(spt));
+      budget--;
+      next++;
+    } else if (new_fd == 0) {
+      /* the accept queue is empty */
+      ready_listeners.erase(ready_listeners.begin() + next);
+    } else {
+      int error = errno;
+      DEBUG_COUNTER_HIT(debug__::event_connect_fail);
+      accept_failures.fetch_add(1, std::memory_order_relaxed);
+      budget--;
+      /* the failed connection is lost, the next ones in the queue are not
+       * but they can not be accepted until some fds are closed */
+      if (error == EMFILE || error == ENFILE)
+        pauseAccept(listen_fd);
+      else
+        next++;
+    }
+  }
+  /* the next loop starts with the listener that was not served */
+  if (next < ready_listeners.size())
+    std::rotate(ready_listeners.begin(), ready_listeners.begin() + next,
+                ready_listeners.end());
+}
+
+void StreamManager::pauseAccept(int listen_fd) {
+  ready_listeners.erase(
+      std::find(ready_listeners.begin(), ready_listeners.end(), listen_fd));
+  /* the listener would be ready again right away */
+  deleteFd(listen_fd);
+  if (paused_listeners.empty())
+    accept_resume_ms = TimerWheel::now() + ACCEPT_BACKOFF;
+  paused_listeners.push_back(listen_fd);
+}
+
+void StreamManager::resumeAccept() {
+  if (paused_listeners.empty() || TimerWheel::now() < accept_resume_ms)
+    return;
+  for (auto listen_fd : paused_listeners) {
+    /* the listener may have been stopped while paused */
+    auto listener = service_manager_set.find(listen_fd);
+    if (listener == service_manager_set.end() || listener->second.expired())
+      continue;
+    addFd(listen_fd, EVENT_TYPE::ACCEPT, EVENT_GROUP::ACCEPTOR);
+  }
+  paused_listeners.clear();
+}
+
+void StreamManager::onTimerWheelEvent() {
+  timer_wheel.advance();
+  while (auto timer = timer_wheel.popExpired()) {
+    auto stream = static_cast<HttpStream*>(timer->data);
+    switch (timer->group) {
+      case EVENT_GROUP::CONNECT_TIMEOUT:
+        onConnectTimeoutEvent(stream);
+        break;
+      case EVENT_GROUP::REQUEST_TIMEOUT:
+        onRequestTimeoutEvent(stream);
+        break;
+      case EVENT_GROUP::RESPONSE_TIMEOUT:
+        onResponseTimeoutEvent(stream);
+        break;
+      default:
+        break;
+    }
+  }
 }
 
 void StreamManager::addStream(int fd,
                               std::shared_ptr<ServiceManager> service_manager) {
   DEBUG_COUNTER_HIT(debug__::on_client_connect);
 #if SM_HANDLE_ACCEPT
-  HttpStream *stream = streams_set[fd];
+  HttpStream *stream = streams_set.get(fd);
 
   if (UNLIKELY(stream != nullptr)) {
     clearStream(stream);
@@ -323,15 +472,16 @@ void StreamManager::addStream(int fd,
   stream = new HttpStream();
   stream->client_connection.setFileDescriptor(fd);
   stream->service_manager = std::move(service_manager);  // TODO::benchmark!!
-  streams_set[fd] = stream;
+  streams_set.set(fd, stream);
   auto& listener_config = *stream->service_manager->listener_config_;
   // update log info
   StreamDataLogger logger(stream, listener_config);
+  if (listener_config.tcp_fast_open > 0 && Network::isSynDataAcked(fd))
+    stream->service_manager->fast_open_hits.fetch_add(
+        1, std::memory_order_relaxed);
 
-  stream->timer_fd.set(listener_config.to * 1000);
-  addFd(stream->timer_fd.getFileDescriptor(), EVENT_TYPE::TIMEOUT,
-        EVENT_GROUP::REQUEST_TIMEOUT);
-  timers_set[stream->timer_fd.getFileDescriptor()] = stream;
+  timer_wheel.arm(stream->timer, EVENT_GROUP::REQUEST_TIMEOUT,
+                  listener_config.to * 1000);
   stream->client_connection.enableEvents(this, EVENT_TYPE::READ,
                                          EVENT_GROUP::CLIENT);
 
@@ -346,6 +496,8 @@ void StreamManager::addStream(int fd,
   if (stream->service_manager->is_https_listener) {
     stream->client_connection.ssl_conn_status = ssl::SSL_STATUS::NEED_HANDSHAKE;
   }
+  stream->client_connection.zerocopy.threshold =
+      static_cast<size_t>(listener_config.zero_copy_send);
 #if WAF_ENABLED
   if (listener_config.rules) {
     stream->waf_rules = listener_config.rules;
@@ -362,7 +514,7 @@ void StreamManager::addStream(int fd,
 int StreamManager::getWorkerId() { return worker_id; }
 
 void StreamManager::onRequestEvent(int fd) {
-  HttpStream* stream = streams_set[fd];
+  HttpStream* stream = streams_set.get(fd);
 
   if (stream != nullptr) {
     if (stream->client_connection.isCancelled()) {
@@ -379,7 +531,7 @@ void StreamManager::onRequestEvent(int fd) {
 #if !SM_HANDLE_ACCEPT
     stream = new HttpStream();
     stream->client_connection.setFileDescriptor(fd);
-    streams_set[fd] = stream;
+    streams_set.set(fd, stream);
     if (fd != stream->client_connection.getFileDescriptor()) {
       Logger::LogInfo("stream connection data inconsistency detected",
                       LOG_DEBUG);
@@ -402,7 +554,9 @@ void StreamManager::onRequestEvent(int fd) {
       stream->request.message_bytes_left);
 #endif
   IO::IO_RESULT result = IO::IO_RESULT::ERROR;
-  if (stream->service_manager->is_https_listener) {
+  if (forwardsBody(stream, stream->client_connection, stream->request)) {
+    result = readBody(stream, stream->client_connection, stream->request);
+  } else if (stream->service_manager->is_https_listener) {
     result =
         ssl::SSLConnectionManager::handleDataRead(stream->client_connection);
   } else {
@@ -458,14 +612,14 @@ void StreamManager::onRequestEvent(int fd) {
     case IO::IO_RESULT::SUCCESS:
     case IO::IO_RESULT::DONE_TRY_AGAIN:
     case IO::IO_RESULT::ZERO_DATA:
-      if (stream->client_connection.buffer_size == 0) {
+      if (stream->client_connection.getBufferedSize() == 0) {
         stream->client_connection.enableReadEvent();
         return;
       }
       break;
     case IO::IO_RESULT::FULL_BUFFER:
     case IO::IO_RESULT::FD_CLOSED:
-      if (stream->client_connection.buffer_size > 0)
+      if (stream->client_connection.getBufferedSize() > 0)
         break;
       else
         return;
@@ -481,14 +635,13 @@ void StreamManager::onRequestEvent(int fd) {
   DEBUG_COUNTER_HIT(debug__::on_request);
   if (stream->upgrade.pinned_connection || stream->request.hasPendingData()) {
 #ifdef CACHE_ENABLED
-    if (stream->request.chunked_status != CHUNKED_STATUS::CHUNKED_DISABLED) {
-      auto pending_chunk_bytes = http_manager::handleChunkedData(
-          stream->client_connection, stream->request);
-      if (pending_chunk_bytes < 0) {  // we don't have enough data to get next
-        // chunk size, so we wait for more data
-        stream->client_connection.enableReadEvent();
-        return;
-      }
+    if (stream->request.chunked_status != CHUNKED_STATUS::CHUNKED_DISABLED &&
+        http_manager::handleChunkedData(stream->client_connection,
+                                        stream->request) < 0) {
+      Logger::logmsg(LOG_INFO, "Client %s sent an invalid chunked body",
+                     stream->client_connection.getPeerAddress().c_str());
+      clearStream(stream);
+      return;
     }
 #endif
 #if PRINT_DEBUG_FLOW_BUFFERS
@@ -514,6 +667,14 @@ void StreamManager::onRequestEvent(int fd) {
       stream->request.message_bytes_left, IO::getResultString(result).data(),
       stream->request.getHeaderSent() ? "true" : "false");
 #endif
+  if (stream->awaiting_response) {
+    /* a pipelined request, it is parsed once the previous response has been
+     * forwarded */
+    if (stream->client_connection.buffer_size <
+        stream->client_connection.buffer_capacity)
+      stream->client_connection.enableReadEvent();
+    return;
+  }
   size_t parsed = 0;
   http_parser::PARSE_RESULT parse_result;
   // do {
@@ -575,9 +736,7 @@ void StreamManager::onRequestEvent(int fd) {
       x_forwarded_for_header += stream->client_connection.getPeerAddress();
       stream->request.addHeader(http::HTTP_HEADER_NAME::X_FORWARDED_FOR,
                                 x_forwarded_for_header);
-      stream->timer_fd.unset();
-      deleteFd(stream->timer_fd.getFileDescriptor());
-      timers_set[stream->timer_fd.getFileDescriptor()] = nullptr;
+      timer_wheel.cancel(stream->timer);
       auto service = stream->service_manager->getService(stream->request);
       if (service == nullptr) {
         http_manager::replyError(
@@ -632,12 +791,14 @@ void StreamManager::onRequestEvent(int fd) {
         static size_t total_request;
         total_request++;
         stream->response.reset_parser();
+        stream->response.reusable = false;
         stream->backend_connection.buffer_offset = 0;
         stream->client_connection.buffer_offset = 0;
         stream->backend_connection.buffer_size = 0;
         switch (bck->backend_type) {
           case BACKEND_TYPE::REMOTE: {
             bool need_new_backend = true;
+            bool pooled = false;
             if (last_service_ptr != nullptr) {
               auto last_service = static_cast<Service*>(last_service_ptr);
               if (last_service->id == service->id &&
@@ -663,8 +824,10 @@ void StreamManager::onRequestEvent(int fd) {
               stream->backend_connection.setBackend(bck);
               stream->backend_connection.time_start =
                   std::chrono::steady_clock::now();
-              op_state = stream->backend_connection.doConnect(
-                  *bck->address_info, bck->conn_timeout);
+              pooled = acquireBackend(stream, *bck);
+              op_state = pooled ? IO::IO_OP::OP_SUCCESS
+                                : bck->connect(stream->backend_connection,
+                                               bck->conn_timeout);
               switch (op_state) {
                 case IO::IO_OP::OP_ERROR: {
                   Logger::logmsg(LOG_NOTICE, "Error connecting to backend %s",
@@ -681,12 +844,10 @@ void StreamManager::onRequestEvent(int fd) {
                 }
 
                 case IO::IO_OP::OP_IN_PROGRESS: {
-                  stream->timer_fd.set(bck->conn_timeout * 1000);
+                  timer_wheel.arm(stream->timer, EVENT_GROUP::CONNECT_TIMEOUT,
+                                  bck->conn_timeout * 1000);
                   stream->backend_connection.getBackend()
                       ->increaseConnTimeoutAlive();
-                  timers_set[stream->timer_fd.getFileDescriptor()] = stream;
-                  addFd(stream->timer_fd.getFileDescriptor(), EVENT_TYPE::READ,
-                        EVENT_GROUP::CONNECT_TIMEOUT);
                   if (stream->backend_connection.getBackend()->nf_mark > 0)
                     Network::setSOMarkOption(
                         stream->backend_connection.getFileDescriptor(),
@@ -695,8 +856,8 @@ void StreamManager::onRequestEvent(int fd) {
                   [[fallthrough]];
                 case IO::IO_OP::OP_SUCCESS: {
                   DEBUG_COUNTER_HIT(debug__::on_backend_connect);
-                  streams_set[stream->backend_connection.getFileDescriptor()] =
-                      stream;
+                  streams_set.set(
+                      stream->backend_connection.getFileDescriptor(), stream);
                   stream->backend_connection.enableEvents(
                       this, EVENT_TYPE::WRITE, EVENT_GROUP::SERVER);
                   break;
@@ -706,7 +867,8 @@ void StreamManager::onRequestEvent(int fd) {
 
             Logger::logmsg(
                 LOG_DEBUG, "%s %lu [%s] %.*s [%s (%d) -> %s:%d (%d)]",
-                need_new_backend ? "NEW" : "REUSED", total_request,
+                pooled ? "POOLED" : need_new_backend ? "NEW" : "REUSED",
+                total_request,
                 service->name.c_str(), stream->request.http_message_length,
                 stream->request.http_message,
                 stream->client_connection.getPeerAddress().c_str(),
@@ -774,6 +936,17 @@ void StreamManager::onRequestEvent(int fd) {
       return;
     case http_parser::PARSE_RESULT::INCOMPLETE:
       Logger::LogInfo("Parser INCOMPLETE", LOG_DEBUG);
+      /* the headers do not fit in the buffer, move them to a larger one */
+      if (stream->client_connection.buffer_offset +
+                  stream->client_connection.buffer_size ==
+              stream->client_connection.buffer_capacity &&
+          !stream->client_connection.growBuffer()) {
+        http_manager::replyError(
+            http::Code::BadRequest, http::reasonPhrase(http::Code::BadRequest),
+            listener_config_.err501, stream->client_connection);
+        this->clearStream(stream);
+        return;
+      }
       stream->client_connection.enableReadEvent();
       return;
   }
@@ -797,7 +970,7 @@ void StreamManager::onRequestEvent(int fd) {
 }
 
 void StreamManager::onResponseEvent(int fd) {
-  HttpStream* stream = streams_set[fd];
+  HttpStream* stream = streams_set.get(fd);
 
   if (stream == nullptr) {
     Logger::LogInfo("Backend Connection, Stream closed", LOG_DEBUG);
@@ -814,7 +987,9 @@ void StreamManager::onResponseEvent(int fd) {
     clearStream(stream);
     return;
   }
-  if (stream->backend_connection.buffer_size == MAX_DATA_SIZE) {
+  if (stream->backend_connection.buffer_capacity != 0 &&
+      stream->backend_connection.buffer_size ==
+          stream->backend_connection.buffer_capacity) {
     stream->client_connection.enableWriteEvent();
     return;
   }
@@ -834,12 +1009,9 @@ void StreamManager::onResponseEvent(int fd) {
             ? "TRUE"
             : "false");
 #endif
-  // disable response timeout timerfd
-  if (stream->backend_connection.getBackend()->response_timeout > 0) {
-    stream->timer_fd.unset();
-    events::EpollManager::deleteFd(stream->timer_fd.getFileDescriptor());
-  }
-  if (stream->backend_connection.buffer_size > 0 &&
+  // disable response timeout
+  timer_wheel.cancel(stream->timer);
+  if (stream->backend_connection.getBufferedSize() > 0 &&
       stream->response.getHeaderSent()) {
     stream->client_connection.enableWriteEvent();
     return;
@@ -847,44 +1019,19 @@ void StreamManager::onResponseEvent(int fd) {
   DEBUG_COUNTER_HIT(debug__::on_response);
   IO::IO_RESULT result;
 
-  if (stream->backend_connection.getBackend()->isHttps()) {
+  if (forwardsBody(stream, stream->backend_connection, stream->response)) {
+    result = readBody(stream, stream->backend_connection, stream->response);
+  } else if (stream->backend_connection.getBackend()->isHttps()) {
     result =
         ssl::SSLConnectionManager::handleDataRead(stream->backend_connection);
   } else {
-#if ENABLE_ZERO_COPY
-    if (stream->response.message_bytes_left > 0 &&
-        !stream->backend_connection.getBackend()->isHttps() &&
-        !this->is_https_listener
-        /*&& stream->response.transfer_encoding_header*/) {
-      result = stream->backend_connection.zeroRead();
-      if (result == IO::IO_RESULT::ERROR) {
-        Logger::LogInfo("Error reading response ", LOG_DEBUG);
-        clearStream(stream);
-        return;
-      }
-// TODO::Evaluar
-#if ENABLE_QUICK_RESPONSE
-      result = stream->backend_connection.zeroWrite(
-          stream->client_connection.getFileDescriptor(), stream->response);
-      switch (result) {
-        case IO::IO_RESULT::FD_CLOSED:
-        case IO::IO_RESULT::ERROR: {
-          Logger::LogInfo("Error Writing response ", LOG_NOTICE);
-          clearStream(stream);
-          return;
-        }
-        case IO::IO_RESULT::SUCCESS:
-          return;
-        case IO::IO_RESULT::DONE_TRY_AGAIN:
-          stream->client_connection.enableWriteEvent();
-          return;
-        case IO::IO_RESULT::FULL_BUFFER:
-          break;
-      }
-#endif
-    } else
-#endif
-      result = stream->backend_connection.read();
+    result = stream->backend_connection.read();
+  }
+  /* the first bytes sent went in the SYN if the backend acknowledged them */
+  if (UNLIKELY(stream->backend_connection.fast_open)) {
+    stream->backend_connection.fast_open = false;
+    stream->backend_connection.getBackend()->increaseFastOpen(
+        Network::isSynDataAcked(stream->backend_connection.getFileDescriptor()));
   }
 #if PRINT_DEBUG_FLOW_BUFFERS
   Logger::logmsg(
@@ -921,7 +1068,7 @@ void StreamManager::onResponseEvent(int fd) {
     case IO::IO_RESULT::ZERO_DATA:
     case IO::IO_RESULT::SUCCESS:
     case IO::IO_RESULT::DONE_TRY_AGAIN: {
-      if (stream->backend_connection.buffer_size == 0) {
+      if (stream->backend_connection.getBufferedSize() == 0) {
         stream->backend_connection.enableReadEvent();
         return;
       }
@@ -929,7 +1076,7 @@ void StreamManager::onResponseEvent(int fd) {
     }
     case IO::IO_RESULT::FULL_BUFFER:
     case IO::IO_RESULT::FD_CLOSED:
-      if (stream->backend_connection.buffer_size > 0)
+      if (stream->backend_connection.getBufferedSize() > 0)
         break;
       else
         return;
@@ -965,16 +1112,16 @@ void StreamManager::onResponseEvent(int fd) {
   // TODO:  stream->backend_stadistics.update();
 
   if (stream->upgrade.pinned_connection || stream->response.hasPendingData()) {
-#ifdef CACHE_ENABLED
-    if (stream->response.chunked_status != CHUNKED_STATUS::CHUNKED_DISABLED) {
-      auto pending_chunk_bytes = http_manager::handleChunkedData(
-          stream->backend_connection, stream->response);
-      if (pending_chunk_bytes < 0) {  // we don't have enough data to get next
-                                      // chunk size, so we wait for more data
-        stream->backend_connection.enableReadEvent();
-        return;
-      }
+    /* the last chunk ends the response, the next one can be forwarded */
+    if (stream->response.chunked_status != CHUNKED_STATUS::CHUNKED_DISABLED &&
+        http_manager::handleChunkedData(stream->backend_connection,
+                                        stream->response) < 0) {
+      Logger::logmsg(LOG_INFO, "Backend %s sent an invalid chunked body",
+                     stream->backend_connection.address_str.c_str());
+      clearStream(stream);
+      return;
     }
+#ifdef CACHE_ENABLED
     auto service = static_cast<Service*>(stream->request.getService());
     if (service->cache_enabled) {
       CacheManager::handleResponse(stream, service);
@@ -1004,10 +1151,12 @@ void StreamManager::onResponseEvent(int fd) {
     static size_t total_responses;
     switch (ret) {
       case http_parser::PARSE_RESULT::SUCCESS: {
-        stream->request.chunked_status = CHUNKED_STATUS::CHUNKED_DISABLED;
         stream->backend_connection.buffer_offset = 0;
         stream->client_connection.buffer_offset = 0;
-        stream->client_connection.buffer_size = 0;
+        /* the buffer holds the body left or the next pipelined requests */
+        if (stream->request.hasPendingData())
+          stream->client_connection.buffer_size = 0;
+        stream->request.chunked_status = CHUNKED_STATUS::CHUNKED_DISABLED;
         break;
       }
       case http_parser::PARSE_RESULT::TOOLONG:
@@ -1105,7 +1254,7 @@ void StreamManager::onResponseEvent(int fd) {
     http_manager::setBackendCookie(service, stream);
     setStrictTransportSecurity(service, stream);
 #if ON_FLY_COMRESSION
-    if (!this->is_https_listener) {
+    if (!stream->service_manager->is_https_listener) {
       Compression::applyCompression(service, stream);
     }
 #endif
@@ -1117,89 +1266,61 @@ void StreamManager::onResponseEvent(int fd) {
 #endif
   }
 }
-void StreamManager::onConnectTimeoutEvent(int fd) {
+void StreamManager::onConnectTimeoutEvent(HttpStream* stream) {
   DEBUG_COUNTER_HIT(debug__::on_backend_connect_timeout);
-  HttpStream* stream = timers_set[fd];
-  if (stream == nullptr) {
-    Logger::LogInfo("Stream null pointer", LOG_REMOVE);
-    deleteFd(fd);
-    ::close(fd);
-    return;
-  }
   auto& listener_config_ = *stream->service_manager->listener_config_;
   // update log info
   StreamDataLogger logger(stream, listener_config_);
-  if (stream->timer_fd.isTriggered()) {
-    stream->backend_connection.getBackend()->status =
-        BACKEND_STATUS::BACKEND_DOWN;
-    Logger::logmsg(LOG_NOTICE, "(%lx) backend %s connection timeout after %d",
-                   /*std::this_thread::get_id()*/ pthread_self(),
-                   stream->backend_connection.getBackend()->address.c_str(),
-                   stream->backend_connection.getBackend()->conn_timeout);
-    Logger::logmsg(
-        LOG_NOTICE,
-        "(%lx) BackEnd %s:%d dead (killed) in farm: '%s', service: '%s'",
-        pthread_self(), stream->backend_connection.getBackend()->address.data(),
-        stream->backend_connection.getBackend()->port,
-        listener_config_.name.data(),
-        stream->backend_connection.getBackend()
-            ->backend_config->srv_name.data());
-    stream->backend_connection.getBackend()->decreaseConnTimeoutAlive();
-    setStreamBackend(stream);
-  }
+  stream->backend_connection.getBackend()->status =
+      BACKEND_STATUS::BACKEND_DOWN;
+  Logger::logmsg(LOG_NOTICE, "(%lx) backend %s connection timeout after %d",
+                 /*std::this_thread::get_id()*/ pthread_self(),
+                 stream->backend_connection.getBackend()->address.c_str(),
+                 stream->backend_connection.getBackend()->conn_timeout);
+  Logger::logmsg(
+      LOG_NOTICE,
+      "(%lx) BackEnd %s:%d dead (killed) in farm: '%s', service: '%s'",
+      pthread_self(), stream->backend_connection.getBackend()->address.data(),
+      stream->backend_connection.getBackend()->port,
+      listener_config_.name.data(),
+      stream->backend_connection.getBackend()
+          ->backend_config->srv_name.data());
+  stream->backend_connection.getBackend()->decreaseConnTimeoutAlive();
+  setStreamBackend(stream);
 }
 
-void StreamManager::onRequestTimeoutEvent(int fd) {
+void StreamManager::onRequestTimeoutEvent(HttpStream* stream) {
   DEBUG_COUNTER_HIT(debug__::on_request_timeout);
-  HttpStream* stream = timers_set[fd];
-  if (stream == nullptr) {
-    Logger::LogInfo("Stream null pointer", LOG_REMOVE);
-    deleteFd(fd);
-    ::close(fd);
-    return;
-  }
   auto& listener_config_ = *stream->service_manager->listener_config_;
   // update log info
   StreamDataLogger logger(stream, listener_config_);
-  if (stream->timer_fd.isTriggered()) {
-    clearStream(stream);
-  }
+  clearStream(stream);
 }
 
-void StreamManager::onResponseTimeoutEvent(int fd) {
+void StreamManager::onResponseTimeoutEvent(HttpStream* stream) {
   DEBUG_COUNTER_HIT(debug__::on_response_timeout);
-
-  HttpStream* stream = timers_set[fd];
-
-  if (stream == nullptr) {
-    Logger::LogInfo("Stream null pointer", LOG_REMOVE);
-    deleteFd(fd);
-    ::close(fd);
-  }
   auto& listener_config_ = *stream->service_manager->listener_config_;
   // update log info
   StreamDataLogger logger(stream, listener_config_);
-  if (stream->timer_fd.isTriggered()) {
-    char caddr[50];
-    if (UNLIKELY(Network::getPeerAddress(
-                     stream->client_connection.getFileDescriptor(), caddr,
-                     50) == nullptr)) {
-      Logger::LogInfo("Error getting peer address", LOG_DEBUG);
-    } else {
-      Logger::logmsg(LOG_NOTICE, "(%lx) e%d %s %s from %s",
-                    std::this_thread::get_id(),
-                    static_cast<int>(http::Code::GatewayTimeout),
-                    validation::request_result_reason
-                        .at(validation::REQUEST_RESULT::BACKEND_TIMEOUT)
-                        .c_str(),
-                    stream->client_connection.buffer, caddr);
-    }
-    http_manager::replyError(http::Code::GatewayTimeout,
-                             http::reasonPhrase(http::Code::GatewayTimeout),
-                             http::reasonPhrase(http::Code::GatewayTimeout),
-                             stream->client_connection);
-    this->clearStream(stream);
+  char caddr[50];
+  if (UNLIKELY(Network::getPeerAddress(
+                   stream->client_connection.getFileDescriptor(), caddr,
+                   50) == nullptr)) {
+    Logger::LogInfo("Error getting peer address", LOG_DEBUG);
+  } else {
+    Logger::logmsg(LOG_NOTICE, "(%lx) e%d %s %s from %s",
+                  std::this_thread::get_id(),
+                  static_cast<int>(http::Code::GatewayTimeout),
+                  validation::request_result_reason
+                      .at(validation::REQUEST_RESULT::BACKEND_TIMEOUT)
+                      .c_str(),
+                  stream->request.http_message_str.c_str(), caddr);
   }
+  http_manager::replyError(http::Code::GatewayTimeout,
+                           http::reasonPhrase(http::Code::GatewayTimeout),
+                           http::reasonPhrase(http::Code::GatewayTimeout),
+                           stream->client_connection);
+  this->clearStream(stream);
 }
 void StreamManager::onSignalEvent([[maybe_unused]] int fd) {
   // TODO::IMPLEMENET
@@ -1229,7 +1350,6 @@ void StreamManager::setStreamBackend(HttpStream* stream) {
     if (stream->backend_connection.getFileDescriptor() > 0) {
       if (stream->backend_connection.isConnected())
         stream->backend_connection.getBackend()->decreaseConnection();
-      streams_set[stream->backend_connection.getFileDescriptor()] = nullptr;
       streams_set.erase(stream->backend_connection.getFileDescriptor());
     }
     stream->backend_connection.reset();
@@ -1263,8 +1383,7 @@ void StreamManager::setStreamBackend(HttpStream* stream) {
         stream->backend_connection.setBackend(bck);
         stream->backend_connection.time_start =
             std::chrono::steady_clock::now();
-        op_state = stream->backend_connection.doConnect(*bck->address_info,
-                                                        bck->conn_timeout);
+        op_state = bck->connect(stream->backend_connection, bck->conn_timeout);
         switch (op_state) {
           case IO::IO_OP::OP_ERROR: {
             Logger::logmsg(LOG_NOTICE, "Error connecting to backend %s",
@@ -1281,11 +1400,9 @@ void StreamManager::setStreamBackend(HttpStream* stream) {
           }
 
           case IO::IO_OP::OP_IN_PROGRESS: {
-            stream->timer_fd.set(bck->conn_timeout * 1000);
+            timer_wheel.arm(stream->timer, EVENT_GROUP::CONNECT_TIMEOUT,
+                            bck->conn_timeout * 1000);
             stream->backend_connection.getBackend()->increaseConnTimeoutAlive();
-            timers_set[stream->timer_fd.getFileDescriptor()] = stream;
-            addFd(stream->timer_fd.getFileDescriptor(), EVENT_TYPE::READ,
-                  EVENT_GROUP::CONNECT_TIMEOUT);
             if (stream->backend_connection.getBackend()->nf_mark > 0)
               Network::setSOMarkOption(
                   stream->backend_connection.getFileDescriptor(),
@@ -1295,8 +1412,8 @@ void StreamManager::setStreamBackend(HttpStream* stream) {
           case IO::IO_OP::OP_SUCCESS: {
             DEBUG_COUNTER_HIT(debug__::on_backend_connect);
             //stream->backend_connection.getBackend()->increaseConnection();
-            streams_set[stream->backend_connection.getFileDescriptor()] =
-                stream;
+            streams_set.set(stream->backend_connection.getFileDescriptor(),
+                            stream);
             stream->backend_connection.enableEvents(this, EVENT_TYPE::WRITE,
                                                     EVENT_GROUP::SERVER);
             break;
@@ -1360,8 +1477,9 @@ void StreamManager::onServerWriteEvent(HttpStream* stream) {
   int fd = stream->backend_connection.getFileDescriptor();
   // Send client request to backend server
   if (stream->backend_connection.getBackend()->conn_timeout > 0 &&
-      Network::isConnected(fd) && stream->timer_fd.is_set) {
-    stream->timer_fd.unset();
+      Network::isConnected(fd) && stream->timer.isSet() &&
+      stream->timer.group == EVENT_GROUP::CONNECT_TIMEOUT) {
+    timer_wheel.cancel(stream->timer);
     stream->backend_connection.getBackend()->decreaseConnTimeoutAlive();
     stream->backend_connection.getBackend()->increaseConnection();
     stream->backend_connection.getBackend()->setAvgConnTime(
@@ -1369,10 +1487,12 @@ void StreamManager::onServerWriteEvent(HttpStream* stream) {
             std::chrono::steady_clock::now() -
             stream->backend_connection.time_start)
             .count());
-    this->deleteFd(stream->timer_fd.getFileDescriptor());
   }
-  /*Check if the buffer has data to be send */
-  if (stream->client_connection.buffer_size == 0) {
+  /*Check if the buffer has data to be send, once the request has been sent
+   * the buffer only holds the next pipelined requests */
+  if (stream->client_connection.getBufferedSize() == 0 ||
+      (stream->awaiting_response && !stream->upgrade.pinned_connection &&
+       !stream->request.hasPendingData())) {
     stream->client_connection.enableReadEvent();
     stream->backend_connection.enableReadEvent();
     return;
@@ -1384,17 +1504,21 @@ void StreamManager::onServerWriteEvent(HttpStream* stream) {
   if (stream->upgrade.pinned_connection || stream->request.hasPendingData()) {
     size_t written = 0;
 
-    if (stream->backend_connection.getBackend()->isHttps()) {
+    if (stream->backend_connection.getBackend()->isHttps() &&
+        !stream->backend_connection.ktls_send) {
       result = ssl::SSLConnectionManager::handleWrite(
           stream->backend_connection, stream->client_connection, written);
     } else {
       if (stream->client_connection.buffer_size > 0)
         result = stream->client_connection.writeTo(
             stream->backend_connection.getFileDescriptor(), written);
+      else if (!stream->client_connection.segment_buffer.empty())
+        result = stream->client_connection.segment_buffer.writeTo(
+            stream->backend_connection.getFileDescriptor(), written);
 #if ENABLE_ZERO_COPY
       else if (stream->client_connection.splice_pipe.bytes > 0)
         result = stream->client_connection.zeroWrite(
-            stream->backend_connection.getFileDescriptor(), stream->request);
+            stream->backend_connection.getFileDescriptor(), written);
 #endif
     }
     switch (result) {
@@ -1454,7 +1578,12 @@ void StreamManager::onServerWriteEvent(HttpStream* stream) {
       stream->client_connection.buffer_offset += written;
       stream->backend_connection.enableWriteEvent();
       return;
+    } else if (stream->client_connection.getBufferedSize() > 0) {
+      stream->backend_connection.enableWriteEvent();
+      return;
     } else {
+      /* nothing else to send until the client sends more */
+      stream->backend_connection.setCork(false);
       stream->client_connection.buffer_offset = 0;
       stream->backend_connection.enableReadEvent();
       stream->client_connection.enableReadEvent();
@@ -1462,6 +1591,9 @@ void StreamManager::onServerWriteEvent(HttpStream* stream) {
     return;
   }
 
+  /* the body is still to come, hold the headers until it is written */
+  if (stream->request.message_bytes_left > 0)
+    stream->backend_connection.setCork(true);
   if (stream->backend_connection.getBackend()->isHttps()) {
     result = ssl::SSLConnectionManager::handleDataWrite(
         stream->backend_connection, stream->client_connection, stream->request);
@@ -1512,11 +1644,12 @@ void StreamManager::onServerWriteEvent(HttpStream* stream) {
       return;
   }
 
-  stream->timer_fd.set(
+  stream->awaiting_response = true;
+  if (stream->request.message_bytes_left == 0)
+    stream->backend_connection.setCork(false);
+  timer_wheel.arm(
+      stream->timer, EVENT_GROUP::RESPONSE_TIMEOUT,
       stream->backend_connection.getBackend()->response_timeout * 1000);
-  timers_set[stream->timer_fd.getFileDescriptor()] = stream;
-  addFd(stream->timer_fd.getFileDescriptor(), EVENT_TYPE::READ,
-        EVENT_GROUP::RESPONSE_TIMEOUT);
   stream->backend_connection.enableReadEvent();
   stream->backend_connection.time_start = std::chrono::steady_clock::now();
 }
@@ -1545,17 +1678,25 @@ void StreamManager::onClientWriteEvent(HttpStream* stream) {
   if (stream->upgrade.pinned_connection || stream->response.hasPendingData()) {
     size_t written = 0;
 
-    if (stream->service_manager->is_https_listener) {
+    if (stream->service_manager->is_https_listener &&
+        !stream->client_connection.ktls_send) {
       result = ssl::SSLConnectionManager::handleWrite(
           stream->client_connection, stream->backend_connection, written);
     } else {
       if (stream->backend_connection.buffer_size > 0)
         result = stream->backend_connection.writeTo(
             stream->client_connection.getFileDescriptor(), written);
+      else if (!stream->backend_connection.segment_buffer.empty())
+        result = stream->backend_connection.segment_buffer.writeTo(
+            stream->client_connection.getFileDescriptor(), written,
+            /* kTLS sockets reject MSG_ZEROCOPY */
+            stream->client_connection.ktls_send
+                ? nullptr
+                : &stream->client_connection.zerocopy);
 #if ENABLE_ZERO_COPY
       else if (stream->backend_connection.splice_pipe.bytes > 0)
         result = stream->backend_connection.zeroWrite(
-            stream->client_connection.getFileDescriptor(), stream->response);
+            stream->client_connection.getFileDescriptor(), written);
 #endif
     }
     switch (result) {
@@ -1607,10 +1748,13 @@ void StreamManager::onClientWriteEvent(HttpStream* stream) {
               http::CHUNKED_STATUS::CHUNKED_LAST_CHUNK &&
           stream->backend_connection.buffer_size == 0) {
         stream->response.reset_parser();
+        stream->awaiting_response = false;
       } else if (stream->response.message_bytes_left > 0) {
         stream->response.message_bytes_left -= written;
-        if (stream->response.message_bytes_left <= 0)
+        if (stream->response.message_bytes_left <= 0) {
           stream->response.reset_parser();
+          stream->awaiting_response = false;
+        }
       }
     }
 #if PRINT_DEBUG_FLOW_BUFFERS
@@ -1631,9 +1775,21 @@ void StreamManager::onClientWriteEvent(HttpStream* stream) {
       if (stream->backend_connection.buffer_size > 0) {
         stream->backend_connection.buffer_offset = written;
         stream->client_connection.enableWriteEvent();
+      } else if (stream->backend_connection.getBufferedSize() > 0) {
+        stream->client_connection.enableWriteEvent();
       } else {
+        /* nothing else to send until the backend sends more */
+        stream->client_connection.setCork(false);
         stream->backend_connection.buffer_offset = 0;
-        stream->backend_connection.enableReadEvent();
+        releaseIdleBuffers(stream);
+        if (!releaseBackend(stream))
+          stream->backend_connection.enableReadEvent();
+        if (!stream->awaiting_response &&
+            stream->client_connection.buffer_size > 0) {
+          /* forward the next pipelined request */
+          onRequestEvent(stream->client_connection.getFileDescriptor());
+          return;
+        }
         stream->client_connection.enableReadEvent();
       }
     return;
@@ -1646,6 +1802,9 @@ void StreamManager::onClientWriteEvent(HttpStream* stream) {
   )
     return;
 
+  /* the body is still to come, hold the headers until it is written */
+  if (stream->response.message_bytes_left > 0)
+    stream->client_connection.setCork(true);
   if (stream->service_manager->is_https_listener) {
     result = ssl::SSLConnectionManager::handleDataWrite(
         stream->client_connection, stream->backend_connection,
@@ -1750,6 +1909,19 @@ void StreamManager::onClientWriteEvent(HttpStream* stream) {
         stream->response.content_length, stream->response.message_bytes_left,
         IO::getResultString(result).data());
 #endif
+  if (stream->response.message_bytes_left == 0) {
+    stream->client_connection.setCork(false);
+    if (stream->response.http_status_code >= 200) {
+      /* the whole chunked body came with the headers */
+      if (stream->response.chunked_status ==
+              http::CHUNKED_STATUS::CHUNKED_LAST_CHUNK &&
+          stream->backend_connection.buffer_size == 0)
+        stream->response.reset_parser();
+      /* the rest of a chunked body still holds the next requests */
+      if (!stream->response.hasPendingData())
+        stream->awaiting_response = false;
+    }
+  }
   if (stream->request.upgrade_header &&
       stream->request.connection_header_upgrade &&
       stream->response.http_status_code == 101) {
@@ -1768,23 +1940,304 @@ void StreamManager::onClientWriteEvent(HttpStream* stream) {
 #ifdef CACHE_ENABLED
     if (!stream->response.isCached())
 #endif
-      stream->backend_connection.enableReadEvent();
+    {
+      releaseIdleBuffers(stream);
+      if (!releaseBackend(stream))
+        stream->backend_connection.enableReadEvent();
+    }
+    if (!stream->awaiting_response &&
+        stream->client_connection.buffer_size > 0) {
+      /* forward the next pipelined request */
+      onRequestEvent(stream->client_connection.getFileDescriptor());
+      return;
+    }
     stream->client_connection.enableReadEvent();
   }
 }
 
+bool StreamManager::forwardsBody(HttpStream* stream, Connection& connection,
+                                 http_parser::HttpData& message) {
+#ifdef CACHE_ENABLED
+  /* the cache needs the body data in the connection buffer */
+  return false;
+#else
+  auto backend = stream->backend_connection.getBackend();
+  if (connection.buffer_size != 0 || backend == nullptr ||
+      !(stream->upgrade.pinned_connection || message.hasPendingData()))
+    return false;
+  bool from_client = &connection == &stream->client_connection;
+  /* the end of a chunked response is found parsing it in the buffer */
+  if (!from_client && !stream->upgrade.pinned_connection &&
+      message.chunked_status != CHUNKED_STATUS::CHUNKED_DISABLED)
+    return false;
+  Connection &peer =
+      from_client ? static_cast<Connection &>(stream->backend_connection)
+                  : stream->client_connection;
+  bool tls_in = from_client ? stream->service_manager->is_https_listener
+                            : backend->isHttps();
+  bool tls_out = from_client ? backend->isHttps()
+                             : stream->service_manager->is_https_listener;
+  /* TLS records only skip the buffer when the kernel encrypts them, the ones
+   * received are read by OpenSSL, kTLS or not, to handle the control records */
+  return !tls_in && (!tls_out || peer.ktls_send);
+#endif
+}
+
+IO::IO_RESULT StreamManager::readBody(HttpStream* stream,
+                                      Connection& connection,
+                                      http_parser::HttpData& message) {
+  /* do not read past the body, the next message is parsed from the buffer */
+  size_t max_bytes = SIZE_MAX;
+  if (!stream->upgrade.pinned_connection && message.message_bytes_left > 0)
+    max_bytes = message.message_bytes_left - connection.getBufferedSize();
+#if ENABLE_ZERO_COPY
+  if (stream->service_manager->listener_config_->zero_copy)
+    return connection.zeroRead(max_bytes);
+#endif
+  return connection.segment_buffer.readFrom(connection.getFileDescriptor(),
+                                            max_bytes);
+}
+
+void StreamManager::releaseIdleBuffers(HttpStream* stream) {
+  if (stream->upgrade.pinned_connection || stream->request.hasPendingData() ||
+      stream->response.hasPendingData())
+    return;
+  if (stream->client_connection.buffer_size == 0) {
+    stream->request.detachBuffer();
+    stream->client_connection.releaseBuffer();
+  }
+  if (stream->backend_connection.buffer_size == 0) {
+    stream->response.detachBuffer();
+    stream->backend_connection.releaseBuffer();
+  }
+}
+
+/* idle connections are only shared between the streams that would set up
+ * the same connection to the backend */
+static std::string getPoolKey(Backend& backend, const char* server_name) {
+  std::string key = backend.address;
+  key += ':';
+  key += std::to_string(backend.port);
+  if (backend.isHttps()) {
+    key += '|';
+    key += std::to_string(reinterpret_cast<uintptr_t>(backend.ctx.get()));
+    if (server_name != nullptr) {
+      key += '|';
+      key += server_name;
+    }
+  }
+  return key;
+}
+
+bool StreamManager::releaseBackend(HttpStream* stream) {
+  auto backend = stream->backend_connection.getBackend();
+  auto& connection = stream->backend_connection;
+  if (backend == nullptr || backend->backend_type != BACKEND_TYPE::REMOTE ||
+      backend->backend_config->pool_max_idle <= 0 ||
+      connection.getFileDescriptor() <= 0 || !stream->response.reusable ||
+      stream->awaiting_response ||
+      stream->upgrade.pinned_connection || stream->request.hasPendingData() ||
+      stream->response.hasPendingData() || connection.getBufferedSize() > 0 ||
+      connection.zerocopy.hasPending() ||
+      isHangingUp(connection.getFileDescriptor()))
+    return false;
+  if (backend->isHttps() &&
+      (!connection.ssl_connected || SSL_pending(connection.ssl) > 0))
+    return false;
+  int fd = connection.getFileDescriptor();
+  deleteFd(fd);
+  streams_set.erase(fd);
+  backend->decreaseConnection();
+  connection.setCork(false);
+  auto& backend_config = *backend->backend_config;
+  connection_pool.release(getPoolKey(*backend, connection.server_name),
+                          connection,
+                          static_cast<size_t>(backend_config.pool_max_idle),
+                          backend_config.pool_idle_timeout);
+  stream->response.reusable = false;
+  return true;
+}
+
+bool StreamManager::acquireBackend(HttpStream* stream, Backend& backend) {
+  if (backend.backend_config->pool_max_idle <= 0 ||
+      !connection_pool.acquire(
+          getPoolKey(backend, stream->client_connection.server_name),
+          stream->backend_connection))
+    return false;
+  stream->backend_connection.server_name =
+      stream->client_connection.server_name;
+  backend.increaseConnection();
+  return true;
+}
+
+void StreamManager::warmUpPool() {
+  auto now = std::chrono::steady_clock::now();
+  if (now - last_warm_up < std::chrono::seconds(1)) return;
+  last_warm_up = now;
+  for (auto it = warm_connections.begin(); it != warm_connections.end();) {
+    if (it->second->deadline > now) {
+      ++it;
+      continue;
+    }
+    /* the TLS 1.3 connections waiting for session tickets that did not come
+     * are ready */
+    if (it->second->connection.ssl_connected)
+      poolWarmConnection(*it->second);
+    else
+      Logger::logmsg(LOG_DEBUG, "Pool warm up connect to %s timed out",
+                     it->second->backend->address.data());
+    it = warm_connections.erase(it);
+  }
+  for (auto& listener : service_manager_set) {
+    auto service_manager = listener.second.lock();
+    if (!service_manager || service_manager->disabled) continue;
+    /* the connections to the HTTPS backends of a listener forwarding the SNI
+     * server name are only shared by the clients sending the same name */
+    bool forwards_sni =
+        service_manager->is_https_listener &&
+        service_manager->listener_config_->ssl_forward_sni_server_name;
+    for (auto service : service_manager->getServices()) {
+      if (service->disabled) continue;
+      for (auto bck : service->getWarmBackends()) {
+        if (bck->status != BACKEND_STATUS::BACKEND_UP ||
+            (forwards_sni && bck->isHttps()))
+          continue;
+        auto key = getPoolKey(*bck, nullptr);
+        auto idle = connection_pool.size(key);
+        for (auto& warm : warm_connections)
+          if (warm.second->key == key) idle++;
+        for (; idle < static_cast<size_t>(bck->backend_config->pool_min_idle);
+             idle++) {
+          auto warm = std::make_unique<WarmConnection>();
+          /* there is no data to send in the SYN */
+          if (bck->connect(warm->connection, bck->conn_timeout, true, false) ==
+              IO::IO_OP::OP_ERROR) {
+            Logger::logmsg(LOG_DEBUG, "Pool warm up connect to %s failed",
+                           bck->address.data());
+            break;
+          }
+          int fd = warm->connection.getFileDescriptor();
+          if (bck->nf_mark > 0) Network::setSOMarkOption(fd, bck->nf_mark);
+          warm->service_manager = service_manager;
+          warm->backend = bck;
+          warm->key = key;
+          warm->deadline = now + std::chrono::seconds(bck->conn_timeout);
+          warm->connection.enableEvents(this, EVENT_TYPE::WRITE,
+                                        EVENT_GROUP::POOL);
+          warm_connections[fd] = std::move(warm);
+        }
+      }
+    }
+  }
+}
+
+void StreamManager::onWarmUpEvent(int fd, EVENT_TYPE event_type) {
+  auto it = warm_connections.find(fd);
+  if (it == warm_connections.end()) {
+    deleteFd(fd);
+    ::close(fd);
+    return;
+  }
+  auto& warm = *it->second;
+  auto& connection = warm.connection;
+  if (event_type == EVENT_TYPE::DISCONNECT || !Network::isConnected(fd)) {
+    Logger::logmsg(LOG_DEBUG, "Pool warm up connect to %s failed",
+                   warm.backend->address.data());
+    warm_connections.erase(it);
+    return;
+  }
+  if (warm.backend->isHttps() && !connection.ssl_connected) {
+    if (!ssl::SSLConnectionManager::handleHandshake(warm.backend->ctx.get(),
+                                                    connection, true)) {
+      Logger::logmsg(LOG_DEBUG, "Pool warm up handshake error with %s",
+                     warm.backend->address.data());
+      warm_connections.erase(it);
+      return;
+    }
+    if (!connection.ssl_connected) return;
+    /* TLS 1.3 servers send the session tickets after the handshake, the pool
+     * would take them as unexpected data on checkout */
+    if (SSL_version(connection.ssl) >= TLS1_3_VERSION) {
+      warm.deadline =
+          std::chrono::steady_clock::now() + std::chrono::seconds(1);
+      connection.enableReadEvent();
+      return;
+    }
+  } else if (warm.backend->isHttps()) {
+    ERR_clear_error();
+    char data;
+    int result = SSL_read(connection.ssl, &data, 1);
+    if (result > 0 ||
+        SSL_get_error(connection.ssl, result) != SSL_ERROR_WANT_READ) {
+      Logger::logmsg(LOG_DEBUG, "Pool warm up connection to %s closed",
+                     warm.backend->address.data());
+      warm_connections.erase(it);
+      return;
+    }
+  }
+  poolWarmConnection(warm);
+  warm_connections.erase(it);
+}
+
+void StreamManager::poolWarmConnection(WarmConnection& warm) {
+  deleteFd(warm.connection.getFileDescriptor());
+  auto& backend_config = *warm.backend->backend_config;
+  connection_pool.warm(warm.key, warm.connection,
+                       static_cast<size_t>(backend_config.pool_max_idle),
+                       backend_config.pool_idle_timeout);
+}
+
 bool StreamManager::registerListener(
-    std::weak_ptr<ServiceManager> service_manager) {
+    std::weak_ptr<ServiceManager> service_manager,
+    ListenerHandover* handover) {
   auto& listener_config = service_manager.lock()->listener_config_;
-  auto address =
-      Network::getAddress(listener_config->address, listener_config->port);
-  int listen_fd = Connection::listen(*address);
+  int listen_fd = handover != nullptr
+                      ? handover->take(ListenerHandover::getKey(
+                            listener_config->address, listener_config->port))
+                      : -1;
+  if (listen_fd < 0) {
+    auto address =
+        Network::getAddress(listener_config->address, listener_config->port);
+    listen_fd = Connection::listen(*address);
+  }
+  return listen_fd > 0 &&
+         registerListenerSocket(std::move(service_manager), listen_fd);
+}
 
-  if (listen_fd > 0) {
-    service_manager_set[listen_fd] = service_manager;
-    return handleAccept(listen_fd);
+bool StreamManager::registerListenerSocket(
+    std::weak_ptr<ServiceManager> service_manager, int listen_fd) {
+  auto& listener_config = service_manager.lock()->listener_config_;
+  if (listener_config->tcp_fast_open > 0 &&
+      !Network::setTcpFastOpenOption(listen_fd,
+                                     listener_config->tcp_fast_open)) {
+    Logger::logmsg(LOG_WARNING, "(%s) TCPFastOpen not available: %s",
+                   listener_config->name.data(), std::strerror(errno));
+  }
+  // also clears the cpu a socket handed over got from its previous worker
+  int steer_cpu = listener_config->steer_accept ? worker_cpu.load() : -1;
+  if (!Network::setIncomingCpu(listen_fd, steer_cpu) && steer_cpu >= 0) {
+    Logger::logmsg(LOG_WARNING,
+                   "(%s) SteerAccept not available, accept is not steered: %s",
+                   listener_config->name.data(), std::strerror(errno));
+  }
+  service_manager_set[listen_fd] = service_manager;
+  return handleAccept(listen_fd);
+}
+
+void StreamManager::copyListeners(ListenerHandover& handover) {
+  for (auto& [listen_fd, service_manager] : service_manager_set) {
+    auto spt = service_manager.lock();
+    if (!spt) continue;
+    int fd = ::fcntl(listen_fd, F_DUPFD_CLOEXEC, 0);
+    if (fd < 0) {
+      Logger::logmsg(LOG_ERR, "(%s) listening socket copy failed: %s",
+                     spt->listener_config_->name.data(), std::strerror(errno));
+      continue;
+    }
+    handover.add(ListenerHandover::getKey(spt->listener_config_->address,
+                                          spt->listener_config_->port),
+                 fd);
   }
-  return false;
 }
 
 /** Clears the HttpStream. It deletes all the timers and events. Finally,
@@ -1800,19 +2253,13 @@ void StreamManager::clearStream(HttpStream* stream) {
   }
   //  logSslErrorStack();
 
-  if (stream->timer_fd.getFileDescriptor() > 0) {
-    deleteFd(stream->timer_fd.getFileDescriptor());
-    stream->timer_fd.unset();
-    timers_set[stream->timer_fd.getFileDescriptor()] = nullptr;
-    timers_set.erase(stream->timer_fd.getFileDescriptor());
-  }
+  timer_wheel.cancel(stream->timer);
   if (stream->client_connection.getFileDescriptor() > 0) {
     //      if (this->is_https_listener &&
     //      stream->client_connection.isConnected()) { //FIXME
     //          ssl_manager->sslShutdown(stream->client_connection);
     //      }
     deleteFd(stream->client_connection.getFileDescriptor());
-    streams_set[stream->client_connection.getFileDescriptor()] = nullptr;
     streams_set.erase(stream->client_connection.getFileDescriptor());
 
     DEBUG_COUNTER_HIT(debug__::on_client_disconnect);
@@ -1826,7 +2273,6 @@ void StreamManager::clearStream(HttpStream* stream) {
       stream->backend_connection.getBackend()->decreaseConnection();
     }
     deleteFd(stream->backend_connection.getFileDescriptor());
-    streams_set[stream->backend_connection.getFileDescriptor()] = nullptr;
     streams_set.erase(stream->backend_connection.getFileDescriptor());
     DEBUG_COUNTER_HIT(debug__::on_backend_disconnect);
   }
@@ -1849,13 +2295,18 @@ std::string StreamManager::handleTask(ctl::CtlTask& task) {
 
   if (task.command == ctl::CTL_COMMAND::EXIT) {
     Logger::logmsg(LOG_REMOVE, "Exit command received");
-    stop();
+    // runs in the worker thread, the loop exits once the task returns
+    is_running = false;
 
     return JSON_OP_RESULT::OK;
   }
   return JSON_OP_RESULT::ERROR;
 }
 
+bool StreamManager::postTask(std::function<void()> task) {
+  return mailbox.post(std::move(task));
+}
+
 bool StreamManager::isHandler(ctl::CtlTask& task) {
   return task.target == ctl::CTL_HANDLER_TYPE::ALL ||
          task.target == ctl::CTL_HANDLER_TYPE::STREAM_MANAGER;
@@ -1871,11 +2322,7 @@ void StreamManager::onServerDisconnect(HttpStream* stream) {
   StreamDataLogger logger(stream, listener_config_);
 
   Logger::LogInfo("Backend closed connection", LOG_DEBUG);
-  if (stream->backend_connection.buffer_size > 0
-#if ENABLE_ZERO_COPY
-      || stream->backend_connection.splice_pipe.bytes > 0
-#endif
-  ) {
+  if (stream->backend_connection.getBufferedSize() > 0) {
     stream->backend_connection.disableEvents();
     stream->client_connection.enableWriteEvent();
     return;
@@ -1907,34 +2354,27 @@ void StreamManager::onServerDisconnect(HttpStream* stream) {
   clearStream(stream);
 }
 
-void StreamManager::stopListener(int listener_id, bool cut_connection) {
-  for (const auto& lc : service_manager_set) {
-    auto spt = lc.second.lock();
-    if (spt && listener_id == spt->id) {
-      this->stopAccept(lc.first);
-
-      ::close(lc.first);
-    }
-  }
+void StreamManager::stopListener(int listener_id, bool cut_connection,
+                                 ListenerHandover* handover) {
   for (auto it = service_manager_set.begin();
        it != service_manager_set.end();) {
     auto spt = it->second.lock();
     if (spt && listener_id == spt->id) {
       this->stopAccept(it->first);
-      ::close(it->first);
-      //      it = listener_config_set.erase(it);
-      break;
+      if (handover != nullptr)
+        handover->add(ListenerHandover::getKey(spt->listener_config_->address,
+                                               spt->listener_config_->port),
+                      it->first);
+      else
+        ::close(it->first);
+      it = service_manager_set.erase(it);
     } else {
       it++;
     }
   }
   if (cut_connection) {
-    for (auto it = streams_set.begin(); it != streams_set.end();) {
-      if (it->second->service_manager->id == listener_id) {
-        auto item = it++;
-        clearStream(item->second);
-      } else
-        it++;
-    }
+    streams_set.forEach([this, listener_id](int, HttpStream* stream) {
+      if (stream->service_manager->id == listener_id) clearStream(stream);
+    });
   }
 }
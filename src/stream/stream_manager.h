@@ -21,8 +21,10 @@
 
 #pragma once
 #include "../config/config_data.h"
+#include "../connection/connection_pool.h"
 #include "../event/epoll_manager.h"
-#include "../event/timer_fd.h"
+#include "../event/mailbox.h"
+#include "../event/timer_wheel.h"
 #include "../handlers/cache_manager.h"
 #include "../handlers/http_manager.h"
 #include "../http/http_stream.h"
@@ -30,6 +32,8 @@
 #include "../service/service_manager.h"
 #include "../ssl/ssl_connection_manager.h"
 #include "../stats/counter.h"
+#include "listener_handover.h"
+#include "stream_table.h"
 #if WAF_ENABLED
 #include "../handlers/waf.h"
 #endif
@@ -118,7 +122,8 @@ using namespace http;
  * operations with the clients and the backends. It is used to manage both HTTP
  * and HTTPS connections.
  */
-class StreamManager : public EpollManager, public CtlObserver<ctl::CtlTask, std::string> {
+class StreamManager : public EpollManager<StreamManager>,
+                      public CtlObserver<ctl::CtlTask, std::string> {
 #if HELLO_WORLD_SERVER
   std::string e200 =
       "HTTP/1.1 200 OK\r\nServer: zproxy 1.0\r\nExpires: now\r\nPragma: "
@@ -127,14 +132,74 @@ class StreamManager : public EpollManager, public CtlObserver<ctl::CtlTask, std:
 #endif
 
   int worker_id{};
+  /** CPU the worker is pinned to, -1 if it is not pinned. */
+  std::atomic<int> worker_cpu{-1};
+  /** NUMA node of worker_cpu, -1 if the worker is not pinned. */
+  std::atomic<int> numa_node{-1};
+  /** Connections accepted by the worker. */
+  std::atomic<uint64_t> accepted_connections{0};
   std::thread worker;
   std::map<int, std::weak_ptr<ServiceManager> > service_manager_set;
+  /** Listening sockets with connections pending, in round robin order. */
+  std::vector<int> ready_listeners;
+  /** Connections accepted in each loop iteration, see AcceptBudget. */
+  int accept_budget{ACCEPT_BUDGET};
+  /** Connections lost because accept() failed. */
+  std::atomic<uint64_t> accept_failures{0};
+  /** Listening sockets out of the event manager after running out of file
+   * descriptors, until accept_resume_ms. */
+  std::vector<int> paused_listeners;
+  uint64_t accept_resume_ms{0};
   std::atomic<bool> is_running{};
-  std::unordered_map<int, HttpStream *> streams_set;
-  std::unordered_map<int, HttpStream *> timers_set;
-  void HandleEvent(int fd, EVENT_TYPE event_type,
-                   EVENT_GROUP event_group) override;
+  /** HttpStream of each client and backend fd handled by the worker. */
+  StreamTable streams_set;
+  /** Request, connect and response timeouts of the streams. */
+  events::TimerWheel timer_wheel;
+  /** Control tasks posted by other threads to run in the worker. */
+  events::Mailbox mailbox;
+  /** Connection buffers of the worker streams. */
+  BufferPool buffer_pool;
+  /** Splice pipes of the worker streams. */
+  PipePool pipe_pool;
+  /** Idle keep-alive connections to the backends of the worker. */
+  ConnectionPool connection_pool;
+  /** Backend connection being set up in advance for the connection pool. */
+  struct WarmConnection {
+    Connection connection;
+    /* keeps the backend alive if the listener is reloaded meanwhile */
+    std::shared_ptr<ServiceManager> service_manager;
+    Backend *backend{nullptr};
+    std::string key;
+    std::chrono::steady_clock::time_point deadline;
+  };
+  /** Connections warming up for the connection pool by fd. */
+  std::unordered_map<int, std::unique_ptr<WarmConnection>> warm_connections;
+  std::chrono::steady_clock::time_point last_warm_up;
+  friend class EpollManager<StreamManager>;
+  void HandleEvent(int fd, EVENT_TYPE event_type, EVENT_GROUP event_group);
+  /**
+   * @brief Reads the MSG_ZEROCOPY completions of a client socket.
+   * @return @c true if the error was only the completions queued.
+   */
+  bool onErrorEvent(int fd, EVENT_GROUP event_group, uint32_t event_mask);
+  uint32_t getFdGeneration(int fd) const final {
+    return streams_set.getGeneration(fd);
+  }
   void doWork();
+  /**
+   * @brief Accepts the connections of the ready listeners, one from each in
+   * turn until the accept budget is spent or their queues are empty.
+   */
+  void acceptConnections();
+  /**
+   * @brief Stops polling @p listen_fd for a while, its pending connections
+   * can not be accepted until some file descriptors are released.
+   */
+  void pauseAccept(int listen_fd);
+  /** Polls again the paused listeners once their backoff has expired. */
+  void resumeAccept();
+  /** Dispatches the expired stream timeouts to their handlers. */
+  void onTimerWheelEvent();
 
 public:
   StreamManager();
@@ -145,8 +210,7 @@ public:
    * @brief Adds a HttpStream to the stream set of the StreamManager.registerListener
    *
    * If the @p fd is already stored in the set it clears the
-   * older one and adds the new one. In addition sets the connect timeout
-   * TimerFd.
+   * older one and adds the new one. In addition arms the request timeout.
    *
    * @param fd is the file descriptor to add.
    * @param listener_config of the accepted connection to add.
@@ -171,18 +235,42 @@ public:
    * StreamManager initializes ssl::SSLConnectionManager too.
    *
    * @param listener_config from the configuration file.
+   * @param handover has the sockets of the previous listeners, the one bound
+   * to the same address is taken instead of binding a new one.
    * @returns @c true if everything is fine.
    */
-  bool registerListener(std::weak_ptr<ServiceManager> service_manager);
+  bool registerListener(std::weak_ptr<ServiceManager> service_manager,
+                        ListenerHandover *handover = nullptr);
+
+  /**
+   * @brief Accepts the connections of the listening socket @p listen_fd for
+   * @p service_manager.
+   * @returns @c true if everything is fine.
+   */
+  bool registerListenerSocket(std::weak_ptr<ServiceManager> service_manager,
+                              int listen_fd);
+
+  /**
+   * @brief Adds a copy of the listening sockets of the worker to
+   * @p handover, the worker keeps accepting on them.
+   */
+  void copyListeners(ListenerHandover &handover);
 
   /**
    * @brief Starts the StreamManager event manager.
    *
-   * Sets the thread name to WORKER_"{worker_id}" and call doWork().
+   * Sets the thread name to WORKER_"{worker_id}" and call doWork(). If a
+   * @p cpu is given the worker thread is pinned to it and its memory is
+   * allocated in the NUMA node of the CPU. The StreamManager
+   * itself, built by the caller thread, is moved to that node by the worker.
    *
    * @param thread_id_ thread id to call functions on them.
+   * @param cpu is the CPU to pin the worker to, -1 to not pin it.
+   * @param handover has the listening sockets received from the previous
+   * process.
    */
-  void start(int thread_id_ = 0);
+  void start(int thread_id_ = 0, int cpu = -1,
+             ListenerHandover *handover = nullptr);
 
   /**
    * @brief Stops the StreamManager event manager.
@@ -223,9 +311,9 @@ public:
    * the HttpStream. Furthermore, it updates the backend status to
    * BACKEND_STATUS::BACKEND_DOWN.
    *
-   * @param fd is the file descriptor used to get the HttpStream.
+   * @param stream is the HttpStream whose timer has expired.
    */
-  inline void onConnectTimeoutEvent(int fd);
+  inline void onConnectTimeoutEvent(HttpStream *stream);
 
   /**
    * @brief Handles the response timeout event.
@@ -233,9 +321,9 @@ public:
    * This means the backend take too long sending the response. It clearStream()
    * on the HttpStream and replies a 504 Gateway Timeout error to the client.
    *
-   * @param fd is the file descriptor used to get the HttpStream.
+   * @param stream is the HttpStream whose timer has expired.
    */
-  inline void onResponseTimeoutEvent(int fd);
+  inline void onResponseTimeoutEvent(HttpStream *stream);
 
   /**
    * @brief Handles the request timeout event.
@@ -243,9 +331,9 @@ public:
    * This means the client take too long sending the request. It clearStream()
    * on the HttpStream and do not send any error to the client.
    *
-   * @param fd is the file descriptor used to get the HttpStream.
+   * @param stream is the HttpStream whose timer has expired.
    */
-  inline void onRequestTimeoutEvent(int fd);
+  inline void onRequestTimeoutEvent(HttpStream *stream);
   inline void onSignalEvent(int fd);
   inline void setStreamBackend(HttpStream *stream);
   /**
@@ -270,6 +358,80 @@ public:
    */
   inline void onClientWriteEvent(HttpStream *stream);
 
+  /**
+   * @brief Returns the connection buffers of an idle HttpStream to the pool.
+   *
+   * Buffers are kept while the connection is pinned or there is pending
+   * request or response data to forward.
+   *
+   * @param stream is the HttpStream to check.
+   */
+  inline void releaseIdleBuffers(HttpStream *stream);
+
+  /**
+   * @brief Returns the backend connection of an idle HttpStream to the
+   * connection pool.
+   *
+   * The connection is kept while it is pinned, there is pending request or
+   * response data to forward, the last response does not allow to reuse it
+   * or the event being handled tells the backend has closed it.
+   *
+   * @param stream is the HttpStream to check.
+   * @return @c true if the connection was returned to the pool.
+   */
+  bool releaseBackend(HttpStream *stream);
+
+  /**
+   * @brief Takes an idle connection to @p backend from the connection pool.
+   * @return @c true if the stream backend connection has been set up with it.
+   */
+  bool acquireBackend(HttpStream *stream, Backend &backend);
+
+  /**
+   * @brief Connects the backends whose idle connections in the pool, counting
+   * the ones being set up, are below their PoolMinIdle. It runs at most once
+   * per second. The HTTPS backends of the listeners forwarding the SNI server
+   * name are skipped, their connections are not shared between the clients.
+   */
+  void warmUpPool();
+
+  /**
+   * @brief Completes the connect and the TLS handshake of a connection
+   * warming up and moves it to the connection pool.
+   */
+  void onWarmUpEvent(int fd, EVENT_TYPE event_type);
+
+  /** @brief Moves a connection set up by warmUpPool() to the pool. */
+  void poolWarmConnection(WarmConnection &warm);
+
+  /**
+   * @brief Checks if the body data read from @p connection is forwarded
+   * without going through the connection buffer.
+   *
+   * Only plain HTTP data of a pinned connection or a message whose headers
+   * have been sent is forwarded, once the connection buffer has been flushed.
+   * HTTPS data is forwarded too if the kernel does the TLS crypto (kTLS) of
+   * both connections.
+   *
+   * @param stream is the HttpStream the connection belongs to.
+   * @param connection is the connection to read from.
+   * @param message is the message being read from @p connection.
+   * @return true if the data has to be read with readBody().
+   */
+  inline bool forwardsBody(HttpStream *stream, Connection &connection,
+                           http_parser::HttpData &message);
+
+  /**
+   * @brief Reads the body data of @p message without reading past its end.
+   *
+   * The data is spliced into the connection pipe if the listener has
+   * ZeroCopy enabled, if not it is read into the connection segment chain.
+   *
+   * @return the IO::IO_RESULT of the read.
+   */
+  inline IO::IO_RESULT readBody(HttpStream *stream, Connection &connection,
+                                http_parser::HttpData &message);
+
 
   /**
    * @brief Clears the HttpStream.
@@ -302,10 +464,32 @@ public:
    * @return true if should handle the task, false if not.
    */
   bool isHandler(ctl::CtlTask &task) override;
+
+  /**
+   * @brief Queues @p task to be run by the worker thread.
+   * @return @c false if the worker is not running.
+   */
+  bool postTask(std::function<void()> task) override;
   /**
    * @brief Stop gracefully the listener from accepting more connections.
    * @param stop immediately established connections.
+   * @param handover gets the listening sockets instead of closing them.
    * @return true if should handle the task, false if not.
    */
-  void stopListener(int listener_id, bool cut_connection = false);
+  void stopListener(int listener_id, bool cut_connection = false,
+                    ListenerHandover *handover = nullptr);
+
+  inline int getWorkerCpu() const { return worker_cpu; }
+  inline int getNumaNode() const { return numa_node; }
+  inline uint64_t getAcceptedConnections() const {
+    return accepted_connections.load(std::memory_order_relaxed);
+  }
+  inline uint64_t getAcceptFailures() const {
+    return accept_failures.load(std::memory_order_relaxed);
+  }
+  inline const BufferPool &getBufferPool() const { return buffer_pool; }
+  inline const PipePool &getPipePool() const { return pipe_pool; }
+  inline const ConnectionPool &getConnectionPool() const {
+    return connection_pool;
+  }
 };
@@ -0,0 +1,108 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+class HttpStream;
+
+/** Initial number of slots of the StreamTable. */
+#define STREAM_TABLE_INITIAL_SIZE 1024
+
+/**
+ * @class StreamTable stream_table.h "src/stream/stream_table.h"
+ * @brief Dense table of the HttpStream handled by a worker, indexed by file
+ * descriptor.
+ *
+ * Each slot keeps a generation counter that changes every time the slot gets a
+ * new HttpStream or it is cleared. The EpollManager tags the events with the
+ * generation of the fd when they are registered, so events of a closed fd
+ * that has been reused in the same loop are discarded without any lookup.
+ */
+class StreamTable {
+  struct Slot {
+    HttpStream *stream{nullptr};
+    uint32_t generation{0};
+  };
+  std::vector<Slot> slots;
+  size_t count{0};
+
+ public:
+  StreamTable() : slots(STREAM_TABLE_INITIAL_SIZE) {}
+
+  /** @return the HttpStream of the @p fd or nullptr if there is none. */
+  inline HttpStream *get(int fd) const {
+    return static_cast<size_t>(fd) < slots.size() ? slots[fd].stream : nullptr;
+  }
+
+  /**
+   * @brief Sets the @p stream of the @p fd, the slot generation changes if the
+   * stream is not the one already stored.
+   */
+  inline void set(int fd, HttpStream *stream) {
+    if (fd < 0) return;
+    if (static_cast<size_t>(fd) >= slots.size())
+      slots.resize(std::max(static_cast<size_t>(fd) + 1, slots.size() * 2));
+    auto &slot = slots[fd];
+    if (slot.stream == stream) return;
+    if (slot.stream == nullptr) count++;
+    if (stream == nullptr) count--;
+    slot.stream = stream;
+    slot.generation++;
+  }
+
+  /** @brief Clears the slot of the @p fd. */
+  inline void erase(int fd) {
+    if (static_cast<size_t>(fd) < slots.size()) set(fd, nullptr);
+  }
+
+  /** @return the current generation of the @p fd slot. */
+  inline uint32_t getGeneration(int fd) const {
+    return static_cast<size_t>(fd) < slots.size() ? slots[fd].generation : 0;
+  }
+
+  /** @return the number of fds with a HttpStream. */
+  inline size_t size() const { return count; }
+
+  /** @return the number of slots allocated. */
+  inline size_t capacity() const { return slots.size(); }
+
+  /** @return the memory of the slots, @p bytes is set to its size. */
+  inline void *data(size_t &bytes) {
+    bytes = slots.size() * sizeof(Slot);
+    return slots.data();
+  }
+
+  /**
+   * @brief Calls @p func(fd, stream) for each fd with a HttpStream. The
+   * function can clear any slot of the table.
+   */
+  template <typename Func>
+  void forEach(Func func) {
+    for (size_t fd = 0; fd < slots.size(); fd++) {
+      if (slots[fd].stream != nullptr)
+        func(static_cast<int>(fd), slots[fd].stream);
+    }
+  }
+};
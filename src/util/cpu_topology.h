@@ -0,0 +1,166 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace helper {
+
+/**
+ * @struct CpuTopology cpu_topology.h "src/util/cpu_topology.h"
+ * @brief Reads the CPU and NUMA layout exported by the kernel in sysfs and
+ * computes the CPUs the workers are pinned to.
+ */
+struct CpuTopology {
+  /**
+   * @brief Parses a CPU list in the sysfs and cpuset format, "0,2,4-7".
+   * CPUs must be lower than CPU_SETSIZE.
+   * @return the CPUs in the list, empty if it is not valid.
+   */
+  static std::vector<int> parseCpuList(const std::string &list) {
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while (pos < list.size()) {
+      char *end;
+      long first = std::strtol(list.c_str() + pos, &end, 10);
+      if (end == list.c_str() + pos || first < 0) return {};
+      long last = first;
+      if (*end == '-') {
+        auto range = end + 1;
+        last = std::strtol(range, &end, 10);
+        if (end == range || last < first) return {};
+      }
+      if (last >= CPU_SETSIZE) return {};
+      for (long cpu = first; cpu <= last; cpu++)
+        cpus.push_back(static_cast<int>(cpu));
+      pos = static_cast<size_t>(end - list.c_str());
+      if (pos < list.size() && list[pos] != ',' && list[pos] != '\n') return {};
+      pos++;
+    }
+    return cpus;
+  }
+
+  /** @return the CPUs the process is allowed to run on. */
+  static std::vector<int> getAllowedCpus() {
+    std::vector<int> cpus;
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    if (::sched_getaffinity(0, sizeof(cpuset), &cpuset) != 0) return cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      if (CPU_ISSET(cpu, &cpuset)) cpus.push_back(cpu);
+    return cpus;
+  }
+
+  /**
+   * @brief Gets the first hardware thread of the physical core of @p cpu.
+   * @return the sibling CPU, @p cpu itself if the topology is not available.
+   */
+  static int getCoreLeader(int cpu) {
+    auto siblings = parseCpuList(readSysFile(
+        "/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
+        "/topology/thread_siblings_list"));
+    return siblings.empty() ? cpu : siblings.front();
+  }
+
+  /** @return the NUMA node of @p cpu, 0 if the system is not NUMA. */
+  static int getNumaNode(int cpu) {
+    for (auto node :
+         parseCpuList(readSysFile("/sys/devices/system/node/online"))) {
+      auto cpus = parseCpuList(readSysFile("/sys/devices/system/node/node" +
+                                           std::to_string(node) + "/cpulist"));
+      if (std::find(cpus.begin(), cpus.end(), cpu) != cpus.end()) return node;
+    }
+    return 0;
+  }
+
+  /**
+   * @brief Computes the CPUs assigned to the workers from the WorkerAffinity
+   * policy.
+   *
+   * @param policy is "none", "physical" to use one hardware thread of each
+   * physical core, or an explicit CPU list.
+   * @return the CPUs in the order they are assigned to the workers, empty if
+   * the workers must not be pinned.
+   */
+  static std::vector<int> getWorkerCpus(const std::string &policy) {
+    if (policy.empty() || policy == "none") return {};
+    auto allowed = getAllowedCpus();
+    std::vector<int> cpus;
+    if (policy == "physical") {
+      for (auto cpu : allowed)
+        if (getCoreLeader(cpu) == cpu) cpus.push_back(cpu);
+    } else {
+      for (auto cpu : parseCpuList(policy))
+        if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end())
+          cpus.push_back(cpu);
+    }
+    return cpus;
+  }
+
+  /**
+   * @brief Makes the memory allocated from now on by the calling thread
+   * prefer the NUMA @p node.
+   * @return @c true on success.
+   */
+  static bool setPreferredNode(int node) {
+    if (node < 0 || node >= static_cast<int>(sizeof(unsigned long) * 8))
+      return false;
+    unsigned long mask = 1UL << node;
+    return ::syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask,
+                     sizeof(mask) * 8) == 0;
+  }
+
+  /**
+   * @brief Moves the pages of the object at @p addr of @p length bytes to the
+   * NUMA @p node and makes the ones not touched yet prefer it. The pages only
+   * partially covered by the object are left where they are.
+   * @return @c true on success.
+   */
+  static bool moveToNode(void *addr, size_t length, int node) {
+    if (node < 0 || node >= static_cast<int>(sizeof(unsigned long) * 8))
+      return false;
+    auto page = static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE));
+    auto start = (reinterpret_cast<uintptr_t>(addr) + page - 1) & ~(page - 1);
+    auto end = (reinterpret_cast<uintptr_t>(addr) + length) & ~(page - 1);
+    if (end <= start) return true;
+    unsigned long mask = 1UL << node;
+    return ::syscall(SYS_mbind, start, end - start, MPOL_PREFERRED, &mask,
+                     sizeof(mask) * 8, MPOL_MF_MOVE) == 0;
+  }
+
+ private:
+  static std::string readSysFile(const std::string &path) {
+    std::ifstream file(path);
+    std::string content;
+    std::getline(file, content);
+    return content;
+  }
+};
+}  // namespace helper
@@ -0,0 +1,85 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+/**
+ * @class MpscQueue mpsc_queue.h "src/util/mpsc_queue.h"
+ * @brief Lock-free unbounded multiple producer, single consumer queue.
+ *
+ * Producers link a new node with a single atomic exchange and never wait for
+ * each other or for the consumer. An item being pushed becomes visible once
+ * its producer links it, so pop() may miss it for a moment; producers must
+ * wake the consumer after push() returns.
+ */
+template <typename T>
+class MpscQueue {
+  struct Node {
+    std::atomic<Node *> next{nullptr};
+    T value{};
+  };
+  /** Last node pushed, shared by the producers. */
+  std::atomic<Node *> head;
+  /** Node already consumed, its next one is the first to pop. */
+  Node *tail;
+
+ public:
+  MpscQueue() : head(new Node()), tail(head.load()) {}
+  ~MpscQueue() {
+    T value;
+    while (pop(value)) {
+    }
+    delete tail;
+  }
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+
+  /** @brief Adds @p value at the end of the queue. Can be called from any
+   * thread. */
+  void push(T value) {
+    auto node = new Node();
+    node->value = std::move(value);
+    auto prev = head.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  /**
+   * @brief Removes the first item of the queue. Only the consumer thread can
+   * call it.
+   * @param value is set to the item removed.
+   * @return @c false if the queue is empty.
+   */
+  bool pop(T &value) {
+    auto next = tail->next.load(std::memory_order_acquire);
+    if (next == nullptr) return false;
+    value = std::move(next->value);
+    delete tail;
+    tail = next;
+    return true;
+  }
+
+  /** @return @c true if there is nothing to pop. Only for the consumer. */
+  bool empty() const {
+    return tail->next.load(std::memory_order_acquire) == nullptr;
+  }
+};
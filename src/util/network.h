@@ -28,6 +28,12 @@
 #include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#ifndef TCP_FASTOPEN_CONNECT
+#define TCP_FASTOPEN_CONNECT 30
+#endif
+#ifndef TCPI_OPT_SYN_DATA
+#define TCPI_OPT_SYN_DATA 32
+#endif
 
 class Network {
  public:
@@ -255,6 +261,20 @@ class Network {
            -1;
   }
 
+  /**
+   * @brief Sets the CPU of the listening socket @p sock_fd, so the connections
+   * received on @p cpu are queued to it rather than to the other sockets of
+   * its SO_REUSEPORT group. Unlike a program indexing the group, it does not
+   * depend on the order of the sockets in the group.
+   *
+   * Kernels older than 6.1 accept the option but ignore it in the group.
+   * @return @c false if the option could not be set.
+   */
+  inline static bool setIncomingCpu(int sock_fd, int cpu) {
+    return setsockopt(sock_fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu,
+                      sizeof(cpu)) != -1;
+  }
+
   inline static bool setTcpNoDelayOption(int sock_fd) {
     int flag = 1;
     return setsockopt(sock_fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag)) != -1;
@@ -282,10 +302,28 @@ class Network {
   }
 
   /*useful for use with send file, wait 200 ms to to fill TCP packet*/
-  inline static bool setTcpCorkOption(int sock_fd) {
-    int flag = 1;
+  inline static bool setTcpCorkOption(int sock_fd, bool enable = true) {
+    int flag = enable ? 1 : 0;
     return setsockopt(sock_fd, IPPROTO_TCP, TCP_CORK, &flag, sizeof(flag)) != -1;
   }
+  /* accept data in the SYN of the clients with a valid cookie, @p queue_len
+   * bounds the connections pending of the 3WHS that carried data */
+  inline static bool setTcpFastOpenOption(int sock_fd, int queue_len) {
+    return setsockopt(sock_fd, IPPROTO_TCP, TCP_FASTOPEN, &queue_len, sizeof(queue_len)) != -1;
+  }
+  /* connect() returns at once and the SYN leaves with the first write, with
+   * its data if there is a cookie for the peer */
+  inline static bool setTcpFastOpenConnectOption(int sock_fd) {
+    int flag = 1;
+    return setsockopt(sock_fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &flag, sizeof(flag)) != -1;
+  }
+  /* true if the data sent or received in the SYN has been acknowledged */
+  inline static bool isSynDataAcked(int sock_fd) {
+    tcp_info info{};
+    socklen_t len = sizeof(info);
+    return getsockopt(sock_fd, IPPROTO_TCP, TCP_INFO, &info, &len) != -1 &&
+           (info.tcpi_options & TCPI_OPT_SYN_DATA) != 0;
+  }
 #ifdef SO_ZEROCOPY
   /*useful for use with send file, wait 200 ms to to fill TCP packet*/
   inline static bool setSoZeroCopy(int sock_fd) {
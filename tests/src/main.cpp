@@ -31,6 +31,22 @@
 #include "t_observer.h"
 #include "t_sslcontext.h"
 #include "t_timerfd.h"
+#include "t_timer_wheel.h"
+#include "t_stream_table.h"
+#include "t_mailbox.h"
+#include "t_cpu_topology.h"
+#include "t_reuseport.h"
+#include "t_buffer_pool.h"
+#include "t_zero_copy.h"
+#include "t_ktls.h"
+#include "t_write_cork.h"
+#include "t_connection_pool.h"
+#include "t_pipelining.h"
+#include "t_dns_resolver.h"
+#include "t_fast_open.h"
+#include "t_listener_handover.h"
+#include "t_accept.h"
+#include "t_header_matcher.h"
 #include "tst_basictest.h"
 #include "t_priority.h"
 
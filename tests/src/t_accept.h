@@ -0,0 +1,107 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include "../../src/connection/connection.h"
+#include "../../src/util/network.h"
+#include "gtest/gtest.h"
+
+TEST(AcceptTest, InheritsListenerOptions) {
+  auto address = Network::getAddress("127.0.0.1", 0);
+  int listener = Connection::listen(*address);
+  ASSERT_GT(listener, 0);
+  Network::setSocketNonBlocking(listener);
+  sockaddr_in addr{};
+  socklen_t addr_len = sizeof(addr);
+  ::getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &addr_len);
+  EXPECT_EQ(0, Connection::doAccept(listener));
+
+  /* TCP_DEFER_ACCEPT holds the connection until the client sends data */
+  int client = ::socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_EQ(0, ::connect(client, reinterpret_cast<sockaddr *>(&addr),
+                         addr_len));
+  ASSERT_EQ(1, ::write(client, "x", 1));
+  pollfd readable{listener, POLLIN, 0};
+  ASSERT_EQ(1, ::poll(&readable, 1, 1000));
+  int accepted = Connection::doAccept(listener);
+  ASSERT_GT(accepted, 0);
+  EXPECT_EQ(O_NONBLOCK, ::fcntl(accepted, F_GETFL) & O_NONBLOCK);
+  EXPECT_EQ(FD_CLOEXEC, ::fcntl(accepted, F_GETFD) & FD_CLOEXEC);
+
+  int flag = 0;
+  socklen_t len = sizeof(flag);
+  ::getsockopt(accepted, IPPROTO_TCP, TCP_NODELAY, &flag, &len);
+  EXPECT_NE(0, flag);
+  flag = 0;
+  ::getsockopt(accepted, SOL_SOCKET, SO_KEEPALIVE, &flag, &len);
+  EXPECT_NE(0, flag);
+  linger l{};
+  len = sizeof(l);
+  ::getsockopt(accepted, SOL_SOCKET, SO_LINGER, &l, &len);
+  EXPECT_EQ(1, l.l_onoff);
+  EXPECT_EQ(10, l.l_linger);
+  ::close(accepted);
+  ::close(client);
+  ::close(listener);
+}
+
+TEST(AcceptTest, ReportsFdExhaustion) {
+  auto address = Network::getAddress("127.0.0.1", 0);
+  int listener = Connection::listen(*address);
+  ASSERT_GT(listener, 0);
+  Network::setSocketNonBlocking(listener);
+  sockaddr_in addr{};
+  socklen_t addr_len = sizeof(addr);
+  ::getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &addr_len);
+  int client = ::socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_EQ(0, ::connect(client, reinterpret_cast<sockaddr *>(&addr),
+                         addr_len));
+  ASSERT_EQ(1, ::write(client, "x", 1));
+  pollfd readable{listener, POLLIN, 0};
+  ASSERT_EQ(1, ::poll(&readable, 1, 1000));
+
+  /* the lowest free fd is over the limit */
+  rlimit saved{};
+  ::getrlimit(RLIMIT_NOFILE, &saved);
+  int lowest = ::dup(client);
+  ::close(lowest);
+  rlimit low = saved;
+  low.rlim_cur = static_cast<rlim_t>(lowest);
+  ASSERT_EQ(0, ::setrlimit(RLIMIT_NOFILE, &low));
+  errno = 0;
+  int accepted = Connection::doAccept(listener);
+  int error = errno;
+  ::setrlimit(RLIMIT_NOFILE, &saved);
+  EXPECT_EQ(-1, accepted);
+  EXPECT_EQ(EMFILE, error);
+
+  /* the connection is still queued */
+  accepted = Connection::doAccept(listener);
+  EXPECT_GT(accepted, 0);
+  if (accepted > 0) ::close(accepted);
+  ::close(client);
+  ::close(listener);
+}
@@ -0,0 +1,130 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstring>
+#include <string>
+#include "../../src/connection/buffer_pool.h"
+#include "../../src/connection/connection.h"
+#include "../../src/connection/segment_buffer.h"
+#include "gtest/gtest.h"
+
+TEST(BufferPoolTest, SizeClassesHitsAndMisses) {
+  BufferPool pool;
+  size_t capacity = 0;
+  auto small = pool.acquire(100, capacity);
+  EXPECT_EQ(BUFFER_POOL_SMALL_SIZE, capacity);
+  EXPECT_EQ(1u, pool.getStats(0).misses.load());
+  pool.release(small, capacity);
+  EXPECT_EQ(1, pool.getStats(0).cached.load());
+  EXPECT_EQ(0, pool.getStats(0).in_use.load());
+
+  auto reused = pool.acquire(BUFFER_POOL_SMALL_SIZE, capacity);
+  EXPECT_EQ(small, reused);
+  EXPECT_EQ(1u, pool.getStats(0).hits.load());
+  EXPECT_EQ(1, pool.getStats(0).in_use.load());
+
+  auto large = pool.acquire(BUFFER_POOL_SMALL_SIZE + 1, capacity);
+  EXPECT_EQ(static_cast<size_t>(MAX_DATA_SIZE), capacity);
+  EXPECT_EQ(1u, pool.getStats(1).misses.load());
+  pool.release(large, capacity);
+  pool.release(reused, BUFFER_POOL_SMALL_SIZE);
+  EXPECT_EQ(0, pool.getStats(1).in_use.load());
+  EXPECT_EQ(1, pool.getStats(1).cached.load());
+}
+
+TEST(BufferPoolTest, ConnectionBufferOnDemand) {
+  BufferPool pool;
+  BufferPool::setLocal(&pool);
+  {
+    Connection connection;
+    connection.buffer_size_hint = BUFFER_POOL_SMALL_SIZE;
+    EXPECT_EQ(nullptr, connection.buffer);
+    connection.acquireBuffer();
+    ASSERT_NE(nullptr, connection.buffer);
+    EXPECT_EQ(BUFFER_POOL_SMALL_SIZE, connection.buffer_capacity);
+
+    /* buffers with pending data are kept, grown ones keep their content */
+    std::memcpy(connection.buffer, "GET / HTTP/1.1\r\n", 16);
+    connection.buffer_size = 16;
+    connection.releaseBuffer();
+    ASSERT_NE(nullptr, connection.buffer);
+    EXPECT_TRUE(connection.growBuffer());
+    EXPECT_EQ(static_cast<size_t>(MAX_DATA_SIZE), connection.buffer_capacity);
+    EXPECT_EQ(0, std::memcmp(connection.buffer, "GET / HTTP/1.1\r\n", 16));
+    EXPECT_FALSE(connection.growBuffer());
+
+    connection.buffer_size = 0;
+    connection.releaseBuffer();
+    EXPECT_EQ(nullptr, connection.buffer);
+    EXPECT_EQ(0, pool.getStats(0).in_use.load());
+    EXPECT_EQ(0, pool.getStats(1).in_use.load());
+    EXPECT_EQ(1, pool.getStats(1).cached.load());
+  }
+  BufferPool::setLocal(nullptr);
+}
+
+TEST(BufferPoolTest, SegmentBufferForwardsAcrossSegments) {
+  BufferPool pool;
+  BufferPool::setLocal(&pool);
+  int in[2], out[2];
+  ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM, 0, in));
+  ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM, 0, out));
+  int buffer_size = 1024 * 1024;
+  for (int fd : {in[0], in[1], out[0], out[1]}) {
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+    ::fcntl(fd, F_SETFL, O_NONBLOCK);
+  }
+  std::string data;
+  for (int i = 0; data.size() < 3 * MAX_DATA_SIZE; i++)
+    data += std::to_string(i) + ",";
+  ASSERT_EQ(static_cast<ssize_t>(data.size()),
+            ::write(in[0], data.data(), data.size()));
+  {
+    SegmentBuffer segments;
+    /* the limit stops the read before the end of the data */
+    EXPECT_EQ(IO::IO_RESULT::FULL_BUFFER, segments.readFrom(in[1], 100));
+    EXPECT_EQ(100u, segments.size());
+    EXPECT_EQ(IO::IO_RESULT::SUCCESS, segments.readFrom(in[1], SIZE_MAX));
+    EXPECT_EQ(data.size(), segments.size());
+    EXPECT_EQ(4u, segments.segmentCount());
+    iovec iov[SEGMENT_BUFFER_MAX_SEGMENTS];
+    EXPECT_EQ(4u, segments.getIovec(iov, SEGMENT_BUFFER_MAX_SEGMENTS));
+    EXPECT_EQ(IO::IO_RESULT::DONE_TRY_AGAIN, segments.readFrom(in[1], SIZE_MAX));
+
+    size_t sent = 0;
+    EXPECT_EQ(IO::IO_RESULT::SUCCESS, segments.writeTo(out[0], sent));
+    EXPECT_EQ(data.size(), sent);
+    EXPECT_TRUE(segments.empty());
+    EXPECT_EQ(0u, segments.segmentCount());
+    EXPECT_EQ(0, pool.getStats(BufferPool::CLASS_COUNT - 1).in_use.load());
+  }
+  std::string received(data.size(), '\0');
+  EXPECT_EQ(static_cast<ssize_t>(data.size()),
+            ::read(out[1], &received[0], received.size()));
+  EXPECT_EQ(data, received);
+  for (int fd : {in[0], in[1], out[0], out[1]}) ::close(fd);
+  BufferPool::setLocal(nullptr);
+}
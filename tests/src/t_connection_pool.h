@@ -0,0 +1,253 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <netinet/tcp.h>
+#include <string>
+#include "../../src/connection/connection.h"
+#include "../../src/connection/connection_pool.h"
+#include "gtest/gtest.h"
+#include "t_pipelining.h"
+#include "t_zero_copy.h"
+
+TEST(ConnectionPoolTest, ReusesIdleConnections) {
+  ConnectionPool pool;
+  int out[2];
+  ASSERT_TRUE(tcpPair(out));
+  Connection connection;
+  EXPECT_FALSE(pool.acquire("backend:80", connection));
+
+  connection.setFileDescriptor(out[0]);
+  EXPECT_TRUE(pool.release("backend:80", connection, 4, 10));
+  EXPECT_EQ(-1, connection.getFileDescriptor());
+  EXPECT_EQ(1u, pool.size("backend:80"));
+
+  /* the socket is kept open while it is idle */
+  EXPECT_EQ(1, ::write(out[1], "x", 1));
+  char data;
+  EXPECT_EQ(1, ::read(out[0], &data, 1));
+
+  Connection other;
+  EXPECT_FALSE(pool.acquire("backend:8080", other));
+  EXPECT_TRUE(pool.acquire("backend:80", other));
+  EXPECT_EQ(out[0], other.getFileDescriptor());
+  EXPECT_FALSE(other.ssl_connected);
+  EXPECT_EQ(0u, pool.size("backend:80"));
+
+  auto &stats = pool.getStats();
+  EXPECT_EQ(1u, stats.hits.load());
+  EXPECT_EQ(2u, stats.misses.load());
+  EXPECT_EQ(1u, stats.released.load());
+  EXPECT_EQ(0, stats.idle.load());
+  ::close(out[1]);
+}
+
+TEST(ConnectionPoolTest, SkipsClosedAndExpiredConnections) {
+  ConnectionPool pool;
+  int closed[2], expired[2], kept[2], extra[2];
+  ASSERT_TRUE(tcpPair(closed) && tcpPair(expired) && tcpPair(kept) &&
+              tcpPair(extra));
+  Connection connection;
+  connection.setFileDescriptor(kept[0]);
+  pool.release("backend", connection, 3, 10);
+  connection.setFileDescriptor(expired[0]);
+  pool.release("backend", connection, 3, 0);
+  connection.setFileDescriptor(closed[0]);
+  pool.release("backend", connection, 3, 10);
+  /* over the idle limit */
+  connection.setFileDescriptor(extra[0]);
+  EXPECT_FALSE(pool.release("backend", connection, 3, 10));
+  EXPECT_EQ(3u, pool.size("backend"));
+
+  ::close(closed[1]);
+  EXPECT_TRUE(pool.acquire("backend", connection));
+  EXPECT_EQ(kept[0], connection.getFileDescriptor());
+
+  auto &stats = pool.getStats();
+  EXPECT_EQ(1u, stats.closed.load());
+  EXPECT_EQ(1u, stats.expired.load());
+  EXPECT_EQ(1u, stats.discarded.load());
+  EXPECT_EQ(0, stats.idle.load());
+  /* the connections closed by the pool are seen by the peer */
+  char data;
+  EXPECT_EQ(0, ::read(expired[1], &data, 1));
+  EXPECT_EQ(0, ::read(extra[1], &data, 1));
+  ::close(expired[1]);
+  ::close(extra[1]);
+  ::close(kept[1]);
+}
+
+TEST(ConnectionPoolTest, CountsWarmedConnections) {
+  ConnectionPool pool;
+  int warmed[2], extra[2];
+  ASSERT_TRUE(tcpPair(warmed) && tcpPair(extra));
+  Connection connection;
+  connection.setFileDescriptor(warmed[0]);
+  EXPECT_TRUE(pool.warm("backend", connection, 1, 10));
+  connection.setFileDescriptor(extra[0]);
+  EXPECT_FALSE(pool.warm("backend", connection, 1, 10));
+
+  /* a warmed connection is taken as any other idle one */
+  EXPECT_TRUE(pool.acquire("backend", connection));
+  EXPECT_EQ(warmed[0], connection.getFileDescriptor());
+  auto &stats = pool.getStats();
+  EXPECT_EQ(1u, stats.warmed.load());
+  EXPECT_EQ(1u, stats.released.load());
+  EXPECT_EQ(1u, stats.discarded.load());
+  ::close(warmed[1]);
+  ::close(extra[1]);
+}
+
+TEST(ConnectionPoolTest, AcquiresWarmedConnection) {
+  int backend_listener = ::socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  ::setsockopt(backend_listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  auto backend_address = Network::getAddress("127.0.0.1", 9993);
+  ASSERT_EQ(0, ::bind(backend_listener, backend_address->ai_addr,
+                      backend_address->ai_addrlen));
+  ASSERT_EQ(0, ::listen(backend_listener, 4));
+
+  Config config;
+  ASSERT_TRUE(loadConfig("ListenHTTP\n"
+                         "  Address 127.0.0.1\n"
+                         "  Port 9992\n"
+                         "  Service \"s\"\n"
+                         "    BackEnd\n"
+                         "      Address 127.0.0.1\n"
+                         "      Port 9993\n"
+                         "      PoolMinIdle 1\n"
+                         "    End\n"
+                         "  End\n"
+                         "End\n",
+                         config));
+  auto service_manager = std::make_shared<ServiceManager>(config.listeners);
+  service_manager->addService(*config.listeners->services, 0);
+  StreamManager manager;
+  ASSERT_TRUE(manager.registerListener(service_manager));
+  manager.start();
+
+  /* the worker connects to the backend before there is any request */
+  pollfd pfd{backend_listener, POLLIN, 0};
+  ASSERT_GT(::poll(&pfd, 1, 3000), 0);
+  int warmed = ::accept(backend_listener, nullptr, nullptr);
+  ASSERT_GE(warmed, 0);
+  auto &stats = manager.getConnectionPool().getStats();
+  for (int i = 0; i < 200 && stats.warmed.load() == 0; i++) ::usleep(10000);
+  ASSERT_EQ(1u, stats.warmed.load());
+
+  int client = ::socket(AF_INET, SOCK_STREAM, 0);
+  auto address = Network::getAddress("127.0.0.1", 9992);
+  ASSERT_EQ(0, ::connect(client, address->ai_addr, address->ai_addrlen));
+  std::string request = "GET /warm HTTP/1.1\r\nHost: a\r\n\r\n";
+  ASSERT_EQ(static_cast<ssize_t>(request.size()),
+            ::write(client, request.data(), request.size()));
+  /* the request comes through the warmed connection */
+  std::string received;
+  bool forwarded = readUntil(warmed, received, "\r\n\r\n");
+  std::string response = "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nwarm!";
+  ::send(warmed, response.data(), response.size(), MSG_NOSIGNAL);
+  std::string responses;
+  bool answered = readUntil(client, responses, "warm!");
+  manager.stop();
+  ::close(client);
+  ::close(warmed);
+  ::close(backend_listener);
+
+  EXPECT_TRUE(forwarded);
+  EXPECT_EQ(0u, received.find("GET /warm HTTP/1.1\r\n"));
+  EXPECT_TRUE(answered);
+}
+
+TEST(ConnectionPoolTest, DoesNotPoolBackendClosedWithResponse) {
+  int backend_listener = ::socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  ::setsockopt(backend_listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  auto backend_address = Network::getAddress("127.0.0.1", 9991);
+  ASSERT_EQ(0, ::bind(backend_listener, backend_address->ai_addr,
+                      backend_address->ai_addrlen));
+  ASSERT_EQ(0, ::listen(backend_listener, 4));
+
+  Config config;
+  ASSERT_TRUE(loadConfig("ListenHTTP\n"
+                         "  Address 127.0.0.1\n"
+                         "  Port 9990\n"
+                         "  Service \"s\"\n"
+                         "    BackEnd\n"
+                         "      Address 127.0.0.1\n"
+                         "      Port 9991\n"
+                         "      PoolMaxIdle 4\n"
+                         "    End\n"
+                         "  End\n"
+                         "End\n",
+                         config));
+  auto service_manager = std::make_shared<ServiceManager>(config.listeners);
+  service_manager->addService(*config.listeners->services, 0);
+  StreamManager manager;
+  ASSERT_TRUE(manager.registerListener(service_manager));
+  manager.start();
+
+  /* the first response is sent in the same segment as the FIN, the worker
+   * gets both in one event */
+  std::thread backend_thread([&] {
+    std::string response = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok";
+    for (int i = 0; i < 2; i++) {
+      pollfd pfd{backend_listener, POLLIN, 0};
+      if (::poll(&pfd, 1, 2000) <= 0) return;
+      int fd = ::accept(backend_listener, nullptr, nullptr);
+      std::string request;
+      if (readUntil(fd, request, "\r\n\r\n")) {
+        if (i == 0) ::setsockopt(fd, IPPROTO_TCP, TCP_CORK, &one, sizeof(one));
+        ::send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+        if (i == 0) {
+          ::shutdown(fd, SHUT_WR);
+          /* until the worker closes it */
+          readUntil(fd, request, "\r\n\r\n");
+        }
+      }
+      ::close(fd);
+    }
+  });
+
+  /* the second client may get the fd number of the first backend connection,
+   * it must not be taken from the pool as a backend connection */
+  std::string responses[2];
+  uint64_t released = 0;
+  auto address = Network::getAddress("127.0.0.1", 9990);
+  for (auto &response : responses) {
+    released = manager.getConnectionPool().getStats().released.load();
+    int client = ::socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(0, ::connect(client, address->ai_addr, address->ai_addrlen));
+    std::string request = "GET /x HTTP/1.1\r\nHost: a\r\n\r\n";
+    ASSERT_EQ(static_cast<ssize_t>(request.size()),
+              ::write(client, request.data(), request.size()));
+    readUntil(client, response, "ok");
+    ::close(client);
+    ::usleep(50000);
+  }
+  backend_thread.join();
+  manager.stop();
+  ::close(backend_listener);
+
+  EXPECT_NE(std::string::npos, responses[0].find("200 OK"));
+  EXPECT_NE(std::string::npos, responses[1].find("200 OK"));
+  /* taken before the second request */
+  EXPECT_EQ(0u, released);
+}
@@ -0,0 +1,75 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <vector>
+#include "../../src/util/cpu_topology.h"
+#include "gtest/gtest.h"
+
+using helper::CpuTopology;
+
+TEST(CpuTopologyTest, ParseCpuList) {
+  EXPECT_EQ(CpuTopology::parseCpuList("0"), std::vector<int>({0}));
+  EXPECT_EQ(CpuTopology::parseCpuList("0,2,4-7"),
+            std::vector<int>({0, 2, 4, 5, 6, 7}));
+  EXPECT_EQ(CpuTopology::parseCpuList("1-3,8"), std::vector<int>({1, 2, 3, 8}));
+  EXPECT_TRUE(CpuTopology::parseCpuList("").empty());
+  EXPECT_TRUE(CpuTopology::parseCpuList("3-1").empty());
+  EXPECT_TRUE(CpuTopology::parseCpuList("1,a").empty());
+  EXPECT_TRUE(CpuTopology::parseCpuList("2-").empty());
+  EXPECT_TRUE(CpuTopology::parseCpuList("0-100000").empty());
+}
+
+TEST(CpuTopologyTest, WorkerCpus) {
+  auto allowed = CpuTopology::getAllowedCpus();
+  ASSERT_FALSE(allowed.empty());
+  EXPECT_TRUE(CpuTopology::getWorkerCpus("none").empty());
+  /* there is at least one physical core */
+  auto physical = CpuTopology::getWorkerCpus("physical");
+  ASSERT_FALSE(physical.empty());
+  EXPECT_LE(physical.size(), allowed.size());
+  for (auto cpu : physical) EXPECT_EQ(CpuTopology::getCoreLeader(cpu), cpu);
+  /* cpus not allowed are skipped */
+  auto list = std::to_string(allowed.front()) + ",1023";
+  EXPECT_EQ(CpuTopology::getWorkerCpus(list),
+            std::vector<int>({allowed.front()}));
+  EXPECT_GE(CpuTopology::getNumaNode(allowed.front()), 0);
+}
+
+TEST(CpuTopologyTest, MoveToNode) {
+  int node = CpuTopology::getNumaNode(CpuTopology::getAllowedCpus().front());
+  std::vector<char> object(4 * ::sysconf(_SC_PAGESIZE), 1);
+  if (!CpuTopology::moveToNode(object.data(), object.size(), node) &&
+      errno == ENOSYS)
+    GTEST_SKIP() << "NUMA policies not supported";
+  EXPECT_TRUE(CpuTopology::moveToNode(object.data(), object.size(), node));
+  /* the whole pages of the object are on the node */
+  int page_node = -1;
+  auto page = reinterpret_cast<uintptr_t>(object.data()) +
+              ::sysconf(_SC_PAGESIZE) - 1;
+  page &= ~static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE) - 1);
+  ASSERT_EQ(::syscall(SYS_get_mempolicy, &page_node, nullptr, 0,
+                      reinterpret_cast<void *>(page),
+                      MPOL_F_NODE | MPOL_F_ADDR),
+            0);
+  EXPECT_EQ(page_node, node);
+  EXPECT_FALSE(CpuTopology::moveToNode(object.data(), object.size(), -1));
+}
@@ -0,0 +1,334 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../src/event/dns_resolver.h"
+#include "../../src/service/backend.h"
+#include "../../src/service/service_manager.h"
+#include "gtest/gtest.h"
+#include "t_pipelining.h"
+
+/* Nameserver on a loopback port answering the queries of the test. */
+struct StubNameserver {
+  int fd{-1};
+  sockaddr_storage endpoint{};
+  /* name of the last query received */
+  std::string name;
+
+  StubNameserver() {
+    fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    auto &in4 = reinterpret_cast<sockaddr_in &>(endpoint);
+    in4.sin_family = AF_INET;
+    in4.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(in4);
+    ::bind(fd, reinterpret_cast<sockaddr *>(&in4), len);
+    ::getsockname(fd, reinterpret_cast<sockaddr *>(&in4), &len);
+    timeval timeout{1, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  }
+  ~StubNameserver() { ::close(fd); }
+
+  /* Answers the next query with the @p ipv4 addresses if it is an A query. */
+  bool answer(const std::vector<std::string> &ipv4, uint32_t ttl) {
+    uint8_t query[512];
+    sockaddr_storage from{};
+    socklen_t from_len = sizeof(from);
+    auto len = ::recvfrom(fd, query, sizeof(query), 0,
+                          reinterpret_cast<sockaddr *>(&from), &from_len);
+    if (len < 12) return false;
+    std::string message(reinterpret_cast<char *>(query),
+                        static_cast<size_t>(len));
+    name.clear();
+    for (size_t pos = 12; pos < message.size() && query[pos] != 0;
+         pos += 1 + query[pos])
+      name += (name.empty() ? "" : ".") + message.substr(pos + 1, query[pos]);
+    bool type_a = query[len - 3] == events::DnsResolver::A;
+    message[2] = '\x81';
+    message[3] = '\x80';
+    message[7] = static_cast<char>(type_a ? ipv4.size() : 0);
+    for (size_t i = 0; type_a && i < ipv4.size(); i++) {
+      /* the name is a pointer to the question */
+      message += std::string("\xc0\x0c\x00\x01\x00\x01", 6);
+      for (int shift = 24; shift >= 0; shift -= 8)
+        message += static_cast<char>(ttl >> shift);
+      message += std::string("\x00\x04", 2);
+      in_addr record{};
+      ::inet_pton(AF_INET, ipv4[i].data(), &record);
+      message.append(reinterpret_cast<char *>(&record), 4);
+    }
+    return ::sendto(fd, message.data(), message.size(), 0,
+                    reinterpret_cast<sockaddr *>(&from), from_len) > 0;
+  }
+};
+
+static std::string addressToString(const sockaddr_storage &address) {
+  char name[INET6_ADDRSTRLEN]{};
+  ::inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in &>(address).sin_addr,
+              name, sizeof(name));
+  return name;
+}
+
+TEST(DnsResolverTest, ParsesAnswers) {
+  uint8_t query[512];
+  auto len = events::DnsResolver::buildQuery("www.example.com", 0x1234,
+                                             events::DnsResolver::A, query,
+                                             sizeof(query));
+  ASSERT_EQ(33u, len);
+  EXPECT_EQ(0, std::memcmp(query + 12, "\3www\7example\3com\0", 17));
+  uint8_t invalid[512];
+  EXPECT_EQ(0u, events::DnsResolver::buildQuery("a..b", 1,
+                                                events::DnsResolver::A, invalid,
+                                                sizeof(invalid)));
+
+  /* a CNAME to a compressed name and the A record of its target */
+  std::string answer(reinterpret_cast<char *>(query), len);
+  answer[2] = '\x81';
+  answer[3] = '\x80';
+  answer[7] = 2;
+  answer += std::string("\xc0\x0c\x00\x05\x00\x01\x00\x00\x01\x00\x00\x06"
+                        "\3web\xc0\x10",
+                        18);
+  answer += std::string("\xc0\x2d\x00\x01\x00\x01\x00\x00\x00\x3c\x00\x04"
+                        "\x0a\x00\x00\x07",
+                        16);
+  uint16_t id;
+  uint32_t ttl;
+  std::vector<sockaddr_storage> addresses;
+  ASSERT_TRUE(events::DnsResolver::parseAnswer(
+      reinterpret_cast<const uint8_t *>(answer.data()), answer.size(), id,
+      addresses, ttl));
+  EXPECT_EQ(0x1234, id);
+  EXPECT_EQ(60u, ttl);
+  ASSERT_EQ(1u, addresses.size());
+  EXPECT_EQ("10.0.0.7", addressToString(addresses[0]));
+
+  /* truncated record */
+  EXPECT_FALSE(events::DnsResolver::parseAnswer(
+      reinterpret_cast<const uint8_t *>(answer.data()), answer.size() - 1, id,
+      addresses, ttl));
+  /* the name does not exist */
+  std::string nxdomain(reinterpret_cast<char *>(query), len);
+  nxdomain[2] = '\x81';
+  nxdomain[3] = '\x83';
+  addresses.clear();
+  EXPECT_TRUE(events::DnsResolver::parseAnswer(
+      reinterpret_cast<const uint8_t *>(nxdomain.data()), nxdomain.size(), id,
+      addresses, ttl));
+  EXPECT_TRUE(addresses.empty());
+  /* a query is not an answer */
+  EXPECT_FALSE(events::DnsResolver::parseAnswer(query, len, id, addresses,
+                                                ttl));
+}
+
+TEST(DnsResolverTest, RefreshesAddressesOnTtl) {
+  StubNameserver nameserver;
+  events::DnsResolver resolver;
+  ASSERT_TRUE(resolver.init({nameserver.endpoint}));
+  std::vector<std::vector<std::string>> results;
+  bool used = true;
+  resolver.setCallback([&](const std::string &,
+                           const std::vector<sockaddr_storage> &addresses) {
+    results.emplace_back();
+    for (auto &address : addresses)
+      results.back().push_back(addressToString(address));
+    return used;
+  });
+
+  /* numeric addresses are not queried */
+  resolver.watch("192.168.0.1");
+  ASSERT_EQ(1u, results.size());
+  EXPECT_EQ(std::vector<std::string>{"192.168.0.1"}, results[0]);
+  EXPECT_FALSE(resolver.isWatched("192.168.0.1"));
+  results.clear();
+  resolver.watch("backend.test");
+  EXPECT_TRUE(resolver.isWatched("backend.test"));
+  ASSERT_TRUE(nameserver.answer({"127.0.0.1"}, 1));
+  ASSERT_TRUE(nameserver.answer({}, 1));
+  resolver.onReadEvent();
+  ASSERT_EQ(1u, results.size());
+  EXPECT_EQ(std::vector<std::string>{"127.0.0.1"}, results[0]);
+
+  /* the whole set is replaced when the TTL expires */
+  auto timeout = resolver.doWork();
+  EXPECT_GT(timeout, 0);
+  EXPECT_LE(timeout, 1000);
+  std::this_thread::sleep_for(std::chrono::milliseconds(timeout + 10));
+  resolver.doWork();
+  ASSERT_TRUE(nameserver.answer({"127.0.0.2", "127.0.0.3"}, 300));
+  ASSERT_TRUE(nameserver.answer({}, 300));
+  used = false;
+  resolver.onReadEvent();
+  ASSERT_EQ(2u, results.size());
+  EXPECT_EQ((std::vector<std::string>{"127.0.0.2", "127.0.0.3"}), results[1]);
+  /* it is no longer used */
+  EXPECT_FALSE(resolver.isWatched("backend.test"));
+  EXPECT_EQ(-1, resolver.doWork());
+}
+
+TEST(DnsResolverTest, AppliesSearchList) {
+  StubNameserver nameserver;
+  events::DnsResolver resolver;
+  ASSERT_TRUE(resolver.init({nameserver.endpoint}, {"example.test"}, 1));
+  EXPECT_EQ((std::vector<std::string>{"backend.example.test", "backend"}),
+            resolver.searchNames("backend"));
+  EXPECT_EQ((std::vector<std::string>{"web.backend", "web.backend.example.test"}),
+            resolver.searchNames("web.backend"));
+  EXPECT_EQ(std::vector<std::string>{"web.backend"},
+            resolver.searchNames("web.backend."));
+  std::vector<std::string> results;
+  resolver.setCallback([&](const std::string &,
+                           const std::vector<sockaddr_storage> &addresses) {
+    for (auto &address : addresses) results.push_back(addressToString(address));
+    return true;
+  });
+
+  /* the name is tried as is when it does not exist in the search domain */
+  resolver.watch("backend");
+  ASSERT_TRUE(nameserver.answer({}, 60));
+  EXPECT_EQ("backend.example.test", nameserver.name);
+  ASSERT_TRUE(nameserver.answer({}, 60));
+  resolver.onReadEvent();
+  EXPECT_TRUE(results.empty());
+  ASSERT_TRUE(nameserver.answer({"127.0.0.4"}, 60));
+  EXPECT_EQ("backend", nameserver.name);
+  ASSERT_TRUE(nameserver.answer({}, 60));
+  resolver.onReadEvent();
+  EXPECT_EQ(std::vector<std::string>{"127.0.0.4"}, results);
+}
+
+static std::string writeTempFile(const std::string &content) {
+  char path[] = "/tmp/zproxy_dns_XXXXXX";
+  int fd = ::mkstemp(path);
+  if (fd < 0) return "";
+  ::close(fd);
+  std::ofstream(path) << content;
+  return path;
+}
+
+TEST(DnsResolverTest, ReadsHostsFileAgain) {
+  auto resolv_conf = writeTempFile("nameserver 127.0.0.1\n");
+  auto hosts_file = writeTempFile("10.0.0.1 web # back-end\n");
+  events::DnsResolver resolver;
+  ASSERT_TRUE(resolver.init(resolv_conf, hosts_file, "/nonexistent"));
+  std::vector<std::vector<std::string>> results;
+  resolver.setCallback([&](const std::string &,
+                           const std::vector<sockaddr_storage> &addresses) {
+    results.emplace_back();
+    for (auto &address : addresses)
+      results.back().push_back(addressToString(address));
+    return true;
+  });
+  resolver.watch("WEB");
+  ASSERT_EQ(1u, results.size());
+  EXPECT_EQ(std::vector<std::string>{"10.0.0.1"}, results[0]);
+  auto timeout = resolver.doWork();
+  EXPECT_GT(timeout, 0);
+  EXPECT_LE(timeout, DNS_RESOLVER_HOSTS_TTL * 1000);
+
+  /* a change of the file is applied on the next call */
+  std::ofstream(hosts_file) << "10.0.0.20 web\n";
+  resolver.doWork();
+  ASSERT_EQ(2u, results.size());
+  EXPECT_EQ(std::vector<std::string>{"10.0.0.20"}, results[1]);
+  ::unlink(resolv_conf.data());
+  ::unlink(hosts_file.data());
+}
+
+TEST(DnsResolverTest, BackendBalancesBetweenAddresses) {
+  int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  socklen_t addr_len = sizeof(addr);
+  ASSERT_EQ(0, ::bind(listener, reinterpret_cast<sockaddr *>(&addr), addr_len));
+  ASSERT_EQ(0, ::listen(listener, 4));
+  ::getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &addr_len);
+
+  Backend backend;
+  backend.port = ntohs(addr.sin_port);
+  Connection none;
+  EXPECT_EQ(IO::IO_OP::OP_ERROR, backend.connect(none, 1, false));
+  std::vector<sockaddr_storage> addresses(2);
+  events::DnsResolver::parseAddress("127.0.0.1", addresses[0]);
+  events::DnsResolver::parseAddress("127.0.0.2", addresses[1]);
+  backend.setAddresses(addresses);
+
+  std::vector<std::string> peers;
+  for (int i = 0; i < 4; i++) {
+    Connection connection;
+    ASSERT_EQ(IO::IO_OP::OP_SUCCESS, backend.connect(connection, 1, false));
+    sockaddr_storage local{};
+    socklen_t local_len = sizeof(local);
+    int accepted = ::accept(listener, reinterpret_cast<sockaddr *>(&local),
+                            &local_len);
+    ASSERT_GE(accepted, 0);
+    ::getsockname(accepted, reinterpret_cast<sockaddr *>(&local), &local_len);
+    peers.push_back(addressToString(local));
+    ::close(accepted);
+  }
+  EXPECT_EQ((std::vector<std::string>{"127.0.0.1", "127.0.0.2", "127.0.0.1",
+                                      "127.0.0.2"}),
+            peers);
+  ::close(listener);
+}
+
+TEST(DnsResolverTest, WatchesBackendsAddedByControl) {
+  Config config;
+  ASSERT_TRUE(loadConfig("ListenHTTP\n"
+                         "  Address 127.0.0.1\n"
+                         "  Port 9988\n"
+                         "  Service \"s\"\n"
+                         "    BackEnd\n"
+                         "      Address 127.0.0.1\n"
+                         "      Port 9989\n"
+                         "    End\n"
+                         "  End\n"
+                         "End\n",
+                         config));
+  auto service_manager = std::make_shared<ServiceManager>(config.listeners);
+  service_manager->addService(*config.listeners->services, 0);
+  auto service = service_manager->getServices().front();
+  std::vector<std::string> watched;
+  Service::setHostWatcher(
+      [&watched](const std::string &host) { watched.push_back(host); });
+
+  ctl::CtlTask task;
+  task.command = ctl::CTL_COMMAND::ADD;
+  task.subject = ctl::CTL_SUBJECT::S_BACKEND;
+  task.data = R"({"id": 1, "weight": 1, "address": "127.0.0.2", "port": 80})";
+  EXPECT_EQ(JSON_OP_RESULT::OK, service->handleTask(task));
+  task.data =
+      R"({"id": 2, "weight": 1, "address": "backend.test", "port": 80})";
+  EXPECT_EQ(JSON_OP_RESULT::OK, service->handleTask(task));
+  Service::setHostWatcher(nullptr);
+
+  /* only the host name is left to the resolver */
+  EXPECT_EQ(std::vector<std::string>{"backend.test"}, watched);
+  EXPECT_EQ((std::vector<std::string>{"127.0.0.1", "127.0.0.2",
+                                      "backend.test"}),
+            service->getBackendHosts());
+}
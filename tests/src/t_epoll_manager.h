@@ -21,10 +21,14 @@
 
 #pragma once
 
+#include "../../src/config/global.h"
 #include "../../src/event/epoll_manager.h"
 #include "../../src/event/timer_fd.h"
 #include "testserver.h"
 #include "gtest/gtest.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <iostream>
 #include <thread>
 
 static void run_loop_server(bool testing){
@@ -94,3 +98,174 @@ TEST(EpollManagerTest, EpollManagerBasicOp) {
   EXPECT_TRUE(errno == ENOENT);
 
 }
+
+template <typename Handler>
+class CountHandler : public EpollManager<Handler> {
+ public:
+  int reads{0};
+  int writes{0};
+  void HandleEvent(int fd, EVENT_TYPE event_type,
+                   EVENT_GROUP event_group) {
+    if (event_type == EVENT_TYPE::READ) reads++;
+    if (event_type == EVENT_TYPE::WRITE) writes++;
+  }
+};
+
+class PipeHandler : public CountHandler<PipeHandler> {};
+
+TEST(EpollManagerTest, IoUringEngineEvents) {
+  if (!IoUringEngine::isSupported()) GTEST_SKIP();
+  global::run_options::getCurrent().event_engine =
+      static_cast<int>(EVENT_ENGINE::IO_URING);
+  PipeHandler e;
+  global::run_options::getCurrent().event_engine =
+      static_cast<int>(EVENT_ENGINE::EPOLL);
+  ASSERT_TRUE(e.getEngine() == EVENT_ENGINE::IO_URING);
+  int p[2];
+  ASSERT_EQ(::pipe2(p, O_NONBLOCK), 0);
+
+  /* Same errno semantics than epoll_ctl. */
+  EXPECT_TRUE(e.addFd(p[0], EVENT_TYPE::READ, EVENT_GROUP::SERVER));
+  EXPECT_FALSE(e.addFd(-1, EVENT_TYPE::READ, EVENT_GROUP::SERVER));
+  EXPECT_TRUE(errno == EBADF);
+
+  /* Nothing to read yet. */
+  EXPECT_EQ(e.loopOnce(50), 0);
+
+  /* Level triggered, the event is repeated while there is pending data. */
+  ASSERT_EQ(::write(p[1], "x", 1), 1);
+  EXPECT_EQ(e.loopOnce(50), 1);
+  EXPECT_EQ(e.loopOnce(50), 1);
+  EXPECT_EQ(e.reads, 2);
+  char c;
+  ASSERT_EQ(::read(p[0], &c, 1), 1);
+  EXPECT_EQ(e.loopOnce(50), 0);
+
+  /* Write events are one shot. */
+  EXPECT_TRUE(e.addFd(p[1], EVENT_TYPE::WRITE, EVENT_GROUP::SERVER));
+  EXPECT_EQ(e.loopOnce(50), 1);
+  EXPECT_EQ(e.loopOnce(50), 0);
+  EXPECT_EQ(e.writes, 1);
+  EXPECT_TRUE(e.updateFd(p[1], EVENT_TYPE::WRITE, EVENT_GROUP::SERVER));
+  EXPECT_EQ(e.loopOnce(50), 1);
+  EXPECT_EQ(e.writes, 2);
+
+  /* Deleted fds are not reported anymore. */
+  ASSERT_EQ(::write(p[1], "x", 1), 1);
+  EXPECT_TRUE(e.deleteFd(p[0]));
+  EXPECT_EQ(e.loopOnce(50), 0);
+  EXPECT_TRUE(e.deleteFd(p[0]));
+  EXPECT_TRUE(errno == ENOENT);
+  ::close(p[0]);
+  ::close(p[1]);
+}
+
+class AcceptHandler : public EpollManager<AcceptHandler> {
+ public:
+  int connects{0};
+  void HandleEvent(int fd, EVENT_TYPE event_type, EVENT_GROUP event_group) {
+    if (event_type == EVENT_TYPE::CONNECT) connects++;
+  }
+};
+
+TEST(EpollManagerTest, IoUringEngineExclusiveAccept) {
+  if (!IoUringEngine::isSupported()) GTEST_SKIP();
+  global::run_options::getCurrent().event_engine =
+      static_cast<int>(EVENT_ENGINE::IO_URING);
+  AcceptHandler workers[2];
+  global::run_options::getCurrent().event_engine =
+      static_cast<int>(EVENT_ENGINE::EPOLL);
+  int listener = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addr_len = sizeof(addr);
+  ASSERT_EQ(0, ::bind(listener, reinterpret_cast<sockaddr *>(&addr), addr_len));
+  ASSERT_EQ(0, ::listen(listener, 4));
+  ::getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &addr_len);
+  for (auto &worker : workers) {
+    ASSERT_TRUE(worker.getEngine() == EVENT_ENGINE::IO_URING);
+    ASSERT_TRUE(worker.handleAccept(listener));
+    /* submits the poll */
+    EXPECT_EQ(0, worker.loopOnce(0));
+  }
+
+  /* a single worker is woken up for the connection */
+  int client = ::socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_EQ(0, ::connect(client, reinterpret_cast<sockaddr *>(&addr),
+                         addr_len));
+  for (auto &worker : workers) worker.loopOnce(50);
+  EXPECT_EQ(1, workers[0].connects + workers[1].connects);
+  ::close(client);
+  ::close(listener);
+}
+
+class GenerationHandler : public CountHandler<GenerationHandler> {
+ public:
+  uint32_t generation{0};
+  uint32_t getFdGeneration(int fd) const override { return generation; }
+};
+
+TEST(EpollManagerTest, StaleEventsDiscarded) {
+  GenerationHandler e;
+  int p[2];
+  ASSERT_EQ(::pipe2(p, O_NONBLOCK), 0);
+  EXPECT_TRUE(e.addFd(p[0], EVENT_TYPE::READ, EVENT_GROUP::SERVER));
+  ASSERT_EQ(::write(p[1], "x", 1), 1);
+  EXPECT_EQ(e.loopOnce(50), 1);
+  EXPECT_EQ(e.reads, 1);
+
+  /* The fd has a new owner, events registered by the old one are stale. */
+  e.generation++;
+  EXPECT_EQ(e.loopOnce(50), 1);
+  EXPECT_EQ(e.reads, 1);
+  EXPECT_TRUE(e.updateFd(p[0], EVENT_TYPE::READ, EVENT_GROUP::SERVER));
+  EXPECT_EQ(e.loopOnce(50), 1);
+  EXPECT_EQ(e.reads, 2);
+  ::close(p[0]);
+  ::close(p[1]);
+}
+
+/* Prints the events dispatched per second on loopback connections with
+ * pending data. */
+TEST(EpollManagerTest, DispatchBenchmark) {
+  const int connections = 256;
+  PipeHandler e;
+  int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(listener, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addr_len = sizeof(addr);
+  ASSERT_EQ(::bind(listener, reinterpret_cast<sockaddr *>(&addr), addr_len), 0);
+  ASSERT_EQ(::listen(listener, connections), 0);
+  ASSERT_EQ(::getsockname(listener, reinterpret_cast<sockaddr *>(&addr),
+                          &addr_len), 0);
+  std::vector<int> fds;
+  for (int i = 0; i < connections; i++) {
+    int client = ::socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(::connect(client, reinterpret_cast<sockaddr *>(&addr), addr_len),
+              0);
+    int server = ::accept(listener, nullptr, nullptr);
+    ASSERT_GE(server, 0);
+    ASSERT_EQ(::write(client, "x", 1), 1);
+    /* level triggered, the data is never read so the event is repeated */
+    EXPECT_TRUE(e.addFd(server, EVENT_TYPE::READ, EVENT_GROUP::SERVER));
+    fds.push_back(client);
+    fds.push_back(server);
+  }
+  uint64_t events = 0;
+  auto start = std::chrono::steady_clock::now();
+  std::chrono::duration<double> elapsed{};
+  do {
+    for (int i = 0; i < 100; i++) events += e.loopOnce(0);
+    elapsed = std::chrono::steady_clock::now() - start;
+  } while (elapsed.count() < 1.0);
+  EXPECT_EQ(static_cast<uint64_t>(e.reads), events);
+  std::cout << "events/s: " << static_cast<uint64_t>(events / elapsed.count())
+            << std::endl;
+  RecordProperty("events_per_second",
+                 std::to_string(static_cast<uint64_t>(events / elapsed.count())));
+  for (auto fd : fds) ::close(fd);
+  ::close(listener);
+}
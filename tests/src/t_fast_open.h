@@ -0,0 +1,107 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <poll.h>
+#include <fstream>
+#include <string>
+#include "../../src/connection/connection.h"
+#include "../../src/util/network.h"
+#include "gtest/gtest.h"
+
+/* Both the client and the server side of TFO are enabled in the sysctl. */
+static bool fastOpenEnabled() {
+  int mode = 0;
+  std::ifstream("/proc/sys/net/ipv4/tcp_fastopen") >> mode;
+  return (mode & 3) == 3;
+}
+
+TEST(FastOpenTest, SendsFirstBytesInTheSyn) {
+  if (!fastOpenEnabled()) GTEST_SKIP();
+  int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addr_len = sizeof(addr);
+  ASSERT_EQ(0, ::bind(listener, reinterpret_cast<sockaddr *>(&addr), addr_len));
+  ASSERT_EQ(0, ::listen(listener, 4));
+  ASSERT_TRUE(Network::setTcpFastOpenOption(listener, 4));
+  ::getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &addr_len);
+  addrinfo address{};
+  address.ai_family = AF_INET;
+  address.ai_socktype = SOCK_STREAM;
+  address.ai_addr = reinterpret_cast<sockaddr *>(&addr);
+  address.ai_addrlen = addr_len;
+
+  /* the first connect to a new server only gets the cookie */
+  std::string request = "GET / HTTP/1.1\r\nHost: a\r\n\r\n";
+  int fast_connects = 0;
+  for (int i = 0; i < 2; i++) {
+    Connection connection;
+    ASSERT_EQ(IO::IO_OP::OP_IN_PROGRESS,
+              connection.doConnect(address, 1, true, true));
+    bool fast_open = connection.fast_open;
+    pollfd writable{connection.getFileDescriptor(), POLLOUT, 0};
+    ASSERT_EQ(1, ::poll(&writable, 1, 1000));
+    ASSERT_EQ(static_cast<ssize_t>(request.size()),
+              ::send(connection.getFileDescriptor(), request.data(),
+                     request.size(), MSG_NOSIGNAL));
+    int accepted = ::accept(listener, nullptr, nullptr);
+    ASSERT_GE(accepted, 0);
+    std::string received(request.size(), '\0');
+    EXPECT_EQ(static_cast<ssize_t>(request.size()),
+              ::read(accepted, &received[0], received.size()));
+    EXPECT_EQ(request, received);
+    EXPECT_EQ(fast_open, Network::isSynDataAcked(accepted));
+    EXPECT_EQ(fast_open,
+              Network::isSynDataAcked(connection.getFileDescriptor()));
+    if (fast_open) fast_connects++;
+    ::close(accepted);
+  }
+  EXPECT_GE(fast_connects, 1);
+  ::close(listener);
+}
+
+TEST(FastOpenTest, BlockingConnectDoesNotDeferTheSyn) {
+  int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addr_len = sizeof(addr);
+  ASSERT_EQ(0, ::bind(listener, reinterpret_cast<sockaddr *>(&addr), addr_len));
+  ASSERT_EQ(0, ::listen(listener, 4));
+  ::getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &addr_len);
+  addrinfo address{};
+  address.ai_family = AF_INET;
+  address.ai_socktype = SOCK_STREAM;
+  address.ai_addr = reinterpret_cast<sockaddr *>(&addr);
+  address.ai_addrlen = addr_len;
+
+  /* the health checks connect without sending anything */
+  Connection connection;
+  EXPECT_EQ(IO::IO_OP::OP_SUCCESS,
+            connection.doConnect(address, 1, false, true));
+  EXPECT_FALSE(connection.fast_open);
+  int accepted = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK);
+  EXPECT_GE(accepted, 0);
+  ::close(accepted);
+  ::close(listener);
+}
@@ -0,0 +1,161 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../../src/handlers/http_manager.h"
+#include "../../src/http/header_matcher.h"
+#include "../../src/http/http_stream.h"
+#include "gtest/gtest.h"
+#include "t_http_parser.h"
+
+/* Listener with @p rules HeadRemove patterns, a quarter of them regular
+ * patterns and the rest plain header names. */
+static std::shared_ptr<ListenerConfig> headRemoveConfig(int rules) {
+  auto listener_config = std::make_shared<ListenerConfig>();
+  ::regcomp(&listener_config->verb,
+            "^(GET|POST|HEAD|PUT|PATCH|DELETE|OPTIONS) ([^ ]+) HTTP/1.[01].*$",
+            REG_ICASE | REG_NEWLINE | REG_EXTENDED);
+  MATCHER **next = &listener_config->head_off;
+  for (int i = 0; i < rules; i++) {
+    auto n = std::to_string(i);
+    std::string pattern = i % 4 == 3   ? "^X-(Debug|Trace)-" + n + ":"
+                          : i % 2 == 0 ? "^X-Remove-" + n + ":"
+                                       : "X-Strip-" + n;
+    *next = new MATCHER();
+    ::regcomp(&(*next)->pat, pattern.c_str(),
+              REG_ICASE | REG_NEWLINE | REG_EXTENDED);
+    listener_config->head_remove.add(pattern, &(*next)->pat);
+    next = &(*next)->next;
+  }
+  return listener_config;
+}
+
+TEST(HeaderMatcherTest, ComparesLiteralPatterns) {
+  std::string text;
+  bool prefix;
+  EXPECT_TRUE(http::HeaderMatcher::isLiteral("X-Forwarded-For", text, prefix));
+  EXPECT_EQ("x-forwarded-for", text);
+  EXPECT_FALSE(prefix);
+  EXPECT_TRUE(http::HeaderMatcher::isLiteral("^Cookie:.*", text, prefix));
+  EXPECT_EQ("cookie:", text);
+  EXPECT_TRUE(prefix);
+  EXPECT_FALSE(http::HeaderMatcher::isLiteral("^X-.*-Id:", text, prefix));
+  EXPECT_FALSE(http::HeaderMatcher::isLiteral("Via$", text, prefix));
+  EXPECT_FALSE(http::HeaderMatcher::isLiteral("^", text, prefix));
+  EXPECT_FALSE(http::HeaderMatcher::isLiteral("X-(A|B)", text, prefix));
+
+  /* the regular patterns are only run on the lines starting with the text
+   * after their anchor */
+  EXPECT_EQ("x-", http::HeaderMatcher::anchoredPrefix("^X-(Debug|Trace):"));
+  EXPECT_EQ("x-i", http::HeaderMatcher::anchoredPrefix("^X-Id?:"));
+  EXPECT_EQ("via", http::HeaderMatcher::anchoredPrefix("^Via+"));
+  EXPECT_EQ("", http::HeaderMatcher::anchoredPrefix("X-(Debug|Trace):"));
+  EXPECT_EQ("", http::HeaderMatcher::anchoredPrefix("^X-Debug|Trace"));
+  EXPECT_EQ("", http::HeaderMatcher::anchoredPrefix("^[XY]-Debug"));
+}
+
+TEST(HeaderMatcherTest, MatchesHeaderLines) {
+  auto listener_config = headRemoveConfig(4);
+  auto &matcher = listener_config->head_remove;
+  EXPECT_TRUE(matcher.matches("X-Remove-0: a"));
+  EXPECT_TRUE(matcher.matches("x-remove-0: a"));
+  EXPECT_FALSE(matcher.matches("X-Remove-00: a"));
+  EXPECT_FALSE(matcher.matches("Y-X-Remove-0: a"));
+  EXPECT_TRUE(matcher.matches("X-Strip-1: a"));
+  EXPECT_TRUE(matcher.matches("Via: X-STRIP-1"));
+  EXPECT_TRUE(matcher.matches("X-Trace-3: a"));
+  EXPECT_TRUE(matcher.matches("x-debug-3: a"));
+  EXPECT_FALSE(matcher.matches("X-Debug-2: a"));
+  EXPECT_FALSE(matcher.matches("X-Strip"));
+  EXPECT_TRUE(http::HeaderMatcher().empty());
+
+  /* only the line of the header is matched, not the ones after it */
+  HttpStream stream;
+  stream.service_manager = std::make_shared<ServiceManager>(listener_config);
+  std::string request =
+      "GET / HTTP/1.1\r\nHost: a\r\nX-Keep: b\r\nX-STRIP-1: c\r\n"
+      "X-Debug-3: d\r\nx-remove-0:e\r\n\r\n";
+  size_t used = 0;
+  ASSERT_EQ(http_parser::PARSE_RESULT::SUCCESS,
+            stream.request.parseRequest(request, &used));
+  ASSERT_EQ(validation::REQUEST_RESULT::OK,
+            http_manager::validateRequest(stream));
+  ASSERT_EQ(5u, stream.request.num_headers);
+  std::vector<bool> removed;
+  for (size_t i = 0; i != stream.request.num_headers; i++)
+    removed.push_back(stream.request.headers[i].header_off);
+  EXPECT_EQ((std::vector<bool>{false, false, true, true, true}), removed);
+}
+
+/* Prints the requests of the parser corpus parsed and validated per second
+ * with 0, 10 and 50 HeadRemove patterns, against running each pattern
+ * through regexec() on every header as it was done before. */
+TEST(HeaderMatcherTest, ValidateRequestBenchmark) {
+  const int runs = 20;
+  const int rounds = 200;
+  auto plain = headRemoveConfig(0);
+  for (int rules : {0, 10, 50}) {
+    auto listener_config = headRemoveConfig(rules);
+    double best_matcher = 1e18, best_regex = 1e18;
+    HttpStream stream;
+    size_t used = 0;
+    for (int run = 0; run < runs; run++) {
+      for (bool regex : {false, true}) {
+        stream.service_manager =
+            std::make_shared<ServiceManager>(regex ? plain : listener_config);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds; i++) {
+          for (auto &message : request_corpus) {
+            stream.request.parseRequest(message.data(), message.size(), &used);
+            for (size_t h = 0; regex && h != stream.request.num_headers; h++) {
+              for (auto m = listener_config->head_off; m; m = m->next) {
+                if (::regexec(&m->pat, stream.request.headers[h].name, 0,
+                              nullptr, 0) == 0) {
+                  stream.request.headers[h].header_off = true;
+                  break;
+                }
+              }
+            }
+            ASSERT_EQ(validation::REQUEST_RESULT::OK,
+                      http_manager::validateRequest(stream));
+          }
+        }
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        auto &best = regex ? best_regex : best_matcher;
+        best = std::min(best, elapsed.count());
+      }
+    }
+    auto requests = static_cast<double>(rounds * request_corpus.size());
+    std::cout << rules << " rules: " << requests / best_matcher
+              << " requests/s, with regexec " << requests / best_regex
+              << " requests/s" << std::endl;
+    RecordProperty(std::to_string(rules) + "_rules_requests_per_second",
+                   std::to_string(requests / best_matcher));
+    RecordProperty(std::to_string(rules) + "_rules_regexec_requests_per_second",
+                   std::to_string(requests / best_regex));
+  }
+}
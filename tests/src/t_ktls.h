@@ -0,0 +1,123 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <fcntl.h>
+#include <poll.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <string>
+#include <thread>
+#include "../../src/connection/connection.h"
+#include "../../src/ssl/ssl_connection_manager.h"
+#include "gtest/gtest.h"
+#include "t_zero_copy.h"
+
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+
+/* Self signed P-256 certificate for "localhost", set on @p ctx. */
+static bool setSelfSignedCertificate(SSL_CTX *ctx) {
+  EVP_PKEY *key = EVP_EC_gen("P-256");
+  X509 *cert = X509_new();
+  bool done = false;
+  if (key != nullptr && cert != nullptr) {
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME *name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                               reinterpret_cast<const unsigned char *>("localhost"),
+                               -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    done = X509_sign(cert, key, EVP_sha256()) > 0 &&
+           SSL_CTX_use_certificate(ctx, cert) == 1 &&
+           SSL_CTX_use_PrivateKey(ctx, key) == 1;
+  }
+  X509_free(cert);
+  EVP_PKEY_free(key);
+  return done;
+}
+
+/* A TLS 1.3 server sends its session tickets after the handshake, and they
+ * reach a kTLS receive socket as control records mixed with the data. */
+TEST(KernelTlsTest, SessionTicketsOnKtlsReceive) {
+  std::shared_ptr<SSL_CTX> server_ctx(SSL_CTX_new(TLS_server_method()),
+                                      &::SSL_CTX_free);
+  std::shared_ptr<SSL_CTX> client_ctx(SSL_CTX_new(TLS_client_method()),
+                                      &::SSL_CTX_free);
+  ASSERT_TRUE(setSelfSignedCertificate(server_ctx.get()));
+  SSL_CTX_set_min_proto_version(server_ctx.get(), TLS1_3_VERSION);
+  SSL_CTX_set_num_tickets(server_ctx.get(), 2);
+  SSL_CTX_set_options(client_ctx.get(), SSL_OP_ENABLE_KTLS);
+  SSL_CTX_set_session_cache_mode(client_ctx.get(), SSL_SESS_CACHE_CLIENT);
+
+  int fds[2];
+  ASSERT_TRUE(tcpPair(fds));
+  const std::string data = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+  std::thread server([&] {
+    SSL *ssl = SSL_new(server_ctx.get());
+    SSL_set_fd(ssl, fds[1]);
+    if (SSL_accept(ssl) == 1) {
+      /* another ticket between the data records */
+      SSL_write(ssl, data.data(), static_cast<int>(data.size()));
+      SSL_new_session_ticket(ssl);
+      SSL_do_handshake(ssl);
+      SSL_write(ssl, data.data(), static_cast<int>(data.size()));
+      SSL_shutdown(ssl);
+    }
+    SSL_free(ssl);
+  });
+
+  Connection client;
+  client.setFileDescriptor(fds[0]);
+  ::fcntl(fds[0], F_SETFL, O_NONBLOCK);
+  pollfd pfd{fds[0], POLLIN, 0};
+  while (!client.ssl_connected &&
+         ssl::SSLConnectionManager::handleHandshake(client_ctx.get(), client,
+                                                    true))
+    ::poll(&pfd, 1, 1000);
+  bool connected = client.ssl_connected;
+  bool ktls_recv = client.ktls_recv;
+
+  std::string received;
+  IO::IO_RESULT result = IO::IO_RESULT::ERROR;
+  while (connected) {
+    result = ssl::SSLConnectionManager::handleDataRead(client);
+    if (result == IO::IO_RESULT::DONE_TRY_AGAIN) {
+      if (::poll(&pfd, 1, 1000) <= 0) break;
+      continue;
+    }
+    if (result != IO::IO_RESULT::SUCCESS) break;
+    received.append(client.buffer + client.buffer_offset, client.buffer_size);
+    client.buffer_size = 0;
+  }
+  server.join();
+  ::close(fds[1]);
+
+  ASSERT_TRUE(connected);
+  if (!ktls_recv) GTEST_SKIP() << "kTLS receive is not available";
+  EXPECT_EQ(IO::IO_RESULT::ZERO_DATA, result);
+  EXPECT_EQ(data + data, received);
+}
+
+#endif
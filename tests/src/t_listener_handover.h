@@ -0,0 +1,180 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <thread>
+#include "../../src/connection/connection.h"
+#include "../../src/stream/listener_handover.h"
+#include "../../src/util/network.h"
+#include "gtest/gtest.h"
+
+static int listenerPort(int fd) {
+  sockaddr_in addr{};
+  socklen_t addr_len = sizeof(addr);
+  ::getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &addr_len);
+  return ntohs(addr.sin_port);
+}
+
+TEST(ListenerHandoverTest, SendsListeningSockets) {
+  auto address = Network::getAddress("127.0.0.1", 0);
+  int first = Connection::listen(*address);
+  ASSERT_GT(first, 0);
+  int port = listenerPort(first);
+  /* a second socket of the same SO_REUSEPORT group */
+  address = Network::getAddress("127.0.0.1", port);
+  int second = Connection::listen(*address);
+  ASSERT_GT(second, 0);
+
+  ListenerHandover sender;
+  auto key = ListenerHandover::getKey("127.0.0.1", port);
+  sender.add(key, first);
+  sender.add(key, second);
+  int peer[2];
+  ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, peer));
+  ASSERT_TRUE(sender.send(peer[0]));
+  ::close(peer[0]);
+  ListenerHandover receiver;
+  ASSERT_TRUE(receiver.receive(peer[1]));
+  ::close(peer[1]);
+  ASSERT_EQ(2u, receiver.size());
+  EXPECT_EQ(-1, receiver.take("127.0.0.1:1"));
+
+  /* the connections queued before the handover are accepted by the receiver,
+   * the listeners only accept them once they have data */
+  int client = ::socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_EQ(0, ::connect(client, address->ai_addr, address->ai_addrlen));
+  ASSERT_EQ(1, ::write(client, "x", 1));
+  sender.clear();
+  int received[2] = {receiver.take(key), receiver.take(key)};
+  ASSERT_GE(received[0], 0);
+  ASSERT_GE(received[1], 0);
+  EXPECT_EQ(port, listenerPort(received[0]));
+  EXPECT_EQ(0u, receiver.size());
+  pollfd readable[2] = {{received[0], POLLIN, 0}, {received[1], POLLIN, 0}};
+  ASSERT_EQ(1, ::poll(readable, 2, 1000));
+  int accepted =
+      ::accept(readable[0].revents != 0 ? received[0] : received[1], nullptr,
+               nullptr);
+  EXPECT_GE(accepted, 0);
+  ::close(accepted);
+  ::close(client);
+  ::close(received[0]);
+  ::close(received[1]);
+}
+
+TEST(ListenerHandoverTest, ReceivesFromHandoverSocket) {
+  std::string path = "/tmp/zproxy_test_handover.socket";
+  int listen_fd = ListenerHandover::listen(path);
+  ASSERT_GT(listen_fd, 0);
+  struct stat info {};
+  ASSERT_EQ(0, ::stat(path.data(), &info));
+  EXPECT_EQ(static_cast<mode_t>(0600), info.st_mode & 0777);
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  bool trusted = false;
+  std::thread old_process([&] {
+    ListenerHandover sockets;
+    sockets.add("a:80", ::dup(fd));
+    pollfd readable{listen_fd, POLLIN, 0};
+    ::poll(&readable, 1, 1000);
+    int peer = ::accept(listen_fd, nullptr, nullptr);
+    trusted = ListenerHandover::isTrustedPeer(peer);
+    sockets.send(peer);
+    ::close(peer);
+  });
+  ListenerHandover handover;
+  EXPECT_TRUE(handover.receive(path));
+  old_process.join();
+  EXPECT_TRUE(trusted);
+  EXPECT_EQ(1u, handover.size());
+  ::close(listen_fd);
+  ::close(fd);
+  ::unlink(path.data());
+  /* nobody listening */
+  EXPECT_FALSE(handover.receive(path));
+}
+
+TEST(ListenerHandoverTest, RefusesOtherUsers) {
+  if (::geteuid() != 0) GTEST_SKIP() << "another user is needed";
+  std::string path = "/tmp/zproxy_test_handover.socket";
+  int listen_fd = ListenerHandover::listen(path);
+  ASSERT_GT(listen_fd, 0);
+  /* a socket anybody can connect to, to reach the credentials check */
+  std::string open_path = "/tmp/zproxy_test_handover_open.socket";
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::memcpy(address.sun_path, open_path.data(), open_path.size());
+  ::unlink(open_path.data());
+  int open_fd = ::socket(AF_UNIX, SOCK_SEQPACKET, 0);
+  ASSERT_EQ(0, ::bind(open_fd, reinterpret_cast<sockaddr *>(&address),
+                      sizeof(address)));
+  ::chmod(open_path.data(), 0666);
+  ASSERT_EQ(0, ::listen(open_fd, 1));
+
+  int done[2];
+  ASSERT_EQ(0, ::pipe(done));
+  pid_t child = ::fork();
+  if (child == 0) {
+    ::close(done[1]);
+    /* nobody */
+    if (::setgid(65534) != 0 || ::setuid(65534) != 0) ::_exit(2);
+    sockaddr_un handover_address{};
+    handover_address.sun_family = AF_UNIX;
+    std::memcpy(handover_address.sun_path, path.data(), path.size());
+    int fd = ::socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    /* the handover socket is not writable by other users */
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&handover_address),
+                  sizeof(handover_address)) == 0)
+      ::_exit(3);
+    ::close(fd);
+    fd = ::socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&address),
+                  sizeof(address)) != 0)
+      ::_exit(4);
+    /* keep the connection until the parent has checked it */
+    char byte;
+    ::_exit(::read(done[0], &byte, 1) == 0 ? 0 : 5);
+  }
+  ASSERT_GT(child, 0);
+  pollfd readable{open_fd, POLLIN, 0};
+  bool connected = ::poll(&readable, 1, 2000) > 0;
+  int peer = connected ? ::accept(open_fd, nullptr, nullptr) : -1;
+  bool trusted = peer >= 0 && ListenerHandover::isTrustedPeer(peer);
+  ::close(done[1]);
+  int status = 0;
+  ::waitpid(child, &status, 0);
+  ::close(done[0]);
+  ::close(peer);
+  ::close(open_fd);
+  ::close(listen_fd);
+  ::unlink(open_path.data());
+  ::unlink(path.data());
+
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(0, WEXITSTATUS(status));
+  EXPECT_TRUE(connected);
+  EXPECT_FALSE(trusted);
+}
@@ -0,0 +1,156 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../src/ctl/observer.h"
+#include "../../src/event/epoll_manager.h"
+#include "../../src/event/mailbox.h"
+#include "../../src/util/mpsc_queue.h"
+#include "gtest/gtest.h"
+
+TEST(MailboxTest, MpscQueueMultipleProducers) {
+  constexpr int producers = 4;
+  constexpr int items = 10000;
+  MpscQueue<int> queue;
+  int value;
+  EXPECT_TRUE(queue.empty());
+  EXPECT_FALSE(queue.pop(value));
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; p++) {
+    threads.emplace_back([&queue, p] {
+      for (int i = 0; i < items; i++) queue.push(p * items + i);
+    });
+  }
+  /* each producer items are consumed in the same order they were pushed */
+  std::vector<int> last(producers, -1);
+  int received = 0;
+  while (received < producers * items) {
+    if (!queue.pop(value)) continue;
+    int producer = value / items;
+    EXPECT_GT(value % items, last[producer]);
+    last[producer] = value % items;
+    received++;
+  }
+  for (auto &thread : threads) thread.join();
+  EXPECT_TRUE(queue.empty());
+}
+
+class MailboxHandler : public events::EpollManager<MailboxHandler>,
+                       public CtlObserver<std::string, std::string> {
+ public:
+  events::Mailbox mailbox;
+  std::atomic<bool> is_running{false};
+  std::thread::id loop_thread;
+
+  void HandleEvent(int fd, events::EVENT_TYPE event_type,
+                   events::EVENT_GROUP event_group) {
+    if (event_group == events::EVENT_GROUP::MAILBOX) mailbox.drain();
+  }
+  std::string handleTask(std::string &arg) override {
+    return std::this_thread::get_id() == loop_thread ? arg : "";
+  }
+  bool isHandler(std::string &arg) override { return true; }
+  bool postTask(std::function<void()> task) override {
+    if (!is_running) return false;
+    return mailbox.post(std::move(task));
+  }
+  void run() {
+    while (is_running) loopOnce(50);
+    mailbox.close();
+  }
+};
+
+class MailboxNotifier : public CtlNotify<std::string, std::string> {};
+
+TEST(MailboxTest, TasksRunInOwnerThread) {
+  MailboxHandler handler;
+  ASSERT_TRUE(handler.mailbox.enableEvents(&handler, events::EVENT_TYPE::READ,
+                                           events::EVENT_GROUP::MAILBOX));
+  /* the loop does not run, the task is executed by the notifier */
+  MailboxNotifier notifier;
+  notifier.attach(handler);
+  auto result = notifier.notify("ping");
+  ASSERT_EQ(result.size(), 1);
+  EXPECT_EQ(result[0].get(), "");
+
+  handler.is_running = true;
+  std::thread loop([&handler] { handler.run(); });
+  handler.loop_thread = loop.get_id();
+  for (int i = 0; i < 100; i++) {
+    result = notifier.notify("ping" + std::to_string(i));
+    ASSERT_EQ(result.size(), 1);
+    EXPECT_EQ(result[0].get(), "ping" + std::to_string(i));
+  }
+
+  /* tasks posted from several threads */
+  std::atomic<int> executed{0};
+  std::vector<std::thread> producers;
+  for (int p = 0; p < 4; p++) {
+    producers.emplace_back([&handler, &executed] {
+      for (int i = 0; i < 1000; i++) handler.postTask([&executed] { executed++; });
+    });
+  }
+  for (auto &producer : producers) producer.join();
+  handler.postTask([&handler] { handler.is_running = false; });
+  loop.join();
+  EXPECT_EQ(executed, 4000);
+  notifier.deAttach(handler);
+}
+
+TEST(MailboxTest, ClosedMailboxRefusesTasks) {
+  events::Mailbox mailbox;
+  int executed = 0;
+  EXPECT_TRUE(mailbox.post([&executed] { executed++; }));
+  /* the queued task runs, the later ones are left to the caller */
+  EXPECT_EQ(mailbox.close(), 1);
+  EXPECT_EQ(executed, 1);
+  EXPECT_FALSE(mailbox.post([&executed] { executed++; }));
+  EXPECT_EQ(mailbox.drain(), 0);
+  EXPECT_EQ(executed, 1);
+}
+
+TEST(MailboxTest, NoTaskIsLostWhenTheOwnerStops) {
+  MailboxHandler handler;
+  ASSERT_TRUE(handler.mailbox.enableEvents(&handler, events::EVENT_TYPE::READ,
+                                           events::EVENT_GROUP::MAILBOX));
+  handler.is_running = true;
+  std::thread loop([&handler] { handler.run(); });
+  std::atomic<int> executed{0};
+  std::vector<std::thread> producers;
+  for (int p = 0; p < 4; p++) {
+    producers.emplace_back([&handler, &executed] {
+      for (int i = 0; i < 10000; i++) {
+        if (!handler.mailbox.post([&executed] { executed++; })) executed++;
+      }
+    });
+  }
+  /* the loop stops while the producers are posting */
+  handler.mailbox.post([&handler] { handler.is_running = false; });
+  loop.join();
+  for (auto &producer : producers) producer.join();
+  /* every task either ran in the loop or was refused and run by its caller */
+  EXPECT_EQ(executed, 40000);
+}
@@ -0,0 +1,292 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <poll.h>
+#include <unistd.h>
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <thread>
+#include "../../src/config/config.h"
+#include "../../src/handlers/http_manager.h"
+#include "../../src/http/http_stream.h"
+#include "../../src/stream/stream_manager.h"
+#include "gtest/gtest.h"
+#include "t_zero_copy.h"
+#include "testserver.h"
+
+static std::shared_ptr<ServiceManager> pipelineServiceManager() {
+  auto listener_config = std::make_shared<ListenerConfig>();
+  ::regcomp(&listener_config->verb, "^(GET|POST|HEAD) ([^ ]+) HTTP/1.[01].*$",
+            REG_ICASE | REG_NEWLINE | REG_EXTENDED);
+  ::regcomp(&listener_config->url_pat, ".*", REG_NEWLINE | REG_EXTENDED);
+  return std::make_shared<ServiceManager>(listener_config);
+}
+
+/* Reads a whole response from the backend and validates it as the response
+ * of the request in @p stream. */
+static bool readResponse(HttpStream &stream, std::string &body) {
+  auto &backend = stream.backend_connection;
+  backend.acquireBuffer();
+  backend.buffer_size = 0;
+  size_t parsed = 0;
+  while (true) {
+    auto res = ::read(backend.getFileDescriptor(),
+                      backend.buffer + backend.buffer_size,
+                      backend.buffer_capacity - backend.buffer_size);
+    if (res <= 0) return false;
+    backend.buffer_size += static_cast<size_t>(res);
+    stream.response.reset_parser();
+    if (stream.response.parseResponse(backend.buffer, backend.buffer_size,
+                                      &parsed) ==
+            http_parser::PARSE_RESULT::SUCCESS &&
+        http_manager::validateResponse(stream) ==
+            validation::REQUEST_RESULT::OK &&
+        stream.response.message_bytes_left == 0)
+      break;
+  }
+  body.assign(stream.response.message, stream.response.message_length);
+  return true;
+}
+
+TEST(PipeliningTest, ForwardsPipelinedRequestsInOrder) {
+  HttpServerHandler server;
+  server.setUp("127.0.0.1", 9997);
+  std::atomic<bool> running{true};
+  std::thread backend_thread([&] {
+    while (running) server.loopOnce(50);
+  });
+
+  HttpStream stream;
+  stream.service_manager = pipelineServiceManager();
+  int client[2];
+  ASSERT_TRUE(tcpPair(client));
+  stream.client_connection.setFileDescriptor(client[1]);
+  int backend_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  auto address = Network::getAddress("127.0.0.1", 9997);
+  ASSERT_EQ(0, ::connect(backend_fd, address->ai_addr, address->ai_addrlen));
+  stream.backend_connection.setFileDescriptor(backend_fd);
+
+  /* the client sends all its requests in a single write */
+  std::string requests =
+      "POST /first HTTP/1.1\r\nHost: a\r\nContent-Length: 5\r\n\r\nhello"
+      "HEAD /second HTTP/1.1\r\nHost: a\r\n\r\n"
+      "GET /third HTTP/1.1\r\nHost: a\r\n\r\n";
+  ASSERT_EQ(static_cast<ssize_t>(requests.size()),
+            ::write(client[0], requests.data(), requests.size()));
+  while (stream.client_connection.buffer_size < requests.size())
+    stream.client_connection.read();
+
+  /* each request is forwarded once the previous response has been read */
+  std::string body;
+  for (std::string path : {"/first", "/second", "/third"}) {
+    size_t parsed = 0;
+    stream.request.reset_parser();
+    ASSERT_EQ(http_parser::PARSE_RESULT::SUCCESS,
+              stream.request.parseRequest(stream.client_connection.buffer,
+                                          stream.client_connection.buffer_size,
+                                          &parsed));
+    ASSERT_EQ(validation::REQUEST_RESULT::OK,
+              http_manager::validateRequest(stream));
+    EXPECT_EQ(path, std::string(stream.request.path,
+                                stream.request.path_length));
+    EXPECT_EQ(IO::IO_RESULT::SUCCESS,
+              stream.client_connection.writeTo(stream.backend_connection,
+                                               stream.request));
+    ASSERT_TRUE(readResponse(stream, body));
+    /* the Content-Length of a response to HEAD does not announce a body */
+    EXPECT_EQ(path == "/second" ? "" : path, body);
+  }
+  EXPECT_EQ(0u, stream.client_connection.buffer_size);
+  EXPECT_EQ(3, server.requests);
+
+  running = false;
+  backend_thread.join();
+  ::close(client[0]);
+}
+
+TEST(PipeliningTest, KeepsPartialPipelinedRequest) {
+  HttpStream stream;
+  stream.service_manager = pipelineServiceManager();
+  int client[2], backend[2];
+  ASSERT_TRUE(tcpPair(client) && tcpPair(backend));
+  stream.client_connection.setFileDescriptor(client[1]);
+  stream.backend_connection.setFileDescriptor(backend[0]);
+
+  std::string first = "GET /first HTTP/1.1\r\nHost: a\r\n\r\n";
+  std::string next = "GET /next HTTP/1.1\r\nHo";
+  ASSERT_EQ(static_cast<ssize_t>(first.size() + next.size()),
+            ::write(client[0], (first + next).data(),
+                    first.size() + next.size()));
+  while (stream.client_connection.buffer_size < first.size() + next.size())
+    stream.client_connection.read();
+
+  size_t parsed = 0;
+  ASSERT_EQ(http_parser::PARSE_RESULT::SUCCESS,
+            stream.request.parseRequest(stream.client_connection.buffer,
+                                        stream.client_connection.buffer_size,
+                                        &parsed));
+  ASSERT_EQ(validation::REQUEST_RESULT::OK,
+            http_manager::validateRequest(stream));
+  EXPECT_EQ(0u, stream.request.message_length);
+  EXPECT_EQ(IO::IO_RESULT::SUCCESS,
+            stream.client_connection.writeTo(stream.backend_connection,
+                                               stream.request));
+
+  /* only the first request reaches the backend, the incomplete one waits at
+   * the start of the buffer for the rest of its headers */
+  std::string forwarded(first.size() + next.size(), '\0');
+  EXPECT_EQ(static_cast<ssize_t>(first.size()),
+            ::read(backend[1], &forwarded[0], forwarded.size()));
+  ASSERT_EQ(next.size(), stream.client_connection.buffer_size);
+  EXPECT_EQ(next, std::string(stream.client_connection.buffer, next.size()));
+  ::close(client[0]);
+  ::close(backend[1]);
+}
+
+TEST(PipeliningTest, ParsesChunksSplitAtAnyByte) {
+  std::string body =
+      "6;name=value\r\n/first\r\n"
+      "A\r\n0123456789\r\n"
+      "0\r\nTrailer: x\r\n\r\n";
+  for (size_t split = 0; split <= body.size(); split++) {
+    http_parser::HttpData response;
+    response.reset_parser();
+    response.chunked_status = CHUNKED_STATUS::CHUNKED_ENABLED;
+    ASSERT_LE(0, http_manager::parseChunks(body.data(), split, response));
+    EXPECT_EQ(split == body.size(),
+              response.chunked_status == CHUNKED_STATUS::CHUNKED_LAST_CHUNK);
+    ASSERT_LE(0, http_manager::parseChunks(body.data() + split,
+                                           body.size() - split, response));
+    EXPECT_EQ(CHUNKED_STATUS::CHUNKED_LAST_CHUNK, response.chunked_status);
+    EXPECT_EQ(16u, response.content_length);
+  }
+  http_parser::HttpData response;
+  response.reset_parser();
+  response.chunked_status = CHUNKED_STATUS::CHUNKED_ENABLED;
+  EXPECT_EQ(-1, http_manager::parseChunks("x\r\n", 3, response));
+}
+
+/* Loads the configuration in @p text into @p config. */
+static bool loadConfig(const std::string &text, Config &config) {
+  char path[] = "/tmp/zproxy_test_XXXXXX";
+  int fd = ::mkstemp(path);
+  if (fd < 0) return false;
+  ::close(fd);
+  std::ofstream(path) << text;
+  bool done = config.init(std::string(path));
+  ::unlink(path);
+  return done;
+}
+
+/* Reads from @p fd until @p data ends with @p end, or for up to 2 seconds. */
+static bool readUntil(int fd, std::string &data, const std::string &end) {
+  char buffer[1024];
+  pollfd pfd{fd, POLLIN, 0};
+  while (data.size() < end.size() ||
+         data.compare(data.size() - end.size(), end.size(), end) != 0) {
+    if (::poll(&pfd, 1, 2000) <= 0) return false;
+    auto count = ::read(fd, buffer, sizeof(buffer));
+    if (count <= 0) return false;
+    data.append(buffer, static_cast<size_t>(count));
+  }
+  return true;
+}
+
+TEST(PipeliningTest, HoldsPipelinedRequestUntilChunkedResponseEnds) {
+  int backend_listener = ::socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  ::setsockopt(backend_listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  auto backend_address = Network::getAddress("127.0.0.1", 9995);
+  ASSERT_EQ(0, ::bind(backend_listener, backend_address->ai_addr,
+                      backend_address->ai_addrlen));
+  ASSERT_EQ(0, ::listen(backend_listener, 4));
+
+  Config config;
+  ASSERT_TRUE(loadConfig("ListenHTTP\n"
+                         "  Address 127.0.0.1\n"
+                         "  Port 9994\n"
+                         "  Service \"s\"\n"
+                         "    BackEnd\n"
+                         "      Address 127.0.0.1\n"
+                         "      Port 9995\n"
+                         "    End\n"
+                         "  End\n"
+                         "End\n",
+                         config));
+  auto service_manager = std::make_shared<ServiceManager>(config.listeners);
+  service_manager->addService(*config.listeners->services, 0);
+  StreamManager manager;
+  ASSERT_TRUE(manager.registerListener(service_manager));
+  manager.start();
+
+  /* the backend sends the chunked response in pieces and checks whether the
+   * next request arrives before its last chunk */
+  bool early_request = false;
+  bool second_request = false;
+  std::thread backend_thread([&] {
+    pollfd pfd{backend_listener, POLLIN, 0};
+    if (::poll(&pfd, 1, 2000) <= 0) return;
+    int fd = ::accept(backend_listener, nullptr, nullptr);
+    std::string request;
+    if (readUntil(fd, request, "\r\n\r\n")) {
+      std::string head =
+          "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+      ::send(fd, head.data(), head.size(), MSG_NOSIGNAL);
+      ::usleep(50000);
+      ::send(fd, "6\r\n/first\r\n", 11, MSG_NOSIGNAL);
+      ::usleep(50000);
+      pfd = {fd, POLLIN, 0};
+      early_request = ::poll(&pfd, 1, 0) > 0;
+      ::send(fd, "0\r\n\r\n", 5, MSG_NOSIGNAL);
+      request.clear();
+      second_request = readUntil(fd, request, "\r\n\r\n");
+      std::string response = "HTTP/1.1 200 OK\r\nContent-Length: 7\r\n\r\n/second";
+      ::send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+    }
+    ::close(fd);
+  });
+
+  int client = ::socket(AF_INET, SOCK_STREAM, 0);
+  auto address = Network::getAddress("127.0.0.1", 9994);
+  ASSERT_EQ(0, ::connect(client, address->ai_addr, address->ai_addrlen));
+  std::string requests =
+      "GET /first HTTP/1.1\r\nHost: a\r\n\r\n"
+      "GET /second HTTP/1.1\r\nHost: a\r\n\r\n";
+  ASSERT_EQ(static_cast<ssize_t>(requests.size()),
+            ::write(client, requests.data(), requests.size()));
+  std::string responses;
+  bool received = readUntil(client, responses, "/second");
+  backend_thread.join();
+  manager.stop();
+  ::close(client);
+  ::close(backend_listener);
+
+  EXPECT_TRUE(received);
+  EXPECT_FALSE(early_request);
+  EXPECT_TRUE(second_request);
+  auto last_chunk = responses.find("/first\r\n0\r\n\r\n");
+  auto second = responses.find("Content-Length: 7");
+  EXPECT_NE(std::string::npos, last_chunk);
+  EXPECT_NE(std::string::npos, second);
+  EXPECT_LT(last_chunk, second);
+}
@@ -0,0 +1,133 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <poll.h>
+#include <sys/utsname.h>
+#include <vector>
+#include "../../src/connection/connection.h"
+#include "../../src/util/cpu_topology.h"
+#include "../../src/util/network.h"
+#include "gtest/gtest.h"
+
+/* SO_INCOMING_CPU selects the socket of a SO_REUSEPORT group since Linux 6.1 */
+static bool incomingCpuSteersReusePort() {
+  utsname name{};
+  int major = 0, minor = 0;
+  if (::uname(&name) != 0 ||
+      std::sscanf(name.release, "%d.%d", &major, &minor) != 2)
+    return false;
+  return major > 6 || (major == 6 && minor >= 1);
+}
+
+/* Listens @p count sockets in the same SO_REUSEPORT group on 127.0.0.1. */
+static std::vector<int> listenReusePortGroup(int count, sockaddr_in &bound) {
+  std::vector<int> group;
+  auto address = Network::getAddress("127.0.0.1", 0);
+  for (int i = 0; i < count; i++) {
+    int fd = Connection::listen(*address);
+    if (fd <= 0) break;
+    ::fcntl(fd, F_SETFL, O_NONBLOCK);
+    if (i == 0) {
+      socklen_t len = sizeof(bound);
+      ::getsockname(fd, reinterpret_cast<sockaddr *>(&bound), &len);
+      address = Network::getAddress("127.0.0.1", ntohs(bound.sin_port));
+    }
+    group.push_back(fd);
+  }
+  return group;
+}
+
+/* Connects @p count clients to @p bound and counts the ones @p listen_fd
+ * accepts. */
+static int acceptedBy(int listen_fd, const sockaddr_in &bound, int count) {
+  std::vector<int> clients;
+  for (int i = 0; i < count; i++) {
+    int client = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (::connect(client, reinterpret_cast<const sockaddr *>(&bound),
+                  sizeof(bound)) != 0) {
+      ::close(client);
+      break;
+    }
+    clients.push_back(client);
+    /* the listeners defer the accept until the first data */
+    if (::write(client, "x", 1) != 1) break;
+  }
+  int accepted = 0;
+  pollfd pfd{listen_fd, POLLIN, 0};
+  while (accepted < count && ::poll(&pfd, 1, 1000) > 0) {
+    int fd = ::accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) break;
+    accepted++;
+    ::close(fd);
+  }
+  for (auto client : clients) ::close(client);
+  return accepted;
+}
+
+class ReusePortTest : public ::testing::Test {
+ protected:
+  cpu_set_t original{};
+  int cpu{};
+
+  void SetUp() override {
+    if (!incomingCpuSteersReusePort())
+      GTEST_SKIP() << "SO_INCOMING_CPU does not steer SO_REUSEPORT groups";
+    ASSERT_EQ(::sched_getaffinity(0, sizeof(original), &original), 0);
+    cpu = helper::CpuTopology::getAllowedCpus().front();
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    /* loopback packets are received on the sender cpu */
+    ASSERT_EQ(::sched_setaffinity(0, sizeof(cpuset), &cpuset), 0);
+  }
+
+  void TearDown() override {
+    if (CPU_COUNT(&original) > 0)
+      ::sched_setaffinity(0, sizeof(original), &original);
+  }
+};
+
+TEST_F(ReusePortTest, SteersToTheSocketOfTheCpu) {
+  sockaddr_in bound{};
+  auto group = listenReusePortGroup(2, bound);
+  ASSERT_EQ(group.size(), 2);
+  ASSERT_TRUE(Network::setIncomingCpu(group[1], cpu));
+  EXPECT_EQ(acceptedBy(group[1], bound, 8), 8);
+  EXPECT_LT(::accept(group[0], nullptr, nullptr), 0);
+  for (auto fd : group) ::close(fd);
+}
+
+TEST_F(ReusePortTest, SteeringDoesNotDependOnTheGroupOrder) {
+  sockaddr_in bound{};
+  auto group = listenReusePortGroup(4, bound);
+  ASSERT_EQ(group.size(), 4);
+  ASSERT_TRUE(Network::setIncomingCpu(group[3], cpu));
+  /* closing the first socket moves the last one to its slot, as happens when
+   * a listener is stopped or handed over */
+  ::close(group[0]);
+  EXPECT_EQ(acceptedBy(group[3], bound, 8), 8);
+  /* a cleared socket is no longer preferred */
+  ASSERT_TRUE(Network::setIncomingCpu(group[3], -1));
+  ASSERT_TRUE(Network::setIncomingCpu(group[1], cpu));
+  EXPECT_EQ(acceptedBy(group[1], bound, 8), 8);
+  for (size_t i = 1; i < group.size(); i++) ::close(group[i]);
+}
@@ -0,0 +1,110 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "../../src/stream/stream_table.h"
+#include "gtest/gtest.h"
+
+TEST(StreamTableTest, SetGetErase) {
+  StreamTable table;
+  auto stream = reinterpret_cast<HttpStream *>(0x10);
+  auto other = reinterpret_cast<HttpStream *>(0x20);
+
+  /* lookups never insert */
+  EXPECT_EQ(table.get(5), nullptr);
+  EXPECT_EQ(table.get(-1), nullptr);
+  EXPECT_EQ(table.get(1 << 20), nullptr);
+  EXPECT_EQ(table.size(), 0);
+  EXPECT_EQ(table.capacity(), STREAM_TABLE_INITIAL_SIZE);
+
+  auto generation = table.getGeneration(5);
+  table.set(5, stream);
+  EXPECT_EQ(table.get(5), stream);
+  EXPECT_NE(table.getGeneration(5), generation);
+  generation = table.getGeneration(5);
+  /* same owner, same generation */
+  table.set(5, stream);
+  EXPECT_EQ(table.getGeneration(5), generation);
+
+  table.erase(5);
+  EXPECT_EQ(table.get(5), nullptr);
+  EXPECT_NE(table.getGeneration(5), generation);
+  generation = table.getGeneration(5);
+  table.erase(5);
+  EXPECT_EQ(table.getGeneration(5), generation);
+
+  /* reused fd */
+  table.set(5, other);
+  EXPECT_NE(table.getGeneration(5), generation);
+  table.set(STREAM_TABLE_INITIAL_SIZE * 3, stream);
+  EXPECT_EQ(table.get(STREAM_TABLE_INITIAL_SIZE * 3), stream);
+  EXPECT_EQ(table.size(), 2);
+
+  int visited = 0;
+  table.forEach([&](int fd, HttpStream *) {
+    visited++;
+    table.erase(fd);
+  });
+  EXPECT_EQ(visited, 2);
+  EXPECT_EQ(table.size(), 0);
+}
+
+/* Prints the cost of a lookup per event against the std::unordered_map that
+ * the StreamManager used before. */
+TEST(StreamTableTest, LookupBenchmark) {
+  const int fds = 100000;
+  const int lookups = 5000000;
+  StreamTable table;
+  std::unordered_map<int, HttpStream *> map;
+  for (int fd = 0; fd < fds; fd++) {
+    table.set(fd, reinterpret_cast<HttpStream *>(fd + 1));
+    map[fd] = reinterpret_cast<HttpStream *>(fd + 1);
+  }
+  std::vector<int> keys(lookups);
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<int> dist(0, fds - 1);
+  for (auto &key : keys) key = dist(rng);
+
+  auto measure = [&](auto &&lookup) {
+    uintptr_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (auto key : keys) sum += reinterpret_cast<uintptr_t>(lookup(key));
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+    EXPECT_NE(sum, 0);
+    return static_cast<double>(ns) / lookups;
+  };
+  auto map_ns = measure([&](int fd) { return map[fd]; });
+  auto table_ns = measure([&](int fd) {
+    return table.getGeneration(fd) != 0 ? table.get(fd) : nullptr;
+  });
+  std::cout << "unordered_map lookup: " << map_ns << " ns\n"
+            << "StreamTable lookup + generation: " << table_ns << " ns"
+            << std::endl;
+  RecordProperty("unordered_map_ns", std::to_string(map_ns));
+  RecordProperty("stream_table_ns", std::to_string(table_ns));
+}
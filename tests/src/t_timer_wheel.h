@@ -0,0 +1,130 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <vector>
+#include "../../src/event/timer_wheel.h"
+#include "gtest/gtest.h"
+
+TEST(TimerWheelTest, ExpireOrder) {
+  events::TimerWheel wheel(0);
+  std::vector<events::TimerWheel::Timer> timers(3);
+  wheel.arm(timers[0], EVENT_GROUP::REQUEST_TIMEOUT, 50, 0);
+  wheel.arm(timers[1], EVENT_GROUP::CONNECT_TIMEOUT, 2000, 0);
+  wheel.arm(timers[2], EVENT_GROUP::RESPONSE_TIMEOUT, 120 * 1000, 0);
+  EXPECT_EQ(wheel.size(), 3);
+  EXPECT_GT(wheel.nextTimeout(500, 0), 0);
+
+  wheel.advance(49);
+  EXPECT_EQ(wheel.popExpired(), nullptr);
+  wheel.advance(70);
+  auto timer = wheel.popExpired();
+  ASSERT_EQ(timer, &timers[0]);
+  EXPECT_EQ(timer->group, EVENT_GROUP::REQUEST_TIMEOUT);
+  EXPECT_FALSE(timer->isSet());
+  EXPECT_EQ(wheel.popExpired(), nullptr);
+
+  /* cascaded from the upper levels */
+  wheel.advance(1999);
+  EXPECT_EQ(wheel.popExpired(), nullptr);
+  wheel.advance(2020);
+  EXPECT_EQ(wheel.popExpired(), &timers[1]);
+  wheel.advance(119 * 1000);
+  EXPECT_EQ(wheel.popExpired(), nullptr);
+  wheel.advance(121 * 1000);
+  EXPECT_EQ(wheel.popExpired(), &timers[2]);
+  EXPECT_EQ(wheel.size(), 0);
+  EXPECT_EQ(wheel.nextTimeout(500, 121 * 1000), 500);
+}
+
+TEST(TimerWheelTest, ExpiresBeyondWheelSpan) {
+  events::TimerWheel wheel(0);
+  events::TimerWheel::Timer timer;
+  /* the wheel spans TIMER_WHEEL_SIZE^TIMER_WHEEL_LEVELS ticks, ~46 hours */
+  const uint64_t span_ms =
+      (1ULL << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS)) * TIMER_WHEEL_TICK_MS;
+  const int timeout_ms = 100 * 3600 * 1000;
+  ASSERT_GT(static_cast<uint64_t>(timeout_ms), 2 * span_ms);
+  wheel.arm(timer, EVENT_GROUP::RESPONSE_TIMEOUT, timeout_ms, 0);
+
+  wheel.advance(span_ms + 1000);
+  EXPECT_EQ(wheel.popExpired(), nullptr);
+  wheel.advance(2 * span_ms + 1000);
+  EXPECT_EQ(wheel.popExpired(), nullptr);
+  wheel.advance(static_cast<uint64_t>(timeout_ms) - 1);
+  EXPECT_EQ(wheel.popExpired(), nullptr);
+  EXPECT_EQ(wheel.size(), 1);
+  wheel.advance(static_cast<uint64_t>(timeout_ms) + 2 * TIMER_WHEEL_TICK_MS);
+  EXPECT_EQ(wheel.popExpired(), &timer);
+  EXPECT_EQ(wheel.size(), 0);
+}
+
+TEST(TimerWheelTest, CancelAndRearm) {
+  events::TimerWheel wheel(0);
+  events::TimerWheel::Timer timer, other;
+  wheel.arm(timer, EVENT_GROUP::REQUEST_TIMEOUT, 100, 0);
+  wheel.cancel(timer);
+  EXPECT_FALSE(timer.isSet());
+  EXPECT_EQ(wheel.size(), 0);
+  wheel.cancel(timer);
+
+  /* rearming replaces the previous timeout */
+  wheel.arm(timer, EVENT_GROUP::CONNECT_TIMEOUT, 100, 0);
+  wheel.arm(timer, EVENT_GROUP::RESPONSE_TIMEOUT, 1000, 0);
+  EXPECT_EQ(wheel.size(), 1);
+  wheel.advance(500);
+  EXPECT_EQ(wheel.popExpired(), nullptr);
+
+  /* timers cancelled after expiring are not returned */
+  wheel.arm(other, EVENT_GROUP::REQUEST_TIMEOUT, 100, 500);
+  wheel.advance(1100);
+  wheel.cancel(other);
+  EXPECT_EQ(wheel.popExpired(), &timer);
+  EXPECT_EQ(timer.group, EVENT_GROUP::RESPONSE_TIMEOUT);
+  EXPECT_EQ(wheel.popExpired(), nullptr);
+
+  /* a zero timeout disarms the timer */
+  wheel.arm(timer, EVENT_GROUP::REQUEST_TIMEOUT, 0, 1100);
+  EXPECT_FALSE(timer.isSet());
+  EXPECT_EQ(wheel.size(), 0);
+}
+
+TEST(TimerWheelTest, ManyTimers) {
+  events::TimerWheel wheel(0);
+  std::vector<events::TimerWheel::Timer> timers(10000);
+  for (size_t i = 0; i < timers.size(); i++)
+    wheel.arm(timers[i], EVENT_GROUP::REQUEST_TIMEOUT,
+              static_cast<int>(i * 37 % 500000) + 1, 0);
+  EXPECT_EQ(wheel.size(), timers.size());
+  size_t expired = 0;
+  for (uint64_t now = 0; now <= 510000; now += 250) {
+    wheel.advance(now);
+    while (auto timer = wheel.popExpired()) {
+      auto index = static_cast<size_t>(timer - timers.data());
+      /* never before its timeout, at most two ticks later */
+      EXPECT_GE(now, index * 37 % 500000 + 1);
+      EXPECT_LE(now, index * 37 % 500000 + 1 + 250 + 2 * TIMER_WHEEL_TICK_MS);
+      expired++;
+    }
+  }
+  EXPECT_EQ(expired, timers.size());
+  EXPECT_EQ(wheel.size(), 0);
+}
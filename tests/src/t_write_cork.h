@@ -0,0 +1,127 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <netinet/tcp.h>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include "../../src/connection/connection.h"
+#include "../../src/util/network.h"
+#include "gtest/gtest.h"
+#include "t_zero_copy.h"
+
+/* glibc tcp_info stops before the segment counters of the kernel one. */
+struct TcpSegmentsInfo {
+  tcp_info info;
+  uint64_t pacing_rate;
+  uint64_t max_pacing_rate;
+  uint64_t bytes_acked;
+  uint64_t bytes_received;
+  uint32_t segs_out;
+  uint32_t segs_in;
+};
+
+static uint32_t segmentsOut(int fd) {
+  TcpSegmentsInfo tcp_info{};
+  socklen_t len = sizeof(tcp_info);
+  ::getsockopt(fd, IPPROTO_TCP, TCP_INFO, &tcp_info, &len);
+  return tcp_info.segs_out;
+}
+
+/* Sends a response whose body is written after the headers, as when the
+ * backend sends them apart, and reads it on @p peer_fd. Returns the number
+ * of segments used. */
+static uint32_t sendResponse(Connection &connection, int peer_fd,
+                             const std::string &headers,
+                             const std::string &body, bool cork) {
+  auto segments = segmentsOut(connection.getFileDescriptor());
+  size_t sent = 0;
+  if (cork) connection.setCork(true);
+  connection.write(headers.data(), headers.size(), sent);
+  connection.write(body.data(), body.size(), sent);
+  connection.setCork(false);
+  std::string received(headers.size() + body.size(), '\0');
+  size_t total = 0;
+  while (total < received.size()) {
+    auto n = ::read(peer_fd, &received[total], received.size() - total);
+    if (n <= 0) break;
+    total += static_cast<size_t>(n);
+  }
+  return segmentsOut(connection.getFileDescriptor()) - segments;
+}
+
+TEST(WriteCorkTest, HeadersLeaveWithTheBody) {
+  int out[2];
+  ASSERT_TRUE(tcpPair(out));
+  Network::setTcpNoDelayOption(out[0]);
+  Connection connection;
+  connection.setFileDescriptor(out[0]);
+  std::string headers =
+      "HTTP/1.1 200 OK\r\nContent-Length: 4096\r\nServer: test\r\n\r\n";
+  std::string body(4096, 'b');
+
+  EXPECT_EQ(2u, sendResponse(connection, out[1], headers, body, false));
+  EXPECT_EQ(1u, sendResponse(connection, out[1], headers, body, true));
+  EXPECT_FALSE(connection.corked);
+
+  connection.setCork(true);
+  EXPECT_TRUE(connection.corked);
+  connection.reset();
+  EXPECT_FALSE(connection.corked);
+  ::close(out[1]);
+}
+
+/* Prints the segments and the latency per response with the headers sent
+ * on their own and corked with the body. */
+TEST(WriteCorkTest, CorkBenchmark) {
+  const int responses = 2000;
+  std::string headers =
+      "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: "
+      "00000\r\nServer: test\r\n\r\n";
+  for (size_t size : {1024UL, 4096UL, 16384UL}) {
+    std::string body(size, 'b');
+    for (bool cork : {false, true}) {
+      int out[2];
+      ASSERT_TRUE(tcpPair(out));
+      Network::setTcpNoDelayOption(out[0]);
+      Connection connection;
+      connection.setFileDescriptor(out[0]);
+      uint64_t segments = 0;
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < responses; i++)
+        segments += sendResponse(connection, out[1], headers, body, cork);
+      std::chrono::duration<double, std::micro> elapsed =
+          std::chrono::steady_clock::now() - start;
+      std::string name = std::string(cork ? "cork" : "nodelay") + "_" +
+                         std::to_string(size >> 10) + "KB";
+      std::cout << name << " segments/response: "
+                << static_cast<double>(segments) / responses
+                << " us/response: " << elapsed.count() / responses
+                << std::endl;
+      RecordProperty(name + "_segments",
+                     std::to_string(static_cast<double>(segments) / responses));
+      connection.reset();
+      ::close(out[1]);
+    }
+  }
+}
@@ -0,0 +1,410 @@
+/*
+ *    Zevenet zproxy Load Balancer Software License
+ *    This file is part of the Zevenet zproxy Load Balancer software package.
+ *
+ *    Copyright (C) 2019-today ZEVENET SL, Sevilla (Spain)
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "../../src/connection/buffer_pool.h"
+#include "../../src/connection/connection.h"
+#include "../../src/connection/pipe_pool.h"
+#include "../../src/connection/segment_buffer.h"
+#include "gtest/gtest.h"
+
+/* Connected loopback TCP pair, like a client or a backend socket. */
+static bool tcpPair(int fds[2]) {
+  int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addr_len = sizeof(addr);
+  if (listener < 0 ||
+      ::bind(listener, reinterpret_cast<sockaddr *>(&addr), addr_len) != 0 ||
+      ::listen(listener, 1) != 0 ||
+      ::getsockname(listener, reinterpret_cast<sockaddr *>(&addr),
+                    &addr_len) != 0) {
+    if (listener >= 0) ::close(listener);
+    return false;
+  }
+  fds[0] = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (::connect(fds[0], reinterpret_cast<sockaddr *>(&addr), addr_len) != 0) {
+    ::close(fds[0]);
+    ::close(listener);
+    return false;
+  }
+  fds[1] = ::accept(listener, nullptr, nullptr);
+  ::close(listener);
+  return fds[1] >= 0;
+}
+
+#if ENABLE_ZERO_COPY
+
+/* Forwards @p size bytes from a sender thread to a receiver thread through
+ * @p connection, the way the StreamManager forwards a body. Returns the
+ * number of bytes received. */
+static size_t forwardBody(Connection &connection, int out_fd, size_t size,
+                          bool zero_copy) {
+  int in[2];
+  if (!tcpPair(in)) return 0;
+  connection.setFileDescriptor(in[1]);
+  ::fcntl(in[1], F_SETFL, O_NONBLOCK);
+  ::fcntl(out_fd, F_SETFL, O_NONBLOCK);
+
+  std::thread sender([&] {
+    std::string chunk(256 * 1024, '\0');
+    for (size_t i = 0; i < chunk.size(); i++) chunk[i] = static_cast<char>(i % 251);
+    size_t sent = 0;
+    while (sent < size) {
+      auto n = ::write(in[0], chunk.data() + sent % chunk.size(),
+                       std::min(size - sent, chunk.size() - sent % chunk.size()));
+      if (n <= 0) break;
+      sent += static_cast<size_t>(n);
+    }
+  });
+
+  size_t left = size;
+  while (left > 0) {
+    auto result = zero_copy
+                      ? connection.zeroRead(left - connection.getBufferedSize())
+                      : connection.segment_buffer.readFrom(
+                            in[1], left - connection.getBufferedSize());
+    if (result == IO::IO_RESULT::ERROR || result == IO::IO_RESULT::FD_CLOSED)
+      break;
+    size_t written = 0;
+    if (zero_copy)
+      result = connection.zeroWrite(out_fd, written);
+    else
+      result = connection.segment_buffer.writeTo(out_fd, written);
+    if (result == IO::IO_RESULT::ERROR) break;
+    left -= written;
+    if (written == 0) {
+      pollfd fds[2]{{in[1], POLLIN, 0}, {out_fd, POLLOUT, 0}};
+      ::poll(connection.getBufferedSize() > 0 ? &fds[1] : &fds[0], 1, 100);
+    }
+  }
+  sender.join();
+  ::close(in[0]);
+  return size - left;
+}
+
+/* Receives and checks the data generated by forwardBody(). */
+static void receiveBody(int fd, size_t size, size_t &received, bool &valid) {
+  std::string data(256 * 1024, '\0');
+  received = 0;
+  valid = true;
+  while (received < size) {
+    auto n = ::read(fd, &data[0], data.size());
+    if (n <= 0) break;
+    for (ssize_t i = 0; i < n && valid; i += 4093)
+      valid = data[i] == static_cast<char>(((received + i) % (256 * 1024)) % 251);
+    received += static_cast<size_t>(n);
+  }
+}
+
+TEST(ZeroCopyTest, SpliceForwardsUpToTheLimit) {
+  Connection connection;
+  int in[2], out[2];
+  ASSERT_TRUE(tcpPair(in));
+  ASSERT_TRUE(tcpPair(out));
+  connection.setFileDescriptor(in[1]);
+  ::fcntl(in[1], F_SETFL, O_NONBLOCK);
+  ::fcntl(out[0], F_SETFL, O_NONBLOCK);
+  /* the body and the beginning of the next request */
+  std::string body(1000, 'b');
+  std::string next = "GET / HTTP/1.1\r\n\r\n";
+  ASSERT_EQ(static_cast<ssize_t>(body.size() + next.size()),
+            ::write(in[0], (body + next).data(), body.size() + next.size()));
+  pollfd pfd{in[1], POLLIN, 0};
+  ASSERT_EQ(1, ::poll(&pfd, 1, 1000));
+
+  EXPECT_EQ(IO::IO_RESULT::FULL_BUFFER, connection.zeroRead(body.size()));
+  EXPECT_EQ(body.size(), connection.getBufferedSize());
+  size_t written = 0;
+  EXPECT_EQ(IO::IO_RESULT::SUCCESS, connection.zeroWrite(out[0], written));
+  EXPECT_EQ(body.size(), written);
+  EXPECT_EQ(0u, connection.getBufferedSize());
+  std::string received(body.size(), '\0');
+  EXPECT_EQ(static_cast<ssize_t>(body.size()),
+            ::read(out[1], &received[0], received.size()));
+  EXPECT_EQ(body, received);
+
+  /* the next request is left in the socket for the header parser */
+  EXPECT_EQ(IO::IO_RESULT::SUCCESS, connection.read());
+  EXPECT_EQ(next, std::string(connection.buffer, connection.buffer_size));
+  for (int fd : {in[0], out[0], out[1]}) ::close(fd);
+}
+
+TEST(ZeroCopyTest, PipePoolLeasesWhileSplicing) {
+  PipePool pool;
+  PipePool::setLocal(&pool);
+  {
+    Connection connection;
+    int in[2], out[2];
+    ASSERT_TRUE(tcpPair(in));
+    ASSERT_TRUE(tcpPair(out));
+    connection.setFileDescriptor(in[1]);
+    ::fcntl(in[1], F_SETFL, O_NONBLOCK);
+    ::fcntl(out[0], F_SETFL, O_NONBLOCK);
+
+    /* no data to splice, no pipe is held */
+    EXPECT_EQ(IO::IO_RESULT::DONE_TRY_AGAIN, connection.zeroRead());
+    EXPECT_EQ(0, pool.getStats().in_use.load());
+    EXPECT_EQ(1, pool.getStats().cached.load());
+    EXPECT_LT(0, pool.getStats().pipe_size.load());
+
+    ASSERT_EQ(4, ::write(in[0], "body", 4));
+    pollfd pfd{in[1], POLLIN, 0};
+    ASSERT_EQ(1, ::poll(&pfd, 1, 1000));
+    EXPECT_EQ(IO::IO_RESULT::SUCCESS, connection.zeroRead());
+    EXPECT_EQ(1, pool.getStats().in_use.load());
+    EXPECT_EQ(1u, pool.getStats().hits.load());
+    EXPECT_EQ(static_cast<size_t>(pool.getStats().pipe_size.load()),
+              connection.splice_pipe.size);
+    size_t written = 0;
+    EXPECT_EQ(IO::IO_RESULT::SUCCESS, connection.zeroWrite(out[0], written));
+    EXPECT_EQ(4u, written);
+    EXPECT_EQ(0, pool.getStats().in_use.load());
+    EXPECT_EQ(1, pool.getStats().cached.load());
+    EXPECT_EQ(1u, pool.getStats().misses.load());
+
+    /* a pipe with data of a closed connection is not reused */
+    ASSERT_EQ(4, ::write(in[0], "body", 4));
+    ASSERT_EQ(1, ::poll(&pfd, 1, 1000));
+    EXPECT_EQ(IO::IO_RESULT::SUCCESS, connection.zeroRead());
+    connection.reset();
+    EXPECT_EQ(0, pool.getStats().in_use.load());
+    EXPECT_EQ(0, pool.getStats().cached.load());
+    EXPECT_EQ(1u, pool.getStats().discarded.load());
+    for (int fd : {in[0], out[0], out[1]}) ::close(fd);
+  }
+  PipePool::setLocal(nullptr);
+}
+
+/* Prints the body forwarding throughput through the segment chain (copy) and
+ * the splice pipe. */
+TEST(ZeroCopyTest, DISABLED_ForwardBenchmark) {
+  BufferPool pool;
+  BufferPool::setLocal(&pool);
+  for (size_t size : {1UL << 20, 100UL << 20}) {
+    for (bool zero_copy : {false, true}) {
+      int out[2];
+      ASSERT_TRUE(tcpPair(out));
+      size_t received = 0, forwarded;
+      bool valid = false;
+      std::thread receiver(
+          [&] { receiveBody(out[1], size, received, valid); });
+      auto start = std::chrono::steady_clock::now();
+      {
+        Connection connection;
+        forwarded = forwardBody(connection, out[0], size, zero_copy);
+      }
+      receiver.join();
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      EXPECT_EQ(size, forwarded);
+      EXPECT_EQ(size, received);
+      EXPECT_TRUE(valid);
+      auto mb_per_second = static_cast<uint64_t>(
+          static_cast<double>(size) / (1 << 20) / elapsed.count());
+      std::string name = std::string(zero_copy ? "splice" : "copy") + "_" +
+                         std::to_string(size >> 20) + "MB";
+      std::cout << name << " MB/s: " << mb_per_second << std::endl;
+      RecordProperty(name + "_mb_per_second", std::to_string(mb_per_second));
+      ::close(out[0]);
+      ::close(out[1]);
+    }
+  }
+  BufferPool::setLocal(nullptr);
+}
+
+#ifdef MSG_ZEROCOPY
+
+TEST(ZeroCopyTest, SendKeepsSegmentsUntilCompletion) {
+  BufferPool pool;
+  BufferPool::setLocal(&pool);
+  int out[2];
+  ASSERT_TRUE(tcpPair(out));
+  ::fcntl(out[0], F_SETFL, O_NONBLOCK);
+  auto &stats = pool.getStats(BufferPool::CLASS_COUNT - 1);
+  std::string received(2 * MAX_DATA_SIZE, '\0');
+  auto receive = [&] {
+    size_t total = 0;
+    while (total < received.size()) {
+      auto n = ::read(out[1], &received[total], received.size() - total);
+      if (n <= 0) break;
+      total += static_cast<size_t>(n);
+    }
+    return total;
+  };
+  {
+    ZeroCopySender zerocopy;
+    zerocopy.threshold = 1;
+    SegmentBuffer segments;
+    std::string data(2 * MAX_DATA_SIZE, 'z');
+    segments.append(data.data(), data.size());
+    size_t sent = 0;
+    EXPECT_EQ(IO::IO_RESULT::SUCCESS, segments.writeTo(out[0], sent, &zerocopy));
+    EXPECT_EQ(data.size(), sent);
+    EXPECT_EQ(1u, zerocopy.sends);
+    /* the segments are not reused before the completion */
+    EXPECT_TRUE(zerocopy.hasPending());
+    EXPECT_EQ(2, stats.in_use.load());
+
+    /* on loopback the send completes once the data has been received */
+    EXPECT_EQ(data.size(), receive());
+    EXPECT_EQ(data, received);
+    pollfd pfd{out[0], 0, 0};
+    ASSERT_EQ(1, ::poll(&pfd, 1, 1000));
+    EXPECT_NE(0, pfd.revents & POLLERR);
+    EXPECT_TRUE(zerocopy.readCompletions(out[0]));
+    EXPECT_FALSE(zerocopy.hasPending());
+    EXPECT_EQ(0, stats.in_use.load());
+    EXPECT_EQ(2, stats.cached.load());
+
+    /* a socket closed with sends pending is kept until they complete, more
+     * data than the socket buffers hold is written so some are */
+    std::string large(64 * MAX_DATA_SIZE, 'l');
+    segments.append(large.data(), large.size());
+    while (segments.writeTo(out[0], sent, &zerocopy) ==
+           IO::IO_RESULT::SUCCESS)
+      segments.append(large.data(), large.size());
+    zerocopy.readCompletions(out[0]);
+    ASSERT_TRUE(zerocopy.hasPending());
+    segments.clear(&zerocopy);
+    zerocopy.close(out[0]);
+    EXPECT_FALSE(zerocopy.hasPending());
+    EXPECT_EQ(1u, pool.lingeringCount());
+    EXPECT_EQ(0, stats.in_use.load());
+    EXPECT_LT(0, stats.deferred.load());
+    /* the lingering sockets are checked on acquire */
+    size_t capacity;
+    auto acquireAndRelease = [&] {
+      auto buffer = pool.acquire(MAX_DATA_SIZE, capacity);
+      pool.release(buffer, capacity);
+    };
+    acquireAndRelease();
+    EXPECT_LT(0, stats.deferred.load());
+    EXPECT_EQ(0, ::fcntl(out[0], F_GETFD));
+
+    /* the peer gets the data written and the end of the stream */
+    std::string rest(large.size(), '\0');
+    size_t rest_size = 0;
+    ssize_t n;
+    while ((n = ::read(out[1], &rest[0], rest.size())) > 0)
+      rest_size += static_cast<size_t>(n);
+    EXPECT_EQ(0, n);
+    EXPECT_LT(0u, rest_size);
+    /* and by the worker loop */
+    for (int i = 0; i < 20 && pool.lingeringCount() > 0; i++) {
+      std::this_thread::sleep_for(
+          std::chrono::milliseconds(BUFFER_POOL_LINGER_INTERVAL));
+      pool.reapLingering();
+    }
+    EXPECT_EQ(0u, pool.lingeringCount());
+    EXPECT_EQ(0, stats.deferred.load());
+    EXPECT_EQ(0, stats.in_use.load());
+    EXPECT_EQ(-1, ::fcntl(out[0], F_GETFD));
+  }
+  ::close(out[1]);
+  BufferPool::setLocal(nullptr);
+}
+
+static double threadCpuSeconds() {
+  timespec ts{};
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+
+/* Prints the CPU time the sending thread spends per GB written with and
+ * without MSG_ZEROCOPY. It writes 512MB twice. */
+TEST(ZeroCopyTest, DISABLED_SendBenchmark) {
+  const size_t size = 512UL << 20;
+  BufferPool pool;
+  BufferPool::setLocal(&pool);
+  std::string chunk(SEGMENT_BUFFER_MAX_SEGMENTS * MAX_DATA_SIZE, 'z');
+  for (bool use_zerocopy : {false, true}) {
+    int out[2];
+    ASSERT_TRUE(tcpPair(out));
+    ::fcntl(out[0], F_SETFL, O_NONBLOCK);
+    size_t received = 0;
+    std::thread receiver([&] {
+      std::string data(256 * 1024, '\0');
+      while (received < size) {
+        auto n = ::read(out[1], &data[0], data.size());
+        if (n <= 0) break;
+        received += static_cast<size_t>(n);
+      }
+    });
+    double cpu = 0;
+    size_t left = size;
+    {
+      ZeroCopySender zerocopy;
+      zerocopy.threshold = use_zerocopy ? 16384 : 0;
+      SegmentBuffer segments;
+      while (left > 0) {
+        if (segments.empty())
+          segments.append(chunk.data(), std::min(left, chunk.size()));
+        auto start = threadCpuSeconds();
+        size_t sent = 0;
+        auto result = segments.writeTo(out[0], sent, &zerocopy);
+        if (zerocopy.hasPending()) zerocopy.readCompletions(out[0]);
+        cpu += threadCpuSeconds() - start;
+        if (result == IO::IO_RESULT::ERROR) break;
+        left -= sent;
+        if (result == IO::IO_RESULT::DONE_TRY_AGAIN) {
+          pollfd pfd{out[0], POLLOUT, 0};
+          ::poll(&pfd, 1, 100);
+        }
+      }
+      receiver.join();
+      while (zerocopy.hasPending()) {
+        pollfd pfd{out[0], 0, 0};
+        if (::poll(&pfd, 1, 100) <= 0 || !zerocopy.readCompletions(out[0]))
+          break;
+      }
+      EXPECT_FALSE(zerocopy.hasPending());
+      std::string name = use_zerocopy ? "zerocopy" : "copy";
+      auto ms_per_gb = static_cast<uint64_t>(cpu * 1000 * (1 << 30) / size);
+      std::cout << name << " sender cpu ms/GB: " << ms_per_gb
+                << " sends: " << zerocopy.sends
+                << " copied by the kernel: " << zerocopy.copied << std::endl;
+      RecordProperty(name + "_cpu_ms_per_gb", std::to_string(ms_per_gb));
+    }
+    EXPECT_EQ(0u, left);
+    EXPECT_EQ(size, received);
+    ::close(out[0]);
+    ::close(out[1]);
+  }
+  BufferPool::setLocal(nullptr);
+}
+
+#endif
+#endif
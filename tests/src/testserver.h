@@ -25,31 +25,51 @@
 #include "../../src/event/epoll_manager.h"
 #include "../../src/util/network.h"
 #include "gtest/gtest.h"
+#include <strings.h>
+#include <string>
 #include <thread>
 #include <unordered_map>
 
 using namespace events;
 
-class ServerHandler : public EpollManager {
+class ServerHandler : public EpollManager<ServerHandler> {
   Connection lst;
 
  public:
   void setUp(std::string addr, int port);
 
   void HandleEvent(int fd, EVENT_TYPE event_type,
-                   EVENT_GROUP event_group) override;
+                   EVENT_GROUP event_group);
 
   ServerHandler() {}
 };
 
-class ClientHandler : public EpollManager {
+/* HTTP/1.1 backend answering the requests of each connection in order, the
+ * response body is the request path. */
+class HttpServerHandler : public EpollManager<HttpServerHandler> {
+  Connection lst;
+  std::unordered_map<int, std::string> pending;
+
+ public:
+  /* requests answered */
+  int requests{0};
+
+  void setUp(std::string addr, int port);
+
+  void HandleEvent(int fd, EVENT_TYPE event_type,
+                   EVENT_GROUP event_group);
+
+  HttpServerHandler() {}
+};
+
+class ClientHandler : public EpollManager<ClientHandler> {
  public:
   std::unordered_map<int, Connection *> connections_set;
 
   void setUp(int n_clients, std::string addr, int port);
 
   void HandleEvent(int fd, EVENT_TYPE event_type,
-                   EVENT_GROUP event_group) override;
+                   EVENT_GROUP event_group);
 
   ClientHandler() {}
 };
@@ -172,3 +192,62 @@ void ServerHandler::HandleEvent(int fd, EVENT_TYPE event_type,
       break;
   }
 }
+
+void HttpServerHandler::setUp(std::string addr, int port) {
+  auto address = Network::getAddress(addr, port);
+  lst.setFileDescriptor(Connection::listen(*address));
+  handleAccept(lst.getFileDescriptor());
+}
+
+void HttpServerHandler::HandleEvent(int fd, EVENT_TYPE event_type,
+                                    EVENT_GROUP event_group) {
+  switch (event_type) {
+    case EVENT_TYPE::DISCONNECT: {
+      deleteFd(fd);
+      pending.erase(fd);
+      ::close(fd);
+      break;
+    }
+    case EVENT_TYPE::CONNECT: {
+      int new_fd;
+      do {
+        new_fd = Connection::doAccept(lst.getFileDescriptor());
+        if (new_fd > 0) addFd(new_fd, EVENT_TYPE::READ, EVENT_GROUP::SERVER);
+      } while (new_fd > 0);
+      break;
+    }
+    case EVENT_TYPE::READ: {
+      std::array<char, 4096> data;
+      auto res = ::read(fd, data.data(), data.size());
+      if (res <= 0) {
+        deleteFd(fd);
+        pending.erase(fd);
+        ::close(fd);
+        break;
+      }
+      auto &in = pending[fd];
+      in.append(data.data(), static_cast<size_t>(res));
+      std::string out;
+      size_t end;
+      while ((end = in.find("\r\n\r\n")) != std::string::npos) {
+        size_t length = 0;
+        auto header = in.find("\r\nContent-Length:");
+        if (header != std::string::npos && header < end)
+          length = std::stoul(in.substr(header + 17));
+        if (in.size() < end + 4 + length) break;
+        auto start = in.find(' ') + 1;
+        auto path = in.substr(start, in.find(' ', start) - start);
+        bool head = ::strncasecmp(in.data(), "HEAD ", 5) == 0;
+        out += "HTTP/1.1 200 OK\r\nContent-Length: " +
+               std::to_string(path.size()) + "\r\n\r\n";
+        if (!head) out += path;
+        in.erase(0, end + 4 + length);
+        requests++;
+      }
+      if (!out.empty()) ::write(fd, out.data(), out.size());
+      break;
+    }
+    default:
+      break;
+  }
+}